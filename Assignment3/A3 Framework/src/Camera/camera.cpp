@@ -13,6 +13,22 @@
 #include <cassert>
 #include <cmath>
 #include "camera.h"
+#if defined(__SSE2__)
+#include "../GML/gmlwide.h"
+
+// Number of rays that genViewRays() generates at once
+#if defined(__AVX__)
+#define RAY_WIDTH 8
+typedef gml::vec3x8_t vec3w_t;
+#else
+#define RAY_WIDTH 4
+typedef gml::vec3x4_t vec3w_t;
+#endif
+typedef vec3w_t::floatw_t floatw_t;
+
+// Lane numbers
+static const float LANES[8] = { 0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f };
+#endif
 
 Camera::Camera()
 {
@@ -20,6 +36,7 @@ Camera::Camera()
 	m_up = gml::vec3_t(0.0,1.0,0.0);
 	m_viewDir = gml::vec3_t(0.0,0.0,-1.0);
 	m_camPos = gml::vec3_t(0.0,0.0,0.0);
+	m_viewVersion = 0;
 	this->setWorldView();
 
 	m_projectionType = CAMERA_PROJECTION_PERSPECTIVE;
@@ -55,14 +72,21 @@ void Camera::setWindowToWorld()
 	windowToWorld[3][2] = 0.5f;
 	windowToWorld[3][3] = 1.0f;
 
-	// Calculate the inverses.
-	gml::mat4x4_t windowInverse = gml::inverse(windowToWorld);
-	gml::mat4x4_t worldViewInverse = gml::inverse(m_worldView);
-	gml::mat4x4_t orthoInverse = gml::inverse(m_ortho);
+	// Calculate the inverses. All three are affine.
+	gml::affine3x4_t windowInverse = gml::inverse(gml::affine(windowToWorld));
+	gml::affine3x4_t worldViewInverse = gml::inverse(gml::affine(m_worldView));
+	gml::affine3x4_t orthoInverse = gml::inverse(gml::affine(m_ortho));
 
 	// Finalize the window to world matrix.
-	m_windowToWorld = gml::mul(worldViewInverse, gml::mul(orthoInverse, windowInverse) );
-
+	const gml::affine3x4_t windowToCam = gml::mul(orthoInverse, windowInverse);
+	const gml::affine3x4_t windowToWorldA = gml::mul(worldViewInverse, windowToCam);
+	m_windowToWorld = gml::embed(windowToWorldA);
+
+	// It is linear in x & y. Window (0,0) on the near plane (z = 1) is
+	// found relative to the camera, so it does not lose precision to m_camPos.
+	m_rayCorner = gml::transformVector(worldViewInverse, gml::transformPoint(windowToCam, gml::vec3_t(0.0f, 0.0f, 1.0f)));
+	m_rayDx = windowToWorldA[0];
+	m_rayDy = windowToWorldA[1];
 }
 
 
@@ -81,6 +105,7 @@ void Camera::setWorldView()
 	m_worldView[1] = gml::vec4_t(m_right.y, m_up.y, m_viewDir.y, 0.0);
 	m_worldView[2] = gml::vec4_t(m_right.z, m_up.z, m_viewDir.z, 0.0);
 	m_worldView[3] = gml::vec4_t( -gml::dot(m_right, m_camPos), -gml::dot(m_up, m_camPos), -gml::dot(m_viewDir, m_camPos), 1.0);
+	m_viewVersion += 1;
 
 	setWindowToWorld();
 }
@@ -223,25 +248,95 @@ void Camera::setDepthClip(float near, float far)
 
 RayTracing::Ray_t Camera::genViewRay(float x, float y) const
 {
-	// TODO!!
-	// Generate a viewing ray with origin of the camera's
-	// position, and through the world-space position of
-	// the screen-space point (x,y).
-	//   Note: Use m_windowToWorld
-
-	// Create the ray.
+	// Generate a viewing ray through the world-space position of
+	// the screen-space point (x,y). From the camera's position with
+	// a perspective projection; along the view direction with an
+	// orthographic one.
+	//   m_rayCorner, m_rayDx & m_rayDy are m_windowToWorld at z = 1;
+	//   normally Z = 1 should be far plane, it is near here.
 	RayTracing::Ray_t ray;
+	const gml::vec3_t toPixel = m_rayCorner + x*m_rayDx + y*m_rayDy;
 
-	// Note that normally Z = 1 should be far plane,
-	// it is near here.
-	gml::vec4_t pixel = gml::vec4_t(x, y, 1, 1);
-	gml::vec4_t wPixel = gml::mul(m_windowToWorld, pixel);
+	if (m_projectionType == CAMERA_PROJECTION_PERSPECTIVE)
+	{
+		ray.o = m_camPos;
+		ray.d = gml::normalize(toPixel);
+	}
+	else
+	{
+		ray.o = m_camPos + toPixel;
+		ray.d = -m_viewDir;
+	}
+	return ray;
+}
 
-	// Initialize the ray.
-	ray.o = m_camPos;
-	ray.d = gml::normalize(gml::sub(gml::extract3(wPixel), m_camPos));
+RayTracing::RayCone_t Camera::getPixelCone() const
+{
+	// A pixel is |m_rayDy| high on the near plane. Perspective rays
+	// spread from the camera; orthographic ones stay that wide.
+	const float pixel = gml::length(m_rayDy);
+	if (m_projectionType == CAMERA_PROJECTION_PERSPECTIVE)
+	{
+		return RayTracing::RayCone_t(0.0f, pixel / getNearClip());
+	}
+	return RayTracing::RayCone_t(pixel, 0.0f);
+}
 
-	return ray;
+void Camera::genViewRays(const int x0, const int y0, const int width, const int height,
+		const float *jitterX, const float *jitterY, const ViewRayTile &rays) const
+{
+	// Pixel (x0 + c + jx, y0 + r + jy) is at
+	//   rowStart + (c + jx) m_rayDx + jy m_rayDy
+	// for the tile's row r; two multiply-adds per ray, rather than a
+	// matrix multiply.
+	const bool perspective = (m_projectionType == CAMERA_PROJECTION_PERSPECTIVE);
+	const gml::vec3_t back = -m_viewDir;
+#if defined(__SSE2__)
+	const vec3w_t camPos(m_camPos), dX(m_rayDx), dY(m_rayDy), backW(back);
+	const floatw_t lanes(LANES);
+#endif
+
+	int i = 0;
+	for (int r=0; r<height; r++)
+	{
+		const gml::vec3_t rowStart = m_rayCorner + (float)x0*m_rayDx + (float)(y0 + r)*m_rayDy;
+		int c = 0;
+#if defined(__SSE2__)
+		const vec3w_t rowStartW(rowStart);
+		for (; c+RAY_WIDTH <= width; c+=RAY_WIDTH, i+=RAY_WIDTH)
+		{
+			floatw_t x = gml::add( floatw_t((float)c), lanes );
+			// Either jitter may be given without the other; as the scalar tail
+			if (jitterX) x = gml::add( x, floatw_t(jitterX + i) );
+			vec3w_t toPixel = gml::add( rowStartW, gml::scale(x, dX) );
+			if (jitterY) toPixel = gml::add( toPixel, gml::scale(floatw_t(jitterY + i), dY) );
+
+			if (perspective)
+			{
+				gml::store(rays.ox + i, camPos.x); gml::store(rays.oy + i, camPos.y); gml::store(rays.oz + i, camPos.z);
+				const vec3w_t d = gml::normalize(toPixel);
+				gml::store(rays.dx + i, d.x); gml::store(rays.dy + i, d.y); gml::store(rays.dz + i, d.z);
+			}
+			else
+			{
+				const vec3w_t o = gml::add(camPos, toPixel);
+				gml::store(rays.ox + i, o.x); gml::store(rays.oy + i, o.y); gml::store(rays.oz + i, o.z);
+				gml::store(rays.dx + i, backW.x); gml::store(rays.dy + i, backW.y); gml::store(rays.dz + i, backW.z);
+			}
+		}
+#endif
+		// The rest of the row, one ray at a time
+		for (; c<width; c++, i++)
+		{
+			const float jx = (jitterX) ? jitterX[i] : 0.0f;
+			const float jy = (jitterY) ? jitterY[i] : 0.0f;
+			const gml::vec3_t toPixel = rowStart + ((float)c + jx)*m_rayDx + jy*m_rayDy;
+			const gml::vec3_t o = (perspective) ? m_camPos : gml::add(m_camPos, toPixel);
+			const gml::vec3_t d = (perspective) ? gml::normalize(toPixel) : back;
+			rays.ox[i] = o.x; rays.oy[i] = o.y; rays.oz[i] = o.z;
+			rays.dx[i] = d.x; rays.dy[i] = d.y; rays.dz[i] = d.z;
+		}
+	}
 }
 
 
@@ -31,6 +31,14 @@ typedef enum {
 	CAMERA_PROJECTION_ORTHOGRAPHIC
 } CameraProjection;
 
+// Viewing rays of a tile of pixels; a structure of arrays. Ray
+// r*width + c, of a width x height tile, is through its pixel (c, r).
+typedef struct
+{
+	float *ox, *oy, *oz; // Origin
+	float *dx, *dy, *dz; // Direction; normalized
+} ViewRayTile;
+
 // Camera with a right-handed cam-space coordinate frame
 class Camera
 {
@@ -44,6 +52,9 @@ protected:
 
 	// world to camera coordinate transform.
 	gml::mat4x4_t m_worldView;
+	// Incremented every time m_worldView changes; i.e. the camera moves.
+	// Consumers that cache data derived from it compare against this.
+	unsigned int m_viewVersion;
 
 	// Perspective projection matrix
 	gml::mat4x4_t m_perspective;
@@ -65,6 +76,10 @@ protected:
 	// Transformation matrix from window to world space
 	//  Does not incorporate the orthographic transform
 	gml::mat4x4_t m_windowToWorld;
+	// m_windowToWorld, taken apart for generating rays: window point
+	// (x,y), on the near plane, is at
+	//   m_camPos + m_rayCorner + x m_rayDx + y m_rayDy
+	gml::vec3_t m_rayCorner, m_rayDx, m_rayDy;
 	void setWindowToWorld();
 
 	// Setup m_worldToCam from m_viewDir, m_up, m_right, m_camPos
@@ -91,8 +106,10 @@ public:
 
 	const gml::mat4x4_t& getOrtho() const { return m_ortho; }
 	const gml::mat4x4_t& getWorldView() const { return m_worldView; }
+	unsigned int getViewVersion() const { return m_viewVersion; }
 	const gml::mat4x4_t& getProjection() const { return m_projection; }
 	const gml::vec3_t& getPosition() const { return m_camPos; }
+	const gml::vec3_t& getViewDir() const { return m_viewDir; }
 	float getFOV() const { return m_fov; }
 	float getAspect() const { return m_aspect; }
 	float getNearClip() const { return m_depthClip.x; }
@@ -101,6 +118,16 @@ public:
 	// Generate a viewing ray through pixel coordinates (x,y)
 	//   -- y=0 is the bottom of the image
 	RayTracing::Ray_t genViewRay(float x, float y) const;
+	// Cone, around each view ray, that covers one pixel
+	RayTracing::RayCone_t getPixelCone() const;
+	// Generate the viewing rays of a tile of pixels; the same rays as
+	// genViewRay(), several at a time.
+	//  (x0,y0) = pixel coordinates of the tile's bottom-left pixel
+	//  jitterX, jitterY = offset of each ray from its pixel; width*height
+	//     each, in the same order as the rays. 0 for no offsets.
+	//  rays = output; width*height rays
+	void genViewRays(const int x0, const int y0, const int width, const int height,
+			const float *jitterX, const float *jitterY, const ViewRayTile &rays) const;
 
 	// Movement controls
 	void moveForward(const float distance); // distance < 0 => backward
@@ -0,0 +1,91 @@
+
+/*
+ * Copyright:
+ * Daniel D. Neilson (ddneilson@ieee.org)
+ * University of Saskatchewan
+ * All rights reserved
+ *
+ * Permission granted to use for use in assignments and
+ * projects for CMPT 485 & CMPT 829 at the University
+ * of Saskatchewan.
+ */
+
+#include <cstdio>
+
+#include "framesync.h"
+#include "../GL3/gl3w.h"
+#include "../glUtils.h"
+
+// How long to wait on a fence before checking again; in nanoseconds
+static const GLuint64 FENCE_TIMEOUT = 100000000; // 100ms
+
+FrameSync::FrameSync()
+{
+	for (int i=0; i<FRAMESYNC_MAX_FRAMES; i++)
+	{
+		m_fences[i] = 0;
+	}
+	m_nFrames = 1;
+	m_slot = 0;
+	m_frameNum = 0;
+}
+
+FrameSync::~FrameSync()
+{
+	for (int i=0; i<FRAMESYNC_MAX_FRAMES; i++)
+	{
+		if (m_fences[i]) glDeleteSync(m_fences[i]);
+	}
+}
+
+bool FrameSync::init(const int framesInFlight)
+{
+	if (framesInFlight < 1 || framesInFlight > FRAMESYNC_MAX_FRAMES)
+	{
+		fprintf(stderr, "ERROR! Frames in flight must be in [1,%d]\n", FRAMESYNC_MAX_FRAMES);
+		return false;
+	}
+	for (int i=0; i<FRAMESYNC_MAX_FRAMES; i++)
+	{
+		if (m_fences[i]) glDeleteSync(m_fences[i]);
+		m_fences[i] = 0;
+	}
+	m_nFrames = framesInFlight;
+	m_slot = 0;
+	return !isGLError();
+}
+
+int FrameSync::beginFrame()
+{
+	GLsync fence = m_fences[m_slot];
+	if (fence)
+	{
+		// Flush on the first wait, so that the fence is sure to be signaled eventually
+		GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+		GLenum result;
+		do
+		{
+			result = glClientWaitSync(fence, flags, FENCE_TIMEOUT);
+			flags = 0;
+		} while (result == GL_TIMEOUT_EXPIRED);
+		if (result == GL_WAIT_FAILED)
+		{
+			fprintf(stderr, "ERROR! Waiting on frame fence failed\n");
+		}
+		glDeleteSync(fence);
+		m_fences[m_slot] = 0;
+	}
+	return m_slot;
+}
+
+void FrameSync::endFrame()
+{
+	if (m_fences[m_slot]) glDeleteSync(m_fences[m_slot]);
+	m_fences[m_slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	if ( !m_fences[m_slot] )
+	{
+		fprintf(stderr, "ERROR! Could not create frame fence\n");
+	}
+	m_slot = (m_slot + 1) % m_nFrames;
+	m_frameNum += 1;
+}
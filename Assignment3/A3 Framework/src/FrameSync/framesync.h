@@ -0,0 +1,65 @@
+
+/*
+ * Copyright:
+ * Daniel D. Neilson (ddneilson@ieee.org)
+ * University of Saskatchewan
+ * All rights reserved
+ *
+ * Permission granted to use for use in assignments and
+ * projects for CMPT 485 & CMPT 829 at the University
+ * of Saskatchewan.
+ */
+
+/*
+ * Bounds how many frames the CPU may run ahead of the GL.
+ *
+ * Instead of a glFinish() at the end of every frame, a fence is placed
+ * after each frame's commands. Before a frame begins, the CPU waits only
+ * for the fence of the frame that last used the same slot; i.e. the one
+ * from (frames in flight) frames ago.
+ *
+ * Dynamic resources that the CPU writes each frame should have one copy
+ * per slot, and the frame should only touch the copy for its slot.
+ * Once beginFrame() returns, the GL is done with that copy.
+ */
+
+#pragma once
+#ifndef __INC_FRAMESYNC_H_
+#define __INC_FRAMESYNC_H_
+
+#include "../GL3/gl3.h"
+
+// Most frames that may be in flight at once
+#define FRAMESYNC_MAX_FRAMES 4
+
+class FrameSync
+{
+protected:
+	// Fence placed after the last frame that used each slot; 0 => none
+	GLsync m_fences[FRAMESYNC_MAX_FRAMES];
+	// Number of frames allowed in flight
+	int m_nFrames;
+	// Slot of the current frame
+	int m_slot;
+	// Number of frames that have been ended
+	GLuint m_frameNum;
+public:
+	FrameSync();
+	~FrameSync();
+
+	// framesInFlight = [1, FRAMESYNC_MAX_FRAMES]
+	// Return true if successful
+	bool init(const int framesInFlight);
+
+	// Wait until the GL is done with the frame that last used the
+	// next slot. Returns the slot to use for this frame.
+	int beginFrame();
+	// Call once all of the frame's GL commands have been issued.
+	void endFrame();
+
+	int getSlot() const { return m_slot; }
+	int getNumSlots() const { return m_nFrames; }
+	GLuint getFrameNum() const { return m_frameNum; }
+};
+
+#endif
@@ -0,0 +1,90 @@
+
+/*
+ * Copyright:
+ * Daniel D. Neilson (ddneilson@ieee.org)
+ * University of Saskatchewan
+ * All rights reserved
+ *
+ * Permission granted to use for use in assignments and
+ * projects for CMPT 485 & CMPT 829 at the University
+ * of Saskatchewan.
+ */
+
+#pragma once
+
+// Inline function definitions for affine transformations.
+// This file should not be directly included by anything other than gml.h
+
+inline affine3x4_t affine(const mat4x4_t M)
+{
+	return affine3x4_t( extract3(M[0]), extract3(M[1]), extract3(M[2]), extract3(M[3]) );
+}
+
+inline affine3x4_t affine(const mat3x3_t L, const vec3_t t)
+{
+	return affine3x4_t( L[0], L[1], L[2], t );
+}
+
+inline mat4x4_t embed(const affine3x4_t A)
+{
+	mat4x4_t dst;
+	dst[0] = vec4_t(A[0], 0.0f);
+	dst[1] = vec4_t(A[1], 0.0f);
+	dst[2] = vec4_t(A[2], 0.0f);
+	dst[3] = vec4_t(A[3], 1.0f);
+	return dst;
+}
+
+inline mat3x3_t extract(const affine3x4_t A)
+{
+	return mat3x3_t( A[0], A[1], A[2] );
+}
+
+inline vec3_t transformVector(const affine3x4_t A, const vec3_t v)
+{
+	return vec3_t( A[0].x*v.x + A[1].x*v.y + A[2].x*v.z,
+			A[0].y*v.x + A[1].y*v.y + A[2].y*v.z,
+			A[0].z*v.x + A[1].z*v.y + A[2].z*v.z );
+}
+
+inline vec3_t transformPoint(const affine3x4_t A, const vec3_t p)
+{
+	return vec3_t( A[0].x*p.x + A[1].x*p.y + A[2].x*p.z + A[3].x,
+			A[0].y*p.x + A[1].y*p.y + A[2].y*p.z + A[3].y,
+			A[0].z*p.x + A[1].z*p.y + A[2].z*p.z + A[3].z );
+}
+
+ // [ Lx tx ] [ Ly ty ] = [ Lx Ly   Lx ty + tx ]
+ // [ 0  1  ] [ 0  1  ]   [ 0       1          ]
+inline affine3x4_t mul(const affine3x4_t X, const affine3x4_t Y)
+{
+	return affine3x4_t( transformVector(X, Y[0]), transformVector(X, Y[1]),
+			transformVector(X, Y[2]), transformPoint(X, Y[3]) );
+}
+
+ // For L with columns c0, c1, c2: the rows of inverse(L) are
+ //  (c1 x c2), (c2 x c0) & (c0 x c1), divided by det(L) = c0.(c1 x c2)
+ // So, those are the columns of the normal matrix.
+inline mat3x3_t normalMatrix(const affine3x4_t A)
+{
+	const vec3_t r0 = cross(A[1], A[2]);
+	const vec3_t r1 = cross(A[2], A[0]);
+	const vec3_t r2 = cross(A[0], A[1]);
+	const float invDet = 1.0f / dot(A[0], r0);
+	return mat3x3_t( scale(invDet, r0), scale(invDet, r1), scale(invDet, r2) );
+}
+
+ // [ L t ]^-1 = [ inverse(L)  -inverse(L) t ]
+ // [ 0 1 ]      [ 0            1            ]
+inline affine3x4_t inverse(const affine3x4_t A)
+{
+	// Rows of inverse(L), as in normalMatrix()
+	const vec3_t r0 = cross(A[1], A[2]);
+	const vec3_t r1 = cross(A[2], A[0]);
+	const vec3_t r2 = cross(A[0], A[1]);
+	const float invDet = 1.0f / dot(A[0], r0);
+	return affine3x4_t( vec3_t(r0.x*invDet, r1.x*invDet, r2.x*invDet),
+			vec3_t(r0.y*invDet, r1.y*invDet, r2.y*invDet),
+			vec3_t(r0.z*invDet, r1.z*invDet, r2.z*invDet),
+			vec3_t(-dot(r0, A[3])*invDet, -dot(r1, A[3])*invDet, -dot(r2, A[3])*invDet) );
+}
@@ -0,0 +1,160 @@
+
+/*
+ * Copyright:
+ * Daniel D. Neilson (ddneilson@ieee.org)
+ * University of Saskatchewan
+ * All rights reserved
+ *
+ * Permission granted to use for use in assignments and
+ * projects for CMPT 485 & CMPT 829 at the University
+ * of Saskatchewan.
+ */
+
+#pragma once
+// Vector operators: a + b, a - b, -a, s * a, a * s, a / s, and a * b
+// (component-wise, as mul()), plus +=, -= and *=.
+//  The operators do not compute anything. They build an expression,
+// which is evaluated, one component at a time, when it becomes a vector:
+//   vec3_t n = w0*n0 + w1*n1 + w2*n2;
+// is a single pass over x, y & z with no intermediate vectors; where the
+// same chain of scale() & add() calls makes a vector for each call.
+//  An expression refers to the vectors in it, so do not keep one past the
+// end of the statement; e.g. in an "auto" variable.
+// This file should not be directly included by anything other than gml.h
+
+// A vector in an expression
+template <typename TYPE>
+struct _leaf_t
+{
+	const TYPE &v;
+	_leaf_t(const TYPE &_v) : v(_v) {}
+	float operator[](const int i) const { return (&v.x)[i]; }
+};
+
+// Expression nodes; one per operator
+template <typename A, typename B>
+struct _addExpr_t
+{
+	const A a; const B b;
+	_addExpr_t(const A &_a, const B &_b) : a(_a), b(_b) {}
+	float operator[](const int i) const { return a[i] + b[i]; }
+};
+template <typename A, typename B>
+struct _subExpr_t
+{
+	const A a; const B b;
+	_subExpr_t(const A &_a, const B &_b) : a(_a), b(_b) {}
+	float operator[](const int i) const { return a[i] - b[i]; }
+};
+template <typename A, typename B>
+struct _mulExpr_t
+{
+	const A a; const B b;
+	_mulExpr_t(const A &_a, const B &_b) : a(_a), b(_b) {}
+	float operator[](const int i) const { return a[i] * b[i]; }
+};
+template <typename A>
+struct _scaleExpr_t
+{
+	const float s; const A a;
+	_scaleExpr_t(const float _s, const A &_a) : s(_s), a(_a) {}
+	float operator[](const int i) const { return s * a[i]; }
+};
+template <typename A>
+struct _negExpr_t
+{
+	const A a;
+	_negExpr_t(const A &_a) : a(_a) {}
+	float operator[](const int i) const { return -a[i]; }
+};
+
+// An N component expression. Converts to the vector type of size N.
+template <typename E, int N>
+struct _expr_t
+{
+	const E e;
+	_expr_t(const E &_e) : e(_e) {}
+	float operator[](const int i) const { return e[i]; }
+};
+
+// What an operand is in an expression. Only defined for the vector types
+// and expressions, so the operators do not apply to anything else.
+template <typename T> struct _exprOf {};
+template <> struct _exprOf<vec2_t>
+{
+	typedef _leaf_t<vec2_t> type; typedef vec2_t vec_t; enum { N = 2 };
+	static type get(const vec2_t &v) { return type(v); }
+};
+template <> struct _exprOf<vec3_t>
+{
+	typedef _leaf_t<vec3_t> type; typedef vec3_t vec_t; enum { N = 3 };
+	static type get(const vec3_t &v) { return type(v); }
+};
+template <> struct _exprOf<vec4_t>
+{
+	typedef _leaf_t<vec4_t> type; typedef vec4_t vec_t; enum { N = 4 };
+	static type get(const vec4_t &v) { return type(v); }
+};
+template <typename E, int _N> struct _exprOf< _expr_t<E,_N> >
+{
+	typedef E type; enum { N = _N };
+	static const E& get(const _expr_t<E,_N> &x) { return x.e; }
+};
+
+// Binary operators on two vectors, or expressions
+#define DEF_BINARY_OP(OP, NODE) \
+	template <typename A, typename B> \
+	inline _expr_t< NODE<typename _exprOf<A>::type, typename _exprOf<B>::type>, _exprOf<A>::N > \
+	OP(const A &a, const B &b) \
+	{ \
+		static_assert((int)_exprOf<A>::N == (int)_exprOf<B>::N, "gml: vectors of different sizes"); \
+		typedef NODE<typename _exprOf<A>::type, typename _exprOf<B>::type> node_t; \
+		return _expr_t< node_t, _exprOf<A>::N >( node_t(_exprOf<A>::get(a), _exprOf<B>::get(b)) ); \
+	}
+DEF_BINARY_OP(operator+, _addExpr_t)
+DEF_BINARY_OP(operator-, _subExpr_t)
+DEF_BINARY_OP(operator*, _mulExpr_t)
+#undef DEF_BINARY_OP
+
+// -a
+template <typename A>
+inline _expr_t< _negExpr_t<typename _exprOf<A>::type>, _exprOf<A>::N > operator-(const A &a)
+{
+	typedef _negExpr_t<typename _exprOf<A>::type> node_t;
+	return _expr_t< node_t, _exprOf<A>::N >( node_t(_exprOf<A>::get(a)) );
+}
+
+// s a, a s, and a / s
+template <typename A>
+inline _expr_t< _scaleExpr_t<typename _exprOf<A>::type>, _exprOf<A>::N > operator*(const float s, const A &a)
+{
+	typedef _scaleExpr_t<typename _exprOf<A>::type> node_t;
+	return _expr_t< node_t, _exprOf<A>::N >( node_t(s, _exprOf<A>::get(a)) );
+}
+template <typename A>
+inline _expr_t< _scaleExpr_t<typename _exprOf<A>::type>, _exprOf<A>::N > operator*(const A &a, const float s)
+{
+	return s * a;
+}
+template <typename A>
+inline _expr_t< _scaleExpr_t<typename _exprOf<A>::type>, _exprOf<A>::N > operator/(const A &a, const float s)
+{
+	return (1.0f / s) * a;
+}
+
+// a += b, a -= b, a *= s; a is a vector.
+template <typename A, typename B>
+inline typename _exprOf<A>::vec_t& operator+=(A &a, const B &b)
+{
+	return a = a + b;
+}
+template <typename A, typename B>
+inline typename _exprOf<A>::vec_t& operator-=(A &a, const B &b)
+{
+	return a = a - b;
+}
+template <typename A>
+inline typename _exprOf<A>::vec_t& operator*=(A &a, const float s)
+{
+	return a = s * a;
+}
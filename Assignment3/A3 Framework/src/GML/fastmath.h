@@ -0,0 +1,263 @@
+
+/*
+ * Copyright:
+ * Daniel D. Neilson (ddneilson@ieee.org)
+ * University of Saskatchewan
+ * All rights reserved
+ *
+ * Permission granted to use for use in assignments and
+ * projects for CMPT 485 & CMPT 829 at the University
+ * of Saskatchewan.
+ */
+
+/*
+ * Fast approximations of the elementary functions, for gml.
+ *
+ * gml::fast has polynomial approximations of:
+ *   atan2, asin, exp2, log2, pow, sincos, rsqrt
+ * They have no calls, no tables and no data dependent branches, so the
+ * compiler can vectorize loops that use them.
+ *
+ * Maximum error, measured against double precision over the domain
+ * given (abs = absolute, rel = relative):
+ *   atan2(y, x)   any finite y, x              abs 3e-7 radians
+ *   asin(x)       [-1, 1]                      abs 3e-7 radians
+ *   exp2(x)       [-126, 127]                  rel 3e-7
+ *   log2(x)       normal floats, x > 0         abs 1.5e-7 in [1/2, 2];
+ *                                              else rel 1.2e-7
+ *   pow(x, y)     x in (0, 1], y in [0, 256]   rel 3e-5
+ *                 (log2's error, times y; so it grows with |y|)
+ *   sincos(x)     |x| <= 8192                  abs 9e-8
+ *   rsqrt(x)      normal floats, x > 0         rel 5e-6
+ * Single precision libm is within about 1e-7 relative. Denormals,
+ * infinities and NaNs are not handled.
+ *
+ * gml::exact has the same functions from <cmath>.
+ *
+ * gml::shading is what the shading and texture coordinate code uses. With
+ * GML_FAST_MATH defined its atan2, asin, sincos & rsqrt are gml::fast's;
+ * otherwise, and for exp2, log2 & pow, they are gml::exact's.
+ */
+
+#pragma once
+#ifndef __INC_GML_FASTMATH_H__
+#define __INC_GML_FASTMATH_H__
+
+#include <cmath>
+#include <stdint.h>
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+namespace gml
+{
+
+namespace fast
+{
+
+// Bits of a float, and back
+inline int32_t _bits(const float f)
+{
+	union { float f; int32_t i; } u;
+	u.f = f;
+	return u.i;
+}
+inline float _float(const int32_t i)
+{
+	union { float f; int32_t i; } u;
+	u.i = i;
+	return u.f;
+}
+
+// x rounded to the nearest integer, for |x| < 2^22; without a call to
+// floorf() or a conversion instruction. The integer is in the low bits.
+const float _ROUND = 12582912.0f; // 1.5 * 2^23
+inline float _round(const float x) { return (x + _ROUND) - _ROUND; }
+inline int32_t _roundInt(const float x) { return _bits(x + _ROUND) - _bits(_ROUND); }
+
+// Minimum & maximum; minss & maxss with SSE. (gcc may make branches of
+// the ?: forms once they are inlined)
+inline float _min(const float a, const float b)
+{
+#if defined(__SSE__)
+	return _mm_cvtss_f32( _mm_min_ss(_mm_set_ss(a), _mm_set_ss(b)) );
+#else
+	return (a < b) ? a : b;
+#endif
+}
+inline float _max(const float a, const float b)
+{
+#if defined(__SSE__)
+	return _mm_cvtss_f32( _mm_max_ss(_mm_set_ss(a), _mm_set_ss(b)) );
+#else
+	return (a > b) ? a : b;
+#endif
+}
+
+// Abramowitz & Stegun 4.4.49; atan(a) for a in [0, 1]
+inline float _atan01(const float a)
+{
+	const float a2 = a*a;
+	float p = 0.0028662257f;
+	p = p*a2 - 0.0161657367f;
+	p = p*a2 + 0.0429096138f;
+	p = p*a2 - 0.0752896400f;
+	p = p*a2 + 0.1065626393f;
+	p = p*a2 - 0.1420889944f;
+	p = p*a2 + 0.1999355085f;
+	p = p*a2 - 0.3333314528f;
+	return a + a*a2*p;
+}
+
+inline float atan2(const float y, const float x)
+{
+	const float ax = fabsf(x), ay = fabsf(y);
+	const float mx = (ax > ay) ? ax : ay;
+	const float mn = (ax > ay) ? ay : ax;
+	// 0/0 for y = x = 0; gives 0 as atan2f does
+	float r = _atan01( (mx > 0.0f) ? mn / mx : 0.0f );
+	r = (ay > ax) ? 1.57079632679f - r : r;
+	r = (x < 0.0f) ? 3.14159265359f - r : r;
+	return copysignf(r, y);
+}
+
+// Abramowitz & Stegun 4.4.46; asin(a) = pi/2 - sqrt(1-a) p(a), for a in [0, 1]
+inline float asin(const float x)
+{
+	const float a = fabsf(x);
+	float p = -0.0012624911f;
+	p = p*a + 0.0066700901f;
+	p = p*a - 0.0170881256f;
+	p = p*a + 0.0308918810f;
+	p = p*a - 0.0501743046f;
+	p = p*a + 0.0889789874f;
+	p = p*a - 0.2145988016f;
+	p = p*a + 1.5707963050f;
+	return copysignf( 1.57079632679f - sqrtf(1.0f - a) * p, x );
+}
+
+// 2^x = 2^i 2^f, i = round(x), f in [-1/2, 1/2]
+inline float exp2(float x)
+{
+	x = _max( _min(x, 127.0f), -126.0f );
+	const float f = x - _round(x);
+	// Degree 5 fit of 2^f (at the Chebyshev nodes); in pairs, so that the
+	// terms are computed in parallel
+	const float f2 = f*f;
+	const float p01 = 1.00000012f + 6.93147182e-1f*f;
+	const float p23 = 2.40221068e-1f + 5.55035695e-2f*f;
+	const float p45 = 9.67603177e-3f + 1.33908633e-3f*f;
+	const float p = p01 + f2*(p23 + f2*p45);
+	return p * _float( (_roundInt(x) + 127) << 23 );
+}
+
+// log2(x) = e + log2(m), m in [sqrt(1/2), sqrt(2)).
+//  log2(m) = 2/ln(2) atanh(t), t = (m-1)/(m+1); |t| < 0.172
+inline float log2(const float x)
+{
+	const int32_t bits = _bits(x);
+	// Exponent, with the mantissa moved into [sqrt(1/2), sqrt(2))
+	const int32_t e = ((bits - 0x3f3504f3) >> 23);
+	const float m = _float(bits - (e << 23));
+	const float t = (m - 1.0f) / (m + 1.0f);
+	const float t2 = t*t;
+	float p = 2.0f/9.0f;
+	p = p*t2 + 2.0f/7.0f;
+	p = p*t2 + 2.0f/5.0f;
+	p = p*t2 + 2.0f/3.0f;
+	p = p*t2 + 2.0f;
+	return (float)e + t * p * 1.44269504089f;
+}
+
+// x^y for x >= 0; 0^y = 0
+inline float pow(const float x, const float y)
+{
+	// Masked rather than branched on
+	const int32_t positive = -(int32_t)(x > 0.0f);
+	return _float( _bits(exp2(y * log2(x))) & positive );
+}
+
+// sin(x) & cos(x).
+//  x = j pi/2 + r, r in [-pi/4, pi/4]; Taylor series of sin(r) & cos(r)
+inline void sincos(const float x, float &s, float &c)
+{
+	const float xj = x * 0.636619772368f;
+	const float j = _round(xj);
+	// x - j pi/2, with pi/2 split in three; j times the first part is exact
+	const float r = ((x - j * 1.5703125f) - j * 4.8375129699707031e-4f) - j * 7.5497899548918821e-8f;
+	const float r2 = r*r;
+
+	float ps = -2.5052108e-8f;
+	ps = ps*r2 + 2.7557319e-6f;
+	ps = ps*r2 - 1.9841270e-4f;
+	ps = ps*r2 + 8.3333333e-3f;
+	ps = ps*r2 - 1.6666667e-1f;
+	const float sr = r + r*r2*ps;
+
+	float pc = 2.0876757e-9f;
+	pc = pc*r2 - 2.7557319e-7f;
+	pc = pc*r2 + 2.4801587e-5f;
+	pc = pc*r2 - 1.3888889e-3f;
+	pc = pc*r2 + 4.1666667e-2f;
+	pc = pc*r2 - 0.5f;
+	const float cr = 1.0f + r2*pc;
+
+	// Quadrant: (sin, cos) = (sr, cr), (cr, -sr), (-sr, -cr), (-cr, sr)
+	const int32_t q = _roundInt(xj);
+	const float ss = (q & 1) ? cr : sr;
+	const float cc = (q & 1) ? sr : cr;
+	s = (q & 2) ? -ss : ss;
+	c = ((q + 1) & 2) ? -cc : cc;
+}
+
+// 1/sqrt(x); initial guess from the bits, and two Newton steps
+inline float rsqrt(const float x)
+{
+	float y = _float( 0x5f375a86 - (_bits(x) >> 1) );
+	const float hx = 0.5f * x;
+	y = y * (1.5f - hx*y*y);
+	y = y * (1.5f - hx*y*y);
+	return y;
+}
+
+}
+
+namespace exact
+{
+
+inline float atan2(const float y, const float x) { return atan2f(y, x); }
+inline float asin(const float x) { return asinf(x); }
+inline float exp2(const float x) { return exp2f(x); }
+inline float log2(const float x) { return log2f(x); }
+inline float pow(const float x, const float y) { return powf(x, y); }
+inline void sincos(const float x, float &s, float &c) { s = sinf(x); c = cosf(x); }
+inline float rsqrt(const float x) { return 1.0f / sqrtf(x); }
+
+}
+
+namespace shading
+{
+
+#if defined(GML_FAST_MATH)
+using fast::atan2;
+using fast::asin;
+using fast::sincos;
+using fast::rsqrt;
+#else
+using exact::atan2;
+using exact::asin;
+using exact::sincos;
+using exact::rsqrt;
+#endif
+// Always from <cmath>: glibc's (table driven) powf, exp2f & log2f are as
+// fast as, or faster than, fast::pow() etc. one call at a time. fast::
+// only wins in loops that the compiler vectorizes.
+using exact::exp2;
+using exact::log2;
+using exact::pow;
+
+}
+
+}
+
+#endif
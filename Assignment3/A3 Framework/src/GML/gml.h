@@ -43,6 +43,16 @@
  *  mechanism instead of through reference parameters. The motivation for
  *  doing so is the same as for pass-by-value parameters.
  *
+ *  Building with GML_SIMD defined (and SSE2 enabled) replaces the vec4_t
+ *  and mat4x4_t arithmetic with SSE; see sseinlines.h. vec4_t is then
+ *  16-byte aligned. The functions, and the layout, do not change.
+ *
+ *  The vector types also have operators: a + b, a - b, -a, s * a, a * s,
+ *  a / s, a * b (component-wise), +=, -= and *=. They build expressions
+ *  that are evaluated a component at a time, so a chain of them makes no
+ *  intermediate vectors; see exprinlines.h. The constructors, and the
+ *  identity matrices, are constexpr.
+ *
  *  It looks like there is a lot here, but it is a lot of duplication.
  *  Familiarize yourself with what's available here. It will make your
  *  life easier.
@@ -55,6 +65,17 @@
 
 #include <cmath>
 
+#if defined(GML_SIMD) && defined(__SSE2__)
+#define GML_SSE
+#include <emmintrin.h>
+#if defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+#endif
+
 namespace gml
 {
 
@@ -80,6 +101,9 @@ typedef struct _mat4x2_t mat4x2_t;
 typedef struct _mat4x3_t mat4x3_t;
 typedef struct _mat4x4_t mat4x4_t;
 
+// Affine transformation; a 4x4 matrix with an implied last row of (0 0 0 1)
+typedef struct _affine3x4_t affine3x4_t;
+
 /*
  * Vector functions
  */
@@ -173,9 +197,9 @@ vec4_t mul(const mat4x4_t A, const vec4_t x);
  *  Each of these functions completely overwrites the values in dst.
  */
  // Identity matrix
-mat2x2_t identity2();
-mat3x3_t identity3();
-mat4x4_t identity4();
+constexpr mat2x2_t identity2();
+constexpr mat3x3_t identity3();
+_GML_CONSTEXPR4 mat4x4_t identity4();
 
  // Right-handed coordinate system: Counter-clockwise rotation matrix.
  // angle given in __radians__
@@ -334,6 +358,37 @@ mat4x4_t mul(const mat4x3_t X, const mat3x4_t Y);
 mat4x4_t mul(const mat4x4_t X, const mat4x4_t Y);
 
 
+/*
+ * Affine transformations
+ *  For transforms with a last row of (0 0 0 1); ex: anything built from
+ *  rotations, scales, shears & translations. They are cheaper to apply,
+ *  combine and invert than a general mat4x4_t.
+ */
+
+ // The top three rows of M; assumes the last row of M is (0 0 0 1)
+affine3x4_t affine(const mat4x4_t M);
+ // [ L t ]
+affine3x4_t affine(const mat3x3_t L, const vec3_t t);
+ // The 4x4 matrix [ A ]
+ //                [ 0 0 0 1 ]
+mat4x4_t embed(const affine3x4_t A);
+ // The linear part of A; without the translation
+mat3x3_t extract(const affine3x4_t A);
+
+ // A p, for the point p  (p, 1)
+vec3_t transformPoint(const affine3x4_t A, const vec3_t p);
+ // A v, for the direction v  (v, 0)
+vec3_t transformVector(const affine3x4_t A, const vec3_t v);
+
+ // XY
+affine3x4_t mul(const affine3x4_t X, const affine3x4_t Y);
+ // Inverse; as inverse(embed(A)), from the inverse of the linear part
+ //  -- Assumes A is invertible.
+affine3x4_t inverse(const affine3x4_t A);
+ // transpose(inverse(extract(A))); transforms normals
+mat3x3_t normalMatrix(const affine3x4_t A);
+
+
 
 
 
@@ -355,11 +410,13 @@ mat4x4_t mul(const mat4x4_t X, const mat4x4_t Y);
 #include "vecinlines.h"
 #undef TYPE
 #undef N_COMPONENTS
+#if !defined(GML_SSE)
 #define TYPE vec4_t
 #define N_COMPONENTS 4
 #include "vecinlines.h"
 #undef TYPE
 #undef N_COMPONENTS
+#endif
 
 inline vec3_t cross(const vec3_t a, const vec3_t b)
 {
@@ -386,8 +443,17 @@ inline vec2_t extract2(const vec3_t v) { return vec2_t(v.x, v.y); }
 inline vec2_t extract2(const vec4_t v) { return vec2_t(v.x, v.y); }
 inline vec3_t extract3(const vec4_t v) { return vec3_t(v.x, v.y, v.z); }
 
+#if defined(GML_SSE)
+#include "sseinlines.h"
+#endif
 #include "matvecinlines.h"
 #include "matinlines.h"
+#include "affineinlines.h"
+#include "exprinlines.h"
+
+#undef _GML_CONSTEXPR2
+#undef _GML_CONSTEXPR3
+#undef _GML_CONSTEXPR4
 
 }
 #endif
@@ -15,6 +15,19 @@
 // Vector & matrix definitions for gml.
 // You do not want to directly include this file.
 
+// Vector expressions (a + b, s * v, ...); see exprinlines.h
+template <typename E, int N> struct _expr_t;
+
+// The constructors are constexpr, so constant vectors & matrices are
+// built at compile time; except those of vec4_t with GML_SSE.
+#define _GML_CONSTEXPR2 constexpr
+#define _GML_CONSTEXPR3 constexpr
+#if defined(GML_SSE)
+#define _GML_CONSTEXPR4
+#else
+#define _GML_CONSTEXPR4 constexpr
+#endif
+
 // Vector types.
 //   Components: xyzw (position/direction), rgba (color), and/or stpq (texture)
 struct _vec2_t;
@@ -26,9 +39,11 @@ struct _vec2_t
 	union { float x, s, r; }; // First coordinate
 	union { float y, t, g; }; // Second coordinate
 
-	_vec2_t() { x=y=0.0f; }
-	_vec2_t(float _x, float _y) { x = _x; y = _y; }
-	_vec2_t(const _vec2_t &_v) { x = _v.x; y = _v.y; }
+	constexpr _vec2_t() : x(0.0f), y(0.0f) {}
+	constexpr _vec2_t(float _x, float _y) : x(_x), y(_y) {}
+	constexpr _vec2_t(const _vec2_t &_v) : x(_v.x), y(_v.y) {}
+	// Evaluates the expression; once per component
+	template <typename E> _vec2_t(const _expr_t<E,2> &e) : x(e[0]), y(e[1]) {}
 
 	bool operator==(const _vec2_t b) const { return x==b.x && y==b.y; }
 	float operator[](const int i) const { return *((&x)+i); }
@@ -40,25 +55,40 @@ struct _vec3_t
 	union { float y, t, g; }; // Second coordinate
 	union { float z, p, b; }; // Third coordinate
 
-	_vec3_t() { x=y=z=0.0f; }
-	_vec3_t(float _x, float _y, float _z) { x = _x; y = _y; z = _z; }
-	_vec3_t(const _vec2_t _v, float _z) { x = _v.x; y = _v.y; z = _z; }
-	_vec3_t(const _vec3_t &_v) { x = _v.x; y = _v.y; z = _v.z; }
+	constexpr _vec3_t() : x(0.0f), y(0.0f), z(0.0f) {}
+	constexpr _vec3_t(float _x, float _y, float _z) : x(_x), y(_y), z(_z) {}
+	constexpr _vec3_t(const _vec2_t _v, float _z) : x(_v.x), y(_v.y), z(_z) {}
+	constexpr _vec3_t(const _vec3_t &_v) : x(_v.x), y(_v.y), z(_v.z) {}
+	template <typename E> _vec3_t(const _expr_t<E,3> &e) : x(e[0]), y(e[1]), z(e[2]) {}
 
 	bool operator==(const _vec3_t b) const { return x==b.x && y==b.y && z==b.z; }
 	float operator[](const int i) const { return *((&x)+i); }
 	float& operator[](const int i) { return *((&x)+i); }
 };
+#if defined(GML_SSE)
+struct __attribute__((aligned(16))) _vec4_t
+#else
 struct _vec4_t
+#endif
 {
 	union { float x, s, r; }; // First coordinate
 	union { float y, t, g; }; // Second coordinate
 	union { float z, p, b; }; // Third coordinate
 	union { float w, q, a; }; // Fourth coordinate
-	_vec4_t() { x=y=z=w=0.0f; }
-	_vec4_t(float _x, float _y, float _z, float _w) { x = _x; y = _y; z = _z; w = _w; }
-	_vec4_t(const _vec3_t _v, float _w) { x = _v.x; y = _v.y; z = _v.z; w = _w; }
-	_vec4_t(const _vec4_t &_v) { x = _v.x; y = _v.y; z = _v.z; w = _v.w; }
+#if defined(GML_SSE)
+	// Whole-register stores, so that SSE loads of the vector are not stalled
+	_vec4_t() { _mm_store_ps(&x, _mm_setzero_ps()); }
+	_vec4_t(float _x, float _y, float _z, float _w) { _mm_store_ps(&x, _mm_setr_ps(_x, _y, _z, _w)); }
+	_vec4_t(const _vec3_t _v, float _w) { _mm_store_ps(&x, _mm_setr_ps(_v.x, _v.y, _v.z, _w)); }
+	_vec4_t(const _vec4_t &_v) { _mm_store_ps(&x, _mm_load_ps(&_v.x)); }
+	template <typename E> _vec4_t(const _expr_t<E,4> &e) { _mm_store_ps(&x, _mm_setr_ps(e[0], e[1], e[2], e[3])); }
+#else
+	constexpr _vec4_t() : x(0.0f), y(0.0f), z(0.0f), w(0.0f) {}
+	constexpr _vec4_t(float _x, float _y, float _z, float _w) : x(_x), y(_y), z(_z), w(_w) {}
+	constexpr _vec4_t(const _vec3_t _v, float _w) : x(_v.x), y(_v.y), z(_v.z), w(_w) {}
+	constexpr _vec4_t(const _vec4_t &_v) : x(_v.x), y(_v.y), z(_v.z), w(_v.w) {}
+	template <typename E> _vec4_t(const _expr_t<E,4> &e) : x(e[0]), y(e[1]), z(e[2]), w(e[3]) {}
+#endif
 	bool operator==(const _vec4_t b) const { return x==b.x && y==b.y && z==b.z && w==b.w; }
 	float operator[](const int i) const { return *((&x)+i); }
 	float& operator[](const int i) { return *((&x)+i); }
@@ -67,12 +97,18 @@ struct _vec4_t
 // Column-major order matrices
 //  Note: Array of columns. So, each vector is a single column.
 
+// Constructors from M columns
+#define MAT_COLS_2(N,T,V) _GML_CONSTEXPR ## N T(const V c0, const V c1) : m{c0, c1} {}
+#define MAT_COLS_3(N,T,V) _GML_CONSTEXPR ## N T(const V c0, const V c1, const V c2) : m{c0, c1, c2} {}
+#define MAT_COLS_4(N,T,V) _GML_CONSTEXPR ## N T(const V c0, const V c1, const V c2, const V c3) : m{c0, c1, c2, c3} {}
+
 // Create the macro to define an NxM matrix
 #define DEF_MAT(N,M) \
 	struct _mat ## N ## x ## M ## _t \
 	{\
 		_vec ## N ## _t m[M];\
-		_mat ## N ## x ## M ## _t() {};\
+		_GML_CONSTEXPR ## N _mat ## N ## x ## M ## _t() : m() {};\
+		MAT_COLS_ ## M(N, _mat ## N ## x ## M ## _t, _vec ## N ## _t) \
 		_vec ## N ## _t const & operator[](const int i) const { return m[i]; } \
 		_vec ## N ## _t& operator[](const int i) { return m[i]; } \
 		bool operator==(const _mat ## N ## x ## M ## _t b) const \
@@ -95,4 +131,19 @@ DEF_MAT(4,3)
 DEF_MAT(4,4)
 
 #undef DEF_MAT
+#undef MAT_COLS_2
+#undef MAT_COLS_3
+#undef MAT_COLS_4
+
+// Affine transformation: the top three rows of a 4x4 matrix whose last
+// row is (0 0 0 1). Columns 0-2 are the linear part; column 3 is the
+// translation. Same layout as a mat3x4_t.
+struct _affine3x4_t
+{
+	_vec3_t m[4];
+	constexpr _affine3x4_t() : m() {}
+	constexpr _affine3x4_t(const _vec3_t c0, const _vec3_t c1, const _vec3_t c2, const _vec3_t t) : m{c0, c1, c2, t} {}
+	_vec3_t const & operator[](const int i) const { return m[i]; }
+	_vec3_t& operator[](const int i) { return m[i]; }
+};
 
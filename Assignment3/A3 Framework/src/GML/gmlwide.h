@@ -0,0 +1,363 @@
+
+/*
+ * Copyright:
+ * Daniel D. Neilson (ddneilson@ieee.org)
+ * University of Saskatchewan
+ * All rights reserved
+ *
+ * Permission granted to use for use in assignments and
+ * projects for CMPT 485 & CMPT 829 at the University
+ * of Saskatchewan.
+ */
+
+/*
+ * Wide (structure of arrays) types for gml.
+ *
+ * Each type holds 4 or 8 values at once, one per SIMD lane, so one
+ * call does the same work on 4 or 8 independent inputs (ex: a packet
+ * of rays, or a block of triangles).
+ *
+ * Types:
+ *   floatx4_t, floatx8_t -- 4 or 8 floats
+ *   maskx4_t, maskx8_t   -- 4 or 8 booleans; the result of a comparison
+ *   vec3x4_t, vec3x8_t   -- 4 or 8 vec3_t's; stored as one wide float
+ *                           per component
+ *
+ *  The vec3xN_t functions are the same as those of vec3_t: add, sub,
+ *  mul, scale, dot, length, length2, normalize, cross, reflect, clamp.
+ *  Comparisons give masks, and select() combines two values by a mask;
+ *  this replaces branches on a per-lane condition.
+ *
+ *  A vec3xN_t is constructed from one vec3_t (in every lane), from N
+ *  wide floats, or from an array of N vec3_t's; store() writes it back
+ *  to such an array.
+ *
+ *  Requires SSE2. The 8-wide types use AVX if the compiler targets it,
+ *  and are a pair of SSE registers otherwise.
+ */
+
+#pragma once
+#ifndef __INC_GML_WIDE_H__
+#define __INC_GML_WIDE_H__
+
+#include "gml.h"
+
+#if !defined(__SSE2__)
+#error "gmlwide.h requires SSE2"
+#endif
+#include <emmintrin.h>
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+namespace gml
+{
+
+/*
+ * Wide floats & masks
+ */
+struct floatx4_t
+{
+	__m128 v;
+	floatx4_t() { v = _mm_setzero_ps(); }
+	floatx4_t(const float s) { v = _mm_set1_ps(s); }
+	floatx4_t(const float a, const float b, const float c, const float d) { v = _mm_setr_ps(a, b, c, d); }
+	floatx4_t(const __m128 _v) { v = _v; }
+	// Load 4 floats; p need not be aligned
+	explicit floatx4_t(const float *p) { v = _mm_loadu_ps(p); }
+};
+struct maskx4_t
+{
+	__m128 m;
+	maskx4_t(const __m128 _m) { m = _m; }
+};
+
+struct floatx8_t
+{
+#if defined(__AVX__)
+	__m256 v;
+	floatx8_t() { v = _mm256_setzero_ps(); }
+	floatx8_t(const float s) { v = _mm256_set1_ps(s); }
+	floatx8_t(const __m256 _v) { v = _v; }
+	explicit floatx8_t(const float *p) { v = _mm256_loadu_ps(p); }
+#else
+	__m128 lo, hi; // Lanes 0-3 & 4-7
+	floatx8_t() { lo = hi = _mm_setzero_ps(); }
+	floatx8_t(const float s) { lo = hi = _mm_set1_ps(s); }
+	floatx8_t(const __m128 _lo, const __m128 _hi) { lo = _lo; hi = _hi; }
+	explicit floatx8_t(const float *p) { lo = _mm_loadu_ps(p); hi = _mm_loadu_ps(p + 4); }
+#endif
+};
+struct maskx8_t
+{
+#if defined(__AVX__)
+	__m256 m;
+	maskx8_t(const __m256 _m) { m = _m; }
+#else
+	__m128 lo, hi;
+	maskx8_t(const __m128 _lo, const __m128 _hi) { lo = _lo; hi = _hi; }
+#endif
+};
+
+/*
+ * Wide vectors
+ */
+struct vec3x4_t
+{
+	typedef floatx4_t floatw_t;
+	typedef maskx4_t maskw_t;
+	floatx4_t x, y, z;
+
+	vec3x4_t() {}
+	vec3x4_t(const floatx4_t _x, const floatx4_t _y, const floatx4_t _z) { x = _x; y = _y; z = _z; }
+	// v in every lane
+	vec3x4_t(const vec3_t v) { x = floatx4_t(v.x); y = floatx4_t(v.y); z = floatx4_t(v.z); }
+	// Load aos[0..3]
+	explicit vec3x4_t(const vec3_t *aos);
+};
+struct vec3x8_t
+{
+	typedef floatx8_t floatw_t;
+	typedef maskx8_t maskw_t;
+	floatx8_t x, y, z;
+
+	vec3x8_t() {}
+	vec3x8_t(const floatx8_t _x, const floatx8_t _y, const floatx8_t _z) { x = _x; y = _y; z = _z; }
+	vec3x8_t(const vec3_t v) { x = floatx8_t(v.x); y = floatx8_t(v.y); z = floatx8_t(v.z); }
+	// Load aos[0..7]
+	explicit vec3x8_t(const vec3_t *aos);
+};
+
+
+/*
+ * floatx4_t & maskx4_t
+ */
+inline floatx4_t add(const floatx4_t a, const floatx4_t b) { return _mm_add_ps(a.v, b.v); }
+inline floatx4_t sub(const floatx4_t a, const floatx4_t b) { return _mm_sub_ps(a.v, b.v); }
+inline floatx4_t mul(const floatx4_t a, const floatx4_t b) { return _mm_mul_ps(a.v, b.v); }
+inline floatx4_t div(const floatx4_t a, const floatx4_t b) { return _mm_div_ps(a.v, b.v); }
+inline floatx4_t min(const floatx4_t a, const floatx4_t b) { return _mm_min_ps(a.v, b.v); }
+inline floatx4_t max(const floatx4_t a, const floatx4_t b) { return _mm_max_ps(a.v, b.v); }
+inline floatx4_t sqrt(const floatx4_t a) { return _mm_sqrt_ps(a.v); }
+inline floatx4_t neg(const floatx4_t a) { return _mm_xor_ps(a.v, _mm_set1_ps(-0.0f)); }
+inline floatx4_t abs(const floatx4_t a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v); }
+// |a|, with the sign of b
+inline floatx4_t copysign(const floatx4_t a, const floatx4_t b)
+{
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	return _mm_or_ps( _mm_andnot_ps(signMask, a.v), _mm_and_ps(signMask, b.v) );
+}
+
+inline maskx4_t cmplt(const floatx4_t a, const floatx4_t b) { return _mm_cmplt_ps(a.v, b.v); }
+inline maskx4_t cmple(const floatx4_t a, const floatx4_t b) { return _mm_cmple_ps(a.v, b.v); }
+inline maskx4_t cmpgt(const floatx4_t a, const floatx4_t b) { return _mm_cmpgt_ps(a.v, b.v); }
+inline maskx4_t cmpge(const floatx4_t a, const floatx4_t b) { return _mm_cmpge_ps(a.v, b.v); }
+inline maskx4_t cmpeq(const floatx4_t a, const floatx4_t b) { return _mm_cmpeq_ps(a.v, b.v); }
+inline maskx4_t cmpneq(const floatx4_t a, const floatx4_t b) { return _mm_cmpneq_ps(a.v, b.v); }
+
+// Lane-wise: a where m is set, else b
+inline floatx4_t select(const maskx4_t m, const floatx4_t a, const floatx4_t b)
+{
+	return _mm_or_ps( _mm_and_ps(m.m, a.v), _mm_andnot_ps(m.m, b.v) );
+}
+
+// Mask logic: a && b, a || b, !a
+inline maskx4_t both(const maskx4_t a, const maskx4_t b) { return _mm_and_ps(a.m, b.m); }
+inline maskx4_t either(const maskx4_t a, const maskx4_t b) { return _mm_or_ps(a.m, b.m); }
+inline maskx4_t invert(const maskx4_t a) { return _mm_xor_ps(a.m, _mm_castsi128_ps(_mm_set1_epi32(-1))); }
+// Bit i set iff lane i is
+inline int bits(const maskx4_t a) { return _mm_movemask_ps(a.m); }
+inline bool any(const maskx4_t a) { return bits(a) != 0; }
+inline bool all(const maskx4_t a) { return bits(a) == 0xF; }
+// Lanes [0, n) set
+inline maskx4_t firstLanes4(const int n)
+{
+	return _mm_castsi128_ps( _mm_cmplt_epi32(_mm_setr_epi32(0, 1, 2, 3), _mm_set1_epi32(n)) );
+}
+
+inline void store(float *p, const floatx4_t a) { _mm_storeu_ps(p, a.v); }
+inline float lane(const floatx4_t a, const int i)
+{
+	float f[4];
+	_mm_storeu_ps(f, a.v);
+	return f[i];
+}
+
+
+/*
+ * floatx8_t & maskx8_t
+ */
+#if defined(__AVX__)
+
+inline floatx8_t add(const floatx8_t a, const floatx8_t b) { return _mm256_add_ps(a.v, b.v); }
+inline floatx8_t sub(const floatx8_t a, const floatx8_t b) { return _mm256_sub_ps(a.v, b.v); }
+inline floatx8_t mul(const floatx8_t a, const floatx8_t b) { return _mm256_mul_ps(a.v, b.v); }
+inline floatx8_t div(const floatx8_t a, const floatx8_t b) { return _mm256_div_ps(a.v, b.v); }
+inline floatx8_t min(const floatx8_t a, const floatx8_t b) { return _mm256_min_ps(a.v, b.v); }
+inline floatx8_t max(const floatx8_t a, const floatx8_t b) { return _mm256_max_ps(a.v, b.v); }
+inline floatx8_t sqrt(const floatx8_t a) { return _mm256_sqrt_ps(a.v); }
+inline floatx8_t neg(const floatx8_t a) { return _mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f)); }
+inline floatx8_t abs(const floatx8_t a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v); }
+inline floatx8_t copysign(const floatx8_t a, const floatx8_t b)
+{
+	const __m256 signMask = _mm256_set1_ps(-0.0f);
+	return _mm256_or_ps( _mm256_andnot_ps(signMask, a.v), _mm256_and_ps(signMask, b.v) );
+}
+
+inline maskx8_t cmplt(const floatx8_t a, const floatx8_t b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+inline maskx8_t cmple(const floatx8_t a, const floatx8_t b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ); }
+inline maskx8_t cmpgt(const floatx8_t a, const floatx8_t b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ); }
+inline maskx8_t cmpge(const floatx8_t a, const floatx8_t b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ); }
+inline maskx8_t cmpeq(const floatx8_t a, const floatx8_t b) { return _mm256_cmp_ps(a.v, b.v, _CMP_EQ_OQ); }
+inline maskx8_t cmpneq(const floatx8_t a, const floatx8_t b) { return _mm256_cmp_ps(a.v, b.v, _CMP_NEQ_UQ); }
+
+// Not blendv; gcc may lower it to a branch per lane
+inline floatx8_t select(const maskx8_t m, const floatx8_t a, const floatx8_t b)
+{
+	return _mm256_or_ps( _mm256_and_ps(m.m, a.v), _mm256_andnot_ps(m.m, b.v) );
+}
+
+inline maskx8_t both(const maskx8_t a, const maskx8_t b) { return _mm256_and_ps(a.m, b.m); }
+inline maskx8_t either(const maskx8_t a, const maskx8_t b) { return _mm256_or_ps(a.m, b.m); }
+inline maskx8_t invert(const maskx8_t a) { return _mm256_xor_ps(a.m, _mm256_castsi256_ps(_mm256_set1_epi32(-1))); }
+inline int bits(const maskx8_t a) { return _mm256_movemask_ps(a.m); }
+inline maskx8_t firstLanes8(const int n)
+{
+	// No 8-wide integer compare in AVX; lane numbers are exact as floats
+	return _mm256_cmp_ps( _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_ps((float)n), _CMP_LT_OQ );
+}
+
+inline void store(float *p, const floatx8_t a) { _mm256_storeu_ps(p, a.v); }
+
+#else // Pairs of SSE registers
+
+#define _GML_PAIR(T, op, a, b) T( op((a).lo, (b).lo), op((a).hi, (b).hi) )
+inline floatx8_t add(const floatx8_t a, const floatx8_t b) { return _GML_PAIR(floatx8_t, _mm_add_ps, a, b); }
+inline floatx8_t sub(const floatx8_t a, const floatx8_t b) { return _GML_PAIR(floatx8_t, _mm_sub_ps, a, b); }
+inline floatx8_t mul(const floatx8_t a, const floatx8_t b) { return _GML_PAIR(floatx8_t, _mm_mul_ps, a, b); }
+inline floatx8_t div(const floatx8_t a, const floatx8_t b) { return _GML_PAIR(floatx8_t, _mm_div_ps, a, b); }
+inline floatx8_t min(const floatx8_t a, const floatx8_t b) { return _GML_PAIR(floatx8_t, _mm_min_ps, a, b); }
+inline floatx8_t max(const floatx8_t a, const floatx8_t b) { return _GML_PAIR(floatx8_t, _mm_max_ps, a, b); }
+inline floatx8_t sqrt(const floatx8_t a) { return floatx8_t( _mm_sqrt_ps(a.lo), _mm_sqrt_ps(a.hi) ); }
+inline floatx8_t neg(const floatx8_t a) { return _GML_PAIR(floatx8_t, _mm_xor_ps, a, floatx8_t(-0.0f)); }
+inline floatx8_t abs(const floatx8_t a) { return _GML_PAIR(floatx8_t, _mm_andnot_ps, floatx8_t(-0.0f), a); }
+inline floatx8_t copysign(const floatx8_t a, const floatx8_t b)
+{
+	const floatx8_t signMask(-0.0f);
+	return _GML_PAIR(floatx8_t, _mm_or_ps, _GML_PAIR(floatx8_t, _mm_andnot_ps, signMask, a),
+			_GML_PAIR(floatx8_t, _mm_and_ps, signMask, b));
+}
+
+inline maskx8_t cmplt(const floatx8_t a, const floatx8_t b) { return _GML_PAIR(maskx8_t, _mm_cmplt_ps, a, b); }
+inline maskx8_t cmple(const floatx8_t a, const floatx8_t b) { return _GML_PAIR(maskx8_t, _mm_cmple_ps, a, b); }
+inline maskx8_t cmpgt(const floatx8_t a, const floatx8_t b) { return _GML_PAIR(maskx8_t, _mm_cmpgt_ps, a, b); }
+inline maskx8_t cmpge(const floatx8_t a, const floatx8_t b) { return _GML_PAIR(maskx8_t, _mm_cmpge_ps, a, b); }
+inline maskx8_t cmpeq(const floatx8_t a, const floatx8_t b) { return _GML_PAIR(maskx8_t, _mm_cmpeq_ps, a, b); }
+inline maskx8_t cmpneq(const floatx8_t a, const floatx8_t b) { return _GML_PAIR(maskx8_t, _mm_cmpneq_ps, a, b); }
+
+inline floatx8_t select(const maskx8_t m, const floatx8_t a, const floatx8_t b)
+{
+	return floatx8_t( select(maskx4_t(m.lo), a.lo, b.lo).v, select(maskx4_t(m.hi), a.hi, b.hi).v );
+}
+
+inline maskx8_t both(const maskx8_t a, const maskx8_t b) { return _GML_PAIR(maskx8_t, _mm_and_ps, a, b); }
+inline maskx8_t either(const maskx8_t a, const maskx8_t b) { return _GML_PAIR(maskx8_t, _mm_or_ps, a, b); }
+inline maskx8_t invert(const maskx8_t a) { return maskx8_t( invert(maskx4_t(a.lo)).m, invert(maskx4_t(a.hi)).m ); }
+inline int bits(const maskx8_t a) { return _mm_movemask_ps(a.lo) | (_mm_movemask_ps(a.hi) << 4); }
+inline maskx8_t firstLanes8(const int n) { return maskx8_t( firstLanes4(n).m, firstLanes4(n - 4).m ); }
+
+inline void store(float *p, const floatx8_t a) { _mm_storeu_ps(p, a.lo); _mm_storeu_ps(p + 4, a.hi); }
+#undef _GML_PAIR
+
+#endif
+
+inline bool any(const maskx8_t a) { return bits(a) != 0; }
+inline bool all(const maskx8_t a) { return bits(a) == 0xFF; }
+inline float lane(const floatx8_t a, const int i)
+{
+	float f[8];
+	store(f, a);
+	return f[i];
+}
+
+
+/*
+ * Wide vectors
+ */
+
+// Bring in the implementations for the wide vector functions
+#define VEC3W vec3x4_t
+#define FLOATW floatx4_t
+#define MASKW maskx4_t
+#define WIDTH 4
+#include "wideinlines.h"
+#undef VEC3W
+#undef FLOATW
+#undef MASKW
+#undef WIDTH
+#define VEC3W vec3x8_t
+#define FLOATW floatx8_t
+#define MASKW maskx8_t
+#define WIDTH 8
+#include "wideinlines.h"
+#undef VEC3W
+#undef FLOATW
+#undef MASKW
+#undef WIDTH
+
+// Array of structures <-> structure of arrays.
+//  The 4 vec3_t's are 12 floats; loaded as 3 registers, and shuffled.
+#define _GML_SHUFFLE(a, b, x, y, z, w) _mm_shuffle_ps( (a), (b), _MM_SHUFFLE((w), (z), (y), (x)) )
+inline vec3x4_t::vec3x4_t(const vec3_t *aos)
+{
+	const float *p = &aos[0].x;
+	const __m128 a0 = _mm_loadu_ps(p); // x0 y0 z0 x1
+	const __m128 a1 = _mm_loadu_ps(p + 4); // y1 z1 x2 y2
+	const __m128 a2 = _mm_loadu_ps(p + 8); // z2 x3 y3 z3
+	const __m128 xy23 = _GML_SHUFFLE(a1, a2, 2, 3, 1, 2);
+	const __m128 yz01 = _GML_SHUFFLE(a0, a1, 1, 2, 0, 1);
+	x = _GML_SHUFFLE(a0, xy23, 0, 3, 0, 2);
+	y = _GML_SHUFFLE(yz01, xy23, 0, 2, 1, 3);
+	z = _GML_SHUFFLE(yz01, a2, 1, 3, 0, 3);
+}
+inline void store(vec3_t *aos, const vec3x4_t v)
+{
+	float *p = &aos[0].x;
+	const __m128 xy01 = _GML_SHUFFLE(v.x.v, v.y.v, 0, 1, 0, 1);
+	const __m128 zx01 = _GML_SHUFFLE(v.z.v, v.x.v, 0, 0, 1, 1);
+	const __m128 yz11 = _GML_SHUFFLE(v.y.v, v.z.v, 1, 1, 1, 1);
+	const __m128 xy22 = _GML_SHUFFLE(v.x.v, v.y.v, 2, 2, 2, 2);
+	const __m128 zx23 = _GML_SHUFFLE(v.z.v, v.x.v, 2, 2, 3, 3);
+	const __m128 yz33 = _GML_SHUFFLE(v.y.v, v.z.v, 3, 3, 3, 3);
+	_mm_storeu_ps( p, _GML_SHUFFLE(xy01, zx01, 0, 2, 0, 2) );
+	_mm_storeu_ps( p + 4, _GML_SHUFFLE(yz11, xy22, 0, 2, 0, 2) );
+	_mm_storeu_ps( p + 8, _GML_SHUFFLE(zx23, yz33, 0, 2, 0, 2) );
+}
+#undef _GML_SHUFFLE
+
+inline vec3x8_t::vec3x8_t(const vec3_t *aos)
+{
+	const vec3x4_t lo(aos), hi(aos + 4);
+#if defined(__AVX__)
+	x = _mm256_insertf128_ps(_mm256_castps128_ps256(lo.x.v), hi.x.v, 1);
+	y = _mm256_insertf128_ps(_mm256_castps128_ps256(lo.y.v), hi.y.v, 1);
+	z = _mm256_insertf128_ps(_mm256_castps128_ps256(lo.z.v), hi.z.v, 1);
+#else
+	x = floatx8_t(lo.x.v, hi.x.v);
+	y = floatx8_t(lo.y.v, hi.y.v);
+	z = floatx8_t(lo.z.v, hi.z.v);
+#endif
+}
+inline void store(vec3_t *aos, const vec3x8_t v)
+{
+#if defined(__AVX__)
+	store( aos, vec3x4_t(_mm256_castps256_ps128(v.x.v), _mm256_castps256_ps128(v.y.v), _mm256_castps256_ps128(v.z.v)) );
+	store( aos + 4, vec3x4_t(_mm256_extractf128_ps(v.x.v, 1), _mm256_extractf128_ps(v.y.v, 1), _mm256_extractf128_ps(v.z.v, 1)) );
+#else
+	store( aos, vec3x4_t(v.x.lo, v.y.lo, v.z.lo) );
+	store( aos + 4, vec3x4_t(v.x.hi, v.y.hi, v.z.hi) );
+#endif
+}
+
+}
+#endif
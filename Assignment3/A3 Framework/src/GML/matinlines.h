@@ -16,29 +16,22 @@
 // This file should not be directly included by anything other than gmath.h
 
 
-inline mat2x2_t identity2()
+inline constexpr mat2x2_t identity2()
 {
-	mat2x2_t dst;
-	dst[0] = vec2_t(1.0f, 0.0f);
-	dst[1] = vec2_t(0.0f, 1.0f);
-	return dst;
+	return mat2x2_t( vec2_t(1.0f, 0.0f), vec2_t(0.0f, 1.0f) );
 }
-inline mat3x3_t identity3()
+inline constexpr mat3x3_t identity3()
 {
-	mat3x3_t dst;
-	dst[0] = vec3_t(1.0f, 0.0f, 0.0f);
-	dst[1] = vec3_t(0.0f, 1.0f, 0.0f);
-	dst[2] = vec3_t(0.0f, 0.0f, 1.0f);
-	return dst;
+	return mat3x3_t( vec3_t(1.0f, 0.0f, 0.0f),
+			vec3_t(0.0f, 1.0f, 0.0f),
+			vec3_t(0.0f, 0.0f, 1.0f) );
 }
-inline mat4x4_t identity4()
+inline _GML_CONSTEXPR4 mat4x4_t identity4()
 {
-	mat4x4_t dst;
-	dst[0] = vec4_t(1.0f, 0.0f, 0.0f, 0.0f);
-	dst[1] = vec4_t(0.0f, 1.0f, 0.0f, 0.0f);
-	dst[2] = vec4_t(0.0f, 0.0f, 1.0f, 0.0f);
-	dst[3] = vec4_t(0.0f, 0.0f, 0.0f, 1.0f);
-	return dst;
+	return mat4x4_t( vec4_t(1.0f, 0.0f, 0.0f, 0.0f),
+			vec4_t(0.0f, 1.0f, 0.0f, 0.0f),
+			vec4_t(0.0f, 0.0f, 1.0f, 0.0f),
+			vec4_t(0.0f, 0.0f, 0.0f, 1.0f) );
 }
 
 // 2d rotation
@@ -548,6 +541,7 @@ inline mat4x3_t transpose(const mat3x4_t M)
 	dst[2] = vec4_t(M[0].z, M[1].z, M[2].z, M[3].z);
 	return dst;
 }
+#if !defined(GML_SSE) // else in sseinlines.h
 inline mat4x4_t transpose(const mat4x4_t M)
 {
 	mat4x4_t dst;
@@ -557,6 +551,7 @@ inline mat4x4_t transpose(const mat4x4_t M)
 	dst[3] = vec4_t(M[0].w, M[1].w, M[2].w, M[3].w);
 	return dst;
 }
+#endif
 
 
 
@@ -616,6 +611,7 @@ inline mat3x3_t inverse(const mat3x3_t A)
 	return dst;
 }
 
+#if !defined(GML_SSE) // else in sseinlines.h
 inline mat4x4_t inverse(const mat4x4_t A)
 {
 	// From: http://www.geometrictools.com/Documentation/LaplaceExpansionTheorem.pdf
@@ -640,7 +636,7 @@ inline mat4x4_t inverse(const mat4x4_t A)
 			A[1][1]*c5-A[1][2]*c4+A[1][3]*c3,
 			-(A[0][1]*c5-A[0][2]*c4+A[0][3]*c3),
 			A[3][1]*s5-A[3][2]*s4+A[3][3]*s3,
-			-(A[2][1]*s5-A[2][2]*s4-A[2][3]*s3)
+			-(A[2][1]*s5-A[2][2]*s4+A[2][3]*s3)
 			);
 	inv[1] = vec4_t(
 			-(A[1][0]*c5-A[1][2]*c2+A[1][3]*c1),
@@ -662,6 +658,7 @@ inline mat4x4_t inverse(const mat4x4_t A)
 			);
 	return scale(1.0/detA, inv);
 }
+#endif
 
  // Matrix embedding
  // Set: dst = [ M 0 ]
@@ -919,6 +916,7 @@ inline mat4x4_t mul(const mat4x3_t X, const mat3x4_t Y)
 	dst[3] = mul(X,Y[3]);
 	return dst;
 }
+#if !defined(GML_SSE) // else in sseinlines.h
 inline mat4x4_t mul(const mat4x4_t X, const mat4x4_t Y)
 {
 	mat4x4_t dst;
@@ -928,3 +926,4 @@ inline mat4x4_t mul(const mat4x4_t X, const mat4x4_t Y)
 	dst[3] = mul(X,Y[3]);
 	return dst;
 }
+#endif
@@ -92,9 +92,11 @@ inline vec4_t mul(const mat4x3_t A, const vec3_t x)
 	b = add( scale(x.x, A[0]), add(scale(x.y,A[1]),scale(x.z,A[2])) );
 	return b;
 }
+#if !defined(GML_SSE) // else in sseinlines.h
 inline vec4_t mul(const mat4x4_t A, const vec4_t x)
 {
 	vec4_t b;
 	b = add( scale(x.x, A[0]), add(scale(x.y,A[1]), add(scale(x.z,A[2]), scale(x.w, A[3]))) );
 	return b;
 }
+#endif
@@ -0,0 +1,233 @@
+
+/*
+ * Copyright:
+ * Daniel D. Neilson (ddneilson@ieee.org)
+ * University of Saskatchewan
+ * All rights reserved
+ *
+ * Permission granted to use for use in assignments and
+ * projects for CMPT 485 & CMPT 829 at the University
+ * of Saskatchewan.
+ */
+
+#pragma once
+// SSE implementations of the vec4_t & mat4x4_t functions.
+//  Used in place of the scalar ones when gml.h is built with GML_SIMD.
+//  vec4_t is 16-byte aligned, so a vec4_t, and each column of a mat4x4_t,
+// is loaded into one register.
+//  SSE2 is required. SSE4.1 (dot products) and AVX (matrix-matrix
+// multiplication) are used when the compiler targets them.
+// This file should not be directly included by anything other than gml.h
+
+inline __m128 _load(const vec4_t &v) { return _mm_load_ps(&v.x); }
+inline vec4_t _store(const __m128 v)
+{
+	vec4_t result;
+	_mm_store_ps(&result.x, v);
+	return result;
+}
+
+#define GML_SHUFFLE(a, b, x, y, z, w) _mm_shuffle_ps( (a), (b), _MM_SHUFFLE((w), (z), (y), (x)) )
+#define GML_SPLAT(a, i) GML_SHUFFLE( (a), (a), (i), (i), (i), (i) )
+
+// a.b in every component
+inline __m128 _dot4(const __m128 a, const __m128 b)
+{
+#if defined(__SSE4_1__)
+	return _mm_dp_ps(a, b, 0xFF);
+#else
+	__m128 p = _mm_mul_ps(a, b);
+	p = _mm_add_ps( p, GML_SHUFFLE(p, p, 1, 0, 3, 2) );
+	return _mm_add_ps( p, GML_SHUFFLE(p, p, 2, 3, 0, 1) );
+#endif
+}
+
+// Vector scaling
+inline vec4_t scale(const float s, const vec4_t v)
+{
+	return _store( _mm_mul_ps(_mm_set1_ps(s), _load(v)) );
+}
+
+// Component-wise addition
+inline vec4_t add(const vec4_t a, const vec4_t b)
+{
+	return _store( _mm_add_ps(_load(a), _load(b)) );
+}
+
+// Component-wise subtraction
+inline vec4_t sub(const vec4_t a, const vec4_t b)
+{
+	return _store( _mm_sub_ps(_load(a), _load(b)) );
+}
+
+// Component-wise multiplication
+inline vec4_t mul(const vec4_t a, const vec4_t b)
+{
+	return _store( _mm_mul_ps(_load(a), _load(b)) );
+}
+
+// Dot product
+inline float dot(const vec4_t a, const vec4_t b)
+{
+	return _mm_cvtss_f32( _dot4(_load(a), _load(b)) );
+}
+
+// Vector length
+inline float length(const vec4_t v)
+{
+	const __m128 _v = _load(v);
+	return _mm_cvtss_f32( _mm_sqrt_ss(_dot4(_v, _v)) );
+}
+
+// Vector length squared
+inline float length2(const vec4_t v)
+{
+	return dot(v,v);
+}
+
+inline vec4_t normalize(const vec4_t v)
+{
+	const __m128 _v = _load(v);
+	const __m128 invLen = _mm_div_ps( _mm_set1_ps(1.0f), _mm_sqrt_ps(_dot4(_v, _v)) );
+	return _store( _mm_mul_ps(invLen, _v) );
+}
+
+inline vec4_t clamp(const vec4_t v, const float a, const float b)
+{
+	return _store( _mm_min_ps( _mm_max_ps(_load(v), _mm_set1_ps(a)), _mm_set1_ps(b) ) );
+}
+
+inline vec4_t reflect(const vec4_t v, const vec4_t n)
+{
+	const __m128 _v = _load(v), _n = _load(n);
+	const __m128 s = _mm_mul_ps( _mm_set1_ps(2.0f), _dot4(_v, _n) );
+	return _store( _mm_sub_ps(_mm_mul_ps(s, _n), _v) );
+}
+
+// A x; a linear combination of the columns of A
+inline __m128 _mul4(const mat4x4_t &A, const __m128 x)
+{
+	__m128 b = _mm_mul_ps( _load(A[0]), GML_SPLAT(x, 0) );
+	b = _mm_add_ps( b, _mm_mul_ps(_load(A[1]), GML_SPLAT(x, 1)) );
+	b = _mm_add_ps( b, _mm_mul_ps(_load(A[2]), GML_SPLAT(x, 2)) );
+	return _mm_add_ps( b, _mm_mul_ps(_load(A[3]), GML_SPLAT(x, 3)) );
+}
+
+inline vec4_t mul(const mat4x4_t A, const vec4_t x)
+{
+	return _store( _mul4(A, _load(x)) );
+}
+
+inline mat4x4_t mul(const mat4x4_t X, const mat4x4_t Y)
+{
+	mat4x4_t dst;
+#if defined(__AVX__)
+	// Two columns of the result at once; X's columns are in both halves
+	const __m256 X0 = _mm256_broadcast_ps((const __m128*)&X[0]);
+	const __m256 X1 = _mm256_broadcast_ps((const __m128*)&X[1]);
+	const __m256 X2 = _mm256_broadcast_ps((const __m128*)&X[2]);
+	const __m256 X3 = _mm256_broadcast_ps((const __m128*)&X[3]);
+	for (int j=0; j<4; j+=2)
+	{
+		const __m256 y = _mm256_loadu_ps(&Y[j].x);
+		__m256 d = _mm256_mul_ps( X0, _mm256_permute_ps(y, 0x00) );
+		d = _mm256_add_ps( d, _mm256_mul_ps(X1, _mm256_permute_ps(y, 0x55)) );
+		d = _mm256_add_ps( d, _mm256_mul_ps(X2, _mm256_permute_ps(y, 0xAA)) );
+		d = _mm256_add_ps( d, _mm256_mul_ps(X3, _mm256_permute_ps(y, 0xFF)) );
+		_mm256_storeu_ps(&dst[j].x, d);
+	}
+#else
+	dst[0] = _store( _mul4(X, _load(Y[0])) );
+	dst[1] = _store( _mul4(X, _load(Y[1])) );
+	dst[2] = _store( _mul4(X, _load(Y[2])) );
+	dst[3] = _store( _mul4(X, _load(Y[3])) );
+#endif
+	return dst;
+}
+
+inline mat4x4_t transpose(const mat4x4_t M)
+{
+	__m128 c0 = _load(M[0]), c1 = _load(M[1]), c2 = _load(M[2]), c3 = _load(M[3]);
+	_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+	mat4x4_t dst;
+	dst[0] = _store(c0);
+	dst[1] = _store(c1);
+	dst[2] = _store(c2);
+	dst[3] = _store(c3);
+	return dst;
+}
+
+// 2x2 matrices, packed as (m00, m01, m10, m11)
+//  A B
+inline __m128 _mat2Mul(const __m128 A, const __m128 B)
+{
+	return _mm_add_ps( _mm_mul_ps(A, GML_SHUFFLE(B, B, 0, 3, 0, 3)),
+			_mm_mul_ps(GML_SHUFFLE(A, A, 1, 0, 3, 2), GML_SHUFFLE(B, B, 2, 1, 2, 1)) );
+}
+//  adjugate(A) B
+inline __m128 _mat2AdjMul(const __m128 A, const __m128 B)
+{
+	return _mm_sub_ps( _mm_mul_ps(GML_SHUFFLE(A, A, 3, 3, 0, 0), B),
+			_mm_mul_ps(GML_SHUFFLE(A, A, 1, 1, 2, 2), GML_SHUFFLE(B, B, 2, 3, 0, 1)) );
+}
+//  A adjugate(B)
+inline __m128 _mat2MulAdj(const __m128 A, const __m128 B)
+{
+	return _mm_sub_ps( _mm_mul_ps(A, GML_SHUFFLE(B, B, 3, 0, 3, 0)),
+			_mm_mul_ps(GML_SHUFFLE(A, A, 1, 0, 3, 2), GML_SHUFFLE(B, B, 2, 1, 2, 1)) );
+}
+
+ // Matrix inverse.
+ //  By 2x2 blocks: M = [ A B ]
+ //                     [ C D ]
+ //  The columns of M are treated as rows; since inverse(M^T) = inverse(M)^T,
+ // the result comes out in columns as well.
+ //  -- Assumes the matrix is invertible.
+inline mat4x4_t inverse(const mat4x4_t M)
+{
+	const __m128 m0 = _load(M[0]), m1 = _load(M[1]), m2 = _load(M[2]), m3 = _load(M[3]);
+	const __m128 A = _mm_movelh_ps(m0, m1);
+	const __m128 B = _mm_movehl_ps(m1, m0);
+	const __m128 C = _mm_movelh_ps(m2, m3);
+	const __m128 D = _mm_movehl_ps(m3, m2);
+
+	// (|A|, |B|, |C|, |D|)
+	const __m128 detSub = _mm_sub_ps(
+			_mm_mul_ps( GML_SHUFFLE(m0, m2, 0, 2, 0, 2), GML_SHUFFLE(m1, m3, 1, 3, 1, 3) ),
+			_mm_mul_ps( GML_SHUFFLE(m0, m2, 1, 3, 1, 3), GML_SHUFFLE(m1, m3, 0, 2, 0, 2) ) );
+	const __m128 detA = GML_SPLAT(detSub, 0);
+	const __m128 detB = GML_SPLAT(detSub, 1);
+	const __m128 detC = GML_SPLAT(detSub, 2);
+	const __m128 detD = GML_SPLAT(detSub, 3);
+
+	// inverse(M) = 1/|M| [ X Y ]
+	//                    [ Z W ]
+	const __m128 D_C = _mat2AdjMul(D, C);
+	const __m128 A_B = _mat2AdjMul(A, B);
+	__m128 X = _mm_sub_ps( _mm_mul_ps(detD, A), _mat2Mul(B, D_C) );
+	__m128 W = _mm_sub_ps( _mm_mul_ps(detA, D), _mat2Mul(C, A_B) );
+	__m128 Y = _mm_sub_ps( _mm_mul_ps(detB, C), _mat2MulAdj(D, A_B) );
+	__m128 Z = _mm_sub_ps( _mm_mul_ps(detC, B), _mat2MulAdj(A, D_C) );
+
+	// |M| = |A||D| + |B||C| - trace(adjugate(A) B adjugate(D) C)
+	__m128 tr = _mm_mul_ps( A_B, GML_SHUFFLE(D_C, D_C, 0, 2, 1, 3) );
+	tr = _mm_add_ps( tr, GML_SHUFFLE(tr, tr, 1, 0, 3, 2) );
+	tr = _mm_add_ps( tr, GML_SHUFFLE(tr, tr, 2, 3, 0, 1) );
+	const __m128 detM = _mm_sub_ps( _mm_add_ps(_mm_mul_ps(detA, detD), _mm_mul_ps(detB, detC)), tr );
+
+	const __m128 rDetM = _mm_div_ps( _mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), detM );
+	X = _mm_mul_ps(X, rDetM);
+	Y = _mm_mul_ps(Y, rDetM);
+	Z = _mm_mul_ps(Z, rDetM);
+	W = _mm_mul_ps(W, rDetM);
+
+	mat4x4_t dst;
+	dst[0] = _store( GML_SHUFFLE(X, Y, 3, 1, 3, 1) );
+	dst[1] = _store( GML_SHUFFLE(X, Y, 2, 0, 2, 0) );
+	dst[2] = _store( GML_SHUFFLE(Z, W, 3, 1, 3, 1) );
+	dst[3] = _store( GML_SHUFFLE(Z, W, 2, 0, 2, 0) );
+	return dst;
+}
+
+#undef GML_SHUFFLE
+#undef GML_SPLAT
@@ -103,7 +103,7 @@ inline TYPE normalize(const TYPE v)
 inline TYPE clamp(const TYPE v, const float a, const float b)
 {
 	TYPE _v;
-	for (int i=1; i < N_COMPONENTS; i++)
+	for (int i=0; i < N_COMPONENTS; i++)
 	{
 		_v[i] = v[i];
 		if (_v[i] > b) _v[i] = b;
@@ -0,0 +1,96 @@
+
+/*
+ * Copyright:
+ * Daniel D. Neilson (ddneilson@ieee.org)
+ * University of Saskatchewan
+ * All rights reserved
+ *
+ * Permission granted to use for use in assignments and
+ * projects for CMPT 485 & CMPT 829 at the University
+ * of Saskatchewan.
+ */
+
+// Inline function definitions for wide vector functions.
+//  Lane for lane, the same as those in vecinlines.h.
+// This file should not be directly included by anything other than gmlwide.h
+
+// Vector scaling
+inline VEC3W scale(const FLOATW s, const VEC3W v)
+{
+	return VEC3W( mul(s, v.x), mul(s, v.y), mul(s, v.z) );
+}
+
+// Component-wise addition
+inline VEC3W add(const VEC3W a, const VEC3W b)
+{
+	return VEC3W( add(a.x, b.x), add(a.y, b.y), add(a.z, b.z) );
+}
+
+// Component-wise subtraction
+inline VEC3W sub(const VEC3W a, const VEC3W b)
+{
+	return VEC3W( sub(a.x, b.x), sub(a.y, b.y), sub(a.z, b.z) );
+}
+
+// Component-wise multiplication
+inline VEC3W mul(const VEC3W a, const VEC3W b)
+{
+	return VEC3W( mul(a.x, b.x), mul(a.y, b.y), mul(a.z, b.z) );
+}
+
+// Dot product
+inline FLOATW dot(const VEC3W a, const VEC3W b)
+{
+	return add( add(mul(a.x, b.x), mul(a.y, b.y)), mul(a.z, b.z) );
+}
+
+// Vector length
+inline FLOATW length(const VEC3W v)
+{
+	return sqrt(dot(v, v));
+}
+
+// Vector length squared
+inline FLOATW length2(const VEC3W v)
+{
+	return dot(v, v);
+}
+
+inline VEC3W normalize(const VEC3W v)
+{
+	return scale(div(FLOATW(1.0f), length(v)), v);
+}
+
+// Cross product: a x b
+inline VEC3W cross(const VEC3W a, const VEC3W b)
+{
+	return VEC3W( sub(mul(a.y, b.z), mul(a.z, b.y)),
+			sub(mul(a.z, b.x), mul(a.x, b.z)),
+			sub(mul(a.x, b.y), mul(a.y, b.x)) );
+}
+
+inline VEC3W reflect(const VEC3W v, const VEC3W n)
+{
+	return sub( scale(mul(FLOATW(2.0f), dot(v, n)), n), v );
+}
+
+inline VEC3W clamp(const VEC3W v, const float a, const float b)
+{
+	const FLOATW _a(a), _b(b);
+	return VEC3W( min(max(v.x, _a), _b), min(max(v.y, _a), _b), min(max(v.z, _a), _b) );
+}
+
+// Lane-wise: a where m is set, else b
+inline VEC3W select(const MASKW m, const VEC3W a, const VEC3W b)
+{
+	return VEC3W( select(m, a.x, b.x), select(m, a.y, b.y), select(m, a.z, b.z) );
+}
+
+inline vec3_t lane(const VEC3W v, const int i)
+{
+	float x[WIDTH], y[WIDTH], z[WIDTH];
+	store(x, v.x);
+	store(y, v.y);
+	store(z, v.z);
+	return vec3_t(x[i], y[i], z[i]);
+}
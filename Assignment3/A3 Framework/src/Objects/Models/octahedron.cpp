@@ -12,6 +12,7 @@
 
 #include <cstdint>
 #include "octahedron.h"
+#include "../../RayTracing/analytic.h"
 
 namespace Object
 {
@@ -135,9 +136,25 @@ static GLuint _indices[8*3] =
 		21, 22, 23
 };
 
-Octahedron::Octahedron() {}
+// Ray traced as the solid |x| + |y| + |z| <= 1. Plane i holds face i,
+// which is triangle i of the mesh.
+static gml::vec4_t _planes[8];
+static const RayTracing::ConvexPolyhedron_t _solid = { _planes, 8 };
+
+Octahedron::Octahedron()
+{
+	for (int i=0; i<8; i++)
+	{
+		_planes[i] = gml::vec4_t( _normals[3*i], gml::dot(_normals[3*i], _verts[3*i]) );
+	}
+}
 Octahedron::~Octahedron() {}
 
+const RayTracing::ConvexPolyhedron_t &Octahedron::getSolid()
+{
+	return _solid;
+}
+
 bool Octahedron::init()
 {
 	return m_mesh.init(GL_TRIANGLES, NUM_VERTS, _verts, _normals, _texcoords, 8*3, _indices);
@@ -150,15 +167,54 @@ void Octahedron::rasterize() const
 
 bool Octahedron::rayIntersects(const RayTracing::Ray_t &ray, const float t0, const float t1, RayTracing::HitInfo_t &hitinfo) const
 {
-	return m_mesh.rayIntersects(ray, t0, t1, hitinfo);
+	RayTracing::AnalyticHit_t hit;
+	if ( !RayTracing::intersectPolyhedron(ray, _solid, t0, t1, hit) )
+	{
+		return false;
+	}
+	hitinfo.hitDist = hit.t;
+	hitinfo.solid.p = hit.p;
+	hitinfo.solid.face = hit.face;
+	return true;
 }
 bool Octahedron::shadowsRay(const RayTracing::Ray_t &ray, const float t0, const float t1) const
 {
-	return m_mesh.shadowsRay(ray, t0, t1);
+	RayTracing::AnalyticHit_t hit;
+	return RayTracing::intersectPolyhedron(ray, _solid, t0, t1, hit);
 }
 void Octahedron::hitProperties(const RayTracing::HitInfo_t &hitinfo, gml::vec3_t &normal, gml::vec2_t &texCoords) const
 {
-	m_mesh.hitProperties(hitinfo, normal, texCoords);
+	// Interpolate the texture coordinates of the face's triangle, as the mesh would
+	const GLuint i0 = 3*hitinfo.solid.face;
+	const gml::vec3_t e1 = gml::sub(_verts[i0+1], _verts[i0]);
+	const gml::vec3_t e2 = gml::sub(_verts[i0+2], _verts[i0]);
+	const gml::vec3_t q = gml::sub(hitinfo.solid.p, _verts[i0]);
+	const float d11 = gml::dot(e1, e1), d12 = gml::dot(e1, e2), d22 = gml::dot(e2, e2);
+	const float dq1 = gml::dot(q, e1), dq2 = gml::dot(q, e2);
+	const float det = d11*d22 - d12*d12;
+	const float u = (d22*dq1 - d12*dq2) / det;
+	const float v = (d11*dq2 - d12*dq1) / det;
+
+	texCoords = (1.0f-u-v)*_texcoords[i0] + u*_texcoords[i0+1] + v*_texcoords[i0+2];
+	normal = _normals[i0];
+}
+float Octahedron::getTexScale(const RayTracing::HitInfo_t &hitinfo) const
+{
+	const GLuint i0 = 3*hitinfo.solid.face;
+	return triangleTexScale(_verts[i0], _verts[i0+1], _verts[i0+2],
+			_texcoords[i0], _texcoords[i0+1], _texcoords[i0+2]);
+}
+void Octahedron::getBoundingSphere(gml::vec3_t &center, float &radius) const
+{
+	// All vertices are at distance 1 from the origin
+	center = gml::vec3_t(0.0f, 0.0f, 0.0f);
+	radius = 1.0f;
+}
+void Octahedron::getBoundingBox(gml::vec3_t &min, gml::vec3_t &max) const
+{
+	const RayTracing::AABB_t box = RayTracing::getBounds(_solid);
+	min = box.min;
+	max = box.max;
 }
 
 
@@ -17,6 +17,9 @@
  * This octahedron has flat faces.
  * It is also centered at (0,0,0).
  * The faces face 45 degree angles relative to the xz plane
+ *
+ * It is ray traced as a convex polyhedron; the mesh is only
+ * used for rasterization.
  */
 
 #pragma once
@@ -43,9 +46,18 @@ public:
 
 	virtual void rasterize() const;
 
+	virtual GeometryType getType() const { return GEOM_OCTAHEDRON; }
+	// The planes that it is ray traced against; plane i is face i.
+	//  Valid once an Octahedron has been constructed.
+	static const RayTracing::ConvexPolyhedron_t &getSolid();
+
 	virtual bool rayIntersects(const RayTracing::Ray_t &ray, const float t0, const float t1, RayTracing::HitInfo_t &hitinfo) const;
 	virtual bool shadowsRay(const RayTracing::Ray_t &ray, const float t0, const float t1) const;
 	virtual void hitProperties(const RayTracing::HitInfo_t &hitinfo, gml::vec3_t &normal, gml::vec2_t &texCoords) const;
+	virtual float getTexScale(const RayTracing::HitInfo_t &hitinfo) const;
+
+	virtual void getBoundingSphere(gml::vec3_t &center, float &radius) const;
+	virtual void getBoundingBox(gml::vec3_t &min, gml::vec3_t &max) const;
 };
 
 }
@@ -12,6 +12,7 @@
 
 #include "../../GML/gml.h"
 #include "plane.h"
+#include "../../RayTracing/analytic.h"
 
 namespace Object
 {
@@ -44,6 +45,9 @@ static GLuint _indices[] =
 		0, 1, 2,
 		2, 3, 0
 };
+// Ray traced as one quad; u runs along z, and v along x, from _verts[0]
+static const RayTracing::Quad_t _quad = RayTracing::makeQuad( _verts[0],
+		gml::vec3_t(0.0f, 0.0f, 2.0f), gml::vec3_t(2.0f, 0.0f, 0.0f) );
 
 Plane::Plane() {}
 Plane::~Plane() {}
@@ -60,88 +64,41 @@ void Plane::rasterize() const
 
 bool Plane::rayIntersects(const RayTracing::Ray_t &ray, const float t0, const float t1, RayTracing::HitInfo_t &hitinfo) const
 {
-	gml::vec3_t E1(0.0f, 0.0f, 2.0f);
-	gml::vec3_t E2(2.0f, 0.0f, 0.0f);
-
-	gml::vec3_t P = gml::cross( ray.d, E2 );
-
-	float detM = gml::dot(P, E1);
-
-	if (fabs(detM) < 1e-4)
-	{
-		return false;
-	}
-
-	gml::vec3_t T = gml::sub( ray.o, _verts[0] );
-
-	float u = gml::dot( P, T ) / detM;
-	if ( u < 0.0f || 1.0f < u )
-	{
-		return false;
-	}
-
-	gml::vec3_t TxE1 = gml::cross(T, E1);
-	float v = gml::dot( TxE1, ray.d ) / detM;
-	if ( v < 0.0f || 1.0f < v)
+	RayTracing::AnalyticHit_t hit;
+	if ( !RayTracing::intersectQuad(ray, _quad, t0, t1, hit) )
 	{
 		return false;
 	}
 
-	float t = gml::dot( TxE1, E2 ) / detM;
-	if (t < t0 || t1 < t)
-	{
-		return false;
-	}
-
-	hitinfo.hitDist =  t;
-
-	hitinfo.plane.u = u;
-	hitinfo.plane.v = v;
-
+	hitinfo.hitDist = hit.t;
+	hitinfo.plane.u = hit.u;
+	hitinfo.plane.v = hit.v;
 	return true;
 }
+
 bool Plane::shadowsRay(const RayTracing::Ray_t &ray, const float t0, const float t1) const
 {
-	gml::vec3_t E1(0.0f, 0.0f, 2.0f);
-	gml::vec3_t E2(2.0f, 0.0f, 0.0f);
-
-	gml::vec3_t P = gml::cross( ray.d, E2 );
-
-	float detM = gml::dot(P, E1);
-
-	if (fabs(detM) < 1e-4)
-	{
-		return false;
-	}
-
-	gml::vec3_t T = gml::sub( ray.o, _verts[0] );
-
-	float u = gml::dot( P, T ) / detM;
-	if ( u < 0.0f || 1.0f < u )
-	{
-		return false;
-	}
-
-	gml::vec3_t TxE1 = gml::cross(T, E1);
-	float v = gml::dot( TxE1, ray.d ) / detM;
-	if ( v < 0.0f || 1.0f < v)
-	{
-		return false;
-	}
-
-	float t = gml::dot( TxE1, E2 ) / detM;
-	if (t < t0 || t1 < t)
-	{
-		return false;
-	}
-
-	return true;
+	RayTracing::AnalyticHit_t hit;
+	return RayTracing::intersectQuad(ray, _quad, t0, t1, hit);
 }
+
 void Plane::hitProperties(const RayTracing::HitInfo_t &hitinfo, gml::vec3_t &normal, gml::vec2_t &texCoords) const
 {
 	texCoords = gml::vec2_t(hitinfo.plane.u, hitinfo.plane.v);
 	normal = gml::vec3_t(0.0f, 1.0f, 0.0f);
 }
+void Plane::getBoundingSphere(gml::vec3_t &center, float &radius) const
+{
+	// Corners of the [-1,1]x[-1,1] square
+	center = gml::vec3_t(0.0f, 0.0f, 0.0f);
+	radius = M_SQRT2;
+}
+void Plane::getBoundingBox(gml::vec3_t &min, gml::vec3_t &max) const
+{
+	const RayTracing::AABB_t box = RayTracing::getBounds(_quad);
+	min = box.min;
+	max = box.max;
+}
 
 
 }
@@ -18,6 +18,9 @@
  *
  * The front face of the plane is in the +y-axis direction.
  * The normal to the plane is the y-axis.
+ *
+ * It is ray traced as a single quad; the mesh is only
+ * used for rasterization.
  */
 
 #pragma once
@@ -44,9 +47,16 @@ public:
 
 	virtual void rasterize() const;
 
+	virtual GeometryType getType() const { return GEOM_PLANE; }
+
 	virtual bool rayIntersects(const RayTracing::Ray_t &ray, const float t0, const float t1, RayTracing::HitInfo_t &hitinfo) const;
 	virtual bool shadowsRay(const RayTracing::Ray_t &ray, const float t0, const float t1) const;
 	virtual void hitProperties(const RayTracing::HitInfo_t &hitinfo, gml::vec3_t &normal, gml::vec2_t &texCoords) const;
+	// The 2x2 square maps to the unit square of texture space
+	virtual float getTexScale(const RayTracing::HitInfo_t &) const { return 0.5f; }
+
+	virtual void getBoundingSphere(gml::vec3_t &center, float &radius) const;
+	virtual void getBoundingBox(gml::vec3_t &min, gml::vec3_t &max) const;
 };
 
 }
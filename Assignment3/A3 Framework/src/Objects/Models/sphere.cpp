@@ -15,6 +15,8 @@
 #include <cstdlib>
 #include <cstring>
 #include "sphere.h"
+#include "../../RayTracing/spherekernel.h"
+#include "../../GML/fastmath.h"
 
 #include "../object.h"
 
@@ -162,108 +164,33 @@ void Sphere::rasterize() const
 
 bool Sphere::rayIntersects(const RayTracing::Ray_t &ray, const float t0, const float t1, RayTracing::HitInfo_t &hitinfo) const
 {
-	// TODO!!
 	// Calculate the ray-sphere intersection.
 	//  Note: ray is given in _object space_ coordinates
-	//  If an intersection is found, then return true and set the appropriate fields
-	// of the hitinfo struct.
 	//  hitinfo struct should _not_ be altered unless there is definitely an intersection.
-	gml::vec3_t o_c = gml::sub(ray.o, gml::vec3_t(0,0,0));
-
-	// Initialize the 3 terms from the formula breakdown.
-	float A = gml::dot(ray.d, ray.d);
-	float B = 2.0f * gml::dot(ray.d, o_c);
-	float C = gml::dot(o_c, o_c) - 1.0f;
-
-	// Discriminant from quadratic formula (using previous terms).
-	float discriminant = sqrt(pow(B, 2) - 4.0f*A*C);
-
-	// discriminant cannot be zero.
-	if (discriminant < 0)
+	float t;
+	if ( !RayTracing::intersectSphere(ray.o, ray.d, 1.0f, t0, t1, t) )
 	{
-		// fail.
 		return false;
 	}
 
-
-	float newt0 = 0.0f;
-	float newt1 = 0.0f;
-	newt0 = (-B + discriminant) / (2.0f*A);
-	newt1 = (-B - discriminant) / (2.0f*A);
-
-	float smallT = newt0;
-	if (newt1 < newt0)
-	{
-		smallT = newt1;
-	}
-
-	// We have a hit!
-	if (smallT >= t0 && smallT <= t1)
-	{
-		// Record the hit distance.
-		hitinfo.hitDist = smallT;
-
-		// Record the hit distance.
-		gml::vec3_t hitPos = gml::add(ray.o, gml::scale(smallT, ray.d));
-		hitinfo.sphere.hitPos = hitPos;
-
-		return true;
-	}
-
-
-	return false;
+	hitinfo.hitDist = t;
+	hitinfo.sphere.hitPos = gml::add(ray.o, gml::scale(t, ray.d));
+	return true;
 }
 
 bool Sphere::shadowsRay(const RayTracing::Ray_t &ray, const float t0, const float t1) const
 {
-	// TODO!!
 	//  Return true if and only if the ray intersects this sphere.
 	//  ray is given in _object space_ coordinates.
-
-	gml::vec3_t o_c = gml::sub(ray.o, gml::vec3_t(0,0,0));
-
-	// Initialize the 3 terms from the formula breakdown.
-	float A = gml::dot(ray.d, ray.d);
-	float B = 2.0f * gml::dot(ray.d, o_c);
-	float C = gml::dot(o_c, o_c) - 1.0f;
-
-	// Discriminant from quadratic formula (using previous terms).
-	float discriminant = sqrtf(powf(B, 2.0f) - 4.0f*A*C);
-
-
-
-	// discriminant cannot be zero.
-	if (discriminant < 0)
-	{
-			// fail.
-			return false;
-	}
-
-	float newt0 = 0.0f;
-	float newt1 = 0.0f;
-	newt0 = (-B + discriminant) / (2.0f*A);
-	newt1 = (-B - discriminant) / (2.0f*A);
-
-	float smallT = newt0;
-
-	if (newt1 < newt0)
-	{
-			smallT = newt1;
-	}
-	if (smallT >= t0 && smallT <= t1)
-	{
-			return true;
-	}
-
-
-	return false;
+	float t;
+	return RayTracing::intersectSphere(ray.o, ray.d, 1.0f, t0, t1, t);
 }
 
 static inline gml::vec2_t getTexCoords(const gml::vec3_t &position)
 {
         gml::vec2_t texcoords;
-        texcoords.s = ( atan2(position.z, -position.x) / M_PI + 1 ) / 2.0f;
-        texcoords.t = ( asin(-position.y )/M_PI + 1) / 2;
+        texcoords.s = ( gml::shading::atan2(position.z, -position.x) / M_PI + 1 ) / 2.0f;
+        texcoords.t = ( gml::shading::asin(-position.y )/M_PI + 1) / 2;
         return texcoords;
 }
 
@@ -279,6 +206,12 @@ void Sphere::hitProperties(const RayTracing::HitInfo_t &hitinfo, gml::vec3_t &no
         normal = gml::normalize(hitinfo.sphere.hitPos);
 }
 
+void Sphere::getBoundingSphere(gml::vec3_t &center, float &radius) const
+{
+	center = gml::vec3_t(0.0f, 0.0f, 0.0f);
+	radius = 1.0f;
+}
+
 
 
 static const float EPSILON = 1e-5;
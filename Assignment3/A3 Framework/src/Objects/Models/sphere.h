@@ -51,10 +51,17 @@ public:
 
 	virtual void rasterize() const;
 
+	virtual GeometryType getType() const { return GEOM_SPHERE; }
+
 	// Ray intersector virtuals
 	virtual bool rayIntersects(const RayTracing::Ray_t &ray, const float t0, const float t1, RayTracing::HitInfo_t &hitinfo) const;
 	virtual bool shadowsRay(const RayTracing::Ray_t &ray, const float t0, const float t1) const;
 	virtual void hitProperties(const RayTracing::HitInfo_t &hitinfo, gml::vec3_t &normal, gml::vec2_t &texCoords) const;
+	// Area 4 pi maps to the unit square of texture space. (An average; the
+	// mapping stretches u toward the poles)
+	virtual float getTexScale(const RayTracing::HitInfo_t &) const { return 0.28209479f; }
+
+	virtual void getBoundingSphere(gml::vec3_t &center, float &radius) const;
 };
 
 }
@@ -10,6 +10,7 @@
  * of Saskatchewan.
  */
 
+#include <math.h>
 #include "geometry.h"
 
 namespace Object
@@ -18,4 +19,23 @@ namespace Object
 Geometry::Geometry() {}
 Geometry::~Geometry() {}
 
+void Geometry::getBoundingBox(gml::vec3_t &min, gml::vec3_t &max) const
+{
+	gml::vec3_t center;
+	float radius;
+	getBoundingSphere(center, radius);
+	min = gml::sub(center, gml::vec3_t(radius, radius, radius));
+	max = gml::add(center, gml::vec3_t(radius, radius, radius));
+}
+
+float triangleTexScale(const gml::vec3_t &p0, const gml::vec3_t &p1, const gml::vec3_t &p2,
+		const gml::vec2_t &t0, const gml::vec2_t &t1, const gml::vec2_t &t2)
+{
+	// Twice each area
+	const float area = gml::length( gml::cross(gml::sub(p1, p0), gml::sub(p2, p0)) );
+	const gml::vec2_t e1 = gml::sub(t1, t0), e2 = gml::sub(t2, t0);
+	const float texArea = fabsf(e1.x*e2.y - e1.y*e2.x);
+	return (area > 0.0f) ? sqrtf(texArea / area) : 0.0f;
+}
+
 }
@@ -27,6 +27,17 @@
 namespace Object
 {
 
+// Shapes that the ray tracer can intersect without a virtual call.
+//  Objects whose geometry reports one of these are grouped by type
+//  when they are added to a scene, and intersected in batches.
+typedef enum
+{
+	GEOM_GENERIC = 0, // Only through the virtual functions; ex: meshes
+	GEOM_SPHERE, // Unit sphere centered at (0,0,0)
+	GEOM_PLANE, // The [-1,1]x[-1,1] square in the xz plane; normal +y
+	GEOM_OCTAHEDRON // The solid |x| + |y| + |z| <= 1; Models::Octahedron::getSolid()
+} GeometryType;
+
 // Base class for all geometric models.
 class Geometry
 {
@@ -35,6 +46,11 @@ public:
 	Geometry();
 	virtual ~Geometry();
 
+	// Analytic shape of the geometry, if it is one of GeometryType.
+	//  The batched intersection must give the same hits, and hitinfo,
+	//  as rayIntersects().
+	virtual GeometryType getType() const { return GEOM_GENERIC; }
+
 	// Rasterize this object via OpenGL
 	virtual void rasterize() const = 0;
 
@@ -44,8 +60,23 @@ public:
 	virtual bool shadowsRay(const RayTracing::Ray_t &ray, const float t0, const float t1) const = 0;
 	//   Gives back object-space normal
 	virtual void hitProperties(const RayTracing::HitInfo_t &hitinfo, gml::vec3_t &normal, gml::vec2_t &texCoords) const = 0;
+	// Texture coordinate units per object-space unit of length at the hit;
+	// the square root of the ratio of texture to surface area. Used to
+	// pick a texture's mip level. Defaults to 0; i.e. always level 0.
+	virtual float getTexScale(const RayTracing::HitInfo_t &) const { return 0.0f; }
+
+	// Object-space sphere that encloses all of the geometry.
+	// Used for culling; it need not be tight, but it must be conservative.
+	virtual void getBoundingSphere(gml::vec3_t &center, float &radius) const = 0;
+	// Object-space axis-aligned box that encloses all of the geometry.
+	// Defaults to the box around the bounding sphere.
+	virtual void getBoundingBox(gml::vec3_t &min, gml::vec3_t &max) const;
 };
 
+// getTexScale() of the triangle p0 p1 p2, with texture coordinates t0 t1 t2
+float triangleTexScale(const gml::vec3_t &p0, const gml::vec3_t &p1, const gml::vec3_t &p2,
+		const gml::vec2_t &t0, const gml::vec2_t &t1, const gml::vec2_t &t2);
+
 } // namespace
 
 #endif
@@ -31,6 +31,9 @@ Mesh::Mesh()
 	m_vertNormals = 0;
 	m_vertTexcoords = 0;
 	m_indices = 0;
+	m_rtTriangles = 0;
+	m_numTriangles = 0;
+	m_watertight = true;
 
 	m_primitiveType = GL_TRIANGLES;
 }
@@ -52,6 +55,10 @@ void Mesh::destroy()
 	m_vertNormals = 0;
 	m_vertTexcoords = 0;
 	m_indices = 0;
+
+	if (m_rtTriangles) delete[] m_rtTriangles;
+	m_rtTriangles = 0;
+	m_numTriangles = 0;
 }
 
 bool Mesh::init(GLenum primitive,
@@ -85,6 +92,18 @@ bool Mesh::init(GLenum primitive,
 	memcpy(m_indices, indices, sizeof(GLuint)*numIndices);
 	m_numIndices = numIndices;
 
+	if (primitive == GL_TRIANGLES)
+	{
+		m_numTriangles = numIndices / 3;
+		m_rtTriangles = new RayTracing::Triangle_t[m_numTriangles];
+		for (GLuint i=0; i<m_numTriangles; i++)
+		{
+			m_rtTriangles[i].v0 = positions[ indices[3*i] ];
+			m_rtTriangles[i].v1 = positions[ indices[3*i+1] ];
+			m_rtTriangles[i].v2 = positions[ indices[3*i+2] ];
+		}
+	}
+
 	// To render objects in OpenGL you first create a "Vertex Array Object" (VAO)
 	// The VAO is basically a container for the object's geometry
 	// So, create one VAO
@@ -268,6 +287,32 @@ bool Mesh::rayIntersects(const RayTracing::Ray_t &ray, const float t0, const flo
 	if (m_primitiveType != GL_TRIANGLES)
 		return false;
 
+	if (m_watertight)
+	{
+		const RayTracing::WatertightRay_t wray = RayTracing::makeWatertightRay(ray);
+		float t_max = t1, t, u, v;
+		GLuint hitTri = m_numTriangles;
+		for (GLuint i=0; i<m_numTriangles; i++)
+		{
+			if ( RayTracing::intersectTriangle(wray, m_rtTriangles[i], t0, t_max, t, u, v) )
+			{
+				t_max = t;
+				hitTri = i;
+				hitinfo.mesh.u = u;
+				hitinfo.mesh.v = v;
+			}
+		}
+		if (hitTri == m_numTriangles)
+		{
+			return false;
+		}
+		hitinfo.hitDist = t_max;
+		hitinfo.mesh.i0 = m_indices[3*hitTri];
+		hitinfo.mesh.i1 = m_indices[3*hitTri+1];
+		hitinfo.mesh.i2 = m_indices[3*hitTri+2];
+		return true;
+	}
+
 	float t_max = t1;
 	bool isHit = false;
 	for (GLuint ind=0; ind < m_numIndices; ind += 3 )
@@ -288,6 +333,20 @@ bool Mesh::shadowsRay(const RayTracing::Ray_t &ray, const float t0, const float
 	if (m_primitiveType != GL_TRIANGLES)
 		return false;
 
+	if (m_watertight)
+	{
+		const RayTracing::WatertightRay_t wray = RayTracing::makeWatertightRay(ray);
+		float t, u, v;
+		for (GLuint i=0; i<m_numTriangles; i++)
+		{
+			if ( RayTracing::intersectTriangle(wray, m_rtTriangles[i], t0, t1, t, u, v) )
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
 	for (GLuint ind=0; ind < m_numIndices; ind += 3 )
 	{
 		if (rayShadowsTriangle(m_indices[ind], m_indices[ind+1], m_indices[ind+2], ray, t0, t1) )
@@ -302,16 +361,11 @@ void Mesh::hitProperties(const RayTracing::HitInfo_t &hitinfo, gml::vec3_t &norm
 {
 	const float u = hitinfo.mesh.u, v = hitinfo.mesh.v;
 	const float w0 = 1.0-u-v, w1 = u, w2 = v;
-	texCoords = gml::add(
-			gml::add( gml::scale(w0, m_vertTexcoords[hitinfo.mesh.i0]), gml::scale(w1, m_vertTexcoords[hitinfo.mesh.i1]) ),
-			gml::scale(w2, m_vertTexcoords[hitinfo.mesh.i2])
-	);
-
-	normal = gml::add(
-			gml::add( gml::scale(w0, m_vertNormals[hitinfo.mesh.i0]), gml::scale(w1, m_vertNormals[hitinfo.mesh.i1]) ),
-			gml::scale(w2, m_vertNormals[hitinfo.mesh.i2])
-	);
-	normal = gml::normalize(normal);
+	texCoords = w0*m_vertTexcoords[hitinfo.mesh.i0] + w1*m_vertTexcoords[hitinfo.mesh.i1]
+			+ w2*m_vertTexcoords[hitinfo.mesh.i2];
+
+	normal = gml::normalize( w0*m_vertNormals[hitinfo.mesh.i0] + w1*m_vertNormals[hitinfo.mesh.i1]
+			+ w2*m_vertNormals[hitinfo.mesh.i2] );
 }
 
 } // namespace
@@ -40,6 +40,7 @@
 #include "../Shaders/shader.h"
 #include "../RayTracing/rayintersector.h"
 #include "../RayTracing/types.h"
+#include "../RayTracing/analytic.h"
 
 namespace Object
 {
@@ -58,6 +59,13 @@ protected:
 
 	GLenum m_primitiveType;
 
+	// Ray tracing layout: the positions of each triangle's vertices,
+	// together; triangle i is m_indices[3*i .. 3*i+2]. GL_TRIANGLES only.
+	RayTracing::Triangle_t *m_rtTriangles;
+	GLuint m_numTriangles;
+	// Use watertight triangle intersection; else Moller-Trumbore
+	bool m_watertight;
+
 	void destroy();
 
 	bool rayIntersectsTriangle(GLuint i0, GLuint i1, GLuint i2,
@@ -77,6 +85,11 @@ public:
 	// Assumes that the shader has already been set up.
 	void rasterize() const;
 
+	// Watertight ray intersection never lets a ray through the shared
+	// edge of two triangles, nor misses grazing triangles. On by default.
+	void setWatertight(const bool watertight) { m_watertight = watertight; }
+	bool isWatertight() const { return m_watertight; }
+
 	// Ray intersector virtuals
 	virtual bool rayIntersects(const RayTracing::Ray_t &ray, const float t0, const float t1, RayTracing::HitInfo_t &hitinfo) const;
 	virtual bool shadowsRay(const RayTracing::Ray_t &ray, const float t0, const float t1) const;
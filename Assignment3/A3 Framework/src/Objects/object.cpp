@@ -14,6 +14,7 @@
 #include "../glUtils.h"
 
 #include <cassert>
+#include <cmath>
 
 namespace Object
 {
@@ -25,19 +26,50 @@ Object::Object(const Geometry *geom, const Material::Material &mat,
 	m_geometry = geom;
 	m_material = mat;
 	m_objectToWorld = objectToWorld;
-	m_worldToObject = gml::inverse(objectToWorld);
-	m_objectToWorld_Normals = gml::transpose(m_worldToObject);
+	m_transformVersion = 0;
+	m_isDynamic = false;
+	setDerived();
 }
 Object::~Object()
 {
 }
 
+void Object::setTransform(const gml::mat4x4_t transform)
+{
+	m_objectToWorld = transform;
+	m_transformVersion += 1;
+	setDerived();
+}
+
+void Object::setDerived()
+{
+	const gml::affine3x4_t objectToWorld = gml::affine(m_objectToWorld);
+	m_worldToObject = gml::inverse(objectToWorld);
+	m_objectToWorld_Normals = gml::normalMatrix(objectToWorld);
+	// The cube root of the volume scale
+	const float det = gml::dot(objectToWorld[0], gml::cross(objectToWorld[1], objectToWorld[2]));
+	m_worldToObjectScale = 1.0f / cbrtf(fabsf(det));
+
+	gml::vec3_t center;
+	float radius;
+	m_geometry->getBoundingSphere(center, radius);
+
+	m_boundCenter = gml::transformPoint(objectToWorld, center);
+	// The sphere is scaled by, at most, the length of the longest basis vector
+	float maxScale2 = gml::length2(objectToWorld[0]);
+	float s2 = gml::length2(objectToWorld[1]);
+	if (s2 > maxScale2) maxScale2 = s2;
+	s2 = gml::length2(objectToWorld[2]);
+	if (s2 > maxScale2) maxScale2 = s2;
+	m_boundRadius = radius * sqrtf(maxScale2);
+}
+
 bool Object::rayIntersects(const RayTracing::Ray_t &ray, const float t0, const float t1, RayTracing::HitInfo_t &hitinfo) const
 {
 	// 1) Transform the ray into object space
 	RayTracing::Ray_t _ray;
-	_ray.o = gml::extract3( gml::mul(m_worldToObject, gml::vec4_t(ray.o,1.0) ) );
-	_ray.d = gml::extract3( gml::mul(m_worldToObject, gml::vec4_t(ray.d,0.0) ) );
+	_ray.o = gml::transformPoint(m_worldToObject, ray.o);
+	_ray.d = gml::transformVector(m_worldToObject, ray.d);
 
 	if ( m_geometry->rayIntersects(_ray, t0, t1, hitinfo) )
 	{
@@ -51,8 +83,8 @@ bool Object::shadowsRay(const RayTracing::Ray_t &ray, const float t0, const floa
 {
 	// 1) Transform the ray into object space
 	RayTracing::Ray_t _ray;
-	_ray.o = gml::extract3( gml::mul(m_worldToObject, gml::vec4_t(ray.o,1.0) ) );
-	_ray.d = gml::extract3( gml::mul(m_worldToObject, gml::vec4_t(ray.d,0.0) ) );
+	_ray.o = gml::transformPoint(m_worldToObject, ray.o);
+	_ray.d = gml::transformVector(m_worldToObject, ray.d);
 
 	return m_geometry->shadowsRay(_ray, t0, t1);
 }
@@ -61,7 +93,19 @@ void Object::hitProperties(const RayTracing::HitInfo_t &hitinfo, gml::vec3_t &no
 {
 	gml::vec3_t _normal;
 	m_geometry->hitProperties(hitinfo, _normal, texCoords);
-	normal = gml::normalize( gml::extract3( gml::mul( m_objectToWorld_Normals, gml::vec4_t(_normal, 0.0f) ) ) );
+	normal = gml::normalize( gml::mul(m_objectToWorld_Normals, _normal) );
+}
+
+float Object::texFootprint(const RayTracing::HitInfo_t &hitinfo, const gml::vec3_t &d,
+		const gml::vec3_t &normal, const float coneWidth) const
+{
+	const float texScale = m_geometry->getTexScale(hitinfo);
+	if (texScale <= 0.0f) return 0.0f;
+	// The cone is stretched along the surface by 1/cos of the angle that
+	// it hits at; limited, as the mip level is anyway.
+	float cosine = fabsf(gml::dot(d, normal));
+	if (cosine < 1e-3f) cosine = 1e-3f;
+	return coneWidth * m_worldToObjectScale * texScale / cosine;
 }
 
 }
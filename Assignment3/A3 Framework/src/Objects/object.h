@@ -48,9 +48,27 @@ protected:
 	Material::Material m_material;
 
 	// object <-> world space transformations
+	//  The transform is assumed to be affine.
 	gml::mat4x4_t m_objectToWorld;
-	gml::mat4x4_t m_objectToWorld_Normals; // Transforming normals
-	gml::mat4x4_t m_worldToObject;
+	gml::mat3x3_t m_objectToWorld_Normals; // Transforming normals
+	gml::affine3x4_t m_worldToObject;
+	// 1 / the average scale of lengths by m_objectToWorld
+	float m_worldToObjectScale;
+
+	// World-space bounding sphere; recomputed whenever the transform changes
+	gml::vec3_t m_boundCenter;
+	float m_boundRadius;
+
+	// Incremented every time the transform changes. Consumers that cache
+	// data derived from the transform (ex: shadow maps) compare against this.
+	GLuint m_transformVersion;
+
+	// true iff the object is expected to move. Static objects are
+	// cached separately from dynamic ones by the shadow map.
+	bool m_isDynamic;
+
+	// Derive the inverse & normal transforms, and bounds, from m_objectToWorld
+	void setDerived();
 public:
 	Object(const Geometry *geom, const Material::Material &mat,
 			const gml::mat4x4_t &objectToWorld);
@@ -58,10 +76,22 @@ public:
 
 	void setTransform(const gml::mat4x4_t transform);
 	gml::mat4x4_t getObjectToWorld() const { return m_objectToWorld; }
-	Material::Material getMaterial() const { return m_material; }
+	const gml::affine3x4_t& getWorldToObject() const { return m_worldToObject; }
+	GLuint getTransformVersion() const { return m_transformVersion; }
 
+	void setIsDynamic(const bool dynamic) { m_isDynamic = dynamic; }
+	bool isDynamic() const { return m_isDynamic; }
+
+	// World-space bounding sphere of the object
+	const gml::vec3_t& getBoundCenter() const { return m_boundCenter; }
+	float getBoundRadius() const { return m_boundRadius; }
+	const Material::Material& getMaterial() const { return m_material; }
+
+	// Call Scene::updateMaterials() after changing the material of an
+	// object that is in a scene.
 	void setMaterial(const Material::Material &mat) { m_material = mat; }
 
+	const Geometry* getGeometry() const { return m_geometry; }
 	void rasterize() const { m_geometry->rasterize(); }
 
 	// Ray intersector virtuals
@@ -69,6 +99,14 @@ public:
 	virtual bool rayIntersects(const RayTracing::Ray_t &ray, const float t0, const float t1, RayTracing::HitInfo_t &hitinfo) const;
 	virtual bool shadowsRay(const RayTracing::Ray_t &ray, const float t0, const float t1) const;
 	virtual void hitProperties(const RayTracing::HitInfo_t &hitinfo, gml::vec3_t &normal, gml::vec2_t &texCoords) const;
+
+	// Width, in texture coordinates, of the footprint of a ray cone on the
+	// surface at hitinfo.
+	//  coneWidth = the cone's width at the hit; d = the (normalized) ray
+	//  direction; normal = the world-space normal at the hit
+	//  Returns 0 if the geometry has no texture scale.
+	float texFootprint(const RayTracing::HitInfo_t &hitinfo, const gml::vec3_t &d,
+			const gml::vec3_t &normal, const float coneWidth) const;
 };
 
 }
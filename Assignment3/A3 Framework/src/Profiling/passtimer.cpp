@@ -0,0 +1,171 @@
+
+/*
+ * Copyright:
+ * Daniel D. Neilson (ddneilson@ieee.org)
+ * University of Saskatchewan
+ * All rights reserved
+ *
+ * Permission granted to use for use in assignments and
+ * projects for CMPT 485 & CMPT 829 at the University
+ * of Saskatchewan.
+ */
+
+#include <cstdlib>
+#include <cstring>
+
+#include "passtimer.h"
+#include "../GL3/gl3w.h"
+#include "../glUtils.h"
+
+PassTimer::PassTimer()
+{
+	memset(m_queries, 0x00, sizeof(m_queries));
+	memset(m_issued, 0x00, sizeof(m_issued));
+	m_slot = 0;
+	m_nPasses = 0;
+	m_isReady = false;
+	reset();
+}
+
+PassTimer::~PassTimer()
+{
+	if (m_isReady)
+	{
+		glDeleteQueries(FRAMESYNC_MAX_FRAMES*PASSTIMER_MAX_PASSES*2, &m_queries[0][0][0]);
+	}
+}
+
+bool PassTimer::init()
+{
+	if (m_isReady)
+	{
+		glDeleteQueries(FRAMESYNC_MAX_FRAMES*PASSTIMER_MAX_PASSES*2, &m_queries[0][0][0]);
+	}
+	glGenQueries(FRAMESYNC_MAX_FRAMES*PASSTIMER_MAX_PASSES*2, &m_queries[0][0][0]);
+	memset(m_issued, 0x00, sizeof(m_issued));
+	m_isReady = !isGLError();
+	return m_isReady;
+}
+
+int PassTimer::addPass(const char *name)
+{
+	if (m_nPasses >= PASSTIMER_MAX_PASSES)
+	{
+		fprintf(stderr, "ERROR! Too many timed passes\n");
+		return -1;
+	}
+	m_names[m_nPasses] = name;
+	m_nSamples[m_nPasses] = 0;
+	m_nextSample[m_nPasses] = 0;
+	return m_nPasses++;
+}
+
+void PassTimer::reset()
+{
+	for (int p=0; p<PASSTIMER_MAX_PASSES; p++)
+	{
+		m_nSamples[p] = 0;
+		m_nextSample[p] = 0;
+	}
+}
+
+void PassTimer::collect(const int slot)
+{
+	for (int p=0; p<m_nPasses; p++)
+	{
+		if ( !m_issued[slot][p] ) continue;
+		m_issued[slot][p] = false;
+
+		// The frame's fence has been waited on, so this should always be
+		// true; but never stall if it isn't.
+		GLint available = 0;
+		glGetQueryObjectiv(m_queries[slot][p][1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if ( !available ) continue;
+
+		GLuint64 start, end;
+		glGetQueryObjectui64v(m_queries[slot][p][0], GL_QUERY_RESULT, &start);
+		glGetQueryObjectui64v(m_queries[slot][p][1], GL_QUERY_RESULT, &end);
+
+		m_samples[p][m_nextSample[p]] = (end - start) * 1.0e-6f; // ns -> ms
+		m_nextSample[p] = (m_nextSample[p] + 1) % PASSTIMER_HISTORY;
+		if (m_nSamples[p] < PASSTIMER_HISTORY) m_nSamples[p] += 1;
+	}
+}
+
+void PassTimer::beginFrame(const int slot)
+{
+	if ( !m_isReady ) return;
+	m_slot = slot;
+	collect(slot);
+}
+
+void PassTimer::begin(const int pass)
+{
+	if ( !m_isReady || pass < 0 ) return;
+	glQueryCounter(m_queries[m_slot][pass][0], GL_TIMESTAMP);
+}
+
+void PassTimer::end(const int pass)
+{
+	if ( !m_isReady || pass < 0 ) return;
+	glQueryCounter(m_queries[m_slot][pass][1], GL_TIMESTAMP);
+	m_issued[m_slot][pass] = true;
+}
+
+static int compareFloat(const void *a, const void *b)
+{
+	const float x = *(const float*)a, y = *(const float*)b;
+	return (x < y) ? -1 : ((x > y) ? 1 : 0);
+}
+
+void PassTimer::getStats(const int pass, float &min, float &avg, float &p99) const
+{
+	const int n = m_nSamples[pass];
+	if (n == 0)
+	{
+		min = avg = p99 = 0.0f;
+		return;
+	}
+	float sorted[PASSTIMER_HISTORY];
+	memcpy(sorted, m_samples[pass], n*sizeof(float));
+	qsort(sorted, n, sizeof(float), compareFloat);
+
+	float sum = 0.0f;
+	for (int i=0; i<n; i++) sum += sorted[i];
+
+	min = sorted[0];
+	avg = sum / n;
+	// Nearest-rank percentile
+	int rank = (99*n + 99) / 100; // ceil(0.99*n)
+	p99 = sorted[rank-1];
+}
+
+void PassTimer::print(FILE *out) const
+{
+	fprintf(out, "%-16s %8s %10s %10s %10s\n", "Pass", "Samples", "Min(ms)", "Avg(ms)", "P99(ms)");
+	for (int p=0; p<m_nPasses; p++)
+	{
+		float min, avg, p99;
+		getStats(p, min, avg, p99);
+		fprintf(out, "%-16s %8d %10.3f %10.3f %10.3f\n", m_names[p], m_nSamples[p], min, avg, p99);
+	}
+}
+
+bool PassTimer::dumpCSV(const char *filename) const
+{
+	FILE *out = fopen(filename, "w");
+	if ( !out )
+	{
+		fprintf(stderr, "ERROR! Could not open %s for writing\n", filename);
+		return false;
+	}
+	fprintf(out, "pass,samples,min_ms,avg_ms,p99_ms\n");
+	for (int p=0; p<m_nPasses; p++)
+	{
+		float min, avg, p99;
+		getStats(p, min, avg, p99);
+		fprintf(out, "%s,%d,%f,%f,%f\n", m_names[p], m_nSamples[p], min, avg, p99);
+	}
+	fclose(out);
+	return true;
+}
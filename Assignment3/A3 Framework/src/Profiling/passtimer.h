@@ -0,0 +1,88 @@
+
+/*
+ * Copyright:
+ * Daniel D. Neilson (ddneilson@ieee.org)
+ * University of Saskatchewan
+ * All rights reserved
+ *
+ * Permission granted to use for use in assignments and
+ * projects for CMPT 485 & CMPT 829 at the University
+ * of Saskatchewan.
+ */
+
+/*
+ * GL-side timing of render passes.
+ *
+ * Each pass is bracketed by a pair of GL_TIMESTAMP queries. There is a
+ * set of queries per FrameSync slot, and a slot's results are only read
+ * back when the slot comes around again; by then FrameSync has waited on
+ * that frame's fence, so reading never stalls.
+ *
+ * The last PASSTIMER_HISTORY times of each pass are kept, and
+ * min/avg/p99 are computed from them.
+ */
+
+#pragma once
+#ifndef __INC_PASSTIMER_H_
+#define __INC_PASSTIMER_H_
+
+#include <cstdio>
+
+#include "../GL3/gl3.h"
+#include "../FrameSync/framesync.h"
+
+// Most passes that can be timed
+#define PASSTIMER_MAX_PASSES 8
+// Number of samples kept for each pass
+#define PASSTIMER_HISTORY 256
+
+class PassTimer
+{
+protected:
+	// Timestamp queries at the [0] start & [1] end of each pass, for each slot
+	GLuint m_queries[FRAMESYNC_MAX_FRAMES][PASSTIMER_MAX_PASSES][2];
+	// Whether the pass's queries were issued in the slot's last frame
+	bool m_issued[FRAMESYNC_MAX_FRAMES][PASSTIMER_MAX_PASSES];
+	int m_slot; // Slot of the current frame
+
+	int m_nPasses;
+	const char *m_names[PASSTIMER_MAX_PASSES];
+
+	// Rolling window of pass times; in milliseconds
+	float m_samples[PASSTIMER_MAX_PASSES][PASSTIMER_HISTORY];
+	int m_nSamples[PASSTIMER_MAX_PASSES]; // Number of valid samples
+	int m_nextSample[PASSTIMER_MAX_PASSES]; // Where the next sample goes
+
+	bool m_isReady;
+
+	// Read back the results of the slot's last frame
+	void collect(const int slot);
+	// Statistics over the pass's samples; in milliseconds
+	void getStats(const int pass, float &min, float &avg, float &p99) const;
+public:
+	PassTimer();
+	~PassTimer();
+
+	// Return true if successful
+	bool init();
+
+	// Register a pass. name must outlive the PassTimer.
+	// Returns the pass' id, or -1 if there are too many.
+	int addPass(const char *name);
+
+	// Call at the start of a frame, after FrameSync::beginFrame()
+	void beginFrame(const int slot);
+	// Bracket the GL commands of a pass
+	void begin(const int pass);
+	void end(const int pass);
+
+	// Forget all samples
+	void reset();
+
+	// Print a table of min/avg/p99 per pass
+	void print(FILE *out) const;
+	// Write the statistics as CSV. Return true if successful
+	bool dumpCSV(const char *filename) const;
+};
+
+#endif
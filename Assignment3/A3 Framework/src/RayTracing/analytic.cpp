@@ -0,0 +1,317 @@
+
+/*
+ * Copyright:
+ * Daniel D. Neilson (ddneilson@ieee.org)
+ * University of Saskatchewan
+ * All rights reserved
+ *
+ * Permission granted to use for use in assignments and
+ * projects for CMPT 485 & CMPT 829 at the University
+ * of Saskatchewan.
+ */
+
+#include <cmath>
+#include <cfloat>
+#include "analytic.h"
+#include "../GML/fastmath.h"
+
+namespace RayTracing
+{
+
+// Rays closer than this to parallel with a unit-normal plane, or the
+// axis of a cylinder, miss it
+static const float PARALLEL_EPSILON = 1e-8f;
+// Slack when testing whether a point is inside a polyhedron
+static const float INSIDE_EPSILON = 1e-4f;
+
+static const GLuint NO_FACE = 0xFFFFFFFF;
+
+static inline void extend(AABB_t &box, const gml::vec3_t &p)
+{
+	for (int a=0; a<3; a++)
+	{
+		if (p[a] < box.min[a]) box.min[a] = p[a];
+		if (p[a] > box.max[a]) box.max[a] = p[a];
+	}
+}
+
+static inline AABB_t emptyBox()
+{
+	AABB_t box;
+	box.min = gml::vec3_t(FLT_MAX, FLT_MAX, FLT_MAX);
+	box.max = gml::vec3_t(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	return box;
+}
+
+WatertightRay_t makeWatertightRay(const Ray_t &ray)
+{
+	WatertightRay_t wr;
+	const float ad[3] = { fabsf(ray.d.x), fabsf(ray.d.y), fabsf(ray.d.z) };
+	wr.kz = (ad[0] > ad[1]) ? ( (ad[0] > ad[2]) ? 0 : 2 ) : ( (ad[1] > ad[2]) ? 1 : 2 );
+	wr.kx = (wr.kz + 1) % 3;
+	wr.ky = (wr.kx + 1) % 3;
+	// Keep the triangles' winding, so the edge function signs stay meaningful
+	if (ray.d[wr.kz] < 0.0f)
+	{
+		const int k = wr.kx; wr.kx = wr.ky; wr.ky = k;
+	}
+	wr.sx = ray.d[wr.kx] / ray.d[wr.kz];
+	wr.sy = ray.d[wr.ky] / ray.d[wr.kz];
+	wr.sz = 1.0f / ray.d[wr.kz];
+	wr.o = ray.o;
+	return wr;
+}
+
+Quad_t makeQuad(const gml::vec3_t &corner, const gml::vec3_t &edgeU, const gml::vec3_t &edgeV)
+{
+	Quad_t quad;
+	quad.corner = corner;
+	quad.edgeU = edgeU;
+	quad.edgeV = edgeV;
+	quad.n = gml::cross(edgeU, edgeV);
+	quad.w = gml::scale(1.0f / gml::dot(quad.n, quad.n), quad.n);
+	return quad;
+}
+
+Disk_t makeDisk(const gml::vec3_t &center, const gml::vec3_t &normal, const float radius)
+{
+	Disk_t disk;
+	disk.center = center;
+	disk.n = gml::normalize(normal);
+	disk.radius = radius;
+	// Any axis that is not close to the normal gives a tangent
+	const gml::vec3_t axis = (fabsf(disk.n.x) < 0.9f) ? gml::vec3_t(1.0f, 0.0f, 0.0f) : gml::vec3_t(0.0f, 1.0f, 0.0f);
+	disk.tu = gml::normalize( gml::cross(axis, disk.n) );
+	disk.tv = gml::cross(disk.n, disk.tu);
+	return disk;
+}
+
+bool intersectBox(const Ray_t &ray, const AABB_t &box, const float t0, const float t1, AnalyticHit_t &hit)
+{
+	// Slabs: the ray is in the box between the last entry into a slab,
+	// and the first exit from one.
+	float tNear = -FLT_MAX, tFar = FLT_MAX;
+	GLuint nearFace = NO_FACE, farFace = NO_FACE;
+	for (int a=0; a<3; a++)
+	{
+		const float o = ray.o[a], d = ray.d[a];
+		if (fabsf(d) < PARALLEL_EPSILON)
+		{
+			if (o < box.min[a] || box.max[a] < o) return false;
+			continue;
+		}
+		float tMin = (box.min[a] - o) / d, tMax = (box.max[a] - o) / d;
+		GLuint fMin = 2*a, fMax = 2*a + 1;
+		if (tMin > tMax)
+		{
+			float tt = tMin; tMin = tMax; tMax = tt;
+			GLuint ff = fMin; fMin = fMax; fMax = ff;
+		}
+		if (tMin > tNear) { tNear = tMin; nearFace = fMin; }
+		if (tMax < tFar) { tFar = tMax; farFace = fMax; }
+	}
+	if (tNear > tFar) return false;
+
+	// The exit is the hit for rays that start inside
+	const bool entering = (tNear >= t0);
+	const float t = entering ? tNear : tFar;
+	const GLuint face = entering ? nearFace : farFace;
+	if (t < t0 || t1 < t || face == NO_FACE) return false;
+
+	hit.t = t;
+	hit.p = gml::add(ray.o, gml::scale(t, ray.d));
+	hit.face = face;
+	const int a1 = (face/2 + 1) % 3, a2 = (face/2 + 2) % 3;
+	hit.u = (hit.p[a1] - box.min[a1]) / (box.max[a1] - box.min[a1]);
+	hit.v = (hit.p[a2] - box.min[a2]) / (box.max[a2] - box.min[a2]);
+	return true;
+}
+
+gml::vec3_t getBoxNormal(const AnalyticHit_t &hit)
+{
+	gml::vec3_t n(0.0f, 0.0f, 0.0f);
+	n[hit.face/2] = (hit.face & 1) ? 1.0f : -1.0f;
+	return n;
+}
+
+bool intersectQuad(const Ray_t &ray, const Quad_t &quad, const float t0, const float t1, AnalyticHit_t &hit)
+{
+	// Only exactly parallel rays are rejected; grazing rays are decided
+	// by the u,v tests, so they do not slip past the quad's surface.
+	const float denom = gml::dot(quad.n, ray.d);
+	if (denom == 0.0f) return false;
+
+	const float t = gml::dot(quad.n, gml::sub(quad.corner, ray.o)) / denom;
+	if (t < t0 || t1 < t) return false;
+
+	const gml::vec3_t p = gml::add(ray.o, gml::scale(t, ray.d));
+	const gml::vec3_t q = gml::sub(p, quad.corner);
+	const float u = gml::dot(quad.w, gml::cross(q, quad.edgeV));
+	if (u < 0.0f || 1.0f < u) return false;
+	const float v = gml::dot(quad.w, gml::cross(quad.edgeU, q));
+	if (v < 0.0f || 1.0f < v) return false;
+
+	hit.t = t;
+	hit.p = p;
+	hit.face = 0;
+	hit.u = u;
+	hit.v = v;
+	return true;
+}
+
+bool intersectDisk(const Ray_t &ray, const Disk_t &disk, const float t0, const float t1, AnalyticHit_t &hit)
+{
+	const float denom = gml::dot(disk.n, ray.d);
+	if (fabsf(denom) < PARALLEL_EPSILON) return false;
+
+	const float t = gml::dot(disk.n, gml::sub(disk.center, ray.o)) / denom;
+	if (t < t0 || t1 < t) return false;
+
+	const gml::vec3_t p = gml::add(ray.o, gml::scale(t, ray.d));
+	const gml::vec3_t q = gml::sub(p, disk.center);
+	if (gml::dot(q, q) > disk.radius*disk.radius) return false;
+
+	hit.t = t;
+	hit.p = p;
+	hit.face = 0;
+	hit.u = gml::dot(q, disk.tu) / disk.radius;
+	hit.v = gml::dot(q, disk.tv) / disk.radius;
+	return true;
+}
+
+bool intersectCylinder(const Ray_t &ray, const Cylinder_t &cyl, const float t0, const float t1, AnalyticHit_t &hit)
+{
+	// |(o + td).xz|^2 = radius^2
+	const float a = ray.d.x*ray.d.x + ray.d.z*ray.d.z;
+	if (a < PARALLEL_EPSILON) return false;
+	const float b = ray.o.x*ray.d.x + ray.o.z*ray.d.z; // Half of B
+	const float c = ray.o.x*ray.o.x + ray.o.z*ray.o.z - cyl.radius*cyl.radius;
+	const float disc = b*b - a*c;
+	if (disc < 0.0f) return false;
+
+	const float root = sqrtf(disc);
+	const float roots[2] = { (-b - root) / a, (-b + root) / a };
+	for (int i=0; i<2; i++)
+	{
+		const float t = roots[i];
+		if (t < t0 || t1 < t) continue;
+		const float y = ray.o.y + t*ray.d.y;
+		if (y < cyl.yMin || cyl.yMax < y) continue;
+
+		hit.t = t;
+		hit.p = gml::add(ray.o, gml::scale(t, ray.d));
+		hit.face = 0;
+		hit.u = (gml::shading::atan2(hit.p.z, hit.p.x) + M_PI) / (2.0f * M_PI);
+		hit.v = (y - cyl.yMin) / (cyl.yMax - cyl.yMin);
+		return true;
+	}
+	return false;
+}
+
+bool intersectPolyhedron(const Ray_t &ray, const ConvexPolyhedron_t &poly, const float t0, const float t1, AnalyticHit_t &hit)
+{
+	// Clip the ray by each half-space in turn
+	float tNear = -FLT_MAX, tFar = FLT_MAX;
+	GLuint nearFace = NO_FACE, farFace = NO_FACE;
+	for (GLuint i=0; i<poly.nPlanes; i++)
+	{
+		const gml::vec3_t n = gml::extract3(poly.planes[i]);
+		const float dist = poly.planes[i].w - gml::dot(n, ray.o); // >= 0 inside
+		const float denom = gml::dot(n, ray.d);
+		if (fabsf(denom) < PARALLEL_EPSILON)
+		{
+			if (dist < 0.0f) return false;
+			continue;
+		}
+		const float t = dist / denom;
+		if (denom < 0.0f)
+		{
+			if (t > tNear) { tNear = t; nearFace = i; }
+		}
+		else
+		{
+			if (t < tFar) { tFar = t; farFace = i; }
+		}
+		if (tNear > tFar) return false;
+	}
+
+	// The exit is the hit for rays that start inside
+	const bool entering = (tNear >= t0);
+	const float t = entering ? tNear : tFar;
+	const GLuint face = entering ? nearFace : farFace;
+	if (t < t0 || t1 < t || face == NO_FACE) return false;
+
+	hit.t = t;
+	hit.p = gml::add(ray.o, gml::scale(t, ray.d));
+	hit.face = face;
+	hit.u = hit.v = 0.0f;
+	return true;
+}
+
+AABB_t getBounds(const Quad_t &quad)
+{
+	AABB_t box = emptyBox();
+	extend(box, quad.corner);
+	extend(box, gml::add(quad.corner, quad.edgeU));
+	extend(box, gml::add(quad.corner, quad.edgeV));
+	extend(box, gml::add(quad.corner, gml::add(quad.edgeU, quad.edgeV)));
+	return box;
+}
+
+AABB_t getBounds(const Disk_t &disk)
+{
+	// The disk's extent along axis a is radius * sin(angle between n & a)
+	AABB_t box;
+	for (int a=0; a<3; a++)
+	{
+		const float s2 = 1.0f - disk.n[a]*disk.n[a];
+		const float e = disk.radius * sqrtf( (s2 > 0.0f) ? s2 : 0.0f );
+		box.min[a] = disk.center[a] - e;
+		box.max[a] = disk.center[a] + e;
+	}
+	return box;
+}
+
+AABB_t getBounds(const Cylinder_t &cyl)
+{
+	AABB_t box;
+	box.min = gml::vec3_t(-cyl.radius, cyl.yMin, -cyl.radius);
+	box.max = gml::vec3_t(cyl.radius, cyl.yMax, cyl.radius);
+	return box;
+}
+
+AABB_t getBounds(const ConvexPolyhedron_t &poly)
+{
+	// Every vertex is where three of the planes meet
+	AABB_t box = emptyBox();
+	for (GLuint i=0; i<poly.nPlanes; i++)
+	{
+		const gml::vec3_t ni = gml::extract3(poly.planes[i]);
+		for (GLuint j=i+1; j<poly.nPlanes; j++)
+		{
+			const gml::vec3_t nj = gml::extract3(poly.planes[j]);
+			for (GLuint k=j+1; k<poly.nPlanes; k++)
+			{
+				const gml::vec3_t nk = gml::extract3(poly.planes[k]);
+				const gml::vec3_t jk = gml::cross(nj, nk);
+				const float det = gml::dot(ni, jk);
+				if (fabsf(det) < INSIDE_EPSILON) continue;
+
+				const gml::vec3_t p = gml::scale( 1.0f / det,
+						gml::add( gml::scale(poly.planes[i].w, jk),
+						gml::add( gml::scale(poly.planes[j].w, gml::cross(nk, ni)),
+								gml::scale(poly.planes[k].w, gml::cross(ni, nj)) ) ) );
+
+				bool inside = true;
+				for (GLuint m=0; inside && m<poly.nPlanes; m++)
+				{
+					inside = gml::dot(gml::extract3(poly.planes[m]), p) <= poly.planes[m].w + INSIDE_EPSILON;
+				}
+				if (inside) extend(box, p);
+			}
+		}
+	}
+	return box;
+}
+
+}
@@ -0,0 +1,177 @@
+
+/*
+ * Copyright:
+ * Daniel D. Neilson (ddneilson@ieee.org)
+ * University of Saskatchewan
+ * All rights reserved
+ *
+ * Permission granted to use for use in assignments and
+ * projects for CMPT 485 & CMPT 829 at the University
+ * of Saskatchewan.
+ */
+
+/*
+ * Analytic ray intersection for simple shapes.
+ *
+ * Geometry models can use these, instead of a triangle mesh, for
+ * ray tracing while keeping their mesh for rasterization.
+ *
+ * Every intersect*() function takes a ray in the shape's own space,
+ * and returns true iff the ray hits the surface in [t0, t1]. On a hit
+ * it sets hit.t, hit.p, and the shape's surface parameters; hit is not
+ * altered otherwise. Surfaces are two-sided: a ray that starts inside
+ * a solid hits it where it leaves.
+ *
+ * Every shape also has a tight axis-aligned bounding box.
+ */
+
+#pragma once
+#ifndef __INC_RAYTRACING_ANALYTIC_H_
+#define __INC_RAYTRACING_ANALYTIC_H_
+
+#include "../GML/gml.h"
+#include "types.h"
+
+namespace RayTracing
+{
+
+// Axis-aligned bounding box
+typedef struct
+{
+	gml::vec3_t min, max;
+} AABB_t;
+
+// Parallelogram: corner + u*edgeU + v*edgeV; u,v in [0,1]
+typedef struct
+{
+	gml::vec3_t corner, edgeU, edgeV;
+	gml::vec3_t n; // cross(edgeU, edgeV)
+	gml::vec3_t w; // n / |n|^2; recovers (u,v) from a point
+} Quad_t;
+
+// Disk of the given radius, in the plane through center with unit normal n.
+//  tu, tv = unit tangents; the hit's (u,v) are along them, in [-1,1]
+typedef struct
+{
+	gml::vec3_t center, n;
+	gml::vec3_t tu, tv;
+	float radius;
+} Disk_t;
+
+// Open cylinder about the y-axis: x^2 + z^2 = radius^2, y in [yMin, yMax].
+//  u = angle about the axis, in [0,1]; v = (y - yMin) / (yMax - yMin)
+typedef struct
+{
+	float radius;
+	float yMin, yMax;
+} Cylinder_t;
+
+// Intersection of half-spaces: the points p with dot(plane.xyz, p) <= plane.w
+// for every plane. plane.xyz must be unit length.
+typedef struct
+{
+	const gml::vec4_t *planes;
+	GLuint nPlanes;
+} ConvexPolyhedron_t;
+
+// Triangle, for watertight intersection
+typedef struct
+{
+	gml::vec3_t v0, v1, v2;
+} Triangle_t;
+
+// A ray, set up for watertight triangle intersection.
+//  The ray is translated to the origin, and sheared so that it runs down
+// its dominant axis, kz. Triangles are then tested in 2D, with the same
+// edge functions for both triangles that share an edge, so a ray can not
+// pass between them.
+typedef struct
+{
+	int kx, ky, kz; // Axes; kz is where |d| is largest
+	float sx, sy, sz; // Shear constants
+	gml::vec3_t o;
+} WatertightRay_t;
+
+// Result of an intersect*() call
+typedef struct
+{
+	float t;
+	gml::vec3_t p; // Hit point
+	GLuint face; // Box: 2*axis + (1 if the max side); polyhedron: plane index
+	float u, v; // Surface parameters; see the shape
+} AnalyticHit_t;
+
+WatertightRay_t makeWatertightRay(const Ray_t &ray);
+Quad_t makeQuad(const gml::vec3_t &corner, const gml::vec3_t &edgeU, const gml::vec3_t &edgeV);
+Disk_t makeDisk(const gml::vec3_t &center, const gml::vec3_t &normal, const float radius);
+
+bool intersectBox(const Ray_t &ray, const AABB_t &box, const float t0, const float t1, AnalyticHit_t &hit);
+bool intersectQuad(const Ray_t &ray, const Quad_t &quad, const float t0, const float t1, AnalyticHit_t &hit);
+bool intersectDisk(const Ray_t &ray, const Disk_t &disk, const float t0, const float t1, AnalyticHit_t &hit);
+bool intersectCylinder(const Ray_t &ray, const Cylinder_t &cyl, const float t0, const float t1, AnalyticHit_t &hit);
+bool intersectPolyhedron(const Ray_t &ray, const ConvexPolyhedron_t &poly, const float t0, const float t1, AnalyticHit_t &hit);
+
+// Watertight ray-triangle intersection (Woop, Benthin & Wald, 2013).
+//  Inline; it is called once per triangle. Sets t, and the barycentric
+// coordinates u & v of v1 & v2 at the hit.
+inline bool intersectTriangle(const WatertightRay_t &ray, const Triangle_t &tri, const float t0, const float t1,
+		float &t, float &u, float &v)
+{
+	const float *o = &ray.o.x;
+	const float *p0 = &tri.v0.x, *p1 = &tri.v1.x, *p2 = &tri.v2.x;
+	const float az = p0[ray.kz] - o[ray.kz], bz = p1[ray.kz] - o[ray.kz], cz = p2[ray.kz] - o[ray.kz];
+	const float ax = p0[ray.kx] - o[ray.kx] - ray.sx*az, ay = p0[ray.ky] - o[ray.ky] - ray.sy*az;
+	const float bx = p1[ray.kx] - o[ray.kx] - ray.sx*bz, by = p1[ray.ky] - o[ray.ky] - ray.sy*bz;
+	const float cx = p2[ray.kx] - o[ray.kx] - ray.sx*cz, cy = p2[ray.ky] - o[ray.ky] - ray.sy*cz;
+
+	// Edge functions; the ray is inside iff they all have the same sign.
+	// Most triangles are missed, and the first two usually show it.
+	float U = cx*by - cy*bx;
+	float V = ax*cy - ay*cx;
+	if ( (U < 0.0f && V > 0.0f) || (U > 0.0f && V < 0.0f) ) return false;
+	float W = bx*ay - by*ax;
+	if (U == 0.0f || V == 0.0f || W == 0.0f)
+	{
+		// On an edge, to float precision; decide it in double
+		U = (float)((double)cx*by - (double)cy*bx);
+		V = (float)((double)ax*cy - (double)ay*cx);
+		W = (float)((double)bx*ay - (double)by*ax);
+	}
+	if ( (U < 0.0f || V < 0.0f || W < 0.0f) && (U > 0.0f || V > 0.0f || W > 0.0f) ) return false;
+
+	const float det = U + V + W;
+	if (det == 0.0f) return false;
+
+	const float T = ray.sz * (U*az + V*bz + W*cz);
+	const float rcpDet = 1.0f / det;
+	const float tHit = T * rcpDet;
+	if (tHit < t0 || t1 < tHit) return false;
+
+	t = tHit;
+	u = V * rcpDet;
+	v = W * rcpDet;
+	return true;
+}
+
+// Outward unit normals at a hit
+gml::vec3_t getBoxNormal(const AnalyticHit_t &hit);
+inline gml::vec3_t getQuadNormal(const Quad_t &quad) { return gml::normalize(quad.n); }
+inline gml::vec3_t getDiskNormal(const Disk_t &disk) { return disk.n; }
+inline gml::vec3_t getCylinderNormal(const Cylinder_t &cyl, const AnalyticHit_t &hit)
+{
+	return gml::vec3_t(hit.p.x / cyl.radius, 0.0f, hit.p.z / cyl.radius);
+}
+inline gml::vec3_t getPolyhedronNormal(const ConvexPolyhedron_t &poly, const AnalyticHit_t &hit)
+{
+	return gml::extract3(poly.planes[hit.face]);
+}
+
+AABB_t getBounds(const Quad_t &quad);
+AABB_t getBounds(const Disk_t &disk);
+AABB_t getBounds(const Cylinder_t &cyl);
+// From the polyhedron's vertices; the polyhedron must be bounded
+AABB_t getBounds(const ConvexPolyhedron_t &poly);
+
+}
+
+#endif
@@ -0,0 +1,88 @@
+
+/*
+ * Copyright:
+ * Daniel D. Neilson (ddneilson@ieee.org)
+ * University of Saskatchewan
+ * All rights reserved
+ *
+ * Permission granted to use for use in assignments and
+ * projects for CMPT 485 & CMPT 829 at the University
+ * of Saskatchewan.
+ */
+
+#include <stdint.h>
+#include "arena.h"
+
+namespace RayTracing
+{
+
+Arena::Arena(const size_t blockSize)
+{
+	m_blocks = 0;
+	m_blockSize = blockSize;
+	m_used = 0;
+	m_highWater = 0;
+}
+
+Arena::~Arena()
+{
+	freeBlocks();
+}
+
+Arena::Block* Arena::newBlock(const size_t size)
+{
+	Block *block = new Block;
+	// Room to align the start of the block
+	block->data = new char[size + ARENA_ALIGN];
+	block->size = size;
+	block->used = 0;
+	block->next = m_blocks;
+	m_blocks = block;
+	return block;
+}
+
+void Arena::freeBlocks()
+{
+	while (m_blocks)
+	{
+		Block *next = m_blocks->next;
+		delete[] m_blocks->data;
+		delete m_blocks;
+		m_blocks = next;
+	}
+}
+
+void* Arena::alloc(const size_t bytes)
+{
+	const size_t size = (bytes + ARENA_ALIGN-1) & ~(size_t)(ARENA_ALIGN-1);
+	if ( !m_blocks || (m_blocks->used + size > m_blocks->size) )
+	{
+		newBlock( (size > m_blockSize) ? size : m_blockSize );
+	}
+
+	// Offset of the block's first aligned byte
+	const size_t start = (ARENA_ALIGN - ((uintptr_t)m_blocks->data & (ARENA_ALIGN-1))) & (ARENA_ALIGN-1);
+	void *ptr = m_blocks->data + start + m_blocks->used;
+	m_blocks->used += size;
+
+	m_used += size;
+	if (m_used > m_highWater) m_highWater = m_used;
+	return ptr;
+}
+
+void Arena::reset()
+{
+	if (m_blocks && m_blocks->next)
+	{
+		// Replace the chain with one block that holds it all
+		freeBlocks();
+		newBlock( (m_highWater > m_blockSize) ? m_highWater : m_blockSize );
+	}
+	else if (m_blocks)
+	{
+		m_blocks->used = 0;
+	}
+	m_used = 0;
+}
+
+}
@@ -0,0 +1,67 @@
+
+/*
+ * Copyright:
+ * Daniel D. Neilson (ddneilson@ieee.org)
+ * University of Saskatchewan
+ * All rights reserved
+ *
+ * Permission granted to use for use in assignments and
+ * projects for CMPT 485 & CMPT 829 at the University
+ * of Saskatchewan.
+ */
+
+#pragma once
+#ifndef __INC_RAYTRACING_ARENA_H_
+#define __INC_RAYTRACING_ARENA_H_
+
+#include <stddef.h>
+
+namespace RayTracing
+{
+
+// Alignment of every allocation; enough for AVX loads
+#define ARENA_ALIGN 32
+
+// Bump allocator for scratch memory that lives for one batch of work.
+// --
+// alloc() hands out memory from a block; when a block is full, another
+// is chained on. reset() frees everything at once, and merges the
+// blocks into one big enough for the most that has been used, so a
+// steady workload stops allocating after its first batch.
+class Arena
+{
+protected:
+	typedef struct _Block
+	{
+		struct _Block *next;
+		size_t size; // Usable bytes in the block
+		size_t used;
+		char *data;
+	} Block;
+	Block *m_blocks; // Newest block first
+	size_t m_blockSize; // Smallest block to allocate
+
+	size_t m_used; // Bytes allocated since the last reset()
+	size_t m_highWater; // Most bytes ever allocated between resets
+
+	Block* newBlock(const size_t size);
+	void freeBlocks();
+public:
+	Arena(const size_t blockSize = 1<<20);
+	~Arena();
+
+	// Uninitialized, ARENA_ALIGN-aligned memory; valid until reset()
+	void* alloc(const size_t bytes);
+	template <typename T>
+	T* alloc(const size_t count) { return (T*)alloc(count * sizeof(T)); }
+
+	// Free every allocation
+	void reset();
+
+	size_t getUsed() const { return m_used; }
+	size_t getHighWater() const { return m_highWater; }
+};
+
+}
+
+#endif
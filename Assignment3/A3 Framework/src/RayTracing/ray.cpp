@@ -14,6 +14,7 @@
 
 #include "types.h"
 #include "../GML/gml.h"
+#include "../GML/fastmath.h"
 
 namespace RayTracing
 {
@@ -93,8 +94,11 @@ void _Ray_t::randomDirection(const gml::vec3_t &n)
 	float random1 = randFloat();
 	float random2 = randFloat();
 
-	float scalarU = cosf(2.0f * M_PI * random1) * sqrtf(random2);
-	float scalarV = sinf(2.0f * M_PI * random1) * sqrtf(random2);
+	float sinA, cosA;
+	gml::shading::sincos(2.0f * M_PI * random1, sinA, cosA);
+	const float r = sqrtf(random2);
+	float scalarU = cosA * r;
+	float scalarV = sinA * r;
 	float scalarW = sqrtf(1.0f - random2);
 
 	gml::vec3_t newU = gml::scale(scalarU, u);
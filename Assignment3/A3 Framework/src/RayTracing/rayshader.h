@@ -30,9 +30,10 @@ typedef struct _ShaderValues
 	gml::vec3_t p; // Point being shaded (world-space)
 	gml::vec3_t n; // Normal of p (world-space)
 	gml::vec2_t tex; // Texture coordinates of p
+	float texWidth; // Width of the pixel's footprint in texture coordinates; 0 = unfiltered
 	const Material::Material &mat; // Material properties of p
 
-	_ShaderValues(const Material::Material &m) : mat(m) { }
+	_ShaderValues(const Material::Material &m) : texWidth(0.0f), mat(m) { }
 } ShaderValues;
 
 class Shader
@@ -0,0 +1,107 @@
+
+/*
+ * Copyright:
+ * Daniel D. Neilson (ddneilson@ieee.org)
+ * University of Saskatchewan
+ * All rights reserved
+ *
+ * Permission granted to use for use in assignments and
+ * projects for CMPT 485 & CMPT 829 at the University
+ * of Saskatchewan.
+ */
+
+/*
+ * Ray-sphere intersection kernel.
+ *
+ * For the ray o + td and a sphere of radius r, centered at c, with
+ * f = o - c:
+ *   a = d.d,  b = f.d,  c' = f.f - r^2
+ *   discriminant = b^2 - a*c' = a*r^2 - |f x d|^2
+ * The second form of the discriminant does not cancel catastrophically
+ * when the sphere is small and far away. The roots are taken as
+ *   q = -(b + sign(b)*sqrt(discriminant)),  t = q/a  and  t = c'/q
+ * so neither is the difference of two nearly equal numbers; both come
+ * from a single division.
+ *
+ * The hit is the nearer root if it is in [t0,t1], else the farther root
+ * if it is; so a ray that starts inside the sphere hits where it leaves.
+ *
+ * The scalar form, and the wide form (gml::vec3x4_t or vec3x8_t; 4 or
+ * 8 rays, or spheres, at once) give the same answer. The wide form
+ * returns a mask of the lanes that hit, and is only defined with SSE2.
+ */
+
+#pragma once
+#ifndef __INC_RAYTRACING_SPHEREKERNEL_H_
+#define __INC_RAYTRACING_SPHEREKERNEL_H_
+
+#include <math.h>
+#include "../GML/gml.h"
+#if defined(__SSE2__)
+#include "../GML/gmlwide.h"
+#endif
+
+namespace RayTracing
+{
+
+// f = ray origin - sphere center; r2 = radius^2
+//  Returns true iff the ray hits the sphere in [t0,t1], and sets t.
+inline bool intersectSphere(const gml::vec3_t &f, const gml::vec3_t &d, const float r2,
+		const float t0, const float t1, float &t)
+{
+	const float a = gml::dot(d, d);
+	const gml::vec3_t fxd = gml::cross(f, d);
+	const float disc = a*r2 - gml::dot(fxd, fxd);
+	if (disc < 0.0f) return false;
+
+	const float b = gml::dot(f, d);
+	const float c = gml::dot(f, f) - r2;
+	const float q = -(b + copysignf(sqrtf(disc), b));
+	// q/a and c/q, with one division
+	const float inv = 1.0f / (a*q);
+	float tNear = q*q*inv, tFar = c*a*inv;
+	if (tNear > tFar)
+	{
+		const float tt = tNear; tNear = tFar; tFar = tt;
+	}
+
+	const float tHit = (tNear >= t0) ? tNear : tFar;
+	if (tHit < t0 || t1 < tHit) return false;
+	t = tHit;
+	return true;
+}
+
+#if defined(__SSE2__)
+// Every lane of intersectSphere(); VEC3W = gml::vec3x4_t or vec3x8_t.
+//  t is only meaningful in the lanes that hit.
+template <typename VEC3W>
+inline typename VEC3W::maskw_t intersectSphere(const VEC3W &f, const VEC3W &d,
+		const typename VEC3W::floatw_t r2, const typename VEC3W::floatw_t t0,
+		const typename VEC3W::floatw_t t1, typename VEC3W::floatw_t &t)
+{
+	typedef typename VEC3W::floatw_t FLOATW;
+	typedef typename VEC3W::maskw_t MASKW;
+	const FLOATW zero(0.0f);
+
+	const FLOATW a = gml::dot(d, d);
+	const FLOATW disc = gml::sub( gml::mul(a, r2), gml::length2(gml::cross(f, d)) );
+	MASKW hit = gml::cmpge(disc, zero);
+	if ( !gml::any(hit) ) return hit;
+
+	const FLOATW b = gml::dot(f, d);
+	const FLOATW c = gml::sub( gml::dot(f, f), r2 );
+	const FLOATW q = gml::neg( gml::add(b, gml::copysign(gml::sqrt(gml::max(disc, zero)), b)) );
+	const FLOATW inv = gml::div( FLOATW(1.0f), gml::mul(a, q) );
+	const FLOATW tA = gml::mul( gml::mul(q, q), inv );
+	const FLOATW tB = gml::mul( gml::mul(c, a), inv );
+	const FLOATW tNear = gml::min(tA, tB), tFar = gml::max(tA, tB);
+
+	// Select without branches: the near root where it is past t0
+	t = gml::select( gml::cmpge(tNear, t0), tNear, tFar );
+	return gml::both( hit, gml::both(gml::cmpge(t, t0), gml::cmple(t, t1)) );
+}
+#endif
+
+}
+
+#endif
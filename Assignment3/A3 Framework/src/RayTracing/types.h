@@ -36,6 +36,17 @@ typedef struct _Ray_t{
 	void randomDirection(const gml::vec3_t &n);
 } Ray_t;
 
+// Cone around a ray, for filtering textures (a "ray cone"). It covers
+// the ray's pixel; its width at distance t along the ray is
+// width + t*spread.
+typedef struct _RayCone_t {
+	float width; // Width at the ray's origin
+	float spread; // Growth of the width per unit distance
+	_RayCone_t() { width = 0.0f; spread = 0.0f; }
+	_RayCone_t(const float w, const float s) { width = w; spread = s; }
+	float widthAt(const float t) const { return width + t*spread; }
+} RayCone_t;
+
 
 // Hit/intersection information caching types
 typedef struct {
@@ -57,9 +68,17 @@ typedef struct {
 	float u, v;
 } MeshHitInfo_t;
 
+typedef struct {
+	// Object-space hit point, and the face of the solid that it is on
+	gml::vec3_t p;
+	GLuint face;
+} SolidHitInfo_t;
+
 typedef struct _HitInfo_t {
 	// Object intersected
 	const Object::Object *objHit;
+	// Index of objHit in the scene; set by Scene::rayIntersects()
+	GLuint objIndex;
 	// Distance along ray to the intersection point
 	float hitDist;
 
@@ -69,6 +88,7 @@ typedef struct _HitInfo_t {
 		SphereHitInfo_t sphere;
 		PlaneHitInfo_t plane;
 		MeshHitInfo_t mesh;
+		SolidHitInfo_t solid;
 	};
 
 	_HitInfo_t() {}
@@ -0,0 +1,477 @@
+
+/*
+ * Copyright:
+ * Daniel D. Neilson (ddneilson@ieee.org)
+ * University of Saskatchewan
+ * All rights reserved
+ *
+ * Permission granted to use for use in assignments and
+ * projects for CMPT 485 & CMPT 829 at the University
+ * of Saskatchewan.
+ */
+
+#include <cstring>
+#include <cmath>
+#include <cfloat>
+
+#include "primbuckets.h"
+#include "../Objects/Models/octahedron.h"
+#include "../RayTracing/spherekernel.h"
+#include "../RayTracing/analytic.h"
+
+namespace Scene
+{
+
+// Marks no object found
+static const GLuint NO_HIT = 0xFFFFFFFF;
+
+static const Object::GeometryType bucketGeometry[PrimitiveBuckets::NUM_BUCKETS] =
+{
+	Object::GEOM_SPHERE, Object::GEOM_PLANE, Object::GEOM_OCTAHEDRON
+};
+
+// As intersectPolyhedron(); planes this near to parallel to the ray are not clipped by
+static const float PARALLEL_EPSILON = 1e-8f;
+
+// Transform p (w=1), or a direction (w=0), by the transform of object i of a bucket
+static inline gml::vec3_t transform(const float *xform, const GLuint capacity, const GLuint i,
+		const gml::vec3_t &p, const float w)
+{
+	const float *m = xform + i;
+	const GLuint c = capacity;
+	return gml::vec3_t( m[0]*p.x + m[c]*p.y + m[2*c]*p.z + w*m[3*c],
+			m[4*c]*p.x + m[5*c]*p.y + m[6*c]*p.z + w*m[7*c],
+			m[8*c]*p.x + m[9*c]*p.y + m[10*c]*p.z + w*m[11*c] );
+}
+
+// -----------------------------------------
+// Intersection kernels
+//  Each finds the distance, t, to where an object-space ray hits the
+// shape in [t0,t1], and whether it hits at all. They match the tests in
+// the shape's Geometry::rayIntersects().
+// -----------------------------------------
+
+#if defined(__SSE2__)
+
+// BUCKET_WIDTH floats, one per object of a block
+#if BUCKET_WIDTH == 8
+typedef gml::vec3x8_t vec3w_t;
+#else
+typedef gml::vec3x4_t vec3w_t;
+#endif
+typedef vec3w_t::floatw_t floatw_t;
+typedef vec3w_t::maskw_t maskw_t;
+
+// Lanes of block i that hold one of the bucket's n objects
+static inline maskw_t laneMask(const GLuint i, const GLuint n)
+{
+#if BUCKET_WIDTH == 8
+	return gml::firstLanes8(n - i);
+#else
+	return gml::firstLanes4(n - i);
+#endif
+}
+
+// Row k of the transforms, times v
+static inline floatw_t row(const float *m, const GLuint c, const vec3w_t &v)
+{
+	return gml::dot( vec3w_t(floatw_t(m), floatw_t(m + c), floatw_t(m + 2*c)), v );
+}
+
+// The ray (o,d) in the object space of objects i .. i+BUCKET_WIDTH-1
+static inline void toObject(const float *xform, const GLuint c, const GLuint i,
+		const vec3w_t &o, const vec3w_t &d, vec3w_t &oObj, vec3w_t &dObj)
+{
+	const float *m = xform + i;
+	oObj = vec3w_t( gml::add(row(m, c, o), floatw_t(m + 3*c)),
+			gml::add(row(m + 4*c, c, o), floatw_t(m + 7*c)),
+			gml::add(row(m + 8*c, c, o), floatw_t(m + 11*c)) );
+	dObj = vec3w_t( row(m, c, d), row(m + 4*c, c, d), row(m + 8*c, c, d) );
+}
+
+// Unit sphere: |o + td|^2 = 1
+static inline maskw_t hitSphere(const vec3w_t &o, const vec3w_t &d, const floatw_t &t0, const floatw_t &t1, floatw_t &t)
+{
+	return RayTracing::intersectSphere(o, d, 1.0f, t0, t1, t);
+}
+
+// Square: y = 0, with x,z in [-1,1]
+static inline maskw_t hitPlane(const vec3w_t &o, const vec3w_t &d, const floatw_t &t0, const floatw_t &t1, floatw_t &t)
+{
+	const floatw_t one(1.0f), minusOne(-1.0f);
+	// Only rays parallel to the plane miss it outright; as intersectQuad()
+	maskw_t ok = gml::cmpneq( d.y, floatw_t(0.0f) );
+	t = gml::div( gml::neg(o.y), d.y );
+	const floatw_t x = gml::add( o.x, gml::mul(t, d.x) );
+	const floatw_t z = gml::add( o.z, gml::mul(t, d.z) );
+	ok = gml::both( ok, gml::both(gml::cmpge(t, t0), gml::cmple(t, t1)) );
+	ok = gml::both( ok, gml::both(gml::cmpge(x, minusOne), gml::cmple(x, one)) );
+	return gml::both( ok, gml::both(gml::cmpge(z, minusOne), gml::cmple(z, one)) );
+}
+
+// Octahedron: intersectPolyhedron() with the octahedron's planes, step for step,
+// so that it finds the same t. Lanes leave off clipping once they miss.
+static inline maskw_t hitOctahedron(const vec3w_t &o, const vec3w_t &d, const floatw_t &t0, const floatw_t &t1, floatw_t &t)
+{
+	const RayTracing::ConvexPolyhedron_t &solid = Object::Models::Octahedron::getSolid();
+	const floatw_t zero(0.0f), eps(PARALLEL_EPSILON);
+	floatw_t tNear(-FLT_MAX), tFar(FLT_MAX);
+	maskw_t ok = laneMask(0, BUCKET_WIDTH);
+	maskw_t hasNear = laneMask(0, 0), hasFar = laneMask(0, 0);
+	for (GLuint i=0; i<solid.nPlanes; i++)
+	{
+		const vec3w_t n( gml::extract3(solid.planes[i]) );
+		const floatw_t dist = gml::sub( floatw_t(solid.planes[i].w), gml::dot(n, o) ); // >= 0 inside
+		const floatw_t denom = gml::dot(n, d);
+		const maskw_t parallel = gml::cmplt( gml::abs(denom), eps );
+		ok = gml::both( ok, gml::invert(gml::both(parallel, gml::cmplt(dist, zero))) );
+
+		const maskw_t clips = gml::both( ok, gml::invert(parallel) );
+		const floatw_t ti = gml::div(dist, denom);
+		const maskw_t entering = gml::cmplt(denom, zero);
+		const maskw_t nearer = gml::both( gml::both(clips, entering), gml::cmpgt(ti, tNear) );
+		const maskw_t farther = gml::both( gml::both(clips, gml::invert(entering)), gml::cmplt(ti, tFar) );
+		tNear = gml::select(nearer, ti, tNear);
+		tFar = gml::select(farther, ti, tFar);
+		hasNear = gml::either(hasNear, nearer);
+		hasFar = gml::either(hasFar, farther);
+		ok = gml::both( ok, gml::cmple(tNear, tFar) );
+	}
+
+	// The exit is the hit for rays that start inside
+	const maskw_t outside = gml::cmpge(tNear, t0);
+	t = gml::select(outside, tNear, tFar);
+	ok = gml::both( ok, gml::either(gml::both(outside, hasNear), gml::both(gml::invert(outside), hasFar)) );
+	return gml::both( ok, gml::both(gml::cmpge(t, t0), gml::cmple(t, t1)) );
+}
+
+template <int Type>
+static inline maskw_t hitW(const vec3w_t &o, const vec3w_t &d, const floatw_t &t0, const floatw_t &t1, floatw_t &t)
+{
+	return (Type == PrimitiveBuckets::BUCKET_SPHERE) ? hitSphere(o, d, t0, t1, t) :
+		(Type == PrimitiveBuckets::BUCKET_PLANE) ? hitPlane(o, d, t0, t1, t) : hitOctahedron(o, d, t0, t1, t);
+}
+
+#else // No SSE
+
+static inline bool hitSphere(const gml::vec3_t &o, const gml::vec3_t &d, const float t0, const float t1, float &t)
+{
+	return RayTracing::intersectSphere(o, d, 1.0f, t0, t1, t);
+}
+
+static inline bool hitPlane(const gml::vec3_t &o, const gml::vec3_t &d, const float t0, const float t1, float &t)
+{
+	if (d.y == 0.0f) return false;
+	t = -o.y / d.y;
+	if (t < t0 || t1 < t) return false;
+	const float x = o.x + t*d.x;
+	const float z = o.z + t*d.z;
+	return -1.0f <= x && x <= 1.0f && -1.0f <= z && z <= 1.0f;
+}
+
+static inline bool hitOctahedron(const gml::vec3_t &o, const gml::vec3_t &d, const float t0, const float t1, float &t)
+{
+	RayTracing::Ray_t ray;
+	ray.o = o;
+	ray.d = d;
+	RayTracing::AnalyticHit_t hit;
+	if ( !RayTracing::intersectPolyhedron(ray, Object::Models::Octahedron::getSolid(), t0, t1, hit) ) return false;
+	t = hit.t;
+	return true;
+}
+
+template <int Type>
+static inline bool hitX1(const gml::vec3_t &o, const gml::vec3_t &d, const float t0, const float t1, float &t)
+{
+	return (Type == PrimitiveBuckets::BUCKET_SPHERE) ? hitSphere(o, d, t0, t1, t) :
+		(Type == PrimitiveBuckets::BUCKET_PLANE) ? hitPlane(o, d, t0, t1, t) : hitOctahedron(o, d, t0, t1, t);
+}
+
+#endif
+
+// Nearest object of the bucket that the ray hits in [t0, tBest).
+//  Returns its position in the bucket, and sets tBest; or NO_HIT
+template <int Type>
+static GLuint nearestHit(const float *xform, const GLuint capacity, const GLuint n,
+		const RayTracing::Ray_t &ray, const float t0, float &tBest)
+{
+	GLuint best = NO_HIT;
+#if defined(__SSE2__)
+	const vec3w_t O(ray.o), D(ray.d);
+	const floatw_t T0(t0);
+	floatw_t T1(tBest);
+	vec3w_t o, d;
+	floatw_t t;
+	for (GLuint i=0; i<n; i+=BUCKET_WIDTH)
+	{
+		toObject(xform, capacity, i, O, D, o, d);
+		maskw_t hit = gml::both( hitW<Type>(o, d, T0, T1, t), laneMask(i, n) );
+		hit = gml::both( hit, gml::cmplt(t, T1) );
+		int mask = gml::bits(hit);
+		if (mask)
+		{
+			float ts[BUCKET_WIDTH];
+			gml::store(ts, t);
+			for (int l=0; mask; l++, mask >>= 1)
+			{
+				if ( (mask & 1) && ts[l] < tBest )
+				{
+					tBest = ts[l];
+					best = i + l;
+				}
+			}
+			T1 = floatw_t(tBest);
+		}
+	}
+#else
+	float t;
+	for (GLuint i=0; i<n; i++)
+	{
+		const gml::vec3_t o = transform(xform, capacity, i, ray.o, 1.0f);
+		const gml::vec3_t d = transform(xform, capacity, i, ray.d, 0.0f);
+		if ( hitX1<Type>(o, d, t0, tBest, t) && t < tBest )
+		{
+			tBest = t;
+			best = i;
+		}
+	}
+#endif
+	return best;
+}
+
+// Whether the ray hits any object of the bucket in [t0, t1]
+template <int Type>
+static bool anyHit(const float *xform, const GLuint capacity, const GLuint n,
+		const RayTracing::Ray_t &ray, const float t0, const float t1)
+{
+#if defined(__SSE2__)
+	const vec3w_t O(ray.o), D(ray.d);
+	const floatw_t T0(t0), T1(t1);
+	vec3w_t o, d;
+	floatw_t t;
+	for (GLuint i=0; i<n; i+=BUCKET_WIDTH)
+	{
+		toObject(xform, capacity, i, O, D, o, d);
+		if ( gml::any( gml::both(hitW<Type>(o, d, T0, T1, t), laneMask(i, n)) ) ) return true;
+	}
+#else
+	float t;
+	for (GLuint i=0; i<n; i++)
+	{
+		const gml::vec3_t o = transform(xform, capacity, i, ray.o, 1.0f);
+		const gml::vec3_t d = transform(xform, capacity, i, ray.d, 0.0f);
+		if ( hitX1<Type>(o, d, t0, t1, t) ) return true;
+	}
+#endif
+	return false;
+}
+
+// -----------------------------------------
+// PrimitiveBuckets
+// -----------------------------------------
+
+// Number of generic object indices to allocate at a time
+static const GLuint N_GENERIC = 20;
+
+PrimitiveBuckets::PrimitiveBuckets()
+{
+	for (int b=0; b<NUM_BUCKETS; b++)
+	{
+		m_buckets[b].n = 0;
+		m_buckets[b].capacity = 0;
+		m_buckets[b].xform = 0;
+		m_buckets[b].object = 0;
+		m_buckets[b].version = 0;
+	}
+	m_generic = 0;
+	m_nGeneric = 0;
+	m_nGenericAlloced = 0;
+}
+
+PrimitiveBuckets::~PrimitiveBuckets()
+{
+	for (int b=0; b<NUM_BUCKETS; b++)
+	{
+		if (m_buckets[b].capacity > 0)
+		{
+			delete[] m_buckets[b].xform;
+			delete[] m_buckets[b].object;
+			delete[] m_buckets[b].version;
+		}
+	}
+	if (m_generic) delete[] m_generic;
+}
+
+void PrimitiveBuckets::grow(Bucket &b)
+{
+	// Doubles, so that scenes of many thousands of objects stay cheap to build
+	const GLuint capacity = (b.capacity > 0) ? 2*b.capacity : 8*BUCKET_WIDTH;
+
+	float *xform = new float[12*capacity];
+	GLuint *object = new GLuint[capacity];
+	GLuint *version = new GLuint[capacity];
+	memset(xform, 0x00, sizeof(float)*12*capacity);
+	if (b.capacity > 0)
+	{
+		for (int k=0; k<12; k++)
+		{
+			memcpy(xform + k*capacity, b.xform + k*b.capacity, sizeof(float)*b.n);
+		}
+		memcpy(object, b.object, sizeof(GLuint)*b.n);
+		memcpy(version, b.version, sizeof(GLuint)*b.n);
+		delete[] b.xform;
+		delete[] b.object;
+		delete[] b.version;
+	}
+	b.xform = xform;
+	b.object = object;
+	b.version = version;
+	b.capacity = capacity;
+}
+
+void PrimitiveBuckets::setTransform(Bucket &b, const GLuint i, const Object::Object *obj)
+{
+	const gml::affine3x4_t &m = obj->getWorldToObject();
+	for (int r=0; r<3; r++)
+	{
+		for (int c=0; c<4; c++)
+		{
+			b.xform[(4*r + c)*b.capacity + i] = m[c][r];
+		}
+	}
+	b.version[i] = obj->getTransformVersion();
+}
+
+bool PrimitiveBuckets::add(const Object::Object *obj, const GLuint index)
+{
+	const Object::GeometryType type = obj->getGeometry()->getType();
+	for (int t=0; t<NUM_BUCKETS; t++)
+	{
+		if (bucketGeometry[t] != type) continue;
+
+		Bucket &b = m_buckets[t];
+		if (b.n == b.capacity) grow(b);
+		b.object[b.n] = index;
+		setTransform(b, b.n, obj);
+		b.n += 1;
+		return true;
+	}
+
+	if (m_nGeneric == m_nGenericAlloced)
+	{
+		GLuint *temp = new GLuint[m_nGenericAlloced + N_GENERIC];
+		if (temp == 0) return false;
+		if (m_generic)
+		{
+			memcpy(temp, m_generic, sizeof(GLuint)*m_nGeneric);
+			delete[] m_generic;
+		}
+		m_generic = temp;
+		m_nGenericAlloced += N_GENERIC;
+	}
+	m_generic[m_nGeneric++] = index;
+	return true;
+}
+
+void PrimitiveBuckets::update(const Object::Object * const *objects)
+{
+	for (int t=0; t<NUM_BUCKETS; t++)
+	{
+		Bucket &b = m_buckets[t];
+		for (GLuint i=0; i<b.n; i++)
+		{
+			const Object::Object *obj = objects[b.object[i]];
+			if (obj->getTransformVersion() != b.version[i])
+			{
+				setTransform(b, i, obj);
+			}
+		}
+	}
+}
+
+bool PrimitiveBuckets::rayIntersects(const Object::Object * const *objects, const RayTracing::Ray_t &ray,
+		const float t0, const float t1, RayTracing::HitInfo_t &hitinfo) const
+{
+	float tBest = t1;
+	hitinfo.hitDist = t1;
+	bool retVal = false;
+
+	const Bucket &spheres = m_buckets[BUCKET_SPHERE];
+	GLuint i = nearestHit<BUCKET_SPHERE>(spheres.xform, spheres.capacity, spheres.n, ray, t0, tBest);
+	if (i != NO_HIT)
+	{
+		const gml::vec3_t o = transform(spheres.xform, spheres.capacity, i, ray.o, 1.0f);
+		const gml::vec3_t d = transform(spheres.xform, spheres.capacity, i, ray.d, 0.0f);
+		hitinfo.sphere.hitPos = gml::add(o, gml::scale(tBest, d));
+		hitinfo.objIndex = spheres.object[i];
+		retVal = true;
+	}
+
+	const Bucket &planes = m_buckets[BUCKET_PLANE];
+	i = nearestHit<BUCKET_PLANE>(planes.xform, planes.capacity, planes.n, ray, t0, tBest);
+	if (i != NO_HIT)
+	{
+		const gml::vec3_t o = transform(planes.xform, planes.capacity, i, ray.o, 1.0f);
+		const gml::vec3_t d = transform(planes.xform, planes.capacity, i, ray.d, 0.0f);
+		// As Plane::rayIntersects(); (u,v) run along z and x from the (-1,0,-1) corner
+		hitinfo.plane.u = (o.z + tBest*d.z + 1.0f) * 0.5f;
+		hitinfo.plane.v = (o.x + tBest*d.x + 1.0f) * 0.5f;
+		hitinfo.objIndex = planes.object[i];
+		retVal = true;
+	}
+
+	const Bucket &octahedra = m_buckets[BUCKET_OCTAHEDRON];
+	i = nearestHit<BUCKET_OCTAHEDRON>(octahedra.xform, octahedra.capacity, octahedra.n, ray, t0, tBest);
+	if (i != NO_HIT)
+	{
+		// Again, for the face; as Octahedron::rayIntersects()
+		RayTracing::Ray_t objRay;
+		objRay.o = transform(octahedra.xform, octahedra.capacity, i, ray.o, 1.0f);
+		objRay.d = transform(octahedra.xform, octahedra.capacity, i, ray.d, 0.0f);
+		RayTracing::AnalyticHit_t hit;
+		RayTracing::intersectPolyhedron(objRay, Object::Models::Octahedron::getSolid(), t0, tBest, hit);
+		hitinfo.solid.p = hit.p;
+		hitinfo.solid.face = hit.face;
+		hitinfo.objIndex = octahedra.object[i];
+		retVal = true;
+	}
+
+	if (retVal)
+	{
+		hitinfo.hitDist = tBest;
+		hitinfo.objHit = objects[hitinfo.objIndex];
+	}
+
+	RayTracing::HitInfo_t tmpInfo;
+	for (GLuint g=0; g<m_nGeneric; g++)
+	{
+		const GLuint idx = m_generic[g];
+		if ( objects[idx]->rayIntersects(ray, t0, hitinfo.hitDist, tmpInfo) &&
+				tmpInfo.hitDist < hitinfo.hitDist )
+		{
+			hitinfo = tmpInfo;
+			hitinfo.objIndex = idx;
+			retVal = true;
+		}
+	}
+	return retVal;
+}
+
+bool PrimitiveBuckets::shadowsRay(const Object::Object * const *objects, const RayTracing::Ray_t &ray,
+		const float t0, const float t1) const
+{
+	const Bucket &spheres = m_buckets[BUCKET_SPHERE];
+	if ( anyHit<BUCKET_SPHERE>(spheres.xform, spheres.capacity, spheres.n, ray, t0, t1) ) return true;
+	const Bucket &planes = m_buckets[BUCKET_PLANE];
+	if ( anyHit<BUCKET_PLANE>(planes.xform, planes.capacity, planes.n, ray, t0, t1) ) return true;
+	const Bucket &octahedra = m_buckets[BUCKET_OCTAHEDRON];
+	if ( anyHit<BUCKET_OCTAHEDRON>(octahedra.xform, octahedra.capacity, octahedra.n, ray, t0, t1) ) return true;
+
+	for (GLuint g=0; g<m_nGeneric; g++)
+	{
+		if ( objects[m_generic[g]]->shadowsRay(ray, t0, t1) ) return true;
+	}
+	return false;
+}
+
+}
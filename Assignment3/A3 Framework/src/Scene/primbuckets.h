@@ -0,0 +1,97 @@
+
+/*
+ * Copyright:
+ * Daniel D. Neilson (ddneilson@ieee.org)
+ * University of Saskatchewan
+ * All rights reserved
+ *
+ * Permission granted to use for use in assignments and
+ * projects for CMPT 485 & CMPT 829 at the University
+ * of Saskatchewan.
+ */
+
+/*
+ * The objects of a scene, grouped by the type of their geometry
+ * for ray tracing.
+ *
+ * Objects with analytic geometry (Object::GeometryType) are kept in
+ * one bucket per type. A bucket stores only the world-to-object
+ * transform of each of its objects, as a structure of arrays, so a
+ * ray is intersected with BUCKET_WIDTH of them at a time by a SIMD
+ * kernel, with no virtual calls. Every other object (ex: meshes)
+ * goes through Object::rayIntersects(), as before.
+ */
+
+#pragma once
+#ifndef __INC_SCENE_PRIMBUCKETS_H_
+#define __INC_SCENE_PRIMBUCKETS_H_
+
+#include "../Objects/object.h"
+#include "../RayTracing/types.h"
+
+namespace Scene
+{
+
+// Number of objects that a bucket kernel intersects at once
+#if defined(__AVX__)
+#define BUCKET_WIDTH 8
+#else
+#define BUCKET_WIDTH 4
+#endif
+
+class PrimitiveBuckets
+{
+public:
+	typedef enum
+	{
+		BUCKET_SPHERE = 0,
+		BUCKET_PLANE,
+		BUCKET_OCTAHEDRON,
+		NUM_BUCKETS
+	} BucketType;
+protected:
+	typedef struct
+	{
+		GLuint n;
+		GLuint capacity; // Multiple of BUCKET_WIDTH
+		// Row-major 3x4 world-to-object transforms; 12 arrays of capacity.
+		//  Element k of object i is xform[k*capacity + i]
+		float *xform;
+		GLuint *object; // Index of each object in the scene
+		GLuint *version; // Object::getTransformVersion() when copied
+	} Bucket;
+
+	Bucket m_buckets[NUM_BUCKETS];
+
+	// Scene indices of the objects in no bucket
+	GLuint *m_generic;
+	GLuint m_nGeneric;
+	GLuint m_nGenericAlloced;
+
+	static void grow(Bucket &b);
+	static void setTransform(Bucket &b, const GLuint i, const Object::Object *obj);
+public:
+	PrimitiveBuckets();
+	~PrimitiveBuckets();
+
+	// Add object number index of the scene
+	bool add(const Object::Object *obj, const GLuint index);
+	// Copy the transform of every object that has moved since it was
+	// added, or last updated.
+	void update(const Object::Object * const *objects);
+
+	// As RayIntersector::rayIntersects() and shadowsRay() over the
+	// whole scene. Sets hitinfo.objHit & hitinfo.objIndex.
+	//  objects = the scene's objects; as given to add()
+	bool rayIntersects(const Object::Object * const *objects, const RayTracing::Ray_t &ray,
+			const float t0, const float t1, RayTracing::HitInfo_t &hitinfo) const;
+	bool shadowsRay(const Object::Object * const *objects, const RayTracing::Ray_t &ray,
+			const float t0, const float t1) const;
+
+	GLuint getCount(const BucketType type) const { return m_buckets[type].n; }
+	GLuint getGenericCount() const { return m_nGeneric; }
+};
+
+}
+
+#endif
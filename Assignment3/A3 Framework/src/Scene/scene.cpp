@@ -26,6 +26,11 @@ const GLuint N_PTRS = 20;
 Scene::Scene()
 {
 	m_scene = 0;
+	m_rtMaterials = 0;
+	m_rasterCache = 0;
+	m_viewCamera = 0;
+	m_viewVersion = 0;
+	m_frame = 0;
 	m_nObjects = 0;
 	m_nObjPtrsAlloced = 0;
 	// Position of a point light: (0,0,0)
@@ -43,6 +48,8 @@ Scene::~Scene()
 		for (GLuint i=0; i<m_nObjects; i++)
 			delete m_scene[i];
 		delete[] m_scene;
+		delete[] m_rtMaterials;
+		delete[] m_rasterCache;
 	}
 }
 
@@ -64,6 +71,10 @@ bool Scene::addObject(Object::Object *obj)
 		m_nObjPtrsAlloced = N_PTRS;
 		m_scene = new Object::Object*[m_nObjPtrsAlloced];
 		if (m_scene == 0) return false;
+		m_rtMaterials = new RTMaterial[m_nObjPtrsAlloced];
+		if (m_rtMaterials == 0) return false;
+		m_rasterCache = new RasterCache[m_nObjPtrsAlloced];
+		if (m_rasterCache == 0) return false;
 	}
 	else if (m_nObjPtrsAlloced == m_nObjects)
 	{
@@ -73,43 +84,109 @@ bool Scene::addObject(Object::Object *obj)
 		memcpy(temp, m_scene, sizeof(Object::Object*)*m_nObjects);
 		delete[] m_scene;
 		m_scene = temp;
+
+		RTMaterial *tempMats = new RTMaterial[m_nObjPtrsAlloced];
+		if (tempMats == 0) return false;
+		for (GLuint i=0; i<m_nObjects; i++)
+		{
+			tempMats[i] = m_rtMaterials[i];
+		}
+		delete[] m_rtMaterials;
+		m_rtMaterials = tempMats;
+
+		RasterCache *tempCache = new RasterCache[m_nObjPtrsAlloced];
+		if (tempCache == 0) return false;
+		for (GLuint i=0; i<m_nObjects; i++)
+		{
+			tempCache[i] = m_rasterCache[i];
+		}
+		delete[] m_rasterCache;
+		m_rasterCache = tempCache;
 	}
 
+	if ( !m_buckets.add(obj, m_nObjects) ) return false;
+	m_rtMaterials[m_nObjects].mat = obj->getMaterial();
+	m_rtMaterials[m_nObjects].kernel = Shader::getShadeKernel(obj->getMaterial());
+	m_rasterCache[m_nObjects].camera = 0;
 	m_scene[m_nObjects++] = obj;
 	return true;
 }
 
-void Scene::rasterizeDepth(const gml::mat4x4_t &worldView, const gml::mat4x4_t &projection)
+void Scene::updateMaterials()
+{
+	for (GLuint i=0; i<m_nObjects; i++)
+	{
+		m_rtMaterials[i].mat = m_scene[i]->getMaterial();
+		m_rtMaterials[i].kernel = Shader::getShadeKernel(m_rtMaterials[i].mat);
+	}
+}
+
+void Scene::updateTransforms()
+{
+	m_buckets.update(m_scene);
+}
+
+void Scene::prewarmShaders()
+{
+	for (GLuint i=0; i<m_nObjects; i++)
+	{
+		m_shaderManager.prewarm(m_scene[i]->getMaterial());
+	}
+	m_shaderManager.prewarmDepth();
+}
+
+void Scene::rasterizeDepth(const gml::mat4x4_t &worldView, const gml::mat4x4_t &projection, const GLuint *objIds, const GLuint nIds)
 {
 	const Shader::Shader *depthShader = m_shaderManager.getDepthShader();
 
 	Shader::GLProgUniforms shaderUniforms;
 	shaderUniforms.m_projection = projection;
+	const gml::affine3x4_t worldViewA = gml::affine(worldView);
 
 	depthShader->bindGL(false);
-	for (GLuint i=0; i<m_nObjects; i++)
+	for (GLuint i=0; i<nIds; i++)
 	{
-		shaderUniforms.m_modelView = gml::mul(worldView, m_scene[i]->getObjectToWorld());
+		const Object::Object *obj = m_scene[objIds[i]];
+		shaderUniforms.m_modelView = gml::embed( gml::mul(worldViewA, gml::affine(obj->getObjectToWorld())) );
 
 		if ( !depthShader->setUniforms(shaderUniforms, false) ) return;
 
-		m_scene[i]->rasterize();
+		obj->rasterize();
 		if ( isGLError() ) return;
 	}
 }
 
-void Scene::rasterize(const gml::mat4x4_t &worldView, const gml::mat4x4_t &projection, const bool useShadows)
+void Scene::rasterize(const Camera &camera, const bool useShadows, const gml::mat4x4_t *shadowFaces)
 {
 	// Struct used to pass data values for GLSL uniform variables to
 	// the shader program
 	Shader::GLProgUniforms shaderUniforms;
 
+	m_frame += 1;
+	const unsigned int viewVersion = camera.getViewVersion();
 
 	// Set up uniforms constant to the world
-	shaderUniforms.m_lightPos = gml::extract3( gml::mul( worldView, m_lightPos ) );
+	shaderUniforms.m_lightPos = gml::extract3( gml::mul( camera.getWorldView(), m_lightPos ) );
 	shaderUniforms.m_lightRad = m_lightRad;
 	shaderUniforms.m_ambientRad = m_ambientRad;
-	shaderUniforms.m_projection = projection;
+	shaderUniforms.m_projection = camera.getProjection();
+	// The shadow map is built in world space, so shadow lookups need to
+	// rotate camera-space vectors back into the world frame
+	const gml::affine3x4_t worldViewA = gml::affine(camera.getWorldView());
+	if (m_viewCamera != &camera || m_viewVersion != viewVersion)
+	{
+		m_viewToWorld = gml::embed( gml::inverse(worldViewA) );
+		m_viewCamera = &camera;
+		m_viewVersion = viewVersion;
+	}
+	shaderUniforms.m_viewToWorld = m_viewToWorld;
+	if (useShadows && shadowFaces)
+	{
+		for (int f=0; f<6; f++)
+		{
+			shaderUniforms.m_shadowFaces[f] = shadowFaces[f];
+		}
+	}
 
 	for (GLuint i=0; i<m_nObjects; i++)
 	{
@@ -122,9 +199,22 @@ void Scene::rasterize(const gml::mat4x4_t &worldView, const gml::mat4x4_t &proje
 			shader->bindGL(useShadows); // Bind the shader to the OpenGL context
 			if (isGLError()) return;
 
-			// Object-specific uniforms
-			shaderUniforms.m_modelView = gml::mul(worldView, m_scene[i]->getObjectToWorld());
-			shaderUniforms.m_normalTrans = gml::transpose( gml::inverse(shaderUniforms.m_modelView) );
+			// Object-specific uniforms; recomputed only if the object or
+			// the camera has moved since they were last
+			RasterCache &cache = m_rasterCache[i];
+			if (cache.camera != &camera || cache.viewVersion != viewVersion ||
+					cache.transformVersion != m_scene[i]->getTransformVersion())
+			{
+				const gml::affine3x4_t modelView = gml::mul(worldViewA, gml::affine(m_scene[i]->getObjectToWorld()));
+				cache.modelView = gml::embed(modelView);
+				cache.normalTrans = gml::embed( gml::normalMatrix(modelView) );
+				cache.camera = &camera;
+				cache.viewVersion = viewVersion;
+				cache.transformVersion = m_scene[i]->getTransformVersion();
+				cache.frame = m_frame;
+			}
+			shaderUniforms.m_modelView = cache.modelView;
+			shaderUniforms.m_normalTrans = cache.normalTrans;
 			// If the surface material is not using a texture for Lambertian surface reflectance
 			if (m_scene[i]->getMaterial().getLambSource() == Material::CONSTANT)
 			{
@@ -157,50 +247,17 @@ void Scene::rasterize(const gml::mat4x4_t &worldView, const gml::mat4x4_t &proje
 
 bool Scene::rayIntersects(const RayTracing::Ray_t &ray, const float t0, const float t1, RayTracing::HitInfo_t &hitinfo) const
 {
-	// TODO
-	//   Find the closest intersection of the ray in the distance range [t0,t1].
-	// Return true if an intersection was found, false otherwise
-	// Return true if an intersection was found, false otherwise
-	RayTracing::HitInfo_t tmpInfo;
-
-	hitinfo.hitDist = t1;
-	tmpInfo.hitDist = t1;
-	bool retVal = false;
-
-	// Go through each object in the scene to check for intersections with the ray.
-	for (unsigned int i = 0; i < m_nObjects; i++)
-	{
-			// If it intersects...
-			if (m_scene[i]->rayIntersects(ray, t0, t1, tmpInfo))
-			{
-					if (tmpInfo.hitDist < hitinfo.hitDist )
-					{
-							hitinfo = tmpInfo;
-							retVal = true;
-					}
-			}
-	}
-
-	return retVal;
+	// Find the closest intersection of the ray in the distance range [t0,t1].
+	//  Spheres & planes are tested in batches, by type; everything else
+	// through its Object.
+	return m_buckets.rayIntersects(m_scene, ray, t0, t1, hitinfo);
 }
 
 bool Scene::shadowsRay(const RayTracing::Ray_t &ray, const float t0, const float t1) const
 {
-	// TODO
-	//  Determine whether or not the ray intersects an object in the distance range [t0,t1].
+	// Determine whether or not the ray intersects an object in the distance range [t0,t1].
 	//  Note: Just need to know whether it intersects _an_ object, not the nearest.
-
-	// Return true if the ray intersects an object, false otherwise.
-	for (unsigned i = 0; i < m_nObjects; i++)
-	{
-			if (m_scene[i]->shadowsRay(ray, t0, t1))
-			{
-					return true;
-			}
-	}
-
-	// Note: Having this return false will effectively disable/ignore shadows
-	return false;
+	return m_buckets.shadowsRay(m_scene, ray, t0, t1);
 }
 
 
@@ -209,7 +266,8 @@ void Scene::hitProperties(const RayTracing::HitInfo_t &hitinfo, gml::vec3_t &nor
 	// You may use this function if you wish, but it is not necessary.
 }
 
-gml::vec3_t Scene::shadeRay(const RayTracing::Ray_t &ray, RayTracing::HitInfo_t &hitinfo, const int remainingRecursionDepth) const
+gml::vec3_t Scene::shadeRay(const RayTracing::Ray_t &ray, RayTracing::HitInfo_t &hitinfo, const int remainingRecursionDepth,
+		const RayTracing::RayCone_t &cone) const
 {
 	// TODO!
 
@@ -220,7 +278,7 @@ gml::vec3_t Scene::shadeRay(const RayTracing::Ray_t &ray, RayTracing::HitInfo_t
 
 	// Note: You will have to set up the values for a RayTracing::ShaderValues object, and then
 	// pass the object to a shader object to do the appropriate shading.
-	//   Use m_shaderManager.getShader() to get an appropriate Shader object for shading
+	//   Use the object's entry in m_rtMaterials, and Shader::shadeKernel(), for shading
 	//  the point based on material properties of the object intersected.
 
 	// When implementing shadows, then the direct lighting component of the
@@ -239,16 +297,21 @@ gml::vec3_t Scene::shadeRay(const RayTracing::Ray_t &ray, RayTracing::HitInfo_t
 
 	hitinfo.objHit->hitProperties(hitinfo, normal, texCoord);
 
-	RayTracing::ShaderValues shaderVal(hitinfo.objHit->getMaterial());
+	const RTMaterial &rtMat = m_rtMaterials[hitinfo.objIndex];
+	RayTracing::ShaderValues shaderVal(rtMat.mat);
 	shaderVal.n = normal;
-	shaderVal.p = gml::add(ray.o, gml::scale(hitinfo.hitDist, ray.d));
-	shaderVal.e = gml::normalize(gml::scale(-1.0f, ray.d));
+	shaderVal.p = ray.o + hitinfo.hitDist*ray.d;
+	shaderVal.e = gml::normalize(-ray.d);
 	shaderVal.tex = texCoord;
-	shaderVal.lightDir = gml::normalize(gml::sub(gml::extract3(m_lightPos), shaderVal.p));
+	// The ray cone where it hits; mirror & indirect rays carry it on
+	const float coneWidth = cone.widthAt(hitinfo.hitDist);
+	shaderVal.texWidth = hitinfo.objHit->texFootprint(hitinfo, ray.d, normal, coneWidth);
+	const RayTracing::RayCone_t bounceCone(coneWidth, cone.spread);
+	const gml::vec3_t toLight = gml::extract3(m_lightPos) - shaderVal.p;
+	float distToLight = gml::length(toLight);
+	shaderVal.lightDir = gml::scale(1.0f/distToLight, toLight);
 	shaderVal.lightRad = m_lightRad;
 
-	float distToLight = gml::length(gml::sub(gml::extract3(m_lightPos), shaderVal.p));
-
 	// test if in shadow
 	RayTracing::Ray_t shadowRay;
 	shadowRay.o = shaderVal.p;
@@ -256,7 +319,7 @@ gml::vec3_t Scene::shadeRay(const RayTracing::Ray_t &ray, RayTracing::HitInfo_t
 	if (!shadowsRay(shadowRay, 0.001, distToLight))
 	{
 			// direct lighting
-			shade = m_shaderManager.getShader(hitinfo.objHit->getMaterial())->shade(shaderVal);
+			shade = Shader::shadeKernel(rtMat.kernel, shaderVal);
 	}
 	else
 	{
@@ -270,41 +333,46 @@ gml::vec3_t Scene::shadeRay(const RayTracing::Ray_t &ray, RayTracing::HitInfo_t
 	if (remainingRecursionDepth > 0)
 	{
 			// Mirror checks, and shading.
-			if (hitinfo.objHit->getMaterial().isMirror())
+			if (rtMat.mat.isMirror())
 			{
 					// Ray for mirrors.
 					RayTracing::Ray_t mirrorRay;
 					mirrorRay.o = shaderVal.p;
-					mirrorRay.d = gml::normalize(gml::scale(-1, gml::reflect(ray.d, normal)));
+					mirrorRay.d = gml::normalize(-gml::reflect(ray.d, normal));
 
 					RayTracing::HitInfo_t mirrorHitInfo;
 
 					// If intersection, get the mirror shading color and apply it.
 					if (this->rayIntersects(mirrorRay, 0.001f, FLT_MAX, mirrorHitInfo))
 					{
-							gml::vec3_t mirrorShade = shadeRay(mirrorRay, mirrorHitInfo, remainingRecursionDepth - 1);
-							shade = gml::add(shade, gml::mul(hitinfo.objHit->getMaterial().getMirrorRefl(), mirrorShade));
+							gml::vec3_t mirrorShade = shadeRay(mirrorRay, mirrorHitInfo, remainingRecursionDepth - 1, bounceCone);
+							shade += rtMat.mat.getMirrorRefl() * mirrorShade;
 					}
 			}
 
-			// Setup indirect lighting.
-			RayTracing::Ray_t indirectRay;
-			indirectRay.o = shaderVal.p;
-			indirectRay.randomDirection(shaderVal.n);
+			// Material::SIMPLE shades white whatever light reaches it, so no
+			// bounce can change it; as in the wavefront, it traces none.
+			if (rtMat.kernel != Shader::KERNEL_NONE)
+			{
+				// Setup indirect lighting.
+				RayTracing::Ray_t indirectRay;
+				indirectRay.o = shaderVal.p;
+				indirectRay.randomDirection(shaderVal.n);
 
-			RayTracing::HitInfo_t indirectHitInfo;
+				RayTracing::HitInfo_t indirectHitInfo;
 
-			// If intersection, apply indirect ray for indirect lighting.
-			if (this->rayIntersects(indirectRay, 0.001f, FLT_MAX, indirectHitInfo))
-			{
+				// If intersection, apply indirect ray for indirect lighting.
+				if (this->rayIntersects(indirectRay, 0.001f, FLT_MAX, indirectHitInfo))
+				{
 
-					shaderVal.lightDir = indirectRay.d;
-					shaderVal.lightRad = shadeRay(indirectRay, indirectHitInfo, remainingRecursionDepth - 1);
+						shaderVal.lightDir = indirectRay.d;
+						shaderVal.lightRad = shadeRay(indirectRay, indirectHitInfo, remainingRecursionDepth - 1, bounceCone);
 
-					gml::vec3_t indirectShade = m_shaderManager.getShader(hitinfo.objHit->getMaterial())->shade(shaderVal);
+						gml::vec3_t indirectShade = Shader::shadeKernel(rtMat.kernel, shaderVal);
 
-					// Add together to the cumulative color.
-					shade = gml::add(shade, indirectShade);
+						// Add together to the cumulative color.
+						shade += indirectShade;
+				}
 			}
 	}
 
@@ -16,8 +16,11 @@
 
 #include "../GML/gml.h"
 #include "../Objects/object.h"
+#include "../Camera/camera.h"
 #include "../Shaders/manager.h"
 #include "../RayTracing/rayintersector.h"
+#include "../Shaders/ubershader.h"
+#include "primbuckets.h"
 
 namespace Scene
 {
@@ -31,7 +34,40 @@ protected:
 	// Objects in the scene to render
 	Object::Object **m_scene;
 	GLuint m_nObjects;
-	GLuint m_nObjPtrsAlloced; // Size of the m_scene array
+	GLuint m_nObjPtrsAlloced; // Size of the m_scene & m_rtMaterials arrays
+
+	// Material of each object for ray tracing, with the shading kernel
+	// that it resolves to. Indexed the same as m_scene.
+	typedef struct
+	{
+		Material::Material mat;
+		Shader::ShadeKernel kernel;
+	} RTMaterial;
+	RTMaterial *m_rtMaterials;
+
+	// Model view & normal matrices of each object, as last rasterized.
+	// Recomputed only when the object or the camera has moved since; i.e.
+	// when either version differs. Indexed the same as m_scene.
+	typedef struct
+	{
+		gml::mat4x4_t modelView;
+		gml::mat4x4_t normalTrans;
+		const Camera *camera; // 0 = not computed yet
+		unsigned int viewVersion;
+		GLuint transformVersion;
+		GLuint frame; // Frame in which they were computed
+	} RasterCache;
+	RasterCache *m_rasterCache;
+	// Camera to world transform, for the shadow lookups; for the camera
+	// and view version in m_viewCamera & m_viewVersion
+	gml::mat4x4_t m_viewToWorld;
+	const Camera *m_viewCamera;
+	unsigned int m_viewVersion;
+	// Number of calls to rasterize()
+	GLuint m_frame;
+
+	// The objects grouped by geometry type, for ray intersection
+	PrimitiveBuckets m_buckets;
 
 	gml::vec4_t m_lightPos; // Point light position
 	gml::vec3_t m_lightRad; // Point light radiance
@@ -45,21 +81,52 @@ public:
 
 	// Add an object to the scene, return true if successful.
 	bool addObject(Object::Object *obj);
+	// Re-resolve the ray tracing materials; call after changing the
+	// material of an object in the scene.
+	void updateMaterials();
+	// Re-read the transforms of the objects that have moved; call after
+	// moving objects in the scene, before ray tracing it.
+	void updateTransforms();
+
+	// Start compiling the shaders for the materials of every object in
+	// the scene, so they compile while the rest of the program starts.
+	// Shaders are otherwise compiled the first time they are drawn with.
+	void prewarmShaders();
 
 	void setLightPos(const gml::vec4_t lp) { m_lightPos = lp; }
 	void setLightPos(const gml::vec3_t lp) { m_lightPos = gml::vec4_t(lp, 1.0); }
 	void setLightRad(const gml::vec3_t lr) { m_lightRad = lr; }
 	void setAmbient(const gml::vec3_t am) { m_ambientRad = am; }
 	gml::vec4_t& getLightPos() { return m_lightPos; }
+	const gml::vec4_t& getLightPos() const { return m_lightPos; }
+	const gml::vec3_t& getLightRad() const { return m_lightRad; }
+
+	GLuint getNumObjects() const { return m_nObjects; }
+	const Object::Object* getObject(const GLuint i) const { return m_scene[i]; }
+	// Ray tracing material of object i, and the kernel that shades it
+	const Material::Material& getRTMaterial(const GLuint i) const { return m_rtMaterials[i].mat; }
+	Shader::ShadeKernel getShadeKernel(const GLuint i) const { return m_rtMaterials[i].kernel; }
 
 	// -----------------------------------------
 	// Rasterization
 	// -----------------------------------------
 
-	// Rasterize only using a depth shader
-	void rasterizeDepth(const gml::mat4x4_t &worldView, const gml::mat4x4_t &projection);
-	// Rasterize the scene. Assumes that the shadowmap, if used, is bound to texture unit 1
-	void rasterize(const gml::mat4x4_t &worldView, const gml::mat4x4_t &projection, const bool useShadows);
+	// Rasterize only the listed objects using a depth shader
+	//  objIds = indices of the objects to draw; nIds = length of objIds
+	void rasterizeDepth(const gml::mat4x4_t &worldView, const gml::mat4x4_t &projection, const GLuint *objIds, const GLuint nIds);
+	// Rasterize the scene as seen by camera. Assumes that the shadowmap, if used, is bound to texture unit SHADOWMAP_TEXTURE_UNIT
+	//  shadowFaces = the light's 6 shadow atlas lookup matrices; required if useShadows
+	void rasterize(const Camera &camera, const bool useShadows, const gml::mat4x4_t *shadowFaces=0);
+
+	// Number of frames rasterized so far; counts calls to rasterize()
+	GLuint getFrame() const { return m_frame; }
+	// The frame in which object i's model view & normal matrices were last
+	// computed; 0 if never. Stays behind getFrame() while neither the object
+	// nor the camera moves.
+	GLuint getMatrixFrame(const GLuint i) const
+	{
+		return (m_rasterCache[i].camera != 0) ? m_rasterCache[i].frame : 0;
+	}
 
 	// -----------------------------------------
 	// Ray tracing
@@ -70,7 +137,11 @@ public:
 	virtual void hitProperties(const RayTracing::HitInfo_t &hitinfo, gml::vec3_t &normal, gml::vec2_t &texCoords) const;
 
 	// Calculate the RGB color for the ray
-	gml::vec3_t shadeRay(const RayTracing::Ray_t &ray, RayTracing::HitInfo_t &hitinfo, const int remainingRecursionDepth) const;
+	//  cone = the ray's cone; textures are filtered over its footprint.
+	//    ex: Camera::getPixelCone() for a view ray. The default, of width 0,
+	//    samples the full resolution textures.
+	gml::vec3_t shadeRay(const RayTracing::Ray_t &ray, RayTracing::HitInfo_t &hitinfo, const int remainingRecursionDepth,
+			const RayTracing::RayCone_t &cone=RayTracing::RayCone_t()) const;
 };
 
 }
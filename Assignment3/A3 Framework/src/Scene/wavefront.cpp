@@ -0,0 +1,673 @@
+
+/*
+ * Copyright:
+ * Daniel D. Neilson (ddneilson@ieee.org)
+ * University of Saskatchewan
+ * All rights reserved
+ *
+ * Permission granted to use for use in assignments and
+ * projects for CMPT 485 & CMPT 829 at the University
+ * of Saskatchewan.
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <cfloat>
+#include <time.h>
+
+#include "wavefront.h"
+#if defined(__SSE2__)
+#include "../GML/gmlwide.h"
+#endif
+
+namespace Scene
+{
+
+// Offset of secondary rays from the surface they leave; as in Scene::shadeRay()
+static const float RAY_EPSILON = 0.001f;
+
+static const char *stageNames[Wavefront::NUM_STAGES] =
+{
+	"generate", "intersect", "sort", "shade", "shadow"
+};
+
+// CPU time in seconds
+static double getTime()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static inline void pushRay(RayQueue &q, const gml::vec3_t &o, const gml::vec3_t &d, const float tMax,
+		const GLuint pixel, const gml::vec3_t &w, const RayTracing::RayCone_t &cone=RayTracing::RayCone_t())
+{
+	const GLuint i = q.n++;
+	q.ox[i] = o.x; q.oy[i] = o.y; q.oz[i] = o.z;
+	q.dx[i] = d.x; q.dy[i] = d.y; q.dz[i] = d.z;
+	q.tMax[i] = tMax;
+	q.pixel[i] = pixel;
+	q.wr[i] = w.x; q.wg[i] = w.y; q.wb[i] = w.z;
+	q.coneWidth[i] = cone.width; q.coneSpread[i] = cone.spread;
+}
+
+static inline bool isBlack(const gml::vec3_t &c)
+{
+	return c.x <= 0.0f && c.y <= 0.0f && c.z <= 0.0f;
+}
+
+#if defined(__SSE2__)
+
+// Hits shaded at once
+#if defined(__AVX__)
+#define SHADE_WIDTH 8
+typedef gml::vec3x8_t vec3w_t;
+#else
+#define SHADE_WIDTH 4
+typedef gml::vec3x4_t vec3w_t;
+#endif
+typedef vec3w_t::floatw_t floatw_t;
+typedef vec3w_t::maskw_t maskw_t;
+
+// Lane l = src[idx[l]]
+static inline floatw_t gather(const float *src, const GLuint *idx)
+{
+	float lanes[SHADE_WIDTH];
+	for (int l=0; l<SHADE_WIDTH; l++)
+	{
+		lanes[l] = src[idx[l]];
+	}
+	return floatw_t(lanes);
+}
+static inline vec3w_t gather(const float *x, const float *y, const float *z, const GLuint *idx)
+{
+	return vec3w_t( gather(x, idx), gather(y, idx), gather(z, idx) );
+}
+
+// Lane l = (v[0][l], v[1][l], v[2][l])
+static inline vec3w_t load3(const float v[3][SHADE_WIDTH])
+{
+	return vec3w_t( floatw_t(v[0]), floatw_t(v[1]), floatw_t(v[2]) );
+}
+
+// Lanes with a component > 0; i.e. not isBlack()
+static inline int notBlack(const vec3w_t &c)
+{
+	const floatw_t zero(0.0f);
+	return gml::bits( gml::either(gml::cmpgt(c.x, zero), gml::either(gml::cmpgt(c.y, zero), gml::cmpgt(c.z, zero))) );
+}
+
+// The rays that a batch of hits emits; lane l is hit l's
+typedef struct
+{
+	float ox[SHADE_WIDTH], oy[SHADE_WIDTH], oz[SHADE_WIDTH];
+	float dx[SHADE_WIDTH], dy[SHADE_WIDTH], dz[SHADE_WIDTH];
+	float tMax[SHADE_WIDTH];
+	float wr[SHADE_WIDTH], wg[SHADE_WIDTH], wb[SHADE_WIDTH];
+	float coneWidth[SHADE_WIDTH], coneSpread[SHADE_WIDTH];
+} RayLanes;
+
+static inline void storeRays(RayLanes &lanes, const vec3w_t &o, const vec3w_t &d, const floatw_t tMax,
+		const vec3w_t &w, const floatw_t coneWidth, const floatw_t coneSpread)
+{
+	gml::store(lanes.ox, o.x); gml::store(lanes.oy, o.y); gml::store(lanes.oz, o.z);
+	gml::store(lanes.dx, d.x); gml::store(lanes.dy, d.y); gml::store(lanes.dz, d.z);
+	gml::store(lanes.tMax, tMax);
+	gml::store(lanes.wr, w.x); gml::store(lanes.wg, w.y); gml::store(lanes.wb, w.z);
+	gml::store(lanes.coneWidth, coneWidth);
+	gml::store(lanes.coneSpread, coneSpread);
+}
+
+// Append lane l to the queue if keep is 1. Without a branch: the lane is
+// always written, but only kept if the queue's end moves past it. So the
+// queue needs room for it either way.
+static inline void appendRay(RayQueue &q, const RayLanes &lanes, const int l, const GLuint pixel, const int keep)
+{
+	const GLuint i = q.n;
+	q.ox[i] = lanes.ox[l]; q.oy[i] = lanes.oy[l]; q.oz[i] = lanes.oz[l];
+	q.dx[i] = lanes.dx[l]; q.dy[i] = lanes.dy[l]; q.dz[i] = lanes.dz[l];
+	q.tMax[i] = lanes.tMax[l];
+	q.pixel[i] = pixel;
+	q.wr[i] = lanes.wr[l]; q.wg[i] = lanes.wg[l]; q.wb[i] = lanes.wb[l];
+	q.coneWidth[i] = lanes.coneWidth[l]; q.coneSpread[i] = lanes.coneSpread[l];
+	q.n += keep;
+}
+
+// Shader::shadeT(), lane for lane; surfRefl is the Lambertian reflectance,
+// from the material or its texture.
+//  There is no wide pow(); the specular exponents are taken one lane at a
+//  time, as gml::shading::pow() is.
+template <bool HasSpecular>
+static inline vec3w_t shadeW(const vec3w_t &lightDir, const vec3w_t &lightRad, const vec3w_t &n,
+		const vec3w_t &e, const vec3w_t &surfRefl, const vec3w_t &specRefl, const float *specExp)
+{
+	const floatw_t zero(0.0f);
+	const floatw_t diff = gml::dot(lightDir, n);
+	vec3w_t c = gml::scale( diff, gml::mul(lightRad, surfRefl) );
+
+	if (HasSpecular)
+	{
+		const vec3w_t r = gml::normalize( gml::reflect(lightDir, n) );
+		const floatw_t cosR = gml::dot(e, r);
+		const maskw_t hasSpec = gml::both( gml::cmpgt(cosR, zero), gml::cmpgt(diff, zero) );
+		if ( gml::any(hasSpec) )
+		{
+			float spec[SHADE_WIDTH];
+			gml::store(spec, gml::max(cosR, zero));
+			for (int l=0; l<SHADE_WIDTH; l++)
+			{
+				spec[l] = gml::shading::pow(spec[l], specExp[l]);
+			}
+			const floatw_t s = gml::select( hasSpec, floatw_t(spec), zero );
+			c = gml::add( c, gml::scale(s, gml::mul(lightRad, specRefl)) );
+		}
+	}
+	return gml::select( gml::cmpgt(diff, zero), c, vec3w_t(gml::vec3_t(0.0f, 0.0f, 0.0f)) );
+}
+
+// Shade every hit in idx[0..n-1]; all of them use the same kernel.
+//  Direct light becomes a shadow ray weighted by the shade. Mirror and
+//  indirect bounces become rays of the next wave, weighted by how much
+//  of their radiance the surface reflects. shadeT() is linear in the
+//  light's radiance, so the indirect weight is its shade under unit light.
+//
+//  SHADE_WIDTH hits at a time. The hits' values are gathered from the
+// queues into lanes; the last batch repeats its last hit to fill them.
+// Only what differs per material (texture lookups, specular exponents)
+// and the random bounce directions are done one lane at a time; the
+// latter in hit order, so the rays are the same as shading one by one.
+template <Material::LambertianSource LambSource, bool HasSpecular>
+static void shadeBatch(const Scene &scene, const RayQueue &rays, const HitQueue &hits,
+		const GLuint *idx, const GLuint n, const int depth, RayQueue &shadowRays, RayQueue &nextRays)
+{
+	const gml::vec3_t lightPos = gml::extract3(scene.getLightPos());
+	const vec3w_t lightPosW(lightPos), lightRadW(scene.getLightRad());
+	const vec3w_t unitRad(gml::vec3_t(1.0f, 1.0f, 1.0f));
+
+	GLuint h[SHADE_WIDTH], r[SHADE_WIDTH], pixel[SHADE_WIDTH];
+	float surf[3][SHADE_WIDTH], spec[3][SHADE_WIDTH], specExp[SHADE_WIDTH];
+	float mirror[3][SHADE_WIDTH], bounce[3][SHADE_WIDTH];
+	int isMirror;
+	RayLanes out;
+	for (GLuint k=0; k<n; k+=SHADE_WIDTH)
+	{
+		const int nLanes = (n - k < SHADE_WIDTH) ? (int)(n - k) : SHADE_WIDTH;
+		isMirror = 0;
+		for (int l=0; l<SHADE_WIDTH; l++)
+		{
+			h[l] = idx[k + ((l < nLanes) ? l : nLanes - 1)];
+			r[l] = hits.ray[h[l]];
+			pixel[l] = rays.pixel[r[l]];
+
+			const Material::Material &mat = scene.getRTMaterial(hits.object[h[l]]);
+			gml::vec3_t surfRefl;
+			if (LambSource == Material::TEXTURE)
+			{
+				assert(mat.getTexture());
+				surfRefl = (l < nLanes) ?
+						mat.getTexture()->lookup(gml::vec2_t(hits.u[h[l]], hits.v[h[l]]), hits.texWidth[h[l]]) :
+						gml::vec3_t(surf[0][l-1], surf[1][l-1], surf[2][l-1]);
+			}
+			else
+			{
+				surfRefl = mat.getSurfRefl();
+			}
+			surf[0][l] = surfRefl.x; surf[1][l] = surfRefl.y; surf[2][l] = surfRefl.z;
+			if (HasSpecular)
+			{
+				const gml::vec3_t &specRefl = mat.getSpecRefl();
+				spec[0][l] = specRefl.x; spec[1][l] = specRefl.y; spec[2][l] = specRefl.z;
+				specExp[l] = mat.getSpecExp();
+			}
+			const gml::vec3_t &mirrorRefl = mat.getMirrorRefl();
+			mirror[0][l] = mirrorRefl.x; mirror[1][l] = mirrorRefl.y; mirror[2][l] = mirrorRefl.z;
+			isMirror |= (int)mat.isMirror() << l;
+		}
+
+		const vec3w_t p = gather(hits.px, hits.py, hits.pz, h);
+		const vec3w_t nrm = gather(hits.nx, hits.ny, hits.nz, h);
+		const vec3w_t d = gather(rays.dx, rays.dy, rays.dz, r);
+		const vec3w_t w = gather(rays.wr, rays.wg, rays.wb, r);
+		const vec3w_t surfRefl = load3(surf);
+		const vec3w_t specRefl = HasSpecular ? load3(spec) : vec3w_t();
+
+		const vec3w_t e = gml::normalize( gml::scale(floatw_t(-1.0f), d) );
+		const vec3w_t toLight = gml::sub(lightPosW, p);
+		const vec3w_t lightDir = gml::normalize(toLight);
+
+		const vec3w_t direct = gml::mul( w, shadeW<HasSpecular>(lightDir, lightRadW, nrm, e, surfRefl, specRefl, specExp) );
+		const int lit = notBlack(direct);
+		storeRays(out, p, lightDir, gml::length(toLight), direct, floatw_t(0.0f), floatw_t(0.0f));
+		for (int l=0; l<nLanes; l++)
+		{
+			appendRay(shadowRays, out, l, pixel[l], (lit >> l) & 1);
+		}
+
+		if (depth > 0)
+		{
+			// As Scene::shadeRay(); bounces carry the cone on
+			const floatw_t coneWidth = gather(hits.coneWidth, h);
+			const floatw_t coneSpread = gather(rays.coneSpread, r);
+
+			RayTracing::Ray_t indirect;
+			for (int l=0; l<SHADE_WIDTH; l++)
+			{
+				if (l < nLanes)
+				{
+					indirect.randomDirection( gml::vec3_t(hits.nx[h[l]], hits.ny[h[l]], hits.nz[h[l]]) );
+				}
+				bounce[0][l] = indirect.d.x; bounce[1][l] = indirect.d.y; bounce[2][l] = indirect.d.z;
+			}
+			const vec3w_t bounceDir = load3(bounce);
+			const vec3w_t weight = gml::mul( w, shadeW<HasSpecular>(bounceDir, unitRad, nrm, e, surfRefl, specRefl, specExp) );
+			const int bounces = notBlack(weight);
+
+			const vec3w_t mirrorDir = gml::normalize( gml::scale(floatw_t(-1.0f), gml::reflect(d, nrm)) );
+			const vec3w_t mirrorW = gml::mul( w, load3(mirror) );
+			RayLanes mirrorOut;
+			storeRays(mirrorOut, p, mirrorDir, floatw_t(FLT_MAX), mirrorW, coneWidth, coneSpread);
+			storeRays(out, p, bounceDir, floatw_t(FLT_MAX), weight, coneWidth, coneSpread);
+			// Each hit's mirror ray, then its indirect ray
+			for (int l=0; l<nLanes; l++)
+			{
+				appendRay(nextRays, mirrorOut, l, pixel[l], (isMirror >> l) & 1);
+				appendRay(nextRays, out, l, pixel[l], (bounces >> l) & 1);
+			}
+		}
+	}
+}
+
+// Hits on Material::SIMPLE objects; their shade is white when lit.
+//  The white shade does not depend on incoming light, so there is no
+//  indirect bounce to trace.
+static void shadeBatchNone(const Scene &scene, const RayQueue &rays, const HitQueue &hits,
+		const GLuint *idx, const GLuint n, const int depth, RayQueue &shadowRays, RayQueue &nextRays)
+{
+	const vec3w_t lightPosW( gml::extract3(scene.getLightPos()) );
+
+	GLuint h[SHADE_WIDTH], r[SHADE_WIDTH], pixel[SHADE_WIDTH];
+	float mirror[3][SHADE_WIDTH];
+	int isMirror;
+	RayLanes out;
+	for (GLuint k=0; k<n; k+=SHADE_WIDTH)
+	{
+		const int nLanes = (n - k < SHADE_WIDTH) ? (int)(n - k) : SHADE_WIDTH;
+		isMirror = 0;
+		for (int l=0; l<SHADE_WIDTH; l++)
+		{
+			h[l] = idx[k + ((l < nLanes) ? l : nLanes - 1)];
+			r[l] = hits.ray[h[l]];
+			pixel[l] = rays.pixel[r[l]];
+
+			const Material::Material &mat = scene.getRTMaterial(hits.object[h[l]]);
+			const gml::vec3_t &mirrorRefl = mat.getMirrorRefl();
+			mirror[0][l] = mirrorRefl.x; mirror[1][l] = mirrorRefl.y; mirror[2][l] = mirrorRefl.z;
+			isMirror |= (int)mat.isMirror() << l;
+		}
+
+		const vec3w_t p = gather(hits.px, hits.py, hits.pz, h);
+		const vec3w_t w = gather(rays.wr, rays.wg, rays.wb, r);
+		const vec3w_t toLight = gml::sub(lightPosW, p);
+
+		storeRays(out, p, gml::normalize(toLight), gml::length(toLight), w, floatw_t(0.0f), floatw_t(0.0f));
+		for (int l=0; l<nLanes; l++)
+		{
+			appendRay(shadowRays, out, l, pixel[l], 1);
+		}
+
+		if (depth > 0 && isMirror)
+		{
+			const vec3w_t d = gather(rays.dx, rays.dy, rays.dz, r);
+			const vec3w_t nrm = gather(hits.nx, hits.ny, hits.nz, h);
+			const vec3w_t mirrorDir = gml::normalize( gml::scale(floatw_t(-1.0f), gml::reflect(d, nrm)) );
+			const vec3w_t mirrorW = gml::mul( w, load3(mirror) );
+			storeRays(out, p, mirrorDir, floatw_t(FLT_MAX), mirrorW, gather(hits.coneWidth, h), gather(rays.coneSpread, r));
+			for (int l=0; l<nLanes; l++)
+			{
+				appendRay(nextRays, out, l, pixel[l], (isMirror >> l) & 1);
+			}
+		}
+	}
+}
+
+#else // One hit at a time
+
+// Shade every hit in idx[0..n-1]; all of them use the same kernel.
+//  Direct light becomes a shadow ray weighted by the shade. Mirror and
+//  indirect bounces become rays of the next wave, weighted by how much
+//  of their radiance the surface reflects. shadeT() is linear in the
+//  light's radiance, so the indirect weight is its shade under unit light.
+template <Material::LambertianSource LambSource, bool HasSpecular>
+static void shadeBatch(const Scene &scene, const RayQueue &rays, const HitQueue &hits,
+		const GLuint *idx, const GLuint n, const int depth, RayQueue &shadowRays, RayQueue &nextRays)
+{
+	const gml::vec3_t lightPos = gml::extract3(scene.getLightPos());
+	const gml::vec3_t unitRad(1.0, 1.0, 1.0);
+
+	for (GLuint k=0; k<n; k++)
+	{
+		const GLuint h = idx[k];
+		const GLuint r = hits.ray[h];
+		const Material::Material &mat = scene.getRTMaterial(hits.object[h]);
+		const gml::vec3_t w(rays.wr[r], rays.wg[r], rays.wb[r]);
+		const gml::vec3_t d(rays.dx[r], rays.dy[r], rays.dz[r]);
+
+		RayTracing::ShaderValues vals(mat);
+		vals.p = gml::vec3_t(hits.px[h], hits.py[h], hits.pz[h]);
+		vals.n = gml::vec3_t(hits.nx[h], hits.ny[h], hits.nz[h]);
+		vals.tex = gml::vec2_t(hits.u[h], hits.v[h]);
+		vals.texWidth = hits.texWidth[h];
+		vals.e = gml::normalize(gml::scale(-1.0f, d));
+		vals.lightDir = gml::normalize(gml::sub(lightPos, vals.p));
+		vals.lightRad = scene.getLightRad();
+
+		const gml::vec3_t direct = gml::mul(w, Shader::shadeT<LambSource, HasSpecular>(vals));
+		if ( !isBlack(direct) )
+		{
+			pushRay(shadowRays, vals.p, vals.lightDir, gml::length(gml::sub(lightPos, vals.p)),
+					rays.pixel[r], direct);
+		}
+
+		if (depth > 0)
+		{
+			// As Scene::shadeRay(); bounces carry the cone on
+			const RayTracing::RayCone_t cone(hits.coneWidth[h], rays.coneSpread[r]);
+			if (mat.isMirror())
+			{
+				pushRay(nextRays, vals.p, gml::normalize(gml::scale(-1, gml::reflect(d, vals.n))),
+						FLT_MAX, rays.pixel[r], gml::mul(w, mat.getMirrorRefl()), cone);
+			}
+
+			RayTracing::Ray_t indirect;
+			indirect.randomDirection(vals.n);
+			vals.lightDir = indirect.d;
+			vals.lightRad = unitRad;
+			const gml::vec3_t weight = gml::mul(w, Shader::shadeT<LambSource, HasSpecular>(vals));
+			if ( !isBlack(weight) )
+			{
+				pushRay(nextRays, vals.p, indirect.d, FLT_MAX, rays.pixel[r], weight, cone);
+			}
+		}
+	}
+}
+
+// Hits on Material::SIMPLE objects; their shade is white when lit.
+//  The white shade does not depend on incoming light, so there is no
+//  indirect bounce to trace.
+static void shadeBatchNone(const Scene &scene, const RayQueue &rays, const HitQueue &hits,
+		const GLuint *idx, const GLuint n, const int depth, RayQueue &shadowRays, RayQueue &nextRays)
+{
+	const gml::vec3_t lightPos = gml::extract3(scene.getLightPos());
+	for (GLuint k=0; k<n; k++)
+	{
+		const GLuint h = idx[k];
+		const GLuint r = hits.ray[h];
+		const Material::Material &mat = scene.getRTMaterial(hits.object[h]);
+		const gml::vec3_t w(rays.wr[r], rays.wg[r], rays.wb[r]);
+		const gml::vec3_t p(hits.px[h], hits.py[h], hits.pz[h]);
+		const gml::vec3_t toLight = gml::sub(lightPos, p);
+
+		pushRay(shadowRays, p, gml::normalize(toLight), gml::length(toLight), rays.pixel[r], w);
+
+		if (depth > 0 && mat.isMirror())
+		{
+			const gml::vec3_t d(rays.dx[r], rays.dy[r], rays.dz[r]);
+			const gml::vec3_t nrm(hits.nx[h], hits.ny[h], hits.nz[h]);
+			pushRay(nextRays, p, gml::normalize(gml::scale(-1, gml::reflect(d, nrm))),
+					FLT_MAX, rays.pixel[r], gml::mul(w, mat.getMirrorRefl()),
+					RayTracing::RayCone_t(hits.coneWidth[h], rays.coneSpread[r]));
+		}
+	}
+}
+
+#endif
+
+Wavefront::Wavefront()
+{
+	resetStats();
+}
+
+Wavefront::~Wavefront()
+{
+}
+
+RayQueue Wavefront::allocRays(const GLuint capacity)
+{
+	RayQueue q;
+	q.n = 0;
+	q.ox = m_arena.alloc<float>(capacity);
+	q.oy = m_arena.alloc<float>(capacity);
+	q.oz = m_arena.alloc<float>(capacity);
+	q.dx = m_arena.alloc<float>(capacity);
+	q.dy = m_arena.alloc<float>(capacity);
+	q.dz = m_arena.alloc<float>(capacity);
+	q.tMax = m_arena.alloc<float>(capacity);
+	q.pixel = m_arena.alloc<GLuint>(capacity);
+	q.wr = m_arena.alloc<float>(capacity);
+	q.wg = m_arena.alloc<float>(capacity);
+	q.wb = m_arena.alloc<float>(capacity);
+	q.coneWidth = m_arena.alloc<float>(capacity);
+	q.coneSpread = m_arena.alloc<float>(capacity);
+	return q;
+}
+
+HitQueue Wavefront::allocHits(const GLuint capacity)
+{
+	HitQueue q;
+	q.n = 0;
+	q.ray = m_arena.alloc<GLuint>(capacity);
+	q.object = m_arena.alloc<GLuint>(capacity);
+	q.px = m_arena.alloc<float>(capacity);
+	q.py = m_arena.alloc<float>(capacity);
+	q.pz = m_arena.alloc<float>(capacity);
+	q.nx = m_arena.alloc<float>(capacity);
+	q.ny = m_arena.alloc<float>(capacity);
+	q.nz = m_arena.alloc<float>(capacity);
+	q.u = m_arena.alloc<float>(capacity);
+	q.v = m_arena.alloc<float>(capacity);
+	q.texWidth = m_arena.alloc<float>(capacity);
+	q.coneWidth = m_arena.alloc<float>(capacity);
+	return q;
+}
+
+void Wavefront::intersect(const Scene &scene, const RayQueue &rays, const float t0, HitQueue &hits)
+{
+	// Each ray is tested against the scene's primitive buckets, which hold
+	// every sphere & plane of the scene together.
+	RayTracing::Ray_t ray;
+	RayTracing::HitInfo_t info;
+	gml::vec3_t normal;
+	gml::vec2_t texCoord;
+	hits.n = 0;
+	for (GLuint j=0; j<rays.n; j++)
+	{
+		ray.o = gml::vec3_t(rays.ox[j], rays.oy[j], rays.oz[j]);
+		ray.d = gml::vec3_t(rays.dx[j], rays.dy[j], rays.dz[j]);
+		if ( !scene.rayIntersects(ray, t0, rays.tMax[j], info) ) continue;
+
+		const GLuint h = hits.n++;
+		hits.ray[h] = j;
+		hits.object[h] = info.objIndex;
+		info.objHit->hitProperties(info, normal, texCoord);
+		hits.px[h] = rays.ox[j] + info.hitDist * rays.dx[j];
+		hits.py[h] = rays.oy[j] + info.hitDist * rays.dy[j];
+		hits.pz[h] = rays.oz[j] + info.hitDist * rays.dz[j];
+		hits.nx[h] = normal.x; hits.ny[h] = normal.y; hits.nz[h] = normal.z;
+		hits.u[h] = texCoord.x; hits.v[h] = texCoord.y;
+		hits.coneWidth[h] = rays.coneWidth[j] + info.hitDist * rays.coneSpread[j];
+		hits.texWidth[h] = info.objHit->texFootprint(info, ray.d, normal, hits.coneWidth[h]);
+	}
+}
+
+GLuint* Wavefront::sortByKernel(const Scene &scene, const HitQueue &hits, GLuint start[Shader::NUM_KERNELS+1])
+{
+	// Counting sort; the kernels are few
+	GLuint *order = m_arena.alloc<GLuint>(hits.n);
+	GLuint count[Shader::NUM_KERNELS];
+	memset(count, 0x00, sizeof(count));
+	for (GLuint h=0; h<hits.n; h++)
+	{
+		count[scene.getShadeKernel(hits.object[h])] += 1;
+	}
+	start[0] = 0;
+	for (int k=0; k<Shader::NUM_KERNELS; k++)
+	{
+		start[k+1] = start[k] + count[k];
+		count[k] = start[k]; // Now the next free slot of kernel k
+	}
+	for (GLuint h=0; h<hits.n; h++)
+	{
+		order[ count[scene.getShadeKernel(hits.object[h])]++ ] = h;
+	}
+	return order;
+}
+
+void Wavefront::shade(const Scene &scene, const RayQueue &rays, const HitQueue &hits,
+		const GLuint *order, const GLuint start[Shader::NUM_KERNELS+1], const int depth,
+		RayQueue &shadowRays, RayQueue &nextRays)
+{
+	for (int k=0; k<Shader::NUM_KERNELS; k++)
+	{
+		const GLuint *idx = order + start[k];
+		const GLuint n = start[k+1] - start[k];
+		if (n == 0) continue;
+
+		switch (k)
+		{
+		case Shader::KERNEL_CONSTANT:
+			shadeBatch<Material::CONSTANT, false>(scene, rays, hits, idx, n, depth, shadowRays, nextRays);
+			break;
+		case Shader::KERNEL_CONSTANT_SPECULAR:
+			shadeBatch<Material::CONSTANT, true>(scene, rays, hits, idx, n, depth, shadowRays, nextRays);
+			break;
+		case Shader::KERNEL_TEXTURE:
+			shadeBatch<Material::TEXTURE, false>(scene, rays, hits, idx, n, depth, shadowRays, nextRays);
+			break;
+		case Shader::KERNEL_TEXTURE_SPECULAR:
+			shadeBatch<Material::TEXTURE, true>(scene, rays, hits, idx, n, depth, shadowRays, nextRays);
+			break;
+		default:
+			shadeBatchNone(scene, rays, hits, idx, n, depth, shadowRays, nextRays);
+			break;
+		}
+	}
+}
+
+void Wavefront::traceShadows(const Scene &scene, const RayQueue &shadowRays, gml::vec3_t *radiance)
+{
+	RayTracing::Ray_t ray;
+	for (GLuint j=0; j<shadowRays.n; j++)
+	{
+		ray.o = gml::vec3_t(shadowRays.ox[j], shadowRays.oy[j], shadowRays.oz[j]);
+		ray.d = gml::vec3_t(shadowRays.dx[j], shadowRays.dy[j], shadowRays.dz[j]);
+		if ( scene.shadowsRay(ray, RAY_EPSILON, shadowRays.tMax[j]) ) continue;
+
+		gml::vec3_t &pixel = radiance[shadowRays.pixel[j]];
+		pixel.x += shadowRays.wr[j];
+		pixel.y += shadowRays.wg[j];
+		pixel.z += shadowRays.wb[j];
+	}
+}
+
+void Wavefront::render(const Scene &scene, const Camera &camera, const int width,
+		const int row0, const int nRows, const int maxDepth, gml::vec3_t *radiance)
+{
+	m_arena.reset();
+
+	double time = getTime();
+	const GLuint nPixels = width * nRows;
+	RayQueue rays = allocRays(nPixels);
+	// Jittered within the pixel
+	float *jitterX = m_arena.alloc<float>(nPixels);
+	float *jitterY = m_arena.alloc<float>(nPixels);
+	for (GLuint i=0; i<nPixels; i++)
+	{
+		jitterX[i] = -0.5 + rand() / ((float)RAND_MAX);
+		jitterY[i] = -0.5 + rand() / ((float)RAND_MAX);
+	}
+	const ViewRayTile tile = { rays.ox, rays.oy, rays.oz, rays.dx, rays.dy, rays.dz };
+	camera.genViewRays(0, row0, width, nRows, jitterX, jitterY, tile);
+	rays.n = nPixels;
+	const float tMax = camera.getFarClip();
+	const RayTracing::RayCone_t cone = camera.getPixelCone();
+	for (GLuint i=0; i<nPixels; i++)
+	{
+		rays.tMax[i] = tMax;
+		rays.pixel[i] = i;
+		rays.wr[i] = rays.wg[i] = rays.wb[i] = 1.0f;
+		rays.coneWidth[i] = cone.width;
+		rays.coneSpread[i] = cone.spread;
+		radiance[i] = gml::vec3_t(0.0, 0.0, 0.0);
+	}
+	double now = getTime();
+	m_stageTime[STAGE_GENERATE] += now - time;
+	m_nStageItems[STAGE_GENERATE] += nPixels;
+	m_nPixels += nPixels;
+
+	float t0 = camera.getNearClip();
+	for (int depth = maxDepth; rays.n > 0; depth--)
+	{
+		time = now;
+		HitQueue hits = allocHits(rays.n);
+		intersect(scene, rays, t0, hits);
+		now = getTime();
+		m_stageTime[STAGE_INTERSECT] += now - time;
+		m_nStageItems[STAGE_INTERSECT] += rays.n;
+
+		time = now;
+		GLuint start[Shader::NUM_KERNELS+1];
+		const GLuint *order = sortByKernel(scene, hits, start);
+		now = getTime();
+		m_stageTime[STAGE_SORT] += now - time;
+		m_nStageItems[STAGE_SORT] += hits.n;
+
+		// Each hit emits at most one shadow ray, and at most a mirror
+		// ray plus an indirect ray
+		time = now;
+		RayQueue shadowRays = allocRays(hits.n);
+		RayQueue nextRays = allocRays( (depth > 0) ? 2*hits.n : 0 );
+		shade(scene, rays, hits, order, start, depth, shadowRays, nextRays);
+		now = getTime();
+		m_stageTime[STAGE_SHADE] += now - time;
+		m_nStageItems[STAGE_SHADE] += hits.n;
+
+		time = now;
+		traceShadows(scene, shadowRays, radiance);
+		now = getTime();
+		m_stageTime[STAGE_SHADOW] += now - time;
+		m_nStageItems[STAGE_SHADOW] += shadowRays.n;
+
+		if (depth == 0) break;
+		rays = nextRays;
+		t0 = RAY_EPSILON;
+	}
+}
+
+void Wavefront::printStats(FILE *out) const
+{
+	double total = 0.0;
+	for (int s=0; s<NUM_STAGES; s++) total += m_stageTime[s];
+
+	fprintf(out, "%-16s %12s %10s %8s %12s\n", "Stage", "Items", "Total(ms)", "Share", "ns/item");
+	for (int s=0; s<NUM_STAGES; s++)
+	{
+		fprintf(out, "%-16s %12.0f %10.1f %7.1f%% %12.1f\n", stageNames[s], m_nStageItems[s],
+				1e3 * m_stageTime[s],
+				(total > 0.0) ? 100.0 * m_stageTime[s] / total : 0.0,
+				(m_nStageItems[s] > 0.0) ? 1e9 * m_stageTime[s] / m_nStageItems[s] : 0.0);
+	}
+	fprintf(out, "%-16s %12.0f %10.1f %8s %12.1f\n", "total (pixels)", m_nPixels, 1e3 * total, "",
+			(m_nPixels > 0.0) ? 1e9 * total / m_nPixels : 0.0);
+}
+
+void Wavefront::resetStats()
+{
+	for (int s=0; s<NUM_STAGES; s++)
+	{
+		m_stageTime[s] = 0.0;
+		m_nStageItems[s] = 0.0;
+	}
+	m_nPixels = 0.0;
+}
+
+}
@@ -0,0 +1,117 @@
+
+/*
+ * Copyright:
+ * Daniel D. Neilson (ddneilson@ieee.org)
+ * University of Saskatchewan
+ * All rights reserved
+ *
+ * Permission granted to use for use in assignments and
+ * projects for CMPT 485 & CMPT 829 at the University
+ * of Saskatchewan.
+ */
+
+/*
+ * Wavefront ray tracer.
+ *
+ * Computes the same image as Scene::shadeRay(), but a batch of rays
+ * at a time, one stage at a time:
+ *  1) generate -- camera rays for a block of pixels
+ *  2) intersect -- every ray of the wave against the scene's primitive buckets
+ *  3) sort -- hits grouped by the shading kernel of their material
+ *  4) shade -- each kernel's hits together, 4 or 8 at once in SIMD lanes;
+ *     emits shadow rays, and the mirror & indirect rays of the next wave
+ *  5) shadow -- shadow rays tested, and unoccluded light added to pixels
+ * Steps 2-5 repeat once per bounce. All queues live in an Arena, and
+ * are structures of arrays.
+ */
+
+#pragma once
+#ifndef __INC_SCENE_WAVEFRONT_H_
+#define __INC_SCENE_WAVEFRONT_H_
+
+#include <stdio.h>
+#include "scene.h"
+#include "../Camera/camera.h"
+#include "../RayTracing/arena.h"
+
+namespace Scene
+{
+
+// Queue of rays
+typedef struct
+{
+	GLuint n;
+	float *ox, *oy, *oz; // Origin
+	float *dx, *dy, *dz; // Direction
+	float *tMax; // Far end of the ray
+	GLuint *pixel; // Pixel that the ray's radiance is added to
+	float *wr, *wg, *wb; // Weight of the ray's radiance in the pixel
+	float *coneWidth, *coneSpread; // Ray cone, for texture filtering; as RayTracing::RayCone_t
+} RayQueue;
+
+// Queue of ray-object intersections
+typedef struct
+{
+	GLuint n;
+	GLuint *ray; // Index of the ray in its RayQueue
+	GLuint *object; // Index of the object in the Scene
+	float *px, *py, *pz; // World-space hit point
+	float *nx, *ny, *nz; // World-space normal
+	float *u, *v; // Texture coordinates
+	float *texWidth; // Footprint of the ray's cone in texture coordinates
+	float *coneWidth; // Width of the ray's cone at the hit
+} HitQueue;
+
+class Wavefront
+{
+public:
+	typedef enum
+	{
+		STAGE_GENERATE = 0,
+		STAGE_INTERSECT,
+		STAGE_SORT,
+		STAGE_SHADE,
+		STAGE_SHADOW,
+		NUM_STAGES
+	} Stage;
+protected:
+	RayTracing::Arena m_arena;
+
+	// Totals since the last resetStats()
+	double m_stageTime[NUM_STAGES]; // seconds
+	double m_nStageItems[NUM_STAGES]; // Rays or hits through each stage
+	double m_nPixels;
+
+	RayQueue allocRays(const GLuint capacity);
+	HitQueue allocHits(const GLuint capacity);
+
+	// Find the nearest hit of every ray in [t0, tMax]
+	void intersect(const Scene &scene, const RayQueue &rays, const float t0, HitQueue &hits);
+	// Order the hits by shading kernel.
+	//  Returns indices into hits; kernel k's hits are order[start[k]] .. order[start[k+1]-1]
+	GLuint* sortByKernel(const Scene &scene, const HitQueue &hits, GLuint start[Shader::NUM_KERNELS+1]);
+	// Shade the hits; fills the shadow queue, and the next wave if depth > 0
+	void shade(const Scene &scene, const RayQueue &rays, const HitQueue &hits,
+			const GLuint *order, const GLuint start[Shader::NUM_KERNELS+1], const int depth,
+			RayQueue &shadowRays, RayQueue &nextRays);
+	// Add the weight of every unoccluded shadow ray to its pixel
+	void traceShadows(const Scene &scene, const RayQueue &shadowRays, gml::vec3_t *radiance);
+public:
+	Wavefront();
+	~Wavefront();
+
+	// Ray trace a block of nRows x width pixels, starting at row row0,
+	// with one jittered camera ray per pixel.
+	//  maxDepth = number of mirror/indirect bounces; as in Scene::shadeRay()
+	//  radiance = output; nRows*width values, row-major
+	void render(const Scene &scene, const Camera &camera, const int width,
+			const int row0, const int nRows, const int maxDepth, gml::vec3_t *radiance);
+
+	// Print the time spent in each stage
+	void printStats(FILE *out) const;
+	void resetStats();
+};
+
+}
+
+#endif
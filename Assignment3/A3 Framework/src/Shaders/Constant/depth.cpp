@@ -49,9 +49,15 @@ static const char fragShader[] =
 
 Depth::Depth()
 {
-	// Try to create, compile, & link a GLSL program using the source
-	// you give it.
-	if ( !m_program.init(vertShader, fragShader) || isGLError() )
+	// Start compiling & linking a GLSL program using the source
+	// you give it. checkReady() sees how it went.
+	m_program.init(vertShader, fragShader);
+}
+Depth::~Depth() {}
+
+void Depth::checkReady()
+{
+	if ( !m_program.finish() || isGLError() )
 	{
 		fprintf(stderr, "ERROR: Depth failed to initialize\n");
 	}
@@ -63,7 +69,6 @@ Depth::Depth()
 			(m_program.getUniformID(UNIFORM_MODELVIEW) >= 0) &&
 			(m_program.getUniformID(UNIFORM_PROJECTION) >= 0);
 }
-Depth::~Depth() {}
 
 
 bool Depth::setUniforms(const GLProgUniforms &uniforms, const bool usingShadow) const
@@ -29,7 +29,7 @@ namespace Constant
 class Depth : public Shader
 {
 protected:
-
+	virtual void checkReady();
 public:
 	Depth();
 	virtual ~Depth();
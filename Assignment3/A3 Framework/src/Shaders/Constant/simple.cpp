@@ -53,9 +53,15 @@ static const char fragShader[] =
 
 Simple::Simple()
 {
-	// Try to create, compile, & link a GLSL program using the source
-	// you give it.
-	if ( !m_program.init(vertShader, fragShader) || isGLError() )
+	// Start compiling & linking a GLSL program using the source
+	// you give it. checkReady() sees how it went.
+	m_program.init(vertShader, fragShader);
+}
+Simple::~Simple() {}
+
+void Simple::checkReady()
+{
+	if ( !m_program.finish() || isGLError() )
 	{
 		fprintf(stderr, "ERROR: Simple failed to initialize\n");
 	}
@@ -67,7 +73,6 @@ Simple::Simple()
 			(m_program.getUniformID(UNIFORM_AMBIENT) >= 0) &&
 			(m_program.getUniformID(UNIFORM_SURFREF) >= 0);
 }
-Simple::~Simple() {}
 
 
 bool Simple::setUniforms(const GLProgUniforms &uniforms, const bool usingShadow) const
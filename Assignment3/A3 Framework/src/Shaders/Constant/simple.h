@@ -35,7 +35,7 @@ namespace Constant
 class Simple : public Shader
 {
 protected:
-
+	virtual void checkReady();
 public:
 	Simple();
 	virtual ~Simple();
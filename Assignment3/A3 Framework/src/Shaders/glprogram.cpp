@@ -12,13 +12,84 @@
 
 #include "../GL3/gl3w.h"
 #include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
 #include "glprogram.h"
+#include "../glUtils.h"
 
 namespace Shader
 {
 
+const char *GLProgram::s_cacheDir = "shadercache";
+int GLProgram::s_nCacheHits = 0;
+int GLProgram::s_nCompiled = 0;
+
+// Header of a cache file; followed by the program binary
+typedef struct
+{
+	char magic[8];
+	GLuint64 key; // Hash that the file is named by
+	GLenum format; // Format of the binary, from glGetProgramBinary
+	GLint length; // Bytes in the binary
+} CacheHeader;
+static const char CACHE_MAGIC[8] = { 'G','L','P','R','O','G','B','1' };
+
+// 64-bit FNV-1a hash of a string, continuing from hash h
+static GLuint64 hashString(GLuint64 h, const char *str)
+{
+	for (const unsigned char *c = (const unsigned char*)str; *c; c++)
+	{
+		h = (h ^ *c) * 1099511628211ULL;
+	}
+	// Hash the terminator too, so that "ab"+"c" != "a"+"bc"
+	return h * 1099511628211ULL;
+}
+
+#if !defined(GL_COMPLETION_STATUS_KHR)
+# define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+// Whether the GL can compile & link on its own threads. Checked once.
+bool GLProgram::isParallelCompileSupported()
+{
+	static int supported = -1;
+	if (supported < 0)
+	{
+		supported = isExtensionSupported("GL_KHR_parallel_shader_compile") ? 1 : 0;
+		if (supported)
+		{
+			// Let the GL pick how many threads to use
+			PFNGLMAXSHADERCOMPILERTHREADSKHRPROC maxThreads =
+					(PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)gl3wGetProcAddress("glMaxShaderCompilerThreadsKHR");
+			if (maxThreads) maxThreads(0xFFFFFFFF);
+		}
+	}
+	return supported == 1;
+}
+
+// Whether the GL can hand back program binaries. Checked once.
+static bool isBinaryCacheSupported()
+{
+	static int supported = -1;
+	if (supported < 0)
+	{
+		GLint nFormats = 0;
+		if (glGetProgramBinary && glProgramBinary && glProgramParameteri)
+		{
+			glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &nFormats);
+		}
+		supported = (nFormats > 0) ? 1 : 0;
+	}
+	return supported == 1;
+}
+
 GLProgram::GLProgram() : m_prog(0)
 {
+	m_state = PROGRAM_NONE;
+	m_vertCode = m_fragCode = 0;
+	m_vertHandle = m_fragHandle = 0;
+	m_useCache = false;
 	for (int i=0; i<NUM_UNIFORM_VARS; i++)
 	{
 		m_uniformLocs[i] = -1;
@@ -33,32 +104,135 @@ GLProgram::~GLProgram()
 	}
 }
 
+bool GLProgram::getCachePath(const char *vertCode, const char *fragCode, char *path, const int pathLen, GLuint64 &key)
+{
+	if ( !s_cacheDir || !isBinaryCacheSupported() ) return false;
+
+	// A binary is only good for the same source on the same driver
+	key = 14695981039346656037ULL;
+	key = hashString(key, vertCode);
+	key = hashString(key, fragCode);
+	key = hashString(key, (const char*)glGetString(GL_VENDOR));
+	key = hashString(key, (const char*)glGetString(GL_RENDERER));
+	key = hashString(key, (const char*)glGetString(GL_VERSION));
+
+	snprintf(path, pathLen, "%s/%016llx.bin", s_cacheDir, (unsigned long long)key);
+	return true;
+}
+
+bool GLProgram::loadBinary(const char *path, const GLuint64 key)
+{
+	FILE *in = fopen(path, "rb");
+	if ( !in ) return false; // Not cached yet
+
+	CacheHeader header;
+	char *binary = 0;
+	bool ok = (fread(&header, sizeof(header), 1, in) == 1) &&
+			(memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0) &&
+			(header.key == key) && (header.length > 0);
+	if (ok)
+	{
+		binary = new char[header.length];
+		ok = (fread(binary, header.length, 1, in) == 1);
+	}
+	fclose(in);
+
+	if (ok)
+	{
+		// Report any errors left by earlier calls, so they are not taken
+		// for the binary's
+		while ( isGLError() ) {}
+		m_prog = glCreateProgram();
+		glProgramBinary(m_prog, header.format, binary, header.length);
+		// A binary from an older driver is rejected with a failed link, and
+		// maybe an error too; that error is expected, so clear it. Either
+		// way, fall back to the source.
+		while (glGetError() != GL_NO_ERROR) {}
+		GLint success;
+		glGetProgramiv(m_prog, GL_LINK_STATUS, &success);
+		ok = (success == GL_TRUE);
+		if ( !ok )
+		{
+			glDeleteProgram(m_prog);
+			m_prog = 0;
+		}
+	}
+	if (binary) delete[] binary;
+	return ok;
+}
+
+void GLProgram::saveBinary(const char *path, const GLuint64 key) const
+{
+	CacheHeader header;
+	glGetProgramiv(m_prog, GL_PROGRAM_BINARY_LENGTH, &header.length);
+	if (header.length <= 0) return;
+
+	char *binary = new char[header.length];
+	glGetProgramBinary(m_prog, header.length, 0, &header.format, binary);
+	if ( isGLError() )
+	{
+		delete[] binary;
+		return;
+	}
+	memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	header.key = key;
+
+	mkdir(s_cacheDir, 0755); // Fails harmlessly if it exists
+	FILE *out = fopen(path, "wb");
+	if ( out )
+	{
+		fwrite(&header, sizeof(header), 1, out);
+		fwrite(binary, header.length, 1, out);
+		fclose(out);
+	}
+	else
+	{
+		fprintf(stderr, "Warning: Could not write program cache file %s\n", path);
+	}
+	delete[] binary;
+}
+
 bool GLProgram::init(const char *vertCode, const char *fragCode)
 {
-	GLuint vertHandle, fragHandle;
 	if (vertCode == NULL || fragCode == NULL)
 	{
 		return false;
 	}
+	m_vertCode = vertCode;
+	m_fragCode = fragCode;
+
+	m_useCache = getCachePath(vertCode, fragCode, m_cachePath, sizeof(m_cachePath), m_cacheKey);
+	if ( m_useCache && loadBinary(m_cachePath, m_cacheKey) )
+	{
+		s_nCacheHits += 1;
+		findUniforms();
+		m_state = PROGRAM_READY;
+		return true;
+	}
 
 	// Compiling a GLSL program is just like compiling
 	// a C program
+	//  The compile & link are only started here. With
+	//  GL_KHR_parallel_shader_compile the GL does them on its own
+	//  threads; finish() collects the results.
 
 	// 1) First we create a vertex shader program object within
 	//    the OpenGL context, and try to compile it
-	vertHandle = glCreateShader(GL_VERTEX_SHADER); // returns 0 on error
-	if (!compileShader(vertCode, vertHandle))
+	m_vertHandle = glCreateShader(GL_VERTEX_SHADER); // returns 0 on error
+	if (!compileShader(vertCode, m_vertHandle))
 	{
-		glDeleteShader(vertHandle);
+		glDeleteShader(m_vertHandle);
+		m_state = PROGRAM_FAILED;
 		return false;
 	}
 	// 2) Then create a fragment shader program object within
 	//   the OpenGL context, and try to compile it
-	fragHandle = glCreateShader(GL_FRAGMENT_SHADER); // returns 0 on error
-	if (!compileShader(fragCode, fragHandle))
+	m_fragHandle = glCreateShader(GL_FRAGMENT_SHADER); // returns 0 on error
+	if (!compileShader(fragCode, m_fragHandle))
 	{
-		glDeleteShader(fragHandle);
-		glDeleteShader(vertHandle);
+		glDeleteShader(m_fragHandle);
+		glDeleteShader(m_vertHandle);
+		m_state = PROGRAM_FAILED;
 		return false;
 	}
 	// 3) Next we're going to attach the vertex & fragment shader
@@ -68,26 +242,58 @@ bool GLProgram::init(const char *vertCode, const char *fragCode)
 	m_prog = glCreateProgram();
 	if (m_prog == 0)
 	{
-		glDeleteShader(fragHandle);
-		glDeleteShader(vertHandle);
+		glDeleteShader(m_fragHandle);
+		glDeleteShader(m_vertHandle);
+		m_state = PROGRAM_FAILED;
 		return false;
 	}
-	glAttachShader(m_prog, vertHandle);
-	glAttachShader(m_prog, fragHandle);
+	glAttachShader(m_prog, m_vertHandle);
+	glAttachShader(m_prog, m_fragHandle);
+	if (m_useCache)
+	{
+		// Tell the GL that we'll want the binary back
+		glProgramParameteri(m_prog, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
 	glLinkProgram(m_prog);
 
 	// Flag the vert & frag GLProgram objects for deletion
 	// when the program object gets deleted.
-	glDeleteShader(vertHandle);
-	glDeleteShader(fragHandle);
+	//  They stay queryable until then, for their error logs.
+	glDeleteShader(m_vertHandle);
+	glDeleteShader(m_fragHandle);
+
+	m_state = PROGRAM_LINKING;
+	return true;
+}
+
+bool GLProgram::isLinkDone() const
+{
+	if (m_state != PROGRAM_LINKING || !isParallelCompileSupported()) return true;
+	GLint done = GL_FALSE;
+	glGetProgramiv(m_prog, GL_COMPLETION_STATUS_KHR, &done);
+	return done == GL_TRUE;
+}
+
+bool GLProgram::finish()
+{
+	if (m_state != PROGRAM_LINKING) return m_state == PROGRAM_READY;
+
+	// Make sure the compiles & link were successful.
+	//  This waits for the GL if it is not done yet.
+	m_state = PROGRAM_FAILED;
+	if ( !checkShader(m_vertCode, m_vertHandle) || !checkShader(m_fragCode, m_fragHandle) )
+	{
+		glDeleteProgram(m_prog);
+		m_prog = 0;
+		return false;
+	}
 
-	// Make sure the link was successful
 	GLint success;
 	glGetProgramiv(m_prog, GL_LINK_STATUS, &success);
 	if (success == GL_FALSE)
 	{
 		char errLog[1024];
-		glGetProgramInfoLog(success, 1024, NULL, errLog);
+		glGetProgramInfoLog(m_prog, 1024, NULL, errLog);
 		fprintf(stderr,
 				"========== LINK ERROR ===================\n%s\n",
 				errLog);
@@ -108,6 +314,19 @@ bool GLProgram::init(const char *vertCode, const char *fragCode)
 		return false;
 	}
 
+	s_nCompiled += 1;
+	if (m_useCache)
+	{
+		saveBinary(m_cachePath, m_cacheKey);
+	}
+
+	findUniforms();
+	m_state = PROGRAM_READY;
+	return true;
+}
+
+void GLProgram::findUniforms()
+{
 	// Find out the handle for each of the uniform variables in the GLSL program.
 	m_uniformLocs[UNIFORM_LIGHTPOS] = glGetUniformLocation(m_prog, UNIF_LIGHTPOS);
 	m_uniformLocs[UNIFORM_LIGHTRAD] = glGetUniformLocation(m_prog, UNIF_LIGHTRAD);
@@ -120,8 +339,8 @@ bool GLProgram::init(const char *vertCode, const char *fragCode)
 	m_uniformLocs[UNIFORM_PROJECTION] = glGetUniformLocation(m_prog, UNIF_PROJECTION);
 	m_uniformLocs[UNIFORM_NORMALTRANS] = glGetUniformLocation(m_prog, UNIF_NORMALTRANS);
 	m_uniformLocs[UNIFORM_SHADOWMAP] = glGetUniformLocation(m_prog, UNIF_SHADOWMAP);
-
-	return true;
+	m_uniformLocs[UNIFORM_VIEWTOWORLD] = glGetUniformLocation(m_prog, UNIF_VIEWTOWORLD);
+	m_uniformLocs[UNIFORM_SHADOWFACES] = glGetUniformLocation(m_prog, UNIF_SHADOWFACES);
 }
 
 bool GLProgram::compileShader(const char *code, const GLuint handle) const
@@ -132,7 +351,11 @@ bool GLProgram::compileShader(const char *code, const GLuint handle) const
 	}
 	glShaderSource(handle, 1, &code, 0);
 	glCompileShader(handle);
+	return true;
+}
 
+bool GLProgram::checkShader(const char *code, const GLuint handle) const
+{
 	// Check for errors
 	GLint success;
 	glGetShaderiv(handle, GL_COMPILE_STATUS, &success);
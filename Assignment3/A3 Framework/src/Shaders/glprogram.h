@@ -64,6 +64,8 @@ typedef enum
 #define UNIF_PROJECTION "projection"
 #define UNIF_NORMALTRANS "normalsTransform"
 #define UNIF_SHADOWMAP "shadowMap"
+#define UNIF_VIEWTOWORLD "viewToWorld"
+#define UNIF_SHADOWFACES "shadowFaces"
 
 
 // enum that gives the offset into the GLProgram::m_uniformLocs[]
@@ -83,7 +85,9 @@ typedef enum
 	UNIFORM_MODELVIEW,  // Modelview matrix. mat4x4
 	UNIFORM_PROJECTION, // Projection matrix. mat4x4. view -> clip coordinates
 	UNIFORM_NORMALTRANS, // Matrix for transforming normals. mat4x4. = transpose(inverse(modelview))
-	UNIFORM_SHADOWMAP,  // CubeMap depth-texture for shadow mapping
+	UNIFORM_SHADOWMAP,  // Atlas depth-texture for shadow mapping. sampler2DShadow
+	UNIFORM_VIEWTOWORLD, // Camera -> world matrix. mat4x4. For world-space shadow map lookups
+	UNIFORM_SHADOWFACES, // Light-relative world -> atlas coords for each cube face. mat4x4[6]
 	NUM_UNIFORM_VARS
 } UniformVars;
 
@@ -103,6 +107,8 @@ typedef struct _GLProgUniforms
 	gml::vec3_t m_lightRad; // Light radiance
 	gml::vec3_t m_ambientRad; // Ambient radiance
 	gml::mat4x4_t m_projection; // Projection matrix
+	gml::mat4x4_t m_viewToWorld; // Camera -> world matrix. = inverse(worldView)
+	gml::mat4x4_t m_shadowFaces[6]; // Shadow atlas lookup matrices for the light
 
 	// Object-specific properties
 	gml::vec3_t m_surfRefl; // Surface reflectance
@@ -119,24 +125,76 @@ protected:
 	// ID for the linked program
 	GLuint m_prog;
 
+	typedef enum
+	{
+		PROGRAM_NONE,    // init() not called
+		PROGRAM_LINKING, // Compile & link started; finish() not yet called
+		PROGRAM_READY,   // Linked, and uniforms found
+		PROGRAM_FAILED
+	} ProgramState;
+	ProgramState m_state;
+
+	// Kept while linking, for error reports & the cache
+	const char *m_vertCode, *m_fragCode;
+	GLuint m_vertHandle, m_fragHandle;
+	bool m_useCache;
+	GLuint64 m_cacheKey;
+	char m_cachePath[256];
+
 	// Handle/ID for each of this program's uniforms.
 	//  m_uniformLocs[i] < 0 => no corresponding uniform
 	//  being used by the program.
 	GLint m_uniformLocs[NUM_UNIFORM_VARS];
 
+	// Start compiling a shader; checkShader() reports the outcome.
 	bool compileShader(const char *code, const GLuint handle) const;
+	bool checkShader(const char *code, const GLuint handle) const;
+	// Look up the handle of every uniform in m_prog
+	void findUniforms();
+
+	// On-disk cache of linked program binaries.
+	//  Each program is stored in its own file, named by a hash of its
+	//  source and of the GL vendor, renderer, and version strings.
+	static const char *s_cacheDir; // 0 => no caching
+	static int s_nCacheHits; // Number of programs loaded from the cache
+	static int s_nCompiled; // Number of programs compiled from source
+	// Key & name of the cache file for the given source. Returns false
+	// if caching is disabled or unsupported.
+	static bool getCachePath(const char *vertCode, const char *fragCode, char *path, const int pathLen, GLuint64 &key);
+	// Try to create m_prog from a cached binary
+	bool loadBinary(const char *path, const GLuint64 key);
+	// Write m_prog's binary to the cache
+	void saveBinary(const char *path, const GLuint64 key) const;
 public:
 	GLProgram();
 	~GLProgram();
 
-	// Try to compile & link a GLSL program from the given
-	// vertex shader & fragment shader source
+	// Start compiling & linking a GLSL program from the given
+	// vertex shader & fragment shader source. The source must outlive
+	// the call to finish().
+	// Returns false if it could not be started.
 	bool init(const char *vertCode, const char *fragCode);
+	// True if finish() would not have to wait on the GL
+	bool isLinkDone() const;
+	// Wait for the compile & link, and check the results.
+	// Must be called before the program is used.
+	// Returns true iff the program is ready.
+	bool finish();
+
+	// Whether the GL supports GL_KHR_parallel_shader_compile
+	static bool isParallelCompileSupported();
 
 	// Bind & unbind the shader to the OpenGL context
 	void bind() const;
 	void unbind() const;
 
+	// Directory for the program binary cache; created if needed.
+	// 0 disables the cache.
+	static void setCacheDir(const char *dir) { s_cacheDir = dir; }
+	// How the programs created so far were made
+	static int getNumCacheHits() { return s_nCacheHits; }
+	static int getNumCompiled() { return s_nCompiled; }
+
 	// Retrieve the program ID of the GLSL program
 	inline GLuint getID() const { return m_prog; }
 	// Retrieve the handle/ID of one of the program's uniforms
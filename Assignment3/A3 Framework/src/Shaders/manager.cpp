@@ -17,14 +17,7 @@
 
 #include "Constant/simple.h"
 #include "Constant/depth.h"
-#include "Constant/Lambertian/gouraud.h"
-#include "Constant/Lambertian/phong.h"
-#include "Constant/Specular/gouraud.h"
-#include "Constant/Specular/phong.h"
-#include "Texture/Lambertian/gouraud.h"
-#include "Texture/Lambertian/phong.h"
-#include "Texture/Specular/gouraud.h"
-#include "Texture/Specular/phong.h"
+#include "ubershader.h"
 
 namespace Shader
 {
@@ -33,15 +26,10 @@ typedef enum
 {
 	SIMPLE = 0,
 	DEPTH,
-	CONST_LAMB_GOURAUD,
-	CONST_LAMB_PHONG,
-	CONST_SPEC_GOURAUD,
-	CONST_SPEC_PHONG,
-	TEXTURE_LAMB_GOURAUD,
-	TEXTURE_LAMB_PHONG,
-	TEXTURE_SPEC_GOURAUD,
-	TEXTURE_SPEC_PHONG,
-	NUM_SHADERS
+	// Offset of permutation 0 of the ubershader; the permutation with
+	// key k is at UBERSHADER + k
+	UBERSHADER,
+	NUM_SHADERS = UBERSHADER + PERM_COUNT
 } ShaderOffsets;
 
 Manager::Manager()
@@ -65,100 +53,82 @@ bool Manager::init()
 {
 	m_nShaders = NUM_SHADERS;
 	m_shaders = new Shader*[m_nShaders];
+	if ( !m_shaders ) return false;
 	memset(m_shaders, 0x00, sizeof(Shader*)*m_nShaders);
 
-	m_shaders[SIMPLE] = new Constant::Simple();
-	if ( !m_shaders[SIMPLE] ) return false;
+	// Shaders are compiled the first time that they're asked for, or
+	// pre-warmed. With this the GL compiles them on its own threads.
+	GLProgram::isParallelCompileSupported();
 
-	m_shaders[DEPTH] = new Constant::Depth();
-	if ( !m_shaders[DEPTH] ) return false;
-
-	m_shaders[CONST_LAMB_GOURAUD] = new Constant::Lambertian::Gouraud();
-	if ( !m_shaders[CONST_LAMB_GOURAUD] ) return false;
+	return true;
+}
 
-	m_shaders[CONST_LAMB_PHONG] = new Constant::Lambertian::Phong();
-	if ( !m_shaders[CONST_LAMB_PHONG] ) return false;
+// Offset of the shader that implements the given material
+static int getOffset(const Material::Material &mat)
+{
+	if (mat.getShaderType() == Material::SIMPLE)
+	{
+		return SIMPLE;
+	}
+	return UBERSHADER + getPermutationKey(mat);
+}
 
-	m_shaders[CONST_SPEC_GOURAUD] = new Constant::Specular::Gouraud();
-	if ( !m_shaders[CONST_SPEC_GOURAUD] ) return false;
+Shader* Manager::create(const int offset) const
+{
+	if ( !m_shaders ) return 0;
+	if ( m_shaders[offset] ) return m_shaders[offset];
 
-	m_shaders[CONST_SPEC_PHONG] = new Constant::Specular::Phong();
-	if ( !m_shaders[CONST_SPEC_PHONG] ) return false;
+	switch (offset)
+	{
+	case SIMPLE: m_shaders[offset] = new Constant::Simple(); break;
+	case DEPTH: m_shaders[offset] = new Constant::Depth(); break;
+	default: m_shaders[offset] = createUberShader(offset - UBERSHADER); break;
+	}
+	return m_shaders[offset];
+}
 
-	m_shaders[TEXTURE_LAMB_GOURAUD] = new Texture::Lambertian::Gouraud();
-	if ( !m_shaders[TEXTURE_LAMB_GOURAUD] ) return false;
+const Shader* Manager::fetch(const int offset) const
+{
+	Shader *shader = create(offset);
+	if (shader) shader->finishInit();
+	return shader;
+}
 
-	m_shaders[TEXTURE_LAMB_PHONG] = new Texture::Lambertian::Phong();
-	if ( !m_shaders[TEXTURE_LAMB_PHONG] ) return false;
+const Shader* Manager::getShader(const Material::Material &mat) const
+{
+	return fetch(getOffset(mat));
+}
 
-	m_shaders[TEXTURE_SPEC_GOURAUD] = new Texture::Specular::Gouraud();
-	if ( !m_shaders[TEXTURE_SPEC_GOURAUD] ) return false;
+const Shader* Manager::getDepthShader() const
+{
+	return fetch(DEPTH);
+}
 
-	m_shaders[TEXTURE_SPEC_PHONG] = new Texture::Specular::Phong();
-	if ( !m_shaders[TEXTURE_SPEC_PHONG] ) return false;
+void Manager::prewarm(const Material::Material &mat)
+{
+	create(getOffset(mat));
+}
 
-	return true;
+void Manager::prewarmDepth()
+{
+	create(DEPTH);
 }
 
-const Shader* Manager::getShader(const Material::Material &mat) const
+void Manager::prewarmAll()
 {
-	switch (mat.getShaderType())
+	for (int i=0; i<m_nShaders; i++)
 	{
-	case Material::GOURAUD:
-		switch (mat.getLambSource())
-		{
-		case Material::CONSTANT:
-			if (!mat.hasSpecular())
-			{
-				return m_shaders[CONST_LAMB_GOURAUD];
-			}
-			else
-			{
-				return m_shaders[CONST_SPEC_GOURAUD];
-			}
-		case Material::TEXTURE:
-			if (!mat.hasSpecular())
-			{
-				return m_shaders[TEXTURE_LAMB_GOURAUD];
-			}
-			else
-			{
-				return m_shaders[TEXTURE_SPEC_GOURAUD];
-			}
-		}
-		break;
-	case Material::PHONG:
-		switch (mat.getLambSource())
-		{
-		case Material::CONSTANT:
-			if (!mat.hasSpecular())
-			{
-				return m_shaders[CONST_LAMB_PHONG];
-			}
-			else
-			{
-				return m_shaders[CONST_SPEC_PHONG];
-			}
-		case Material::TEXTURE:
-			if (!mat.hasSpecular())
-			{
-				return m_shaders[TEXTURE_LAMB_PHONG];
-			}
-			else
-			{
-				return m_shaders[TEXTURE_SPEC_PHONG];
-			}
-		}
-		break;
-	default:
-		return m_shaders[SIMPLE];
+		create(i);
 	}
-	return m_shaders[SIMPLE];
 }
 
-const Shader* Manager::getDepthShader() const
+bool Manager::isCompiled() const
 {
-	return m_shaders[DEPTH];
+	for (int i=0; i<m_nShaders; i++)
+	{
+		if (m_shaders[i] && !m_shaders[i]->isCompiled()) return false;
+	}
+	return true;
 }
 
 }
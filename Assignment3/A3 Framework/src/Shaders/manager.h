@@ -13,8 +13,10 @@
 /*
  * Definition of a Manager for shader objects.
  *
- * When initialized, a Manager object will/should allocate
- * an object of each of the Shaders that have been implemented.
+ * A Manager object allocates (and compiles) each of the Shaders
+ * that have been implemented the first time that it is asked for.
+ * Shaders that are known to be needed can be pre-warmed so that
+ * they compile while the rest of the program starts up.
  *
  * When a rendering thread needs a Shader it should query the
  * manager object with the material properties of the object
@@ -36,8 +38,15 @@ namespace Shader
 class Manager
 {
 protected:
+	// Entries are null until the shader is first needed
 	Shader **m_shaders;
 	int m_nShaders;
+
+	// Allocate the shader at the given offset, if it isn't already.
+	//  Its GLSL programs are only started compiling.
+	Shader* create(const int offset) const;
+	// As create(), but the shader is also ready for use.
+	const Shader* fetch(const int offset) const;
 public:
 	Manager();
 	~Manager();
@@ -52,6 +61,18 @@ public:
 
 	// Get the depth-only shader; shader that only outputs fragment depths.
 	const Shader* getDepthShader() const;
+
+	// Start compiling the shader for the given material, and the depth
+	// shader, without waiting for them. With
+	// GL_KHR_parallel_shader_compile the GL compiles them in the
+	// background until they are first asked for.
+	void prewarm(const Material::Material &mat);
+	void prewarmDepth();
+	// Start compiling every shader, and every permutation of the
+	// ubershader; i.e. to fill the program binary cache.
+	void prewarmAll();
+	// True iff every shader created so far is done compiling
+	bool isCompiled() const;
 };
 
 }
@@ -91,9 +91,9 @@ public:
 	// Set the material to be a mirror.
 	void setMirror(bool b) { m_mirror = b; }
 	// Returns whether or not the material is a mirror.
-	bool isMirror() { return m_mirror; }
+	bool isMirror() const { return m_mirror; }
 	// Returns mirror reflectance.
-	const gml::vec3_t& getMirrorRefl() { return m_mirrorRefl; }
+	const gml::vec3_t& getMirrorRefl() const { return m_mirrorRefl; }
 	// Sets the mirror reflectance.
 	void setMirrorReflectance(const gml::vec3_t &mirrorRef) { m_mirrorRefl = mirrorRef;}
 };
@@ -21,8 +21,24 @@ Shader::Shader()
 {
 	m_isReady = false;
 	m_isShadowReady = false;
+	m_isFinished = false;
 }
 Shader::~Shader() {}
+
+bool Shader::isCompiled() const
+{
+	return m_isFinished || (m_program.isLinkDone() && m_shadowProgram.isLinkDone());
+}
+void Shader::finishInit()
+{
+	if (m_isFinished) return;
+	m_isFinished = true;
+	checkReady();
+}
+void Shader::checkReady()
+{
+}
+
 void Shader::bindGL(const bool useShadow) const
 {
 	if (!useShadow)
@@ -41,11 +41,23 @@ protected:
 	bool m_isReady;
 	// True iff the program for shadow mapping is ready
 	bool m_isShadowReady;
+	// True once finishInit() has been called
+	bool m_isFinished;
+
+	// Collect the results of the GLSL programs' compiles & links, and
+	// set m_isReady & m_isShadowReady.
+	// The constructors of subclasses only start the compiles.
+	virtual void checkReady();
 
 public:
 	Shader();
 	virtual ~Shader();
 
+	// True iff finishInit() would not have to wait for the GL
+	bool isCompiled() const;
+	// Must be called before the shader is first used. Safe to call again.
+	void finishInit();
+
 	inline bool getIsReady(const bool useShadow=false) const { return useShadow?m_isShadowReady:m_isReady; }
 	inline GLuint getID(const bool useShadow=false) const { return useShadow?m_shadowProgram.getID():m_program.getID(); }
 
@@ -0,0 +1,373 @@
+
+/*
+ * Copyright:
+ * Daniel D. Neilson (ddneilson@ieee.org)
+ * University of Saskatchewan
+ * All rights reserved
+ *
+ * Permission granted to use for use in assignments and
+ * projects for CMPT 485 & CMPT 829 at the University
+ * of Saskatchewan.
+ */
+
+#include "../GL3/gl3w.h"
+#include <cstdio>
+#include <cstring>
+
+#include "ubershader.h"
+#include "../glUtils.h"
+#include "../ShadowMapping/shadowmap.h"
+
+namespace Shader
+{
+
+// Every GLSL source below is compiled with these defined to 0 or 1:
+//  HAS_TEXTURE  -- PERM_TEXTURE
+//  HAS_SPECULAR -- PERM_SPECULAR
+//  IS_PHONG     -- PERM_PHONG
+//  HAS_SHADOW   -- Shadow mapped variant of a Phong permutation
+static const char headerFormat[] =
+		"#version 330\n"
+		"#define HAS_TEXTURE %d\n"
+		"#define HAS_SPECULAR %d\n"
+		"#define IS_PHONG %d\n"
+		"#define HAS_SHADOW %d\n";
+
+// Lighting terms; done in the vertex shader for Gouraud, and in the
+// fragment shader for Phong.
+#define UBER_GLSL_LIGHTING \
+		"uniform vec3 " UNIF_LIGHTRAD ";\n" \
+		"uniform vec3 " UNIF_AMBIENT ";\n" \
+		"#if HAS_TEXTURE\n" \
+		"uniform sampler2D " UNIF_TEXTURE0 ";\n" \
+		"#else\n" \
+		"uniform vec3 " UNIF_SURFREF ";\n" \
+		"#endif\n" \
+		/* Lambertian + ambient */ \
+		"vec3 lambert(vec3 surf, vec3 l, vec3 n, float notShadow) {\n" \
+		" float diff = notShadow * max(0.0, dot(l, n));\n" \
+		" return surf * ( " UNIF_AMBIENT " + diff * " UNIF_LIGHTRAD " );\n" \
+		"}\n" \
+		"#if HAS_SPECULAR\n" \
+		"uniform float " UNIF_SPECEXP ";\n" \
+		"uniform vec3 " UNIF_SPECREF ";\n" \
+		"vec3 specular(vec3 e, vec3 r, float notShadow) {\n" \
+		" float spec = notShadow * max(0.0, dot(e, r));\n" \
+		" if (spec > 0.0)\n" \
+		"   return " UNIF_LIGHTRAD " * " UNIF_SPECREF " * pow( spec, " UNIF_SPECEXP " );\n" \
+		" return vec3(0.0);\n" \
+		"}\n" \
+		"#endif\n"
+
+static const char vertShader[] =
+		"uniform vec3 " UNIF_LIGHTPOS ";\n"
+		"uniform mat4 " UNIF_MODELVIEW ";\n"
+		"uniform mat4 " UNIF_PROJECTION ";\n"
+		"uniform mat4 " UNIF_NORMALTRANS ";\n"
+		"layout (location=0) in vec3 position;\n"
+		"layout (location=1) in vec3 normal;\n"
+		"#if HAS_TEXTURE\n"
+		"layout (location=2) in vec2 texCoords;\n"
+		"#endif\n"
+		"#if IS_PHONG\n"
+		"smooth out vec3 l;\n"
+		"smooth out vec3 n;\n"
+		"#if HAS_SPECULAR\n"
+		"smooth out vec3 r;\n"
+		"smooth out vec3 e;\n"
+		"#endif\n"
+		"#if HAS_TEXTURE\n"
+		"smooth out vec2 texCoord0;\n"
+		"#endif\n"
+		"#if HAS_SHADOW\n"
+		"uniform mat4 " UNIF_VIEWTOWORLD ";\n"
+		"smooth out float distToLight;\n"
+		"smooth out vec3 lightToVert;\n"
+		"#endif\n"
+		"#else\n"
+		UBER_GLSL_LIGHTING
+		"smooth out vec4 vertColor;\n"
+		"#endif\n"
+		"void main(void) {\n"
+		" vec4 p = " UNIF_MODELVIEW " * vec4(position, 1.0);\n"
+		"#if !IS_PHONG\n"
+		" vec3 l, n, r, e;\n"
+		"#elif HAS_TEXTURE\n"
+		" texCoord0 = texCoords;\n"
+		"#endif\n"
+		" n = normalize( (" UNIF_NORMALTRANS " * vec4(normal,0.0)).xyz );\n"
+		" l = " UNIF_LIGHTPOS " - p.xyz;\n"
+		"#if HAS_SPECULAR\n"
+		" r = normalize( reflect( -l, n ) );\n"
+		" e = -normalize( p.xyz );\n"
+		"#endif\n"
+		"#if HAS_SHADOW\n"
+		" distToLight = length(l) / " SHADOWMAP_FAR_STR ";\n"
+		// The shadow map is indexed by world-space direction from the light
+		" lightToVert = (" UNIF_VIEWTOWORLD " * vec4(-l, 0.0)).xyz;\n"
+		"#endif\n"
+		" l = normalize(l);\n"
+		"#if !IS_PHONG\n"
+		"#if HAS_TEXTURE\n"
+		" vec3 surf = texture(" UNIF_TEXTURE0 ", texCoords.st).rgb;\n"
+		"#else\n"
+		" vec3 surf = " UNIF_SURFREF ";\n"
+		"#endif\n"
+		" vec3 c = lambert(surf, l, n, 1.0);\n"
+		"#if HAS_SPECULAR\n"
+		" c = c + specular(e, r, 1.0);\n"
+		"#endif\n"
+		" vertColor = vec4(  clamp(c, 0.0, 1.0), 1.0);\n"
+		"#endif\n"
+		" gl_Position = " UNIF_PROJECTION " * p;\n"
+		"}";
+
+static const char fragShader[] =
+		"#if IS_PHONG\n"
+		UBER_GLSL_LIGHTING
+		"#if HAS_SHADOW\n"
+		SHADOWMAP_GLSL_LOOKUP
+		"in float distToLight;\n"
+		"in vec3 lightToVert;\n"
+		"#endif\n"
+		"#if HAS_TEXTURE\n"
+		"in vec2 texCoord0;\n"
+		"#endif\n"
+		"in vec3 l;\n"
+		"in vec3 n;\n"
+		"#if HAS_SPECULAR\n"
+		"in vec3 r;\n"
+		"in vec3 e;\n"
+		"#endif\n"
+		"#else\n"
+		"in vec4 vertColor;\n"
+		"#endif\n"
+		"out vec4 vFragColor;\n"
+		"void main(void) {\n"
+		"#if IS_PHONG\n"
+		"#if HAS_SHADOW\n"
+		" float notShadow = shadowLookup(lightToVert, distToLight);\n"
+		"#else\n"
+		" const float notShadow = 1.0;\n"
+		"#endif\n"
+		"#if HAS_TEXTURE\n"
+		" vec3 surf = texture(" UNIF_TEXTURE0 ", texCoord0.st).rgb;\n"
+		"#else\n"
+		" vec3 surf = " UNIF_SURFREF ";\n"
+		"#endif\n"
+		" vec3 c = lambert(surf, normalize(l), normalize(n), notShadow);\n"
+		"#if HAS_SPECULAR\n"
+		" c = c + specular(normalize(e), normalize(r), notShadow);\n"
+		"#endif\n"
+		" vFragColor = vec4(  clamp(c, 0.0, 1.0), 1.0);\n"
+		"#else\n"
+		" vFragColor = vertColor;\n"
+		"#endif\n"
+		"}";
+
+// Prefix the source with the permutation's #defines.
+//  Returned string is allocated with new[]
+static char* specialize(const char *source, const PermutationKey key, const bool isShadow)
+{
+	const size_t len = sizeof(headerFormat) + 64 + strlen(source);
+	char *code = new char[len];
+	int n = snprintf(code, len, headerFormat,
+			(key & PERM_TEXTURE) ? 1 : 0,
+			(key & PERM_SPECULAR) ? 1 : 0,
+			(key & PERM_PHONG) ? 1 : 0,
+			isShadow ? 1 : 0);
+	strcpy(code + n, source);
+	return code;
+}
+
+PermutationKey getPermutationKey(const Material::Material &mat)
+{
+	assert(mat.getShaderType() != Material::SIMPLE);
+	PermutationKey key = 0;
+	if (mat.getLambSource() == Material::TEXTURE) key |= PERM_TEXTURE;
+	if (mat.hasSpecular()) key |= PERM_SPECULAR;
+	if (mat.getShaderType() == Material::PHONG) key |= PERM_PHONG;
+	return key;
+}
+
+ShadeKernel getShadeKernel(const Material::Material &mat)
+{
+	if (mat.getShaderType() == Material::SIMPLE)
+	{
+		return KERNEL_NONE;
+	}
+	if (mat.getLambSource() == Material::TEXTURE)
+	{
+		return mat.hasSpecular() ? KERNEL_TEXTURE_SPECULAR : KERNEL_TEXTURE;
+	}
+	return mat.hasSpecular() ? KERNEL_CONSTANT_SPECULAR : KERNEL_CONSTANT;
+}
+
+const char* getPermutationName(const PermutationKey key)
+{
+	static const char *names[PERM_COUNT] =
+	{
+		"constant-lambertian-gouraud",
+		"texture-lambertian-gouraud",
+		"constant-specular-gouraud",
+		"texture-specular-gouraud",
+		"constant-lambertian-phong",
+		"texture-lambertian-phong",
+		"constant-specular-phong",
+		"texture-specular-phong",
+	};
+	return (key < PERM_COUNT) ? names[key] : "invalid";
+}
+
+UberShader::UberShader(const PermutationKey key)
+{
+	m_key = key;
+	m_vertCode = specialize(vertShader, key, false);
+	m_fragCode = specialize(fragShader, key, false);
+	m_program.init(m_vertCode, m_fragCode);
+	m_shadowVertCode = m_shadowFragCode = 0;
+	if (key & PERM_PHONG)
+	{
+		// Both stages change for the shadow variant; the vertex shader
+		// adds the light-relative outputs.
+		m_shadowVertCode = specialize(vertShader, key, true);
+		m_shadowFragCode = specialize(fragShader, key, true);
+		m_shadowProgram.init(m_shadowVertCode, m_shadowFragCode);
+	}
+}
+UberShader::~UberShader()
+{
+	delete[] m_vertCode;
+	delete[] m_fragCode;
+	if (m_shadowVertCode) delete[] m_shadowVertCode;
+	if (m_shadowFragCode) delete[] m_shadowFragCode;
+}
+
+void UberShader::checkReady()
+{
+	if ( !m_program.finish() || isGLError() )
+	{
+		fprintf(stderr, "ERROR: %s failed to initialize\n", getPermutationName(m_key));
+	}
+	m_isReady = hasUniforms(m_program, false);
+
+	if (m_key & PERM_PHONG)
+	{
+		if ( !m_shadowProgram.finish() || isGLError() )
+		{
+			fprintf(stderr, "ERROR: %s-shadow failed to initialize\n", getPermutationName(m_key));
+		}
+		m_isShadowReady = hasUniforms(m_shadowProgram, true);
+	}
+	else
+	{
+		// Gouraud ignores the shadow map
+		m_isShadowReady = m_isReady;
+	}
+#if !defined(NDEBUG)
+	if ( !m_isReady || !m_isShadowReady )
+	{
+		fprintf(stderr, "ERROR: %s missing uniforms\n", getPermutationName(m_key));
+	}
+#endif
+}
+
+bool UberShader::hasUniforms(const GLProgram &prog, const bool isShadow) const
+{
+	bool ok =
+			(prog.getUniformID(UNIFORM_LIGHTPOS) >= 0) &&
+			(prog.getUniformID(UNIFORM_LIGHTRAD) >= 0) &&
+			(prog.getUniformID(UNIFORM_AMBIENT) >= 0) &&
+			(prog.getUniformID(UNIFORM_MODELVIEW) >= 0) &&
+			(prog.getUniformID(UNIFORM_PROJECTION) >= 0) &&
+			(prog.getUniformID(UNIFORM_NORMALTRANS) >= 0);
+	if (m_key & PERM_TEXTURE)
+	{
+		ok = ok && (prog.getUniformID(UNIFORM_TEXTURE0) >= 0);
+	}
+	else
+	{
+		ok = ok && (prog.getUniformID(UNIFORM_SURFREF) >= 0);
+	}
+	if (m_key & PERM_SPECULAR)
+	{
+		ok = ok &&
+				(prog.getUniformID(UNIFORM_SPECEXP) >= 0) &&
+				(prog.getUniformID(UNIFORM_SPECREF) >= 0);
+	}
+	if (isShadow)
+	{
+		ok = ok &&
+				(prog.getUniformID(UNIFORM_SHADOWMAP) >= 0) &&
+				(prog.getUniformID(UNIFORM_VIEWTOWORLD) >= 0) &&
+				(prog.getUniformID(UNIFORM_SHADOWFACES) >= 0);
+	}
+	return ok;
+}
+
+const GLProgram& UberShader::getProgram(const bool useShadow) const
+{
+	return (useShadow && (m_key & PERM_PHONG)) ? m_shadowProgram : m_program;
+}
+
+void UberShader::bindGL(const bool useShadow) const
+{
+	if (getIsReady(useShadow)) getProgram(useShadow).bind();
+#if !defined(NDEBUG)
+	else
+	{
+		fprintf(stderr, "Attempt to bind non-ready shader\n");
+	}
+#endif
+}
+
+bool UberShader::setUniforms(const GLProgUniforms &uniforms, const bool usingShadow) const
+{
+	const GLProgram &prog = getProgram(usingShadow);
+
+	glUniform3fv(prog.getUniformID(UNIFORM_LIGHTPOS), 1, (GLfloat*)&uniforms.m_lightPos);
+	glUniform3fv(prog.getUniformID(UNIFORM_LIGHTRAD), 1, (GLfloat*)&uniforms.m_lightRad);
+	glUniform3fv(prog.getUniformID(UNIFORM_AMBIENT), 1, (GLfloat*)&uniforms.m_ambientRad);
+	if (m_key & PERM_TEXTURE)
+	{
+		glUniform1i(prog.getUniformID(UNIFORM_TEXTURE0), 0);
+	}
+	else
+	{
+		glUniform3fv(prog.getUniformID(UNIFORM_SURFREF), 1, (GLfloat*)&uniforms.m_surfRefl);
+	}
+	if (m_key & PERM_SPECULAR)
+	{
+		glUniform1f(prog.getUniformID(UNIFORM_SPECEXP), uniforms.m_specExp);
+		glUniform3fv(prog.getUniformID(UNIFORM_SPECREF), 1, (GLfloat*)&uniforms.m_specRefl);
+	}
+	glUniformMatrix4fv(prog.getUniformID(UNIFORM_MODELVIEW), 1, GL_FALSE, (GLfloat*)&uniforms.m_modelView);
+	glUniformMatrix4fv(prog.getUniformID(UNIFORM_PROJECTION), 1, GL_FALSE, (GLfloat*)&uniforms.m_projection);
+	glUniformMatrix4fv(prog.getUniformID(UNIFORM_NORMALTRANS), 1, GL_FALSE, (GLfloat*)&uniforms.m_normalTrans);
+	if (usingShadow && (m_key & PERM_PHONG))
+	{
+		glUniform1i(prog.getUniformID(UNIFORM_SHADOWMAP), SHADOWMAP_TEXTURE_UNIT);
+		glUniformMatrix4fv(prog.getUniformID(UNIFORM_VIEWTOWORLD), 1, GL_FALSE, (GLfloat*)&uniforms.m_viewToWorld);
+		glUniformMatrix4fv(prog.getUniformID(UNIFORM_SHADOWFACES), 6, GL_FALSE, (GLfloat*)uniforms.m_shadowFaces);
+	}
+	return !isGLError();
+}
+
+UberShader* createUberShader(const PermutationKey key)
+{
+	// One case per key; keep in step with PERM_COUNT
+	switch (key)
+	{
+	case 0: return new UberShaderT<0>();
+	case 1: return new UberShaderT<1>();
+	case 2: return new UberShaderT<2>();
+	case 3: return new UberShaderT<3>();
+	case 4: return new UberShaderT<4>();
+	case 5: return new UberShaderT<5>();
+	case 6: return new UberShaderT<6>();
+	case 7: return new UberShaderT<7>();
+	}
+	return 0;
+}
+
+}
@@ -0,0 +1,166 @@
+
+/*
+ * Copyright:
+ * Daniel D. Neilson (ddneilson@ieee.org)
+ * University of Saskatchewan
+ * All rights reserved
+ *
+ * Permission granted to use for use in assignments and
+ * projects for CMPT 485 & CMPT 829 at the University
+ * of Saskatchewan.
+ */
+
+/*
+ * One shader for every combination of material features.
+ *
+ * A material is reduced to a permutation key; a bitmask of the
+ * features that it uses. The key picks:
+ *  - GLSL: the #defines that the single ubershader source is
+ *    compiled with, so every feature test is done by the GLSL
+ *    preprocessor.
+ *  - C++: the template arguments of shadeT(), so the ray tracer's
+ *    shading has no feature tests either.
+ * Keys are 0 .. PERM_COUNT-1, so every permutation can be enumerated
+ * to precompile or cache them.
+ */
+
+#pragma once
+#ifndef __INC_SHADERS_UBERSHADER_H_
+#define __INC_SHADERS_UBERSHADER_H_
+
+#include <math.h>
+#include <assert.h>
+#include "shader.h"
+#include "material.h"
+#include "../GML/fastmath.h"
+
+namespace Shader
+{
+
+// Bits of a permutation key
+#define PERM_TEXTURE  0x1 // Lambertian reflectance from texture 0; else a constant
+#define PERM_SPECULAR 0x2 // Add a specular term
+#define PERM_PHONG    0x4 // Light per-fragment; else per-vertex (Gouraud)
+// Number of permutation keys
+#define PERM_COUNT    8
+
+typedef unsigned int PermutationKey;
+
+// Key of the permutation that implements the given material.
+//  The material must not be Material::SIMPLE
+PermutationKey getPermutationKey(const Material::Material &mat);
+// Short name of a permutation; i.e. "texture-specular-phong"
+const char* getPermutationName(const PermutationKey key);
+
+// Ray tracing shade for one combination of material features.
+//  Lambertian, plus specular if HasSpecular.
+template <Material::LambertianSource LambSource, bool HasSpecular>
+inline gml::vec3_t shadeT(const RayTracing::ShaderValues &vals)
+{
+	float diff = gml::dot(vals.lightDir, vals.n);
+	if (diff <= 0.0)
+	{
+		return gml::vec3_t(0.0, 0.0, 0.0);
+	}
+
+	gml::vec3_t surfRefl;
+	if (LambSource == Material::TEXTURE)
+	{
+		assert(vals.mat.getTexture());
+		surfRefl = vals.mat.getTexture()->lookup(vals.tex, vals.texWidth);
+	}
+	else
+	{
+		surfRefl = vals.mat.getSurfRefl();
+	}
+	gml::vec3_t c = gml::scale( diff, gml::mul( vals.lightRad, surfRefl ) );
+
+	if (HasSpecular)
+	{
+		gml::vec3_t r = gml::normalize( gml::reflect( vals.lightDir, vals.n ) );
+		diff = gml::dot(vals.e, r);
+		if (diff > 0.0)
+		{
+			diff = gml::shading::pow(diff, vals.mat.getSpecExp());
+			c = gml::add(c, gml::scale(diff, gml::mul( vals.lightRad, vals.mat.getSpecRefl() ) ));
+		}
+	}
+	return c;
+}
+
+// Ray tracing shading kernels; one per specialization of shadeT().
+//  A material is resolved to its kernel once, when it is added to the
+//  scene, so shading a hit needs no shader lookup or virtual call.
+typedef enum
+{
+	KERNEL_NONE = 0, // Material::SIMPLE; shades white
+	KERNEL_CONSTANT,
+	KERNEL_CONSTANT_SPECULAR,
+	KERNEL_TEXTURE,
+	KERNEL_TEXTURE_SPECULAR,
+	NUM_KERNELS
+} ShadeKernel;
+
+ShadeKernel getShadeKernel(const Material::Material &mat);
+
+// Ray tracing shade using the given kernel
+inline gml::vec3_t shadeKernel(const ShadeKernel kernel, const RayTracing::ShaderValues &vals)
+{
+	switch (kernel)
+	{
+	case KERNEL_CONSTANT: return shadeT<Material::CONSTANT, false>(vals);
+	case KERNEL_CONSTANT_SPECULAR: return shadeT<Material::CONSTANT, true>(vals);
+	case KERNEL_TEXTURE: return shadeT<Material::TEXTURE, false>(vals);
+	case KERNEL_TEXTURE_SPECULAR: return shadeT<Material::TEXTURE, true>(vals);
+	default: return gml::vec3_t(1.0, 1.0, 1.0);
+	}
+}
+
+// The GL half of a permutation.
+//  Builds & checks the GLSL programs for the key given to it, and
+//  sets the uniforms that the key needs.
+class UberShader : public Shader
+{
+protected:
+	PermutationKey m_key;
+	// Generated GLSL sources; GLProgram only holds pointers to them
+	char *m_vertCode, *m_fragCode;
+	char *m_shadowVertCode, *m_shadowFragCode; // Phong only
+
+	virtual void checkReady();
+	// Whether every uniform that the permutation uses was found in prog
+	bool hasUniforms(const GLProgram &prog, const bool isShadow) const;
+	// Program to use; Gouraud permutations have no shadow program
+	const GLProgram& getProgram(const bool useShadow) const;
+public:
+	UberShader(const PermutationKey key);
+	virtual ~UberShader();
+
+	PermutationKey getKey() const { return m_key; }
+
+	virtual void bindGL(const bool useShadow=false) const;
+	virtual bool setUniforms(const GLProgUniforms &uniforms, const bool usingShadow=false) const;
+};
+
+// A permutation, with its ray tracing shade specialized on the key
+template <PermutationKey Key>
+class UberShaderT : public UberShader
+{
+public:
+	UberShaderT() : UberShader(Key) {}
+	virtual ~UberShaderT() {}
+
+	virtual gml::vec3_t shade(const RayTracing::ShaderValues &vals) const
+	{
+		return shadeT< (Key & PERM_TEXTURE) ? Material::TEXTURE : Material::CONSTANT,
+				(Key & PERM_SPECULAR) != 0 >(vals);
+	}
+};
+
+// Allocate the permutation with the given key; 0 if key >= PERM_COUNT.
+//  Its GLSL programs are only started compiling.
+UberShader* createUberShader(const PermutationKey key);
+
+}
+
+#endif
@@ -11,6 +11,8 @@
  */
 
 #include <cstdio>
+#include <cstring>
+#include <cmath>
 
 #include "shadowmap.h"
 #include "../GL3/gl3.h"
@@ -28,164 +30,659 @@ static const int SHADOWMAP_NEG_Z = 5;
 ShadowMap::ShadowMap()
 {
 	m_fbo = 0;
+	m_staticFbo = 0;
 	m_shadowmap = 0;
+	m_staticmap = 0;
+	m_atlasWidth = m_atlasHeight = 0;
+	m_maxTileSize = 0;
+	m_faceBudget = 0;
+	m_isReady = false;
 
-	// To create a shadowmap for an omni-directional point light we need
-	// 90 degree FOV cameras pointing along each axis in world space
-	//  These will be used to render each side of a cubemap depth texture.
-	gml::vec3_t zero(0.0,0.0,0.0); // location at 0 for now
-	m_cameras[SHADOWMAP_POS_X].lookAt(zero, gml::vec3_t(1.0,0.0,0.0), gml::vec3_t(0.0,-1.0,0.0));
-	m_cameras[SHADOWMAP_NEG_X].lookAt(zero, gml::vec3_t(-1.0,0.0,0.0), gml::vec3_t(0.0,-1.0,0.0));
-
-	m_cameras[SHADOWMAP_POS_Y].lookAt(zero, gml::vec3_t(0.0,1.0,0.0), gml::vec3_t(0.0,0.0,1.0));
-	m_cameras[SHADOWMAP_NEG_Y].lookAt(zero, gml::vec3_t(0.0,-1.0,0.0), gml::vec3_t(0.0,0.0,-1.0));
+	m_casterList = 0;
+	m_casterListSize = 0;
 
-	m_cameras[SHADOWMAP_POS_Z].lookAt(zero, gml::vec3_t(0.0,0.0,1.0), gml::vec3_t(0.0,-1.0,0.0));
-	m_cameras[SHADOWMAP_NEG_Z].lookAt(zero, gml::vec3_t(0.0,0.0,-1.0), gml::vec3_t(0.0,-1.0,0.0));
-
-	for (int i=0;i<6;i++)
+	for (int l=0; l<SHADOWMAP_MAX_LIGHTS; l++)
 	{
-		m_cameras[i].setCameraProjection(CAMERA_PROJECTION_PERSPECTIVE); // perspective projection
-		m_cameras[i].setFOV( (90.0f * M_PI)/180.0f ); // 90 degree FOV
-		m_cameras[i].setImageDimensions( 512, 512 );
-		m_cameras[i].setDepthClip(SHADOWMAP_NEAR, SHADOWMAP_FAR);
+		m_lights[l].isActive = false;
+		m_lights[l].casters = 0;
+		m_lights[l].nCasters = 0;
+		m_lights[l].nCastersAlloced = 0;
 	}
 }
 
 ShadowMap::~ShadowMap()
 {
 	if (m_fbo > 0) glDeleteFramebuffers(1, &m_fbo);
+	if (m_staticFbo > 0) glDeleteFramebuffers(1, &m_staticFbo);
 	if (m_shadowmap > 0) glDeleteTextures(1, &m_shadowmap);
+	if (m_staticmap > 0) glDeleteTextures(1, &m_staticmap);
+	if (m_casterList) delete[] m_casterList;
+	for (int l=0; l<SHADOWMAP_MAX_LIGHTS; l++)
+	{
+		if (m_lights[l].casters) delete[] m_lights[l].casters;
+	}
+}
+
+// Create a 2D depth-texture for the atlas
+static GLuint createDepthAtlas(const int width, const int height)
+{
+	GLuint tex;
+	glGenTextures(1, &tex);
+	glBindTexture(GL_TEXTURE_2D, tex);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
 
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return tex;
 }
 
 // Initialize the shadowmap
-//  smapSize = width & height of shadow map textures; in pixels.
+//  atlasWidth, atlasHeight = dimensions of the atlas; in pixels.
+//  maxTileSize = largest tile that a cube face may be given; in pixels.
+//  faceBudget = most faces to re-render per update(); 0 => no limit
 // Return true if successful.
-bool ShadowMap::init(const int smapSize)
+bool ShadowMap::init(const int atlasWidth, const int atlasHeight, const int maxTileSize, const int faceBudget)
 {
-	// Create a framebuffer object for shadow mapping
+	m_isReady = false;
+
+	if (m_shadowmap > 0) glDeleteTextures(1, &m_shadowmap);
+	if (m_staticmap > 0) glDeleteTextures(1, &m_staticmap);
+	m_shadowmap = createDepthAtlas(atlasWidth, atlasHeight);
+	m_staticmap = createDepthAtlas(atlasWidth, atlasHeight);
+	if ( isGLError() ) return false;
+
+	// Create framebuffer objects for shadow mapping
 	// A framebuffer object encapsulates a render-target context
-	// We'll have to bind each of the depth-textures for shadow mapping
-	// to the GL_DEPTH_ATTACHMENT point in this framebuffer object
+	// Each atlas is attached to the depth attachment of one of these,
+	// and each face is drawn with the viewport set to its tile.
 	if (m_fbo > 0) glDeleteFramebuffers(1, &m_fbo);
+	if (m_staticFbo > 0) glDeleteFramebuffers(1, &m_staticFbo);
 	glGenFramebuffers(1, &m_fbo);
+	glGenFramebuffers(1, &m_staticFbo);
 
-	// Create the cubemap of depth-textures
-	if (m_shadowmap > 0) glDeleteTextures(1, &m_shadowmap);
-	glGenTextures(1, &m_shadowmap);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, m_shadowmap);
-
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
-
-	GLuint cubeSides[] = {
-			GL_TEXTURE_CUBE_MAP_POSITIVE_X,
-			GL_TEXTURE_CUBE_MAP_POSITIVE_Y,
-			GL_TEXTURE_CUBE_MAP_POSITIVE_Z,
-			GL_TEXTURE_CUBE_MAP_NEGATIVE_X,
-			GL_TEXTURE_CUBE_MAP_NEGATIVE_Y,
-			GL_TEXTURE_CUBE_MAP_NEGATIVE_Z,
-	};
-	// Create a texture for each side of the cubemap
+	const GLuint fbos[2] = { m_fbo, m_staticFbo };
+	const GLuint texs[2] = { m_shadowmap, m_staticmap };
+	for (int i=0; i<2; i++)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, fbos[i]);
+		// Depth only; no color output or input
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, texs[i], 0);
+		if ( isGLError() ) return false;
+		if (GL_FRAMEBUFFER_COMPLETE != glCheckFramebufferStatus(GL_FRAMEBUFFER))
+		{
+			fprintf(stderr, "Incomplete framebuffer!\n");
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			return false;
+		}
+	}
+	// Nothing shadowed until a light's faces are drawn
+	glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+	glClear(GL_DEPTH_BUFFER_BIT);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	m_atlasWidth = atlasWidth;
+	m_atlasHeight = atlasHeight;
+	m_maxTileSize = maxTileSize;
+	m_faceBudget = faceBudget;
+
+	// New textures; nothing in them is valid
+	for (int l=0; l<SHADOWMAP_MAX_LIGHTS; l++)
+	{
+		m_lights[l].isValid = false;
+		m_lights[l].tileSize = 0;
+	}
+
+	m_isReady = (glIsTexture(m_shadowmap) == GL_TRUE) && (glIsTexture(m_staticmap) == GL_TRUE);
+
+	return !isGLError();
+}
+
+int ShadowMap::addLight(const gml::vec3_t &pos)
+{
+	int id = -1;
+	for (int l=0; l<SHADOWMAP_MAX_LIGHTS; l++)
+	{
+		if ( !m_lights[l].isActive )
+		{
+			id = l;
+			break;
+		}
+	}
+	if (id < 0)
+	{
+		fprintf(stderr, "ERROR! Too many shadow-casting lights\n");
+		return -1;
+	}
+
+	Light &light = m_lights[id];
+	light.isActive = true;
+	light.isValid = false;
+	light.pos = pos;
+	light.importance = 0.0f;
+	light.tileSize = 0;
+	light.nCasters = 0;
+
+	// To create a shadowmap for an omni-directional point light we need
+	// 90 degree FOV cameras pointing along each axis in world space
+	//  These will be used to render each of the light's tiles.
+	gml::vec3_t zero(0.0,0.0,0.0); // location at 0 for now
+	light.cameras[SHADOWMAP_POS_X].lookAt(zero, gml::vec3_t(1.0,0.0,0.0), gml::vec3_t(0.0,-1.0,0.0));
+	light.cameras[SHADOWMAP_NEG_X].lookAt(zero, gml::vec3_t(-1.0,0.0,0.0), gml::vec3_t(0.0,-1.0,0.0));
+
+	light.cameras[SHADOWMAP_POS_Y].lookAt(zero, gml::vec3_t(0.0,1.0,0.0), gml::vec3_t(0.0,0.0,1.0));
+	light.cameras[SHADOWMAP_NEG_Y].lookAt(zero, gml::vec3_t(0.0,-1.0,0.0), gml::vec3_t(0.0,0.0,-1.0));
+
+	light.cameras[SHADOWMAP_POS_Z].lookAt(zero, gml::vec3_t(0.0,0.0,1.0), gml::vec3_t(0.0,-1.0,0.0));
+	light.cameras[SHADOWMAP_NEG_Z].lookAt(zero, gml::vec3_t(0.0,0.0,-1.0), gml::vec3_t(0.0,-1.0,0.0));
+
+	for (int i=0;i<6;i++)
+	{
+		light.cameras[i].setCameraProjection(CAMERA_PROJECTION_PERSPECTIVE); // perspective projection
+		light.cameras[i].setFOV( (90.0f * M_PI)/180.0f ); // 90 degree FOV
+		light.cameras[i].setImageDimensions( 512, 512 ); // Only the aspect ratio matters
+		light.cameras[i].setDepthClip(SHADOWMAP_NEAR, SHADOWMAP_FAR);
+		light.lookup[i] = gml::identity4();
+		light.nStaticCasters[i] = light.nDynamicCasters[i] = 0;
+	}
+	return id;
+}
+
+void ShadowMap::removeLight(const int id)
+{
+	m_lights[id].isActive = false;
+	m_lights[id].tileSize = 0;
+}
+
+void ShadowMap::setLightPos(const int id, const gml::vec3_t &pos)
+{
+	if ( !(pos == m_lights[id].pos) )
+	{
+		m_lights[id].pos = pos;
+		m_lights[id].isValid = false;
+	}
+}
+
+void ShadowMap::invalidate()
+{
+	for (int l=0; l<SHADOWMAP_MAX_LIGHTS; l++)
+	{
+		m_lights[l].isValid = false;
+	}
+}
+
+int ShadowMap::getFaceMask(const Light &light, const gml::vec3_t &center, const float radius) const
+{
+	const gml::vec3_t d = gml::sub(center, light.pos);
+
+	// Entirely beyond the light's range of effect
+	if ( gml::length(d) - radius > SHADOWMAP_FAR ) return 0;
+
+	int mask = 0;
 	for (int i=0; i<6; i++)
 	{
-		glTexImage2D(cubeSides[i], 0, GL_DEPTH_COMPONENT,	smapSize, smapSize, 0, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
+		const int axis = i % 3;
+		// Distance along the face's view direction
+		const float a = (i < 3) ? d[axis] : -d[axis];
+		// Face frustum is bounded by the planes a = +/-b and a = +/-c
+		// The nearest of each pair is the one against |b| (resp. |c|);
+		// the sphere is outside when its signed distance is below -radius.
+		const float b = fabsf(d[(axis+1)%3]);
+		const float c = fabsf(d[(axis+2)%3]);
+		if ( (a - b) * (float)M_SQRT1_2 < -radius ) continue;
+		if ( (a - c) * (float)M_SQRT1_2 < -radius ) continue;
+		mask |= (1 << i);
 	}
+	return mask;
+}
 
-	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+void ShadowMap::markFaces(Light &light, const int faceMask, const bool isDynamic)
+{
+	for (int i=0; i<6; i++)
+	{
+		if ( faceMask & (1 << i) )
+		{
+			if (isDynamic) light.faceDirty[i] = true;
+			else light.staticDirty[i] = true;
+		}
+	}
+}
 
+bool ShadowMap::trackCasters(Light &light, const Scene::Scene &scene)
+{
+	const GLuint nObjects = scene.getNumObjects();
+	if (nObjects > light.nCastersAlloced)
+	{
+		GLuint newSize = (light.nCastersAlloced > 0) ? light.nCastersAlloced : 8;
+		while (newSize < nObjects) newSize *= 2;
+		CasterState *newCasters = new CasterState[newSize];
+		if ( !newCasters )
+		{
+			fprintf(stderr, "ERROR! Could not allocate shadow caster states\n");
+			return false;
+		}
+		if (light.casters)
+		{
+			memcpy(newCasters, light.casters, sizeof(CasterState)*light.nCasters);
+			delete[] light.casters;
+		}
+		light.casters = newCasters;
+		light.nCastersAlloced = newSize;
+	}
+	if (nObjects > m_casterListSize)
+	{
+		if (m_casterList) delete[] m_casterList;
+		m_casterList = new GLuint[light.nCastersAlloced];
+		if ( !m_casterList )
+		{
+			fprintf(stderr, "ERROR! Could not allocate shadow caster list\n");
+			m_casterListSize = 0;
+			return false;
+		}
+		m_casterListSize = light.nCastersAlloced;
+	}
+
+	for (GLuint i=0; i<nObjects; i++)
+	{
+		const Object::Object *obj = scene.getObject(i);
+		const GLuint version = obj->getTransformVersion();
+		const bool isDynamic = obj->isDynamic();
+		CasterState &caster = light.casters[i];
+
+		if ( i < light.nCasters &&
+				caster.version == version && caster.isDynamic == isDynamic )
+		{
+			continue; // Unchanged since the faces were last rendered
+		}
+
+		const int faces = getFaceMask(light, obj->getBoundCenter(), obj->getBoundRadius());
+		// The faces it left need to lose it, and the faces it entered need to gain it
+		if (i < light.nCasters) markFaces(light, caster.faces, caster.isDynamic);
+		markFaces(light, faces, isDynamic);
+
+		caster.version = version;
+		caster.faces = (GLubyte)faces;
+		caster.isDynamic = isDynamic;
+		caster.reach = gml::length(gml::sub(obj->getBoundCenter(), light.pos)) + obj->getBoundRadius();
+	}
+	light.nCasters = nObjects;
+	return true;
+}
+
+GLuint ShadowMap::gatherCasters(const Light &light, const int face, const bool isDynamic)
+{
+	const GLubyte faceBit = (GLubyte)(1 << face);
+	GLuint n = 0;
+	for (GLuint i=0; i<light.nCasters; i++)
+	{
+		if ( (light.casters[i].faces & faceBit) && light.casters[i].isDynamic == isDynamic )
+		{
+			m_casterList[n++] = i;
+		}
+	}
+	return n;
+}
+
+void ShadowMap::setImportance(const Camera &viewer)
+{
+	const float tanHalfFOV = tanf(0.5f * viewer.getFOV());
+	for (int l=0; l<SHADOWMAP_MAX_LIGHTS; l++)
+	{
+		Light &light = m_lights[l];
+		if ( !light.isActive ) continue;
+
+		// Radius, around the light, of the region that it shadows
+		float reach = 0.0f;
+		for (GLuint i=0; i<light.nCasters; i++)
+		{
+			if (light.casters[i].faces && light.casters[i].reach > reach) reach = light.casters[i].reach;
+		}
+		if (reach > SHADOWMAP_FAR) reach = SHADOWMAP_FAR;
+
+		const gml::vec3_t toLight = gml::sub(light.pos, viewer.getPosition());
+		const float dist = gml::length(toLight);
+
+		if ( reach <= 0.0f || gml::dot(toLight, viewer.getViewDir()) < -reach )
+		{
+			// No shadows, or they're all behind the viewer
+			light.importance = 0.0f;
+		}
+		else if ( dist <= reach )
+		{
+			// Viewer is inside the shadowed region
+			light.importance = 1.0f;
+		}
+		else
+		{
+			// Size of the region on screen, relative to the height of the screen
+			light.importance = reach / (dist * tanHalfFOV);
+			if (light.importance > 1.0f) light.importance = 1.0f;
+		}
+	}
+}
+
+bool ShadowMap::packTiles(const int *sizes)
+{
+	// Order every face of every light by tile size; largest first.
+	int order[6*SHADOWMAP_MAX_LIGHTS];
+	int nTiles = 0;
+	for (int l=0; l<SHADOWMAP_MAX_LIGHTS; l++)
+	{
+		if ( !m_lights[l].isActive ) continue;
+		for (int i=0; i<6; i++)
+		{
+			int j = nTiles++;
+			while (j > 0 && sizes[order[j-1]/6] < sizes[l])
+			{
+				order[j] = order[j-1];
+				j--;
+			}
+			order[j] = 6*l + i;
+		}
+	}
+
+	// Shelf packing. Power-of-two sizes in decreasing order leave no
+	// gaps within a shelf.
+	int tileX[6*SHADOWMAP_MAX_LIGHTS], tileY[6*SHADOWMAP_MAX_LIGHTS];
+	int x = 0, y = 0, shelfHeight = 0;
+	for (int t=0; t<nTiles; t++)
+	{
+		const int size = sizes[order[t]/6];
+		if (x + size > m_atlasWidth)
+		{
+			x = 0;
+			y += shelfHeight;
+			shelfHeight = 0;
+		}
+		if (y + size > m_atlasHeight) return false;
+		tileX[order[t]] = x;
+		tileY[order[t]] = y;
+		x += size;
+		if (size > shelfHeight) shelfHeight = size;
+	}
+
+	// It fits. Any light whose tiles moved has to be redrawn.
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_fbo);
+	glEnable(GL_SCISSOR_TEST);
+	for (int l=0; l<SHADOWMAP_MAX_LIGHTS; l++)
+	{
+		Light &light = m_lights[l];
+		if ( !light.isActive ) continue;
+
+		bool moved = (light.tileSize != sizes[l]);
+		for (int i=0; i<6 && !moved; i++)
+		{
+			moved = (light.tileX[i] != tileX[6*l+i]) || (light.tileY[i] != tileY[6*l+i]);
+		}
+		if ( !moved ) continue;
+
+		light.tileSize = sizes[l];
+		for (int i=0; i<6; i++)
+		{
+			light.tileX[i] = tileX[6*l+i];
+			light.tileY[i] = tileY[6*l+i];
+			light.staticDirty[i] = light.faceDirty[i] = true;
+			light.isFresh[i] = true;
+			light.age[i] = 0;
+			// Unshadowed until the face is drawn
+			glScissor(light.tileX[i], light.tileY[i], light.tileSize, light.tileSize);
+			glClear(GL_DEPTH_BUFFER_BIT);
+		}
+		setLookup(light);
+	}
+	glDisable(GL_SCISSOR_TEST);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+
+	return !isGLError();
+}
+
+bool ShadowMap::allocateTiles()
+{
+	int sizes[SHADOWMAP_MAX_LIGHTS];
+	bool changed = false;
+	for (int l=0; l<SHADOWMAP_MAX_LIGHTS; l++)
+	{
+		const Light &light = m_lights[l];
+		sizes[l] = 0;
+		if ( !light.isActive ) continue;
+
+		// Smallest power of two that covers the light's share of the maximum
+		int size = SHADOWMAP_MIN_TILE;
+		while (size < m_maxTileSize && size < light.importance * m_maxTileSize) size *= 2;
+		if (size > m_maxTileSize) size = m_maxTileSize;
+		// Only shrink by two or more steps, so that the atlas isn't
+		// re-packed as the importance wavers around a boundary.
+		if (size < light.tileSize && 4*size > light.tileSize) size = light.tileSize;
+
+		sizes[l] = size;
+		changed = changed || (size != light.tileSize);
+	}
+	if ( !changed ) return true;
+
+	while ( !packTiles(sizes) )
+	{
+		// Doesn't fit; halve the largest tile, and try again.
+		int largest = -1;
+		for (int l=0; l<SHADOWMAP_MAX_LIGHTS; l++)
+		{
+			if ( sizes[l] > SHADOWMAP_MIN_TILE && (largest < 0 || sizes[l] > sizes[largest]) ) largest = l;
+		}
+		if (largest < 0)
+		{
+			fprintf(stderr, "ERROR! Shadow-casting lights do not fit in the atlas\n");
+			return false;
+		}
+		sizes[largest] /= 2;
+	}
+	return true;
+}
+
+void ShadowMap::setLookup(Light &light)
+{
+	// Each tile is inset by half a texel, so that lookups on a face's
+	// edge don't sample the neighbouring tile.
+	const float sx = 0.5f * (light.tileSize - 1) / m_atlasWidth;
+	const float sy = 0.5f * (light.tileSize - 1) / m_atlasHeight;
 	for (int i=0; i<6; i++)
 	{
-		m_cameras[i].setImageDimensions(smapSize, smapSize);
+		// Clip coords -> atlas texture coords of the face's tile
+		const gml::mat4x4_t toTile = gml::mul(
+				gml::translate(gml::vec3_t(
+						(light.tileX[i] + 0.5f*light.tileSize) / m_atlasWidth,
+						(light.tileY[i] + 0.5f*light.tileSize) / m_atlasHeight,
+						0.0f)),
+				gml::scaleh(sx, sy, 1.0f) );
+		// The shaders give vectors relative to the light, so undo the
+		// camera's translation to the light.
+		const gml::mat4x4_t faceView = gml::embed( gml::mul(gml::affine(light.cameras[i].getWorldView()),
+				gml::affine(gml::identity3(), light.pos)) );
+		light.lookup[i] = gml::mul(toTile, gml::mul(light.cameras[i].getProjection(), faceView));
 	}
+}
+
+bool ShadowMap::renderFace(Scene::Scene &scene, Light &light, const int face)
+{
+	const int x = light.tileX[face], y = light.tileY[face], size = light.tileSize;
+	const gml::mat4x4_t worldCam = light.cameras[face].getWorldView();
+
+	glViewport(x, y, size, size);
+	// Keep clears inside of the tile
+	glScissor(x, y, size, size);
+
+	if ( light.staticDirty[face] )
+	{
+		// Only casters whose bounds reach into this face's frustum
+		const GLuint nStatic = gatherCasters(light, face, false);
+		// With no static casters the static layer is never read,
+		// so there is no need to even clear it.
+		if ( nStatic > 0 )
+		{
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_staticFbo);
+			// Clear the depth buffer
+			glClear(GL_DEPTH_BUFFER_BIT);
+			if ( isGLError() ) return false;
+
+			scene.rasterizeDepth(worldCam, light.cameras[face].getProjection(), m_casterList, nStatic);
+		}
+
+		light.nStaticCasters[face] = nStatic;
+		light.staticDirty[face] = false;
+		light.faceDirty[face] = true;
+	}
+
+	if ( light.faceDirty[face] )
+	{
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_fbo);
+		if ( light.nStaticCasters[face] > 0 )
+		{
+			// Start from the static casters' depths, then draw the dynamic ones over them
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, m_staticFbo);
+			glBlitFramebuffer(x, y, x+size, y+size, x, y, x+size, y+size, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+		}
+		else
+		{
+			glClear(GL_DEPTH_BUFFER_BIT);
+		}
+		if ( isGLError() ) return false;
 
-	m_shadowMapSize = smapSize;
+		const GLuint nDynamic = gatherCasters(light, face, true);
+		if ( nDynamic > 0 )
+		{
+			scene.rasterizeDepth(worldCam, light.cameras[face].getProjection(), m_casterList, nDynamic);
+		}
 
-	m_isReady = glIsTexture(m_shadowmap) == GL_TRUE;
+		light.nDynamicCasters[face] = nDynamic;
+		light.faceDirty[face] = false;
+	}
+
+	light.isFresh[face] = false;
+	light.age[face] = 0;
 
 	return !isGLError();
 }
 
-void ShadowMap::create(Scene::Scene &scene, const gml::mat4x4_t worldView)
+void ShadowMap::update(Scene::Scene &scene, const Camera &viewer)
 {
 
 	if ( !m_isReady )
 	{
 #if !defined(NDEBUG)
-		fprintf(stderr, "Trying to create shadow map when cubemap not ready\n");
+		fprintf(stderr, "Trying to create shadow map when atlas not ready\n");
 #endif
 		return;
 	}
 
-	gml::vec3_t _lightPos; // light position in camera coordinates
-	_lightPos = gml::extract3(gml::mul( worldView, scene.getLightPos() ));
+	for (int l=0; l<SHADOWMAP_MAX_LIGHTS; l++)
+	{
+		Light &light = m_lights[l];
+		if ( !light.isActive ) continue;
 
-	GLuint textures[6];
-	textures[SHADOWMAP_POS_X] = GL_TEXTURE_CUBE_MAP_POSITIVE_X;
-	textures[SHADOWMAP_NEG_X] = GL_TEXTURE_CUBE_MAP_NEGATIVE_X;
-	textures[SHADOWMAP_POS_Y] = GL_TEXTURE_CUBE_MAP_POSITIVE_Y;
-	textures[SHADOWMAP_NEG_Y] = GL_TEXTURE_CUBE_MAP_NEGATIVE_Y;
-	textures[SHADOWMAP_POS_Z] = GL_TEXTURE_CUBE_MAP_POSITIVE_Z;
-	textures[SHADOWMAP_NEG_Z] = GL_TEXTURE_CUBE_MAP_NEGATIVE_Z;
+		if ( !light.isValid )
+		{
+			// Everything is relative to the light; start over.
+			for (int i=0; i<6; i++)
+			{
+				// Center camera on the world-coordinates of the light source
+				light.cameras[i].setPosition(light.pos);
+				light.staticDirty[i] = light.faceDirty[i] = true;
+			}
+			light.nCasters = 0; // forget what was cached about the casters
+			light.isValid = true;
+		}
 
-	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_fbo);
-	//glDrawBuffer(GL_NONE); // turn off color output
-	if ( isGLError() ) return;
+		if ( !trackCasters(light, scene) ) return;
+	}
 
-	glViewport(0, 0, m_shadowMapSize, m_shadowMapSize);
+	setImportance(viewer);
+	if ( !allocateTiles() ) return;
+
+	// Every dirty face, with how urgently it needs to be drawn.
+	// Freshly allocated tiles have nothing in them, so they go first;
+	// then the most important lights, with waiting faces moving up.
+	int candidates[6*SHADOWMAP_MAX_LIGHTS];
+	float priority[6*SHADOWMAP_MAX_LIGHTS];
+	int nCandidates = 0;
+	for (int l=0; l<SHADOWMAP_MAX_LIGHTS; l++)
+	{
+		const Light &light = m_lights[l];
+		if ( !light.isActive || light.tileSize == 0 ) continue;
+		for (int i=0; i<6; i++)
+		{
+			if ( !light.staticDirty[i] && !light.faceDirty[i] ) continue;
+			candidates[nCandidates] = 6*l + i;
+			priority[nCandidates] = (light.isFresh[i] ? 2.0f : light.importance + 0.01f) * (1 + light.age[i]);
+			nCandidates++;
+		}
+	}
+	if ( nCandidates == 0 ) return;
+
+	const int nRender = (m_faceBudget > 0 && m_faceBudget < nCandidates) ? m_faceBudget : nCandidates;
 
 	glEnable(GL_CULL_FACE);
 	glCullFace(GL_FRONT);
 	// Turn on the depth buffer
 	glEnable(GL_DEPTH_TEST);
+	glEnable(GL_SCISSOR_TEST);
 
 	if ( isGLError() ) return;
 
-	for (int i=0; i<6; i++)
+	for (int r=0; r<nRender; r++)
 	{
-		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, textures[i], m_shadowmap, 0);
-		if ( isGLError() ) return;
-
-		if (GL_FRAMEBUFFER_COMPLETE != glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER))
+		int best = r;
+		for (int c=r+1; c<nCandidates; c++)
 		{
-			fprintf(stderr, "Incomplete framebuffer!\n");
-			return;
+			if (priority[c] > priority[best]) best = c;
 		}
+		const int tile = candidates[best];
+		candidates[best] = candidates[r];
+		priority[best] = priority[r];
 
-		// Clear the depth buffer
-		glClear(GL_DEPTH_BUFFER_BIT);
-		if ( isGLError() ) return;
-
-		// Center camera on the camera-coordinates of the light source
-		m_cameras[i].setPosition(_lightPos);
-
-		gml::mat4x4_t worldCam = gml::mul(m_cameras[i].getWorldView(), worldView);
-
-		scene.rasterizeDepth(worldCam, m_cameras[i].getProjection());
-
-		glFinish();
-
+		if ( !renderFace(scene, m_lights[tile/6], tile%6) ) break;
+	}
+	// The rest wait for a later update
+	for (int c=nRender; c<nCandidates; c++)
+	{
+		m_lights[candidates[c]/6].age[candidates[c]%6] += 1;
 	}
 
+	glDisable(GL_SCISSOR_TEST);
 	glDisable(GL_DEPTH_TEST);
 	glDisable(GL_CULL_FACE);
 
-	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
+void ShadowMap::printCasterStats() const
+{
+	static const char *faceNames[6] = { "+X", "+Y", "+Z", "-X", "-Y", "-Z" };
+	for (int l=0; l<SHADOWMAP_MAX_LIGHTS; l++)
+	{
+		const Light &light = m_lights[l];
+		if ( !light.isActive ) continue;
+		printf("Light %d: %dpx tiles, importance %.2f. Casters per face (static/dynamic):",
+				l, light.tileSize, light.importance);
+		for (int i=0; i<6; i++)
+		{
+			printf(" %s %u/%u", faceNames[i], light.nStaticCasters[i], light.nDynamicCasters[i]);
+		}
+		printf("\n");
+	}
+}
 
 void ShadowMap::bindGL(GLenum textureUnit) const
 {
 	if (m_isReady)
 	{
 		glActiveTexture(textureUnit);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, m_shadowmap);
+		glBindTexture(GL_TEXTURE_2D, m_shadowmap);
 	}
 }
 
@@ -194,6 +691,6 @@ void ShadowMap::unbindGL(GLenum textureUnit) const
 	if (m_isReady)
 	{
 		glActiveTexture(textureUnit);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+		glBindTexture(GL_TEXTURE_2D, 0);
 	}
 }
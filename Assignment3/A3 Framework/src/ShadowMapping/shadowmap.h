@@ -24,39 +24,181 @@
 #define SHADOWMAP_FAR 50.0f
 #define SHADOWMAP_FAR_STR "50.0f"
 
+// Most lights that can share the atlas
+#define SHADOWMAP_MAX_LIGHTS 8
+// Smallest tile, in pixels, that a light's cube face is given
+#define SHADOWMAP_MIN_TILE 64
+
+// Texture unit that the shaders expect the shadow atlas on
+#define SHADOWMAP_TEXTURE_UNIT 1
+
+// GLSL for the fragment shaders: declares the shadow atlas uniforms and
+//   float shadowLookup(vec3 lightToVert, float distToLight)
+// that returns 1 if the point is lit, and 0 if it is in shadow.
+//  lightToVert = world-space vector from the light to the point
+//  distToLight = distance to the light / SHADOWMAP_FAR
+#define SHADOWMAP_GLSL_LOOKUP \
+		"uniform sampler2DShadow " UNIF_SHADOWMAP ";\n" \
+		"uniform mat4 " UNIF_SHADOWFACES "[6];\n" \
+		"float shadowLookup(vec3 lightToVert, float distToLight) {\n" \
+		" vec3 a = abs(lightToVert);\n" \
+		/* Pick the cube face by the major axis; faces are +X,+Y,+Z,-X,-Y,-Z */ \
+		" int face;\n" \
+		" if (a.x >= a.y && a.x >= a.z) face = (lightToVert.x >= 0.0) ? 0 : 3;\n" \
+		" else if (a.y >= a.z) face = (lightToVert.y >= 0.0) ? 1 : 4;\n" \
+		" else face = (lightToVert.z >= 0.0) ? 2 : 5;\n" \
+		" vec4 p = " UNIF_SHADOWFACES "[face] * vec4(lightToVert, 1.0);\n" \
+		" return texture(" UNIF_SHADOWMAP ", vec3(p.xy / p.w, distToLight));\n" \
+		"}\n"
+
+// Omni-directional shadow maps for up to SHADOWMAP_MAX_LIGHTS point lights.
+// --
+// Every light's six cube faces are packed as square tiles into one 2D
+// depth texture (the atlas). Lights that matter more on screen are given
+// bigger tiles. Faces are only re-rendered when their casters change, and
+// at most a budgeted number of faces are re-rendered per update().
 class ShadowMap
 {
 public:
-	// Cameras centered on the light, with 90 degree FOV,
-	// pointing in each direction along every axis
-	Camera m_cameras[6];
-
-	// The shadowmap itself. This is a handle
-	// to a cube map.
+	// The atlas of every light's cube faces.
+	// Holds the composite of static & dynamic casters.
 	GLuint m_shadowmap;
+	// Atlas holding the depths of only the static casters.
+	// Tiles are copied into m_shadowmap before the dynamic casters are drawn.
+	GLuint m_staticmap;
 
-	// Framebuffer object to use when creating shadowmap
-	GLuint m_fbo;
+	// Framebuffer objects to use when creating shadowmap
+	GLuint m_fbo; // m_shadowmap is attached to this
+	GLuint m_staticFbo; // m_staticmap is attached to this
 
-	int m_shadowMapSize;
+	int m_atlasWidth, m_atlasHeight;
+	// Largest tile that a face may be given
+	int m_maxTileSize;
+	// Most faces that are re-rendered by one update(); 0 => no limit
+	int m_faceBudget;
 
 	// True iff the shadow map texture has been properly created
 	bool m_isReady;
+protected:
+	// What we know about each caster from the last update.
+	//  Indexed the same as the objects in the Scene.
+	typedef struct
+	{
+		GLuint version; // Object::getTransformVersion() when last seen
+		GLubyte faces; // Bitmask of the cube faces that the caster overlapped
+		bool isDynamic;
+		float reach; // Distance from the light to the far side of the caster
+	} CasterState;
+
+	typedef struct
+	{
+		bool isActive;
+		// false => nothing cached is usable; re-render everything
+		bool isValid;
+		// World-space light position that the cube faces were rendered from
+		gml::vec3_t pos;
+
+		// Cameras centered on the light, with 90 degree FOV,
+		// pointing in each direction along every world axis
+		Camera cameras[6];
+
+		// How much the light matters on screen; [0,1]
+		float importance;
+		// Width & height of each of the light's tiles; 0 => not in the atlas
+		int tileSize;
+		// Lower-left corner of each face's tile in the atlas
+		int tileX[6], tileY[6];
+		// Light-relative world coords -> atlas coords for each face; for the shaders
+		gml::mat4x4_t lookup[6];
+
+		// Faces whose static layer must be re-rendered
+		bool staticDirty[6];
+		// Faces whose composite must be rebuilt
+		bool faceDirty[6];
+		// Tile has been (re)allocated and never rendered
+		bool isFresh[6];
+		// Number of updates that a dirty face has been waiting
+		GLuint age[6];
+
+		// Number of static & dynamic casters in each face's frustum,
+		// as of the last time that layer of the face was rendered.
+		GLuint nStaticCasters[6];
+		GLuint nDynamicCasters[6];
+
+		CasterState *casters;
+		GLuint nCasters;
+		GLuint nCastersAlloced;
+	} Light;
+	Light m_lights[SHADOWMAP_MAX_LIGHTS];
+
+	// Scratch list of the scene indices of casters to draw into a face
+	GLuint *m_casterList;
+	GLuint m_casterListSize;
+
+	// Bitmask of the cube faces of the light whose frusta overlap the
+	// given world-space sphere. Bit i is set for face i.
+	int getFaceMask(const Light &light, const gml::vec3_t &center, const float radius) const;
+	// Compare the scene against the light's cached caster states, and
+	// flag the faces that are affected by changes.
+	bool trackCasters(Light &light, const Scene::Scene &scene);
+	void markFaces(Light &light, const int faceMask, const bool isDynamic);
+	// Fill m_casterList with the light's casters that overlap the given
+	// face and are of the given kind. Returns the number of casters.
+	GLuint gatherCasters(const Light &light, const int face, const bool isDynamic);
+
+	// Estimate each light's importance from how large the region that it
+	// casts shadows into appears to the viewer.
+	void setImportance(const Camera &viewer);
+	// Choose tile sizes from the importances, and re-pack the atlas if
+	// they changed. Returns false if the lights can't fit.
+	bool allocateTiles();
+	// Shelf-pack every active light's tiles at the given sizes.
+	bool packTiles(const int *sizes);
+	void setLookup(Light &light);
+
+	// Render the given face of the light into the atlas
+	bool renderFace(Scene::Scene &scene, Light &light, const int face);
 public:
 	ShadowMap();
 	~ShadowMap();
 
 	// Initialize the shadowmap
-	//  smapSize = width & height of shadow map textures; in pixels.
+	//  atlasWidth, atlasHeight = dimensions of the atlas; in pixels.
+	//  maxTileSize = largest tile that a cube face may be given; in pixels.
+	//  faceBudget = most faces to re-render per update(); 0 => no limit
 	// Return true if successful.
-	bool init(const int smapSize);
+	bool init(const int atlasWidth, const int atlasHeight, const int maxTileSize, const int faceBudget=0);
+
+	// Add a light to the atlas. Returns its id, or -1 if full.
+	int addLight(const gml::vec3_t &pos);
+	void removeLight(const int id);
+	// Move a light. Every face of the light will be re-rendered.
+	void setLightPos(const int id, const gml::vec3_t &pos);
 
-	// Create a shadowmap from the given light position
-	// -- lightPos is expected in world coordinates
+	void setFaceBudget(const int faceBudget) { m_faceBudget = faceBudget; }
+
+	// Bring the shadowmap up to date with the scene's objects.
 	// --
-	// The shadowmap will be created relative to the camera-space
-	// coordinates of the light source
-	void create(Scene::Scene &scene, const gml::mat4x4_t worldView);
+	// The shadowmaps are built in world space around each light, so
+	// camera motion never requires them to be re-rendered. Only the cube
+	// faces that overlap a caster whose transform has changed since
+	// the last update are re-rendered. The viewer is used to decide how
+	// much of the atlas each light gets, and which faces go first.
+	void update(Scene::Scene &scene, const Camera &viewer);
+
+	// Force every face to be re-rendered
+	void invalidate();
+
+	// Matrices that map a light-relative world-space vector to atlas
+	// coordinates for each cube face of the light. Passed to the shaders.
+	const gml::mat4x4_t* getLookupMatrices(const int id) const { return m_lights[id].lookup; }
+
+	// Number of casters drawn into the given face; static casters are
+	// counted from the last time the face's static layer was rendered.
+	GLuint getNumStaticCasters(const int id, const int face) const { return m_lights[id].nStaticCasters[face]; }
+	GLuint getNumDynamicCasters(const int id, const int face) const { return m_lights[id].nDynamicCasters[face]; }
+	// Print the atlas allocation & casters per face to stdout
+	void printCasterStats() const;
 
 	// Bind the shadow map to the given texture unit
 	void bindGL(GLenum textureUnit) const;
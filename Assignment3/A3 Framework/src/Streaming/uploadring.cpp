@@ -0,0 +1,243 @@
+
+/*
+ * Copyright:
+ * Daniel D. Neilson (ddneilson@ieee.org)
+ * University of Saskatchewan
+ * All rights reserved
+ *
+ * Permission granted to use for use in assignments and
+ * projects for CMPT 485 & CMPT 829 at the University
+ * of Saskatchewan.
+ */
+
+#include <cstdio>
+
+#include "uploadring.h"
+#include "../GL3/gl3w.h"
+#include "../glUtils.h"
+
+#if !defined(GL_MAP_PERSISTENT_BIT)
+# define GL_MAP_PERSISTENT_BIT 0x0040
+# define GL_MAP_COHERENT_BIT 0x0080
+#endif
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const GLvoid *data, GLbitfield flags);
+
+// How long to wait on a fence before checking again; in nanoseconds
+static const GLuint64 FENCE_TIMEOUT = 100000000; // 100ms
+// Spans start on this many bytes; enough for any pixel type
+static const size_t SPAN_ALIGN = 16;
+
+// glBufferStorage, if the GL has GL_ARB_buffer_storage; else 0. Checked once.
+static PFNGLBUFFERSTORAGEPROC getBufferStorage()
+{
+	static bool checked = false;
+	static PFNGLBUFFERSTORAGEPROC bufferStorage = 0;
+	if ( !checked )
+	{
+		checked = true;
+		if ( isExtensionSupported("GL_ARB_buffer_storage") )
+		{
+			bufferStorage = (PFNGLBUFFERSTORAGEPROC)gl3wGetProcAddress("glBufferStorage");
+		}
+	}
+	return bufferStorage;
+}
+
+UploadRing::UploadRing()
+{
+	m_buffer = 0;
+	m_size = 0;
+	m_persistent = 0;
+	m_first = m_nSpans = 0;
+	m_head = 0;
+	m_start = m_end = 0;
+	m_isMapped = false;
+}
+
+UploadRing::~UploadRing()
+{
+	destroy();
+}
+
+void UploadRing::destroy()
+{
+	// The GL keeps the buffer until it's done reading it
+	for (int i=0; i<m_nSpans; i++)
+	{
+		glDeleteSync(m_spans[(m_first + i) % UPLOADRING_MAX_FENCES].fence);
+	}
+	m_first = m_nSpans = 0;
+	if (m_buffer)
+	{
+		glDeleteBuffers(1, &m_buffer);
+	}
+	m_buffer = 0;
+	m_size = 0;
+	m_persistent = 0;
+	m_head = 0;
+}
+
+bool UploadRing::init(const size_t size)
+{
+	destroy();
+
+	glGenBuffers(1, &m_buffer);
+	if ( isGLError() || (0==m_buffer) )
+	{
+		m_buffer = 0;
+		return false;
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_buffer);
+
+	PFNGLBUFFERSTORAGEPROC bufferStorage = getBufferStorage();
+	if (bufferStorage)
+	{
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		bufferStorage(GL_PIXEL_UNPACK_BUFFER, size, 0, flags);
+		m_persistent = (char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags);
+		if ( !m_persistent )
+		{
+			fprintf(stderr, "ERROR! Could not map the upload buffer\n");
+		}
+	}
+	else
+	{
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, size, 0, GL_STREAM_DRAW);
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	if ( isGLError() || (bufferStorage && !m_persistent) )
+	{
+		destroy();
+		return false;
+	}
+	m_size = size;
+	return true;
+}
+
+bool UploadRing::retire(const bool wait)
+{
+	if (m_nSpans == 0) return false;
+
+	while (m_nSpans > 0)
+	{
+		GLsync fence = m_spans[m_first].fence;
+		GLenum result;
+		if (wait)
+		{
+			// Flush on the first wait, so that the fence is sure to be signaled eventually
+			GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+			do
+			{
+				result = glClientWaitSync(fence, flags, FENCE_TIMEOUT);
+				flags = 0;
+			} while (result == GL_TIMEOUT_EXPIRED);
+		}
+		else
+		{
+			result = glClientWaitSync(fence, 0, 0);
+			if (result == GL_TIMEOUT_EXPIRED) break;
+		}
+		if (result == GL_WAIT_FAILED)
+		{
+			fprintf(stderr, "ERROR! Waiting on upload fence failed\n");
+		}
+		glDeleteSync(fence);
+		m_first = (m_first + 1) % UPLOADRING_MAX_FENCES;
+		m_nSpans -= 1;
+		// Only the oldest is waited for
+		if (wait) break;
+	}
+	return true;
+}
+
+size_t UploadRing::findSpace(const size_t bytes) const
+{
+	if (m_nSpans == 0)
+	{
+		// Nothing in flight; start over at the front
+		return (bytes <= m_size) ? 0 : m_size;
+	}
+
+	const size_t head = (m_head + SPAN_ALIGN - 1) & ~(SPAN_ALIGN - 1);
+	const size_t oldest = m_spans[m_first].start;
+	if (m_head > oldest)
+	{
+		// Free: [head, m_size) & [0, oldest)
+		if (head + bytes <= m_size) return head;
+		if (bytes <= oldest) return 0;
+	}
+	else if (m_head < oldest)
+	{
+		// Free: [head, oldest)
+		if (head + bytes <= oldest) return head;
+	}
+	// else full
+	return m_size;
+}
+
+void* UploadRing::beginUpload(const size_t bytes, GLintptr &offset)
+{
+	if ( !m_buffer || bytes > m_size ) return 0;
+
+	retire(false);
+	while (m_nSpans == UPLOADRING_MAX_FENCES)
+	{
+		retire(true);
+	}
+	size_t start;
+	while ( (start = findSpace(bytes)) == m_size )
+	{
+		retire(true);
+	}
+	m_start = start;
+	m_end = start + bytes;
+	offset = (GLintptr)start;
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_buffer);
+	if (m_persistent)
+	{
+		return m_persistent + start;
+	}
+	// The fences say that the GL is done with the span, so it can be
+	// written without having the GL synchronize.
+	void *dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, start, bytes,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	if ( !dst )
+	{
+		fprintf(stderr, "ERROR! Could not map the upload buffer\n");
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		return 0;
+	}
+	m_isMapped = true;
+	return dst;
+}
+
+void UploadRing::unmap()
+{
+	if (m_isMapped)
+	{
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		m_isMapped = false;
+	}
+}
+
+void UploadRing::endUpload()
+{
+	unmap();
+	const int i = (m_first + m_nSpans) % UPLOADRING_MAX_FENCES;
+	m_spans[i].fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	m_spans[i].start = m_start;
+	m_head = m_end;
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	if ( !m_spans[i].fence )
+	{
+		// Without a fence there is no knowing when the GL is done with
+		// the span; wait for everything.
+		fprintf(stderr, "ERROR! Could not create upload fence\n");
+		while ( retire(true) );
+		glFinish();
+		return;
+	}
+	m_nSpans += 1;
+}
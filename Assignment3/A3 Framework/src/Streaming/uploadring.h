@@ -0,0 +1,96 @@
+
+/*
+ * Copyright:
+ * Daniel D. Neilson (ddneilson@ieee.org)
+ * University of Saskatchewan
+ * All rights reserved
+ *
+ * Permission granted to use for use in assignments and
+ * projects for CMPT 485 & CMPT 829 at the University
+ * of Saskatchewan.
+ */
+
+/*
+ * Streams pixel data to the GL through a ring of pixel unpack buffer
+ * space.
+ *
+ * glTex(Sub)Image2D from client memory has to copy the pixels before it
+ * returns. From a GL_PIXEL_UNPACK_BUFFER it only queues the copy; the
+ * GL does it when it gets to it. Each upload gets the next free span of
+ * one big buffer, and a fence placed after the commands that read it.
+ * The span is only written again once its fence has signaled, so the
+ * CPU never waits on the GL unless the ring is full.
+ *
+ * With GL_ARB_buffer_storage the buffer is mapped once, persistently.
+ * Otherwise each span is mapped unsynchronized; the fences do the
+ * synchronizing.
+ *
+ * Usage:
+ *   GLintptr offset;
+ *   void *dst = ring.beginUpload(bytes, offset);
+ *   ... write the pixels to dst ...
+ *   ring.unmap();  // Leaves the buffer bound to GL_PIXEL_UNPACK_BUFFER
+ *   glTexSubImage2D(..., (const GLvoid*)offset);
+ *   ring.endUpload();
+ */
+
+#pragma once
+#ifndef __INC_STREAMING_UPLOADRING_H_
+#define __INC_STREAMING_UPLOADRING_H_
+
+#include <stddef.h>
+#include "../GL3/gl3.h"
+
+// Most uploads that may be waiting on the GL at once
+#define UPLOADRING_MAX_FENCES 64
+
+class UploadRing
+{
+protected:
+	GLuint m_buffer;
+	size_t m_size; // Bytes in m_buffer
+	// Whole buffer, if it is persistently mapped; else 0
+	char *m_persistent;
+
+	// Spans the GL may still be reading; oldest at m_first
+	struct
+	{
+		GLsync fence;
+		size_t start;
+	} m_spans[UPLOADRING_MAX_FENCES];
+	int m_first, m_nSpans;
+
+	size_t m_head; // Where the next span starts
+	// The span between beginUpload() & endUpload()
+	size_t m_start, m_end;
+	bool m_isMapped;
+
+	// Forget the spans whose fences have signaled; wait = block on the
+	// oldest until it has. Returns false if there were none to wait on.
+	bool retire(const bool wait);
+	// Start of a free span of the given size, or m_size if none
+	size_t findSpace(const size_t bytes) const;
+	void destroy();
+public:
+	UploadRing();
+	~UploadRing();
+
+	// Allocate a buffer of the given size; replaces any previous buffer.
+	// Return true if successful
+	bool init(const size_t size);
+
+	size_t getSize() const { return m_size; }
+
+	// Space to write bytes of pixel data to. offset = where it is in the
+	// buffer; for the pixels argument of the upload call. Waits for the
+	// GL if the ring is full.
+	//  Returns 0 if bytes is more than the ring holds.
+	void* beginUpload(const size_t bytes, GLintptr &offset);
+	// Done writing; binds the buffer to GL_PIXEL_UNPACK_BUFFER
+	void unmap();
+	// Call after the commands that read the span; fences it and unbinds
+	// the buffer
+	void endUpload();
+};
+
+#endif
@@ -0,0 +1,383 @@
+
+/*
+ * Copyright:
+ * Daniel D. Neilson (ddneilson@ieee.org)
+ * University of Saskatchewan
+ * All rights reserved
+ *
+ * Permission granted to use for use in assignments and
+ * projects for CMPT 485 & CMPT 829 at the University
+ * of Saskatchewan.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "manager.h"
+
+namespace Texture
+{
+
+// Bytes of upload buffer space; images that are bigger are uploaded
+// straight from memory
+static const size_t UPLOAD_RING_SIZE = 16 << 20;
+
+Manager::Manager()
+{
+	m_entries = 0;
+	m_nEntries = m_maxEntries = 0;
+
+	m_threads = 0;
+	m_nThreads = 0;
+	pthread_mutex_init(&m_lock, 0);
+	pthread_cond_init(&m_wake, 0);
+	pthread_cond_init(&m_idle, 0);
+	m_queueHead = m_queueTail = 0;
+	m_done = 0;
+	m_nPending = 0;
+	m_quit = false;
+
+	m_placeholder = 0;
+
+	m_cpuBudget = 256 << 20;
+	m_gpuBudget = 256 << 20;
+	m_frame = 0;
+}
+
+Manager::~Manager()
+{
+	if (m_threads)
+	{
+		pthread_mutex_lock(&m_lock);
+		m_quit = true;
+		pthread_cond_broadcast(&m_wake);
+		pthread_mutex_unlock(&m_lock);
+		for (int i=0; i<m_nThreads; i++)
+		{
+			pthread_join(m_threads[i], 0);
+		}
+		delete[] m_threads;
+	}
+	// Decodes that were never installed; the queue, then the done list
+	if (m_queueTail) m_queueTail->next = m_done;
+	Job *job = m_queueHead ? m_queueHead : m_done;
+	while (job)
+	{
+		Job *next = job->next;
+		if (job->ok) Texture::freeDecoded(job->image);
+		free(job->filename);
+		delete job;
+		job = next;
+	}
+	pthread_cond_destroy(&m_idle);
+	pthread_cond_destroy(&m_wake);
+	pthread_mutex_destroy(&m_lock);
+
+	if (m_entries)
+	{
+		for (int i=0; i<m_nEntries; i++)
+		{
+			if (m_entries[i].texture) delete m_entries[i].texture;
+		}
+		delete[] m_entries;
+	}
+	if (m_placeholder) delete m_placeholder;
+}
+
+bool Manager::init(const int nThreads)
+{
+	m_placeholder = new Texture(gml::vec3_t(0.5f, 0.5f, 0.5f));
+	if ( !m_placeholder->getIsReady() )
+	{
+		fprintf(stderr, "ERROR! Could not create placeholder texture\n");
+		return false;
+	}
+	if ( !m_upload.init(UPLOAD_RING_SIZE) )
+	{
+		// Not fatal; uploads are just synchronous
+		fprintf(stderr, "Could not create texture upload buffer\n");
+	}
+
+	if (nThreads > 0)
+	{
+		m_threads = new pthread_t[nThreads];
+		for (m_nThreads=0; m_nThreads<nThreads; m_nThreads++)
+		{
+			if ( pthread_create(&m_threads[m_nThreads], 0, workerMain, this) != 0 )
+			{
+				// Make do with the threads that did start; with none,
+				// acquire() decodes
+				fprintf(stderr, "Could only start %d of %d texture threads\n", m_nThreads, nThreads);
+				break;
+			}
+		}
+	}
+	return true;
+}
+
+void* Manager::workerMain(void *manager)
+{
+	Manager *self = (Manager*)manager;
+
+	pthread_mutex_lock(&self->m_lock);
+	while (true)
+	{
+		while ( !self->m_quit && !self->m_queueHead )
+		{
+			pthread_cond_wait(&self->m_wake, &self->m_lock);
+		}
+		if (self->m_quit) break;
+
+		Job *job = self->m_queueHead;
+		self->m_queueHead = job->next;
+		if ( !self->m_queueHead ) self->m_queueTail = 0;
+
+		pthread_mutex_unlock(&self->m_lock);
+		job->ok = Texture::decode(job->filename, job->image);
+		pthread_mutex_lock(&self->m_lock);
+
+		job->next = self->m_done;
+		self->m_done = job;
+		self->m_nPending -= 1;
+		pthread_cond_broadcast(&self->m_idle);
+	}
+	pthread_mutex_unlock(&self->m_lock);
+	return 0;
+}
+
+Texture* Manager::acquire(const char *filename,
+		FilterType minFilter, FilterType magFilter, WrapMode wrap)
+{
+	int freeEntry = -1;
+	for (int i=0; i<m_nEntries; i++)
+	{
+		const Texture *tex = m_entries[i].texture;
+		if ( !tex )
+		{
+			if (freeEntry < 0) freeEntry = i;
+			continue;
+		}
+		if ( tex->getMinFilter() == minFilter && tex->getMagFilter() == magFilter &&
+				tex->getWrapMode() == wrap && strcmp(tex->getFilename(), filename) == 0 )
+		{
+			m_entries[i].refs += 1;
+			return m_entries[i].texture;
+		}
+	}
+
+	if (freeEntry < 0)
+	{
+		if (m_nEntries == m_maxEntries)
+		{
+			const int newMax = (m_maxEntries > 0) ? 2*m_maxEntries : 8;
+			Entry *entries = new Entry[newMax];
+			if (m_entries)
+			{
+				memcpy(entries, m_entries, sizeof(Entry)*m_nEntries);
+				delete[] m_entries;
+			}
+			m_entries = entries;
+			m_maxEntries = newMax;
+		}
+		freeEntry = m_nEntries++;
+	}
+
+	Entry &entry = m_entries[freeEntry];
+	entry.texture = new Texture(filename, minFilter, magFilter, wrap, false);
+	entry.texture->setPlaceholder(m_placeholder);
+	entry.refs = 1;
+	entry.state = UNLOADED;
+	entry.cpuUsed = entry.gpuUsed = m_frame;
+	queueDecode(freeEntry);
+	return entry.texture;
+}
+
+void Manager::release(const Texture *texture)
+{
+	for (int i=0; i<m_nEntries; i++)
+	{
+		if (m_entries[i].texture == texture)
+		{
+			// Stays cached; evict() frees it
+			m_entries[i].refs -= 1;
+			return;
+		}
+	}
+}
+
+void Manager::setBudget(const size_t cpuBytes, const size_t gpuBytes)
+{
+	m_cpuBudget = cpuBytes;
+	m_gpuBudget = gpuBytes;
+}
+
+void Manager::queueDecode(const int entry)
+{
+	Entry &e = m_entries[entry];
+	if (m_nThreads == 0)
+	{
+		DecodedImage image;
+		if ( Texture::decode(e.texture->getFilename(), image) )
+		{
+			e.texture->install(image, &m_upload);
+			e.state = LOADED;
+		}
+		else
+		{
+			fprintf(stderr, "ERROR! Could not load texture %s\n", e.texture->getFilename());
+			e.state = FAILED;
+		}
+		return;
+	}
+
+	Job *job = new Job;
+	job->next = 0;
+	job->entry = entry;
+	job->filename = strdup(e.texture->getFilename());
+	job->ok = false;
+	e.state = LOADING;
+
+	pthread_mutex_lock(&m_lock);
+	if (m_queueTail) m_queueTail->next = job;
+	else m_queueHead = job;
+	m_queueTail = job;
+	m_nPending += 1;
+	pthread_cond_signal(&m_wake);
+	pthread_mutex_unlock(&m_lock);
+}
+
+void Manager::installDecoded()
+{
+	pthread_mutex_lock(&m_lock);
+	Job *job = m_done;
+	m_done = 0;
+	pthread_mutex_unlock(&m_lock);
+
+	while (job)
+	{
+		Job *next = job->next;
+		Entry &e = m_entries[job->entry];
+		if (job->ok)
+		{
+			e.texture->install(job->image, &m_upload);
+			e.state = LOADED;
+			e.cpuUsed = e.gpuUsed = m_frame;
+		}
+		else
+		{
+			fprintf(stderr, "ERROR! Could not load texture %s\n", job->filename);
+			e.state = FAILED;
+		}
+		free(job->filename);
+		delete job;
+		job = next;
+	}
+}
+
+void Manager::update()
+{
+	m_frame += 1;
+	installDecoded();
+
+	for (int i=0; i<m_nEntries; i++)
+	{
+		Entry &e = m_entries[i];
+		if ( !e.texture ) continue;
+
+		const int used = e.texture->getUsed();
+		e.texture->clearUsed();
+		if (used & USED_CPU) e.cpuUsed = m_frame;
+		if (used & USED_GL) e.gpuUsed = m_frame;
+
+		// A copy that was evicted is needed again
+		if ( e.state == LOADED &&
+				( ((used & USED_CPU) && !e.texture->hasTexels()) ||
+				  ((used & USED_GL) && !e.texture->getIsReady()) ) )
+		{
+			queueDecode(i);
+		}
+	}
+
+	evict();
+}
+
+void Manager::finish()
+{
+	pthread_mutex_lock(&m_lock);
+	while (m_nPending > 0)
+	{
+		pthread_cond_wait(&m_idle, &m_lock);
+	}
+	pthread_mutex_unlock(&m_lock);
+	installDecoded();
+}
+
+void Manager::evict()
+{
+	// Copies used in the last frame are never evicted; they would only
+	// be decoded again.
+	size_t cpuBytes = getCPUBytes();
+	while (m_cpuBudget > 0 && cpuBytes > m_cpuBudget)
+	{
+		int lru = -1;
+		for (int i=0; i<m_nEntries; i++)
+		{
+			const Entry &e = m_entries[i];
+			if ( !e.texture || !e.texture->hasTexels() || e.cpuUsed == m_frame ) continue;
+			if (lru < 0 || e.cpuUsed < m_entries[lru].cpuUsed) lru = i;
+		}
+		if (lru < 0) break;
+		cpuBytes -= m_entries[lru].texture->getCPUBytes();
+		m_entries[lru].texture->evictCPU();
+	}
+
+	size_t gpuBytes = getGPUBytes();
+	while (m_gpuBudget > 0 && gpuBytes > m_gpuBudget)
+	{
+		int lru = -1;
+		for (int i=0; i<m_nEntries; i++)
+		{
+			const Entry &e = m_entries[i];
+			if ( !e.texture || !e.texture->getIsReady() || e.gpuUsed == m_frame ) continue;
+			if (lru < 0 || e.gpuUsed < m_entries[lru].gpuUsed) lru = i;
+		}
+		if (lru < 0) break;
+		gpuBytes -= m_entries[lru].texture->getGPUBytes();
+		m_entries[lru].texture->evictGL();
+	}
+
+	// Textures that nobody holds, with nothing left to cache
+	for (int i=0; i<m_nEntries; i++)
+	{
+		Entry &e = m_entries[i];
+		if ( !e.texture || e.refs > 0 || e.state == LOADING ) continue;
+		if ( e.state == FAILED || (!e.texture->hasTexels() && !e.texture->getIsReady()) )
+		{
+			delete e.texture;
+			e.texture = 0;
+		}
+	}
+}
+
+size_t Manager::getCPUBytes() const
+{
+	size_t bytes = 0;
+	for (int i=0; i<m_nEntries; i++)
+	{
+		if (m_entries[i].texture) bytes += m_entries[i].texture->getCPUBytes();
+	}
+	return bytes;
+}
+
+size_t Manager::getGPUBytes() const
+{
+	size_t bytes = 0;
+	for (int i=0; i<m_nEntries; i++)
+	{
+		if (m_entries[i].texture) bytes += m_entries[i].texture->getGPUBytes();
+	}
+	return bytes;
+}
+
+}
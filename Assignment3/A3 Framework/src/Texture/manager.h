@@ -0,0 +1,137 @@
+
+/*
+ * Copyright:
+ * Daniel D. Neilson (ddneilson@ieee.org)
+ * University of Saskatchewan
+ * All rights reserved
+ *
+ * Permission granted to use for use in assignments and
+ * projects for CMPT 485 & CMPT 829 at the University
+ * of Saskatchewan.
+ */
+
+/*
+ * Definition of a Manager for textures.
+ *
+ * Textures are shared: asking for the same file, with the same filters
+ * and wrap mode, twice gives the same Texture. Each acquire() should be
+ * paired with a release().
+ *
+ * Image files are read & decoded by a small pool of worker threads. The
+ * GL copy is made on the GL thread, in update(), once the decode is
+ * done; until then the texture binds, and looks up, a 1x1 gray
+ * placeholder. Uploads are staged in an UploadRing, so update() does
+ * not wait for the GL to copy the images.
+ *
+ * The CPU (ray tracer) and GL copies of the textures are kept under a
+ * memory budget each. Over budget, update() frees the copies that were
+ * used least recently; a texture whose copy was freed is decoded again
+ * the next time that it is used. Textures that are no longer acquired
+ * stay cached until the budget pushes them out.
+ */
+
+#pragma once
+#ifndef __INC_TEXTURE_MANAGER_H_
+#define __INC_TEXTURE_MANAGER_H_
+
+#include <pthread.h>
+#include <stddef.h>
+#include "texture.h"
+#include "../Streaming/uploadring.h"
+
+namespace Texture
+{
+
+class Manager
+{
+protected:
+	typedef enum
+	{
+		UNLOADED,
+		LOADING, // A decode is queued, or running
+		LOADED,
+		FAILED   // The file could not be read
+	} EntryState;
+
+	typedef struct
+	{
+		Texture *texture; // 0 => the entry is free
+		int refs;
+		EntryState state;
+		// Frame that the CPU & GL copies were last used in
+		unsigned int cpuUsed, gpuUsed;
+	} Entry;
+	Entry *m_entries;
+	int m_nEntries; // Entries in use, or free, in m_entries
+	int m_maxEntries; // Allocated size of m_entries
+
+	// A file for the workers to decode
+	typedef struct _Job
+	{
+		struct _Job *next;
+		int entry; // Index in m_entries
+		char *filename;
+		bool ok;
+		DecodedImage image;
+	} Job;
+
+	pthread_t *m_threads;
+	int m_nThreads;
+	// Guards the job lists, m_nPending & m_quit
+	pthread_mutex_t m_lock;
+	pthread_cond_t m_wake; // Signalled when a job is queued, or to quit
+	pthread_cond_t m_idle; // Signalled when a job is done
+	Job *m_queueHead, *m_queueTail; // Waiting to be decoded
+	Job *m_done; // Decoded; waiting for the GL thread
+	int m_nPending; // Jobs queued or decoding
+	bool m_quit;
+
+	Texture *m_placeholder;
+	// Stages the uploads of decoded images
+	UploadRing m_upload;
+
+	size_t m_cpuBudget, m_gpuBudget;
+	unsigned int m_frame;
+
+	static void* workerMain(void *manager);
+	// Start decoding the entry's file
+	void queueDecode(const int entry);
+	// Install the textures that the workers have finished decoding
+	void installDecoded();
+	// Free the least recently used copies until under budget
+	void evict();
+public:
+	Manager();
+	~Manager();
+
+	// Must be called, from the GL thread, before trying to use.
+	//  nThreads = number of decoding threads; 0 decodes in acquire().
+	// Return true iff successfully initialized
+	bool init(const int nThreads = 2);
+
+	// The texture for the given file & parameters; shared with everyone
+	// who asked for the same. It may not be loaded yet.
+	Texture* acquire(const char *filename,
+			FilterType minFilter=LINEAR_MIPMAP_LINEAR,
+			FilterType magFilter=LINEAR,
+			WrapMode wrap=REPEAT);
+	// Done with a texture from acquire()
+	void release(const Texture *texture);
+
+	// Most bytes of CPU & GL texture memory to keep; 0 => no limit
+	void setBudget(const size_t cpuBytes, const size_t gpuBytes);
+
+	// Call once per frame, from the GL thread: uploads the textures that
+	// have been decoded, and evicts over budget.
+	void update();
+	// Wait for every decode that has been started, and install them
+	void finish();
+
+	// Memory used by every texture's CPU & GL copies, in bytes
+	size_t getCPUBytes() const;
+	size_t getGPUBytes() const;
+};
+
+}
+
+#endif
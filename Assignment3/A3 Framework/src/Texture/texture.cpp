@@ -12,18 +12,31 @@
 
 #include <cstring>
 #include <cstdlib>
+#include <cmath>
+#include <stdint.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__F16C__)
+#include <immintrin.h>
+#endif
 
 #include "texture.h"
 #include "../GL3/gl3w.h"
 #include "Decoders/png.h"
 #include "../glUtils.h"
+#include "../GML/fastmath.h"
+#include "../Streaming/uploadring.h"
 
 namespace Texture
 {
 
+// With the texel storage, below
+static void buildMipLevels(const gml::vec3_t *image, DecodedImage &img);
+
 Texture::Texture(const char *filename,
 		FilterType minFilter, FilterType magFilter,
-		WrapMode wrap)
+		WrapMode wrap, const bool load)
 {
 
 	m_filename = strdup(filename);
@@ -32,16 +45,77 @@ Texture::Texture(const char *filename,
 
 	m_wrapMode = wrap;
 
-	m_image = 0;
+	m_nLevels = 0;
 	m_handle = 0;
+	m_width = m_height = 0;
+	m_nChannels = m_bitDepth = 0;
+	m_rowBytes = 0;
+	m_format = TEXELS_RGBA8;
+
+	m_isReady = false;
+	m_placeholder = 0;
+	m_used = 0;
+
+	if ( !load )
+	{
+		return;
+	}
+
+	DecodedImage img;
+	if ( decode(filename, img) )
+	{
+		install(img);
+	}
+}
+
+Texture::Texture(const gml::vec3_t &color)
+{
+	m_filename = 0;
+	m_minFilter = LINEAR;
+	m_magFilter = NEAREST;
+	m_wrapMode = REPEAT;
 
+	m_nLevels = 0;
+	m_handle = 0;
 	m_isReady = false;
+	m_placeholder = 0;
+	m_used = 0;
+
+	// One RGB8 texel; rows are 4-byte aligned
+	DecodedImage img;
+	img.width = img.height = 1;
+	img.nChannels = 3;
+	img.bitDepth = 8;
+	img.rowBytes = 4;
+	uint8_t *px = (uint8_t*)malloc(img.rowBytes);
+	px[0] = (uint8_t)(color.x * 255.0f + 0.5f);
+	px[1] = (uint8_t)(color.y * 255.0f + 0.5f);
+	px[2] = (uint8_t)(color.z * 255.0f + 0.5f);
+	px[3] = 0;
+	img.image = px;
+	img.format = TEXELS_RGBA8;
+	buildMipLevels(&color, img);
+
+	install(img);
+}
+
+Texture::~Texture()
+{
+	if (m_filename) free((char*)m_filename);
+	evictCPU();
+	evictGL();
+}
+
+bool Texture::decode(const char *filename, DecodedImage &out)
+{
+	out.image = 0;
+	out.nLevels = 0;
 
 	// Try to read in the image file
 	FILE *infile = fopen(filename, "r");
 	if (!infile)
 	{
-		return;
+		return false;
 	}
 
 	Image::PNGDecoder decoder;
@@ -49,28 +123,138 @@ Texture::Texture(const char *filename,
 	{
 		fprintf(stderr, "ERROR! Texture file not a png\n");
 		fclose(infile);
-		return;
+		return false;
 	}
 
-	void *image = decoder.decode(infile, m_width, m_height, m_nChannels, m_bitDepth, m_rowBytes);
+	void *image = decoder.decode(infile, out.width, out.height, out.nChannels, out.bitDepth, out.rowBytes);
+	fclose(infile);
 
 	if ( !image )
 	{
-		return;
+		return false;
 	}
+	out.image = image;
+
+	const int width = out.width, height = out.height;
+	const int rowBytes = out.rowBytes;
+	gml::vec3_t *pixels = new gml::vec3_t[width * height];
+	if (out.nChannels == 1)
+	{
+		if (out.bitDepth == 8)
+		{
+			for (int r=0; r<height; r++)
+			{
+				uint8_t *px = (uint8_t*)((uint8_t*)image + r*rowBytes);
+				for (int c=0; c<width; c++, px++)
+				{
+					float red = (*px) / 255.0f;
+					pixels[r*width + c] = gml::vec3_t(red, red, red);
+				}
+			}
+		}
+		else // 16-bit
+		{
+			for (int r=0; r<height; r++)
+			{
+				uint16_t *px = (uint16_t*)((uint8_t*)image + r*rowBytes);
+				for (int c=0; c<width; c++, px++)
+				{
+					float red = (*px) / 65535.0f;
+					pixels[r*width + c] = gml::vec3_t(red, red, red);
+				}
+			}
+		}
+	}
+	else // 3 channels
+	{
+		if (out.bitDepth == 8)
+		{
+			for (int r=0; r<height; r++)
+			{
+				uint8_t *px = (uint8_t*)((uint8_t*)image + r*rowBytes);
+				for (int c=0; c<width; c++, px+=3)
+				{
+					float red = (*px) / 255.0f;
+					float g = (*(px+1)) / 255.0f;
+					float b = (*(px+2)) / 255.0f;
+					pixels[r*width + c] = gml::vec3_t(red, g, b);
+				}
+			}
+		}
+		else // 16-bit
+		{
+			for (int r=0; r<height; r++)
+			{
+				uint16_t *px = (uint16_t*)((uint8_t*)image + r*rowBytes);
+				for (int c=0; c<width; c++, px+=3)
+				{
+					float red = (*px) / 65535.0f;
+					float g = (*(px+1)) / 65535.0f;
+					float b = (*(px+2)) / 65535.0f;
+					pixels[r*width + c] = gml::vec3_t(red, g, b);
+				}
+			}
+		}
+
+	}
+
+	out.format = (out.bitDepth == 8) ? TEXELS_RGBA8 : TEXELS_RGBA16F;
+	buildMipLevels(pixels, out);
+	delete[] pixels;
+	return true;
+}
+
+void Texture::freeDecoded(DecodedImage &img)
+{
+	if (img.image) free(img.image);
+	img.image = 0;
+	for (int l=0; l<img.nLevels; l++)
+	{
+		delete[] (uint8_t*)img.levels[l].texels;
+	}
+	img.nLevels = 0;
+}
+
+void Texture::install(DecodedImage &img, UploadRing *ring)
+{
+	m_width = img.width;
+	m_height = img.height;
+	m_nChannels = img.nChannels;
+	m_bitDepth = img.bitDepth;
+	m_rowBytes = img.rowBytes;
+
+	// Take the mip levels, if there isn't a CPU copy already
+	if (m_nLevels == 0)
+	{
+		m_format = img.format;
+		memcpy(m_levels, img.levels, sizeof(MipLevel)*img.nLevels);
+		m_nLevels = img.nLevels;
+		img.nLevels = 0;
+	}
+	if ( !m_isReady )
+	{
+		upload(img, ring);
+	}
+	freeDecoded(img);
+}
+
+bool Texture::upload(const DecodedImage &img, UploadRing *ring)
+{
+	const char *name = m_filename ? m_filename : "(color)";
 
 	// Upload the texture to the GL context
 	glGenTextures(1, &m_handle);
 	if ( isGLError() || (0==m_handle) )
 	{
-		return;
+		m_handle = 0;
+		return false;
 	}
 	glBindTexture(GL_TEXTURE_2D, m_handle);
 
 	if ( isGLError() )
 	{
 		fprintf(stderr, "ERROR!! 1\n");
-		return;
+		return false;
 	}
 
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, m_wrapMode);
@@ -79,7 +263,7 @@ Texture::Texture(const char *filename,
 	if ( isGLError() )
 	{
 		fprintf(stderr, "ERROR!! 1\n");
-		return;
+		return false;
 	}
 
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, m_minFilter);
@@ -88,7 +272,7 @@ Texture::Texture(const char *filename,
 	if ( isGLError() )
 	{
 		fprintf(stderr, "ERROR!! 1\n");
-		return;
+		return false;
 	}
 
 	// Each row of image data is 4-byte aligned.
@@ -97,116 +281,374 @@ Texture::Texture(const char *filename,
 	if ( isGLError() )
 	{
 		fprintf(stderr, "ERROR!! 1\n");
-		return;
+		return false;
 	}
 
 	//fprintf(stderr, "Channels = %u\nwidth = %u\nheight = %u\nbitdepth = %u\n", m_nChannels, m_width, m_height, m_bitDepth);
 
+	// Staged in the ring, glTexImage2D only queues the copy. An image
+	// bigger than the ring is copied from img.
+	const size_t bytes = (size_t)img.height * img.rowBytes;
+	const GLvoid *pixels = img.image;
+	GLintptr offset = 0;
+	void *staged = ring ? ring->beginUpload(bytes, offset) : 0;
+	if (staged)
+	{
+		memcpy(staged, img.image, bytes);
+		ring->unmap();
+		// Source is the bound unpack buffer, at offset
+		pixels = (const GLvoid*)offset;
+	}
+
 	glTexImage2D(GL_TEXTURE_2D, 0,
-			(m_nChannels==1)?GL_RED:GL_RGB8,
-					m_width, m_height, 0,
-					(m_nChannels==1)?GL_RED:GL_RGB,
-							(m_bitDepth==8)?GL_UNSIGNED_BYTE:GL_UNSIGNED_SHORT,
-									image);
+			(img.nChannels==1)?GL_RED:GL_RGB8,
+					img.width, img.height, 0,
+					(img.nChannels==1)?GL_RED:GL_RGB,
+							(img.bitDepth==8)?GL_UNSIGNED_BYTE:GL_UNSIGNED_SHORT,
+									pixels);
+	if (staged)
+	{
+		ring->endUpload();
+	}
 
 	if ( isGLError() )
 	{
 		fprintf(stderr, "ERROR!! 1\n");
-		return;
+		return false;
 	}
 
-	m_isReady = glIsTexture(m_handle) == GL_TRUE;
-
-	m_image = new gml::vec3_t[m_width * m_height];
-	if (m_nChannels == 1)
+	if (m_minFilter == LINEAR_MIPMAP_LINEAR)
 	{
-		if (m_bitDepth == 8)
+		glGenerateMipmap(GL_TEXTURE_2D);
+		if ( isGLError() )
 		{
-			for (int r=0; r<m_height; r++)
-			{
-				uint8_t *px = (uint8_t*)((uint8_t*)image + r*m_rowBytes);
-				for (int c=0; c<m_width; c++, px++)
-				{
-					float red = (*px) / 255.0f;
-					m_image[r*m_width + c] = gml::vec3_t(red, red, red);
-				}
-			}
-		}
-		else // 16-bit
-		{
-			for (int r=0; r<m_height; r++)
-			{
-				uint16_t *px = (uint16_t*)((uint8_t*)image + r*m_rowBytes);
-				for (int c=0; c<m_width; c++, px++)
-				{
-					float red = (*px) / 65535.0f;
-					m_image[r*m_width + c] = gml::vec3_t(red, red, red);
-				}
-			}
+			fprintf(stderr, "ERROR! Could not generate mipmaps for %s\n", name);
+			return false;
 		}
 	}
-	else // 3 channels
-	{
-		if (m_bitDepth == 8)
-		{
-			for (int r=0; r<m_height; r++)
-			{
-				uint8_t *px = (uint8_t*)((uint8_t*)image + r*m_rowBytes);
-				for (int c=0; c<m_width; c++, px+=3)
-				{
-					float red = (*px) / 255.0f;
-					float g = (*(px+1)) / 255.0f;
-					float b = (*(px+2)) / 255.0f;
-					m_image[r*m_width + c] = gml::vec3_t(red, g, b);
-				}
-			}
-		}
-		else // 16-bit
-		{
-			for (int r=0; r<m_height; r++)
-			{
-				uint16_t *px = (uint16_t*)((uint8_t*)image + r*m_rowBytes);
-				for (int c=0; c<m_width; c++, px+=3)
-				{
-					float red = (*px) / 65535.0f;
-					float g = (*(px+1)) / 65535.0f;
-					float b = (*(px+2)) / 65535.0f;
-					m_image[r*m_width + c] = gml::vec3_t(red, g, b);
-				}
-			}
-		}
 
-	}
+	m_isReady = glIsTexture(m_handle) == GL_TRUE;
+	return m_isReady;
+}
 
-	free(image);
+void Texture::evictCPU()
+{
+	for (int l=0; l<m_nLevels; l++)
+	{
+		delete[] (uint8_t*)m_levels[l].texels;
+	}
+	m_nLevels = 0;
 }
 
-Texture::~Texture()
+void Texture::evictGL()
 {
-	if (m_filename) free((char*)m_filename);
-	if (m_image) delete[] m_image;
 	if (m_handle)
 	{
 		glDeleteTextures(1, &m_handle);
 	}
+	m_handle = 0;
+	m_isReady = false;
+}
+
+size_t Texture::getCPUBytes() const
+{
+	const size_t texelBytes = (m_format == TEXELS_RGBA8) ? 4 : 8;
+	size_t bytes = 0;
+	for (int l=0; l<m_nLevels; l++)
+	{
+		bytes += 16 * m_levels[l].tilesX * ((m_levels[l].height + 3) / 4) * texelBytes;
+	}
+	return bytes;
+}
+
+size_t Texture::getGPUBytes() const
+{
+	if ( !m_isReady ) return 0;
+	// As the GL is likely to store the internal format; RGB8 padded to 4
+	// bytes. A full mip chain adds a third.
+	size_t bytes = (size_t)m_width * m_height * ((m_nChannels==1) ? 1 : 4);
+	if (m_minFilter == LINEAR_MIPMAP_LINEAR) bytes += bytes / 3;
+	return bytes;
 }
 
 
 void Texture::bindGL(GLenum textureUnit) const
 {
+	m_used |= USED_GL;
 	if (m_isReady)
 	{
 		glActiveTexture(textureUnit);
 		glBindTexture(GL_TEXTURE_2D, m_handle);
 	}
+	else if (m_placeholder)
+	{
+		m_placeholder->bindGL(textureUnit);
+	}
+}
+
+
+// -----------------------------------------
+// Texel storage
+// -----------------------------------------
+
+// Index of texel (x,y) of a level; see MipLevel
+static inline int texelIndex(const MipLevel &level, const int x, const int y)
+{
+	const int tile = (y >> 2)*level.tilesX + (x >> 2);
+	// Interleave the bits of x & y within the tile
+	const int morton = (x & 1) | ((y & 1) << 1) | ((x & 2) << 1) | ((y & 2) << 2);
+	return (tile << 4) | morton;
+}
+
+static inline int32_t floatBits(const float f)
+{
+	union { float f; int32_t i; } u;
+	u.f = f;
+	return u.i;
+}
+static inline float bitsFloat(const int32_t i)
+{
+	union { float f; int32_t i; } u;
+	u.i = i;
+	return u.f;
+}
+
+// Float to half float, rounded to nearest even. f in [0, 65504]
+static uint16_t toHalf(const float f)
+{
+	int32_t b = floatBits(f);
+	if (b < 0x38800000) // Denormal, or 0; the addition rounds the mantissa
+	{
+		return (uint16_t)(floatBits(f + 0.5f) - 0x3f000000);
+	}
+	const int32_t mantOdd = (b >> 13) & 1;
+	// Rebias the exponent from 127 to 15
+	b += -(112 << 23) + 0xfff + mantOdd;
+	return (uint16_t)(b >> 13);
+}
+
+#if defined(__SSE2__)
+// A texel, as floats (r,g,b,a) in one register
+typedef __m128 rgba_t;
+
+// 4 half floats, in the low 16 bits of each 32-bit lane, to floats.
+//  No infinities or NaNs; textures have none.
+static inline __m128 halfToFloat(const __m128i h)
+{
+	const __m128i expMant = _mm_and_si128(h, _mm_set1_epi32(0x7fff));
+	const __m128i sign = _mm_slli_epi32(_mm_xor_si128(h, expMant), 16);
+	// Rebias the exponent by multiplying by 2^112; denormals come out right
+	const __m128 scaled = _mm_mul_ps( _mm_castsi128_ps(_mm_slli_epi32(expMant, 13)), _mm_set1_ps(5.192296858534828e33f) );
+	return _mm_or_ps( scaled, _mm_castsi128_ps(sign) );
+}
+
+static inline rgba_t fetch(const MipLevel &level, const TexelFormat format, const int i)
+{
+	if (format == TEXELS_RGBA8)
+	{
+		const __m128i t = _mm_cvtsi32_si128( ((const int32_t*)level.texels)[i] );
+		const __m128i zero = _mm_setzero_si128();
+		return _mm_mul_ps( _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(t, zero), zero)),
+				_mm_set1_ps(1.0f / 255.0f) );
+	}
+	const __m128i h = _mm_loadl_epi64( (const __m128i*)((const uint16_t*)level.texels + 4*i) );
+#if defined(__F16C__)
+	return _mm_cvtph_ps(h);
+#else
+	return halfToFloat( _mm_unpacklo_epi16(h, _mm_setzero_si128()) );
+#endif
+}
+
+// The 2x2 texels i00, i10, i01 & i11, weighted by w00 .. w11
+static inline rgba_t blend4(const MipLevel &level, const TexelFormat format,
+		const int i00, const int i10, const int i01, const int i11,
+		const float w00, const float w10, const float w01, const float w11)
+{
+	if (format == TEXELS_RGBA8)
+	{
+		// All four texels in one register; the 1/255 is in the weights
+		const int32_t *p = (const int32_t*)level.texels;
+		const __m128i t = _mm_setr_epi32(p[i00], p[i10], p[i01], p[i11]);
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i lo = _mm_unpacklo_epi8(t, zero), hi = _mm_unpackhi_epi8(t, zero);
+		const float s = 1.0f / 255.0f;
+		return _mm_add_ps(
+				_mm_add_ps( _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)), _mm_set1_ps(s*w00)),
+						_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)), _mm_set1_ps(s*w10)) ),
+				_mm_add_ps( _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)), _mm_set1_ps(s*w01)),
+						_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)), _mm_set1_ps(s*w11)) ) );
+	}
+	return _mm_add_ps(
+			_mm_add_ps( _mm_mul_ps(fetch(level, format, i00), _mm_set1_ps(w00)),
+					_mm_mul_ps(fetch(level, format, i10), _mm_set1_ps(w10)) ),
+			_mm_add_ps( _mm_mul_ps(fetch(level, format, i01), _mm_set1_ps(w01)),
+					_mm_mul_ps(fetch(level, format, i11), _mm_set1_ps(w11)) ) );
+}
+
+// (1-f) a + f b
+static inline rgba_t lerp(const rgba_t a, const rgba_t b, const float f)
+{
+	return _mm_add_ps( a, _mm_mul_ps(_mm_sub_ps(b, a), _mm_set1_ps(f)) );
+}
+
+static inline gml::vec3_t toVec3(const rgba_t c)
+{
+	float f[4];
+	_mm_storeu_ps(f, c);
+	return gml::vec3_t(f[0], f[1], f[2]);
+}
+#else
+typedef gml::vec4_t rgba_t;
+
+static inline float halfToFloat(const uint16_t h)
+{
+	const int32_t expMant = h & 0x7fff;
+	return copysignf( bitsFloat(expMant << 13) * 5.192296858534828e33f, (h & 0x8000) ? -1.0f : 1.0f );
+}
+
+static inline rgba_t fetch(const MipLevel &level, const TexelFormat format, const int i)
+{
+	if (format == TEXELS_RGBA8)
+	{
+		const uint8_t *p = (const uint8_t*)level.texels + 4*i;
+		return gml::scale( 1.0f / 255.0f, gml::vec4_t(p[0], p[1], p[2], p[3]) );
+	}
+	const uint16_t *p = (const uint16_t*)level.texels + 4*i;
+	return gml::vec4_t( halfToFloat(p[0]), halfToFloat(p[1]), halfToFloat(p[2]), halfToFloat(p[3]) );
+}
+
+static inline rgba_t blend4(const MipLevel &level, const TexelFormat format,
+		const int i00, const int i10, const int i01, const int i11,
+		const float w00, const float w10, const float w01, const float w11)
+{
+	return w00*fetch(level, format, i00) + w10*fetch(level, format, i10)
+			+ w01*fetch(level, format, i01) + w11*fetch(level, format, i11);
+}
+
+static inline rgba_t lerp(const rgba_t a, const rgba_t b, const float f)
+{
+	return a + f*(b - a);
+}
+
+static inline gml::vec3_t toVec3(const rgba_t c)
+{
+	return gml::extract3(c);
+}
+#endif
+
+// Bi-linear filtered value of the level at (wrapped) coords
+static inline rgba_t bilinear(const MipLevel &level, const TexelFormat format, const gml::vec2_t coords)
+{
+	const float x = coords.s * (level.width - 1);
+	const float y = coords.t * (level.height - 1);
+
+	// x, y >= 0, so the conversion is floor(). The high texel only has
+	// a weight of 0 at the last column & row.
+	const int low_x = (int)x, low_y = (int)y;
+	const int high_x = (low_x < level.width - 1) ? low_x + 1 : low_x;
+	const int high_y = (low_y < level.height - 1) ? low_y + 1 : low_y;
+	const float res_x = x - low_x, res_y = y - low_y;
+
+	return blend4(level, format,
+			texelIndex(level, low_x, low_y), texelIndex(level, high_x, low_y),
+			texelIndex(level, low_x, high_y), texelIndex(level, high_x, high_y),
+			(1.0f-res_x)*(1.0f-res_y), res_x*(1.0f-res_y), (1.0f-res_x)*res_y, res_x*res_y);
+}
+
+// Store a width x height image as the level, in format
+static void encodeLevel(const gml::vec3_t *image, const int width, const int height,
+		const TexelFormat format, MipLevel &level)
+{
+	level.width = width;
+	level.height = height;
+	level.tilesX = (width + 3) / 4;
+	const int nTexels = 16 * level.tilesX * ((height + 3) / 4);
+	const int texelBytes = (format == TEXELS_RGBA8) ? 4 : 8;
+	uint8_t *texels = new uint8_t[nTexels * texelBytes];
+	// Clear the padding of partial tiles; it is never read
+	memset(texels, 0x00, nTexels * texelBytes);
+	level.texels = texels;
+
+	for (int r=0; r<height; r++)
+	{
+		for (int c=0; c<width; c++)
+		{
+			const gml::vec3_t &px = image[r*width + c];
+			const int i = texelIndex(level, c, r);
+			if (format == TEXELS_RGBA8)
+			{
+				uint8_t *t = texels + 4*i;
+				t[0] = (uint8_t)(px.x * 255.0f + 0.5f);
+				t[1] = (uint8_t)(px.y * 255.0f + 0.5f);
+				t[2] = (uint8_t)(px.z * 255.0f + 0.5f);
+				t[3] = 255;
+			}
+			else
+			{
+				uint16_t *t = (uint16_t*)texels + 4*i;
+				t[0] = toHalf(px.x);
+				t[1] = toHalf(px.y);
+				t[2] = toHalf(px.z);
+				t[3] = toHalf(1.0f);
+			}
+		}
+	}
+}
+
+// Build img's mip levels from the img.width * img.height image, in
+// img.format; 2x2 box filtered
+static void buildMipLevels(const gml::vec3_t *image, DecodedImage &img)
+{
+	int width = img.width, height = img.height;
+	encodeLevel(image, width, height, img.format, img.levels[0]);
+	img.nLevels = 1;
+
+	// Each level is filtered from the full precision level before it
+	const gml::vec3_t *src = image;
+	while (width > 1 || height > 1)
+	{
+		const int dstWidth = (width > 1) ? width / 2 : 1;
+		const int dstHeight = (height > 1) ? height / 2 : 1;
+		gml::vec3_t *dst = new gml::vec3_t[dstWidth * dstHeight];
+
+		// Average of the 2x2 source texels; clamped to the edge of a
+		// source level that is one texel wide or high
+		for (int r=0; r<dstHeight; r++)
+		{
+			const gml::vec3_t *row0 = src + (2*r)*width;
+			const gml::vec3_t *row1 = src + ((2*r+1 < height) ? 2*r+1 : 2*r)*width;
+			for (int c=0; c<dstWidth; c++)
+			{
+				const int c0 = 2*c;
+				const int c1 = (c0+1 < width) ? c0+1 : c0;
+				dst[r*dstWidth + c] = 0.25f * (row0[c0] + row0[c1] + row1[c0] + row1[c1]);
+			}
+		}
+		encodeLevel(dst, dstWidth, dstHeight, img.format, img.levels[img.nLevels]);
+		img.nLevels += 1;
+
+		if (src != image) delete[] src;
+		src = dst;
+		width = dstWidth;
+		height = dstHeight;
+	}
+	if (src != image) delete[] src;
 }
 
-gml::vec3_t Texture::lookup(gml::vec2_t coords) const
+gml::vec3_t Texture::lookup(gml::vec2_t coords, const float width) const
 {
+	m_used |= USED_CPU;
+	if (m_nLevels == 0)
+	{
+		// Not loaded (yet), or evicted
+		if (m_placeholder) return m_placeholder->lookup(coords);
+		return gml::vec3_t(0.5f, 0.5f, 0.5f);
+	}
+
 	if (m_wrapMode == REPEAT)
 	{
-		coords.s = copysignf( fmodf(coords.s, 1.0f), 1.0f );
-		coords.t = copysignf( fmodf(coords.t, 1.0f), 1.0f );
+		coords.s = coords.s - floorf(coords.s);
+		coords.t = coords.t - floorf(coords.t);
 	}
 	else // CLAMP mode
 	{
@@ -216,28 +658,33 @@ gml::vec3_t Texture::lookup(gml::vec2_t coords) const
 		else if (coords.t > 1.0f) coords.t = 1.0f;
 	}
 
-	if (m_magFilter == NEAREST)
+	// Level of detail; the level whose texels are width wide
+	float lod = 0.0f;
+	if (m_minFilter == LINEAR_MIPMAP_LINEAR && width > 0.0f)
 	{
-		int row = (int)(coords.t * (m_height - 1) + 0.5f);
-		int col = (int)(coords.s * (m_width - 1) + 0.5f);
-
-		return m_image[row*m_width + col];
+		lod = gml::shading::log2( width * sqrtf((float)m_width * m_height) );
 	}
-	else // LINEAR (aka: bi-linear interpolation)
-	{
-		float x = coords.s * (m_width - 1);
-		float y = coords.t * (m_height - 1);
 
-		int low_x = (int)floorf(x), high_x = (int)ceilf(x);
-		int low_y = (int)floorf(y), high_y = (int)ceilf(y);
-		int res_x = x - floorf(x), res_y = y - floorf(y);
+	if (lod > 0.0f)
+	{
+		// Minified; tri-linear
+		if (lod >= m_nLevels - 1) return toVec3( bilinear(m_levels[m_nLevels - 1], m_format, coords) );
+		const int l = (int)lod;
+		const float f = lod - l;
+		const rgba_t c = bilinear(m_levels[l], m_format, coords);
+		if (f == 0.0f) return toVec3(c);
+		return toVec3( lerp(c, bilinear(m_levels[l+1], m_format, coords), f) );
+	}
 
-		gml::vec3_t c1, c2;
-		c1 = gml::add( gml::scale((1.0f-res_x), m_image[low_y*m_width+low_x]), gml::scale(res_x, m_image[low_y*m_width+high_x]) );
-		c2 = gml::add( gml::scale((1.0f-res_x), m_image[high_y*m_width+low_x]), gml::scale(res_x, m_image[high_y*m_width+high_x]) );
+	if (m_magFilter == NEAREST)
+	{
+		int row = (int)(coords.t * (m_height - 1) + 0.5f);
+		int col = (int)(coords.s * (m_width - 1) + 0.5f);
 
-		return gml::add( gml::scale((1.0f-res_y), c1), gml::scale(res_y, c2) );
+		return toVec3( fetch(m_levels[0], m_format, texelIndex(m_levels[0], col, row)) );
 	}
+	// LINEAR (aka: bi-linear interpolation)
+	return toVec3( bilinear(m_levels[0], m_format, coords) );
 }
 
 }
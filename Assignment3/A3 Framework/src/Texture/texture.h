@@ -14,9 +14,12 @@
 #ifndef __INC_TEXTURE_TEXTURE_H_
 #define __INC_TEXTURE_TEXTURE_H_
 
+#include <stddef.h>
 #include "../GL3/gl3.h"
 #include "../GML/gml.h"
 
+class UploadRing;
+
 namespace Texture
 {
 
@@ -24,9 +27,55 @@ namespace Texture
 typedef enum
 {
 	NEAREST=GL_NEAREST,  // Nearest neighbour
-	LINEAR=GL_LINEAR      // Linear (bi-linear) filtering
+	LINEAR=GL_LINEAR,     // Linear (bi-linear) filtering
+	// Tri-linear filtering: bi-linear in the two nearest mip levels, and
+	// linear between them. Minification filter only.
+	LINEAR_MIPMAP_LINEAR=GL_LINEAR_MIPMAP_LINEAR
 } FilterType;
 
+// Most mip levels a texture can have; enough for 65535 x 65535
+#define MAX_MIP_LEVELS 17
+
+// CPU storage of a texture's texels
+typedef enum
+{
+	TEXELS_RGBA8,  // 4 bytes per texel; for 8-bit images
+	TEXELS_RGBA16F // 8 bytes per texel, half floats; for 16-bit images
+} TexelFormat;
+
+// One level of a texture's mip pyramid, in CPU memory.
+//  Texels are in 4x4 tiles. The tiles are in row-major order, and the
+//  texels of a tile in Morton (Z) order; so the 2x2 texels of a bi-linear
+//  lookup are usually in one 64 or 128 byte tile, rather than two rows.
+typedef struct
+{
+	void *texels;
+	int width, height;
+	int tilesX; // Tiles per row of tiles
+} MipLevel;
+
+// A decoded image file, ready to become a Texture's CPU & GL copies.
+//  Texture::decode() fills it in without the GL, on any thread.
+typedef struct
+{
+	void *image; // The decoder's output, for the GL; rows of rowBytes bytes
+	uint16_t width, height;
+	uint8_t nChannels;
+	uint8_t bitDepth;
+	uint16_t rowBytes;
+
+	TexelFormat format;
+	MipLevel levels[MAX_MIP_LEVELS];
+	int nLevels;
+} DecodedImage;
+
+// What a texture has been used for
+typedef enum
+{
+	USED_GL = 0x1, // bindGL()
+	USED_CPU = 0x2 // lookup()
+} TextureUse;
+
 // Ways to wrap out-of-range texture coordinates
 typedef enum
 {
@@ -34,7 +83,7 @@ typedef enum
 	CLAMP_TO_EDGE = GL_CLAMP_TO_EDGE
 } WrapMode;
 
-// A _very_ simple texture class. Only supports 8-bit per channel
+// A _very_ simple texture class. Only supports 8 & 16-bit per channel
 // images.
 class Texture
 {
@@ -58,24 +107,77 @@ protected:
 	uint8_t m_bitDepth;
 	uint16_t m_rowBytes;
 
-	// Image data
-	//   m_width * m_height array of RGB pixels
-	gml::vec3_t *m_image;
+	// Image data, for the ray tracer, as a mip pyramid. Level 0 is the
+	// m_width * m_height image; each level after it is half the size of
+	// the one before, down to 1x1.
+	TexelFormat m_format;
+	MipLevel m_levels[MAX_MIP_LEVELS];
+	int m_nLevels;
+
+	// Bound, and looked up, in place of this texture while it has no
+	// GL, or CPU, copy
+	const Texture *m_placeholder;
+	// What the texture has been used for since clearUsed(); TextureUse bits
+	mutable int m_used;
+
+	// Create the GL copy from img.image; through ring, if given
+	bool upload(const DecodedImage &img, UploadRing *ring);
 public:
 
+	// load = false leaves the texture empty; see decode() & install()
 	Texture(const char *filename,
-			FilterType minFilter=LINEAR,
+			FilterType minFilter=LINEAR_MIPMAP_LINEAR,
 			FilterType magFilter=LINEAR,
-			WrapMode wrap=REPEAT);
+			WrapMode wrap=REPEAT,
+			const bool load=true);
+	// A 1x1 texture of the given color
+	Texture(const gml::vec3_t &color);
 
 	~Texture();
 
+	// True iff the GL copy exists
 	bool getIsReady() const { return m_isReady; }
+	// True iff the CPU copy, for lookup(), exists
+	bool hasTexels() const { return m_nLevels > 0; }
+
+	const char* getFilename() const { return m_filename; }
+	FilterType getMinFilter() const { return m_minFilter; }
+	FilterType getMagFilter() const { return m_magFilter; }
+	WrapMode getWrapMode() const { return m_wrapMode; }
+
+	// Read & decode the image file, and build the CPU copy of it into out.
+	//  Does not use the GL; safe to call from any thread.
+	//  Returns false if the file could not be read.
+	static bool decode(const char *filename, DecodedImage &out);
+	// Free what is left in img
+	static void freeDecoded(DecodedImage &img);
+	// Take the CPU copy from img, and upload the GL copy, if the texture
+	// does not already have them; then free img. GL thread only.
+	//  ring = where to stage the upload, so that the GL copies the image
+	//  asynchronously; 0 => from img itself.
+	void install(DecodedImage &img, UploadRing *ring=0);
+
+	// Free the CPU, or GL, copy; the placeholder stands in until the
+	// next install()
+	void evictCPU();
+	void evictGL();
+	// Memory used by the CPU & GL copies, in bytes
+	size_t getCPUBytes() const;
+	size_t getGPUBytes() const;
+
+	void setPlaceholder(const Texture *placeholder) { m_placeholder = placeholder; }
+	// What the texture has been used for since clearUsed(); TextureUse bits
+	int getUsed() const { return m_used; }
+	void clearUsed() { m_used = 0; }
 
 	// textureUnit is one of GL_TEXTURE#, where # is 0,1,2,3,...,etc
 	void bindGL(GLenum textureUnit) const;
 
-	gml::vec3_t lookup(gml::vec2_t coords) const;
+	// Filtered texture value at coords.
+	//  width = width of the area to filter over, in texture coordinates;
+	//    ex: a ray cone's footprint. With a mipmapped minification filter
+	//    it picks the two nearest mip levels. 0 = level 0 only.
+	gml::vec3_t lookup(gml::vec2_t coords, const float width=0.0f) const;
 
 };
 
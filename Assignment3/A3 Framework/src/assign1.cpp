@@ -66,6 +66,10 @@ Assignment1::~Assignment1()
 		}
 		delete[] m_geometry;
 	}
+	if (m_texture)
+	{
+		m_textureManager.release(m_texture);
+	}
 }
 
 bool Assignment1::init()
@@ -81,12 +85,13 @@ bool Assignment1::init()
 		return false;
 	}
 
-	m_texture = new Texture::Texture("testPattern.png");
-	if ( !m_texture->getIsReady() )
+	if ( !m_textureManager.init() )
 	{
-		fprintf(stderr, "ERROR! Texture not ready\n");
+		fprintf(stderr, "ERROR! Could not initialize Texture Manager.\n");
 		return false;
 	}
+	// Decoded in the background; a placeholder is drawn until it's ready
+	m_texture = m_textureManager.acquire("testPattern.png");
 
 	m_scene.setLightPos(gml::vec4_t(0.0f,10.0f,10.0f,1.0f));
 
@@ -350,6 +355,9 @@ void Assignment1::repaint()
 	 * This will end up being called after any user event (keypress, etc),
 	 * and pretty much every time through the event loop.
 	 */
+	// Upload the textures that have finished decoding
+	m_textureManager.update();
+
 	if (m_renderWireframe)
 	{
 		// Turn on wireframe rendering
@@ -372,7 +380,7 @@ void Assignment1::repaint()
 		return;
 	}
 
-	m_scene.rasterize(m_camera.getWorldView(), m_camera.getProjection(), false);
+	m_scene.rasterize(m_camera, false);
 
 
 	if (m_sRGBframebuffer)
@@ -23,6 +23,7 @@
 #include "Scene/scene.h"
 #include "Camera/camera.h"
 #include "Texture/texture.h"
+#include "Texture/manager.h"
 #include "UI/ui.h"
 
 class Assignment1 : public UI::Callbacks
@@ -51,6 +52,8 @@ protected:
 	// Whether to render in wireframe or not
 	bool m_renderWireframe;
 
+	// Loads, and shares, the textures
+	Texture::Manager m_textureManager;
 	Texture::Texture *m_texture;
 
 	void toggleCameraMoveDirection(bool enable, int direction);
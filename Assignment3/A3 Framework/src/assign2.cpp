@@ -55,6 +55,8 @@ Assignment2::Assignment2()
 	m_renderWireframe = false;
 
 	m_shadowmapSize = 1024;
+	m_shadowFaceBudget = 0;
+	m_shadowLight = -1;
 
 	m_lastIdleTime = UI::getTime();
 }
@@ -157,11 +159,13 @@ bool Assignment2::init()
 
 	// =============================================================================================
 
-	if ( !m_shadowmap.init(m_shadowmapSize) )
+	// Room for every face of one light at full size, or more lights at less
+	if ( !m_shadowmap.init(4*m_shadowmapSize, 2*m_shadowmapSize, m_shadowmapSize, m_shadowFaceBudget) )
 	{
 		fprintf(stderr, "Failed to initialize shadow mapping members.\n");
 		return false;
 	}
+	m_shadowLight = m_shadowmap.addLight(gml::extract3(m_scene.getLightPos()));
 
 	printf(
 			"Camera movement:\n"
@@ -333,18 +337,19 @@ void Assignment2::rasterizeScene()
 
 	if (isGLError()) return;
 
-	// Bind the shadowmap to texture unit 1
+	// Bind the shadowmap to its texture unit
 	if (m_useShadowMap)
 	{
-		m_shadowmap.bindGL(GL_TEXTURE1);
+		m_shadowmap.bindGL(GL_TEXTURE0 + SHADOWMAP_TEXTURE_UNIT);
 		if (isGLError()) return;
 	}
 
-	m_scene.rasterize(m_camera.getWorldView(), m_camera.getProjection(), m_useShadowMap);
+	m_scene.rasterize(m_camera, m_useShadowMap,
+			m_shadowmap.getLookupMatrices(m_shadowLight));
 
 	if (m_useShadowMap)
 	{
-		m_shadowmap.unbindGL(GL_TEXTURE1);
+		m_shadowmap.unbindGL(GL_TEXTURE0 + SHADOWMAP_TEXTURE_UNIT);
 	}
 	// Put the render state back the way we found it
 	glDisable(GL_CULL_FACE);
@@ -374,7 +379,8 @@ void Assignment2::repaint()
 
 	if (m_useShadowMap)
 	{
-		m_shadowmap.create(m_scene, m_camera.getWorldView());
+		m_shadowmap.setLightPos(m_shadowLight, gml::extract3(m_scene.getLightPos()));
+		m_shadowmap.update(m_scene, m_camera);
 		if ( isGLError() ) return;
 	}
 
@@ -55,8 +55,10 @@ protected:
 	bool m_renderWireframe;
 
 	bool m_useShadowMap;
-	int m_shadowmapSize;
+	int m_shadowmapSize; // Largest tile for a cube face
+	int m_shadowFaceBudget; // Most cube faces to re-render per frame; 0 => no limit
 	ShadowMap m_shadowmap;
+	int m_shadowLight; // Id of the scene's light in the shadow map
 
 	// For animation
 	double m_lastIdleTime; // Time that idle was last called
@@ -42,6 +42,21 @@ static const int CAMERA_SPIN_RIGHT = 0x800;
 
 static const int MAX_RT_PASSES = 500;
 static const int MAX_RAY_DEPTH = 2;
+// Rows of pixels in each batch traced by the wavefront integrator
+static const int WAVEFRONT_ROWS = 16;
+
+// Fold a new sample into a pixel that holds the average of passNum samples
+static inline void accumulateSample(gml::vec3_t &pixel, const gml::vec3_t &clr, const int passNum)
+{
+	if (passNum == 0)
+	{
+		pixel = clr;
+	}
+	else
+	{
+		pixel = gml::scale(1.0f/(passNum+1),	gml::add( gml::scale(passNum,pixel), clr ) );
+	}
+}
 
 Assignment3::Assignment3()
 {
@@ -58,14 +73,26 @@ Assignment3::Assignment3()
 	m_renderWireframe = false;
 
 	m_shadowmapSize = 1024;
+	// Only re-render a few cube faces per frame
+	m_shadowFaceBudget = 3;
+	m_shadowLight = -1;
 	m_useShadowMap = true;
 
+	m_framesInFlight = 2;
+	m_shaderStartTime = 0.0;
+	m_isFirstFrame = true;
+
 	m_lastIdleTime = UI::getTime();
 
+	m_texture = 0;
+
 	m_rtImage = 0;
 	m_isRayTracing = false;
 	m_rtFBO = 0;
 	m_rtTex = 0;
+	m_rtDirtyStart = m_rtDirtyEnd = 0;
+	m_useWavefront = false;
+	m_wfRadiance = 0;
 
 	m_cameraChanged = true;
 }
@@ -85,6 +112,10 @@ Assignment3::~Assignment3()
 	{
 		delete[] m_rtImage;
 	}
+	if (m_wfRadiance)
+	{
+		delete[] m_wfRadiance;
+	}
 	if (m_rtFBO)
 	{
 		glDeleteFramebuffers(1, &m_rtFBO);
@@ -93,6 +124,10 @@ Assignment3::~Assignment3()
 	{
 		glDeleteTextures(1, &m_rtTex);
 	}
+	if (m_texture)
+	{
+		m_textureManager.release(m_texture);
+	}
 }
 
 bool Assignment3::init()
@@ -102,18 +137,23 @@ bool Assignment3::init()
 	 * It should initialize whatever data the assignment requires.
 	 */
 
+	// Shaders are only built for the materials that the scene uses; the
+	// first run compiles them (cold) and later runs load them from the
+	// program cache (warm). The time to the first frame is reported.
+	m_shaderStartTime = UI::getTime();
 	if ( !m_scene.init() )
 	{
 		fprintf(stderr, "Could not initialize scene object\n");
 		return false;
 	}
 
-	m_texture = new Texture::Texture("gray_wall.png");
-	if ( !m_texture->getIsReady() )
+	if ( !m_textureManager.init() )
 	{
-		fprintf(stderr, "ERROR! Texture not ready\n");
+		fprintf(stderr, "ERROR! Could not initialize Texture Manager.\n");
 		return false;
 	}
+	// Decoded in the background; a placeholder is drawn until it's ready
+	m_texture = m_textureManager.acquire("gray_wall.png");
 
 	// Create the geometry.
 	const int SPHERE_LOC = 0;
@@ -217,11 +257,16 @@ bool Assignment3::init()
 
 	// =============================================================================================
 
-	if ( !m_shadowmap.init(m_shadowmapSize) )
+	// Let the GL compile the scene's shaders while we set up everything else
+	m_scene.prewarmShaders();
+
+	// Room for every face of one light at full size, or more lights at less
+	if ( !m_shadowmap.init(4*m_shadowmapSize, 2*m_shadowmapSize, m_shadowmapSize, m_shadowFaceBudget) )
 	{
 		fprintf(stderr, "Failed to initialize shadow mapping members.\n");
 		return false;
 	}
+	m_shadowLight = m_shadowmap.addLight(gml::extract3(m_scene.getLightPos()));
 
 	// Ray tracing inits
 	if (m_rtFBO) glDeleteFramebuffers(1, &m_rtFBO);
@@ -230,6 +275,22 @@ bool Assignment3::init()
 	if (m_rtTex) glDeleteTextures(1, &m_rtTex);
 	glGenTextures(1, &m_rtTex);
 
+	if ( !m_frameSync.init(m_framesInFlight) )
+	{
+		fprintf(stderr, "Failed to initialize frame synchronization.\n");
+		return false;
+	}
+
+	if ( !m_passTimer.init() )
+	{
+		fprintf(stderr, "Failed to initialize pass timers.\n");
+		return false;
+	}
+	m_passShadow = m_passTimer.addPass("shadow");
+	m_passRaster = m_passTimer.addPass("raster");
+	m_passRTUpload = m_passTimer.addPass("rt-upload");
+	m_passRTBlit = m_passTimer.addPass("rt-blit");
+
 	printf(
 			"Camera movement:\n"
 			"  [w] -- Camera forward\n"
@@ -249,6 +310,10 @@ bool Assignment3::init()
 			"  [F1] -- Toggle shadows\n"
 			"  [F2] -- Toggle ray tracing\n"
 			"  [g] -- Toggle sRGB framebuffer\n"
+			"  [v] -- Toggle wavefront ray tracing\n"
+			"  [c] -- Print shadow casters per cube face\n"
+			"  [t] -- Print GL times of each render pass\n"
+			"  [y] -- Write GL times of each render pass to passtimes.csv\n"
 			"  [f] -- Toggle wireframe rendering\n"
 			"  [o] -- Set to orthographic camera\n"
 			"  [p] -- Set to perspective camera\n"
@@ -280,10 +345,25 @@ void Assignment3::windowResize(int width, int height)
 		delete[] m_rtImage;
 	}
 	m_rtImage = new gml::vec3_t[width * height];
+	m_rtDirtyStart = m_rtDirtyEnd = 0;
+
+	if (m_wfRadiance)
+	{
+		delete[] m_wfRadiance;
+	}
+	m_wfRadiance = new gml::vec3_t[width * WAVEFRONT_ROWS];
 
 	assert(m_rtTex != 0);
 	glBindTexture(GL_TEXTURE_2D, m_rtTex);
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_FLOAT, 0);
+
+	// Room for a whole image per frame in flight, so uploading never
+	// waits for the GL longer than FrameSync does
+	if ( !m_rtUpload.init(m_framesInFlight * sizeof(gml::vec3_t)*width*height) )
+	{
+		// Not fatal; uploadRTRows() uploads from m_rtImage instead
+		fprintf(stderr, "Could not create ray tracing upload buffer\n");
+	}
 }
 
 void Assignment3::toggleCameraMoveDirection(bool enable, int direction)
@@ -376,6 +456,12 @@ void Assignment3::specialKeyboard(UI::KeySpecial_t key, UI::ButtonState_t state)
 		if (state == UI::BUTTON_DOWN)
 		{
 			m_isRayTracing = !m_isRayTracing;
+			if (m_isRayTracing)
+			{
+				m_scene.updateTransforms();
+				// Samples would otherwise be of the placeholder textures
+				m_textureManager.finish();
+			}
 			if (m_isRayTracing && m_cameraChanged)
 			{
 				m_rtRow = 0; // start at the beginning of the image.
@@ -390,6 +476,7 @@ void Assignment3::specialKeyboard(UI::KeySpecial_t key, UI::ButtonState_t state)
 				m_cameraChanged = false;
 				// Zero(black)-out the image
 				memset(m_rtImage, 0x00, sizeof(gml::vec3_t)*m_windowHeight*m_windowWidth);
+				m_rtDirtyStart = m_rtDirtyEnd = 0;
 				m_rtPassNum = 0;
 			}
 		}
@@ -410,6 +497,39 @@ void Assignment3::specialKeyboard(UI::KeySpecial_t key, UI::ButtonState_t state)
 			}
 		}
 		break;
+	case UI::KEY_V:
+		if (state == UI::BUTTON_DOWN)
+		{
+			m_useWavefront = !m_useWavefront;
+			m_wavefront.resetStats();
+			printf("Wavefront ray tracing %s\n", m_useWavefront ? "enabled" : "disabled");
+		}
+		break;
+	case UI::KEY_C:
+		if (state == UI::BUTTON_DOWN)
+		{
+			m_shadowmap.printCasterStats();
+		}
+		break;
+	case UI::KEY_T:
+		if (state == UI::BUTTON_DOWN)
+		{
+			m_passTimer.print(stdout);
+			if (m_useWavefront)
+			{
+				m_wavefront.printStats(stdout);
+			}
+		}
+		break;
+	case UI::KEY_Y:
+		if (state == UI::BUTTON_DOWN)
+		{
+			if (m_passTimer.dumpCSV("passtimes.csv"))
+			{
+				printf("Pass times written to passtimes.csv\n");
+			}
+		}
+		break;
 	case UI::KEY_F:
 		if (m_isRayTracing) break;
 		if (state == UI::BUTTON_DOWN)
@@ -452,18 +572,19 @@ void Assignment3::rasterizeScene()
 
 	if (isGLError()) return;
 
-	// Bind the shadowmap to texture unit 1
+	// Bind the shadowmap to its texture unit
 	if (m_useShadowMap)
 	{
-		m_shadowmap.bindGL(GL_TEXTURE1);
+		m_shadowmap.bindGL(GL_TEXTURE0 + SHADOWMAP_TEXTURE_UNIT);
 		if (isGLError()) return;
 	}
 
-	m_scene.rasterize(m_camera.getWorldView(), m_camera.getProjection(), m_useShadowMap);
+	m_scene.rasterize(m_camera, m_useShadowMap,
+			m_shadowmap.getLookupMatrices(m_shadowLight));
 
 	if (m_useShadowMap)
 	{
-		m_shadowmap.unbindGL(GL_TEXTURE1);
+		m_shadowmap.unbindGL(GL_TEXTURE0 + SHADOWMAP_TEXTURE_UNIT);
 	}
 
 	// Put the render state back the way we found it
@@ -474,9 +595,6 @@ void Assignment3::rasterizeScene()
 	{
 		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 	}
-
-	// Force everything outstanding to complete
-	glFinish();
 }
 
 void Assignment3::repaint()
@@ -487,6 +605,56 @@ void Assignment3::repaint()
 	 * This will end up being called after any user event (keypress, etc),
 	 * and pretty much every time through the event loop.
 	 */
+	// Upload the textures that have finished decoding
+	m_textureManager.update();
+
+	// Waits for the GL only if it is m_framesInFlight frames behind
+	const int slot = m_frameSync.beginFrame();
+	m_passTimer.beginFrame(slot);
+	drawFrame();
+	m_frameSync.endFrame();
+
+	if (m_isFirstFrame)
+	{
+		m_isFirstFrame = false;
+		printf("First frame in %.1f ms (%s: %d shaders from cache, %d compiled)\n",
+				1000.0 * (UI::getTime() - m_shaderStartTime),
+				(Shader::GLProgram::getNumCompiled() == 0) ? "warm" : "cold",
+				Shader::GLProgram::getNumCacheHits(), Shader::GLProgram::getNumCompiled());
+	}
+}
+
+void Assignment3::uploadRTRows()
+{
+	if (m_rtDirtyEnd <= m_rtDirtyStart) return;
+
+	const int nRows = m_rtDirtyEnd - m_rtDirtyStart;
+	const GLsizeiptr size = sizeof(gml::vec3_t)*m_windowWidth*nRows;
+
+	const gml::vec3_t *rows = m_rtImage + m_rtDirtyStart*m_windowWidth;
+	GLintptr offset;
+	void *dst = m_rtUpload.beginUpload(size, offset);
+	glBindTexture(GL_TEXTURE_2D, m_rtTex);
+	if ( !dst )
+	{
+		// No ring; copy straight from the image, synchronously
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, m_rtDirtyStart, m_windowWidth, nRows, GL_RGB, GL_FLOAT, rows);
+	}
+	else
+	{
+		memcpy(dst, rows, size);
+		m_rtUpload.unmap();
+
+		// Source is the bound unpack buffer, at offset
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, m_rtDirtyStart, m_windowWidth, nRows, GL_RGB, GL_FLOAT, (const GLvoid*)offset);
+		m_rtUpload.endUpload();
+	}
+
+	m_rtDirtyStart = m_rtDirtyEnd = 0;
+}
+
+void Assignment3::drawFrame()
+{
 	if (m_sRGBframebuffer)
 	{
 		glEnable(GL_FRAMEBUFFER_SRGB_EXT);
@@ -494,27 +662,46 @@ void Assignment3::repaint()
 
 	if (m_isRayTracing)
 	{
+		// Each pass's query is ended even on an error, so the next begin() is not nested
+		m_passTimer.begin(m_passRTUpload);
+		uploadRTRows();
+		const bool uploadFailed = isGLError();
+		m_passTimer.end(m_passRTUpload);
+		if (uploadFailed) return;
+
+		m_passTimer.begin(m_passRTBlit);
 		glBindFramebuffer(GL_READ_FRAMEBUFFER, m_rtFBO);
 		glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_rtTex, 0);
-		if (isGLError()) return;
-		glBlitFramebuffer(
-				0, 0, m_windowWidth, m_windowHeight,
-				0, 0, m_windowWidth, m_windowHeight,
-				GL_COLOR_BUFFER_BIT, GL_NEAREST);
-		if (isGLError()) return;
+		bool blitFailed = isGLError();
+		if (!blitFailed)
+		{
+			glBlitFramebuffer(
+					0, 0, m_windowWidth, m_windowHeight,
+					0, 0, m_windowWidth, m_windowHeight,
+					GL_COLOR_BUFFER_BIT, GL_NEAREST);
+			blitFailed = isGLError();
+		}
+		m_passTimer.end(m_passRTBlit);
+		if (blitFailed) return;
 	}
 	else {
 		if (m_useShadowMap)
 		{
-			m_shadowmap.create(m_scene, m_camera.getWorldView());
-			if ( isGLError() ) return;
+			m_shadowmap.setLightPos(m_shadowLight, gml::extract3(m_scene.getLightPos()));
+			m_passTimer.begin(m_passShadow);
+			m_shadowmap.update(m_scene, m_camera);
+			const bool shadowFailed = isGLError();
+			m_passTimer.end(m_passShadow);
+			if (shadowFailed) return;
 		}
 
 		// Bind the default framebuffer.
 		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
 		glViewport(0,0,m_windowWidth,m_windowHeight);
 
+		m_passTimer.begin(m_passRaster);
 		rasterizeScene();
+		m_passTimer.end(m_passRaster);
 	}
 
 	if (m_sRGBframebuffer)
@@ -537,6 +724,10 @@ void Assignment3::idle()
 		{
 			GLuint startRow = m_rtRow;
 
+			// Objects may have moved since the last slice; the sphere & plane
+			// buckets hold copies of their transforms. Only the moved ones are copied.
+			m_scene.updateTransforms();
+
 			// Ray trace rows for TIMEOUT s
 			float timeout = 0.1f; // 100ms
 
@@ -545,6 +736,23 @@ void Assignment3::idle()
 			double time = currTime;
 			do
 			{
+				if (m_useWavefront)
+				{
+					// A block of rows at once; the integrator works in batches
+					int nRows = m_windowHeight - m_rtRow;
+					if (nRows > WAVEFRONT_ROWS) nRows = WAVEFRONT_ROWS;
+					m_wavefront.render(m_scene, m_camera, m_windowWidth, m_rtRow, nRows, MAX_RAY_DEPTH, m_wfRadiance);
+
+					gml::vec3_t *imgPos = m_rtImage + m_rtRow*m_windowWidth;
+					for (int i=0; i<nRows*m_windowWidth; i++)
+					{
+						accumulateSample(imgPos[i], m_wfRadiance[i], m_rtPassNum);
+					}
+					m_rtRow += nRows;
+					time = UI::getTime();
+					continue;
+				}
+
 				gml::vec3_t *imgPos = m_rtImage + m_rtRow*m_windowWidth;
 
 				for (int c=0; c<m_windowWidth; c++, imgPos++)
@@ -569,28 +777,28 @@ void Assignment3::idle()
 
 					if (m_scene.rayIntersects(ray, m_camera.getNearClip(), m_camera.getFarClip(), hitinfo))
 					{
-							clr = m_scene.shadeRay(ray, hitinfo, MAX_RAY_DEPTH);
+							clr = m_scene.shadeRay(ray, hitinfo, MAX_RAY_DEPTH, m_camera.getPixelCone());
 					}
 
 					// Use 'clr' to update the image
-					if (m_rtPassNum == 0)
-					{
-						*imgPos = clr;
-					}
-					else
-					{
-						*imgPos = gml::scale(1.0f/(m_rtPassNum+1),	gml::add( gml::scale(m_rtPassNum,*imgPos), clr ) );
-					}
+					accumulateSample(*imgPos, clr, m_rtPassNum);
 				}
 
 				m_rtRow += 1;
 				time = UI::getTime();
 			} while (m_rtRow < m_windowHeight && (time-currTime)<timeout);
 
-			// Copy the new image data to the texture for blitting to the screen.
-			glBindTexture(GL_TEXTURE_2D, m_rtTex);
-			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, startRow, m_windowWidth, m_rtRow-startRow, GL_RGB, GL_FLOAT, m_rtImage+startRow*m_windowWidth);
-			if (isGLError()) return;
+			// The new image data is copied to the texture when the next frame is drawn.
+			if (m_rtDirtyEnd <= m_rtDirtyStart)
+			{
+				m_rtDirtyStart = startRow;
+				m_rtDirtyEnd = m_rtRow;
+			}
+			else
+			{
+				if ((int)startRow < m_rtDirtyStart) m_rtDirtyStart = startRow;
+				if (m_rtRow > m_rtDirtyEnd) m_rtDirtyEnd = m_rtRow;
+			}
 		}
 		else
 		{
@@ -20,10 +20,15 @@
 
 #include "GML/gml.h"
 #include "Scene/scene.h"
+#include "Scene/wavefront.h"
 #include "Camera/camera.h"
 #include "Objects/geometry.h"
 #include "Texture/texture.h"
+#include "Texture/manager.h"
 #include "ShadowMapping/shadowmap.h"
+#include "FrameSync/framesync.h"
+#include "Streaming/uploadring.h"
+#include "Profiling/passtimer.h"
 #include "UI/ui.h"
 
 class Assignment3 : public UI::Callbacks
@@ -54,11 +59,27 @@ protected:
 	// Whether to render in wireframe or not
 	bool m_renderWireframe;
 
+	// Loads, and shares, the textures
+	Texture::Manager m_textureManager;
 	Texture::Texture *m_texture;
 
 	bool m_useShadowMap;
-	int m_shadowmapSize;
+	int m_shadowmapSize; // Largest tile for a cube face
+	int m_shadowFaceBudget; // Most cube faces to re-render per frame; 0 => no limit
 	ShadowMap m_shadowmap;
+	int m_shadowLight; // Id of the scene's light in the shadow map
+
+	// Bounds how far the CPU may run ahead of the GL
+	int m_framesInFlight;
+	FrameSync m_frameSync;
+
+	// GL-side timing of each render pass
+	PassTimer m_passTimer;
+	int m_passShadow, m_passRaster, m_passRTUpload, m_passRTBlit;
+
+	// Time that shader compilation started, for the time to first frame
+	double m_shaderStartTime;
+	bool m_isFirstFrame;
 
 	// For animation
 	double m_lastIdleTime; // Time that idle was last called
@@ -72,11 +93,23 @@ protected:
 	int m_rtRow; // Which row to ray trace next.
 	bool m_cameraChanged;
 	int m_rtPassNum; // How many rays have been cast through each pixel
+	// Stages the uploads of m_rtImage to m_rtTex
+	UploadRing m_rtUpload;
+	// Rows [m_rtDirtyStart, m_rtDirtyEnd) of m_rtImage have not been uploaded yet
+	int m_rtDirtyStart, m_rtDirtyEnd;
+	// Ray trace with m_wavefront instead of Scene::shadeRay()
+	bool m_useWavefront;
+	Scene::Wavefront m_wavefront;
+	gml::vec3_t *m_wfRadiance; // One block of rows traced by m_wavefront
 
 	void toggleCameraMoveDirection(bool enable, int direction);
 
 	// Rasterize the scene with full color shaders
 	void rasterizeScene();
+	// Draw the frame
+	void drawFrame();
+	// Copy the dirty rows of m_rtImage to m_rtTex via m_rtUpload
+	void uploadRTRows();
 public:
 	Assignment3();
 	virtual ~Assignment3();
@@ -0,0 +1,295 @@
+/*
+ * Copyright:
+ * Daniel D. Neilson (ddneilson@ieee.org)
+ * University of Saskatchewan
+ * All rights reserved
+ *
+ * Permission granted to use for use in assignments and
+ * projects for CMPT 485 & CMPT 829 at the University
+ * of Saskatchewan.
+ */
+
+/*
+ * Accuracy test for gml::fast (src/GML/fastmath.h).
+ *
+ * Sweeps each function over the domain that the header gives its error
+ * bound for, and compares it to the double precision <cmath> function.
+ * The one argument functions are sampled evenly over the bit patterns
+ * of the domain (so every binade gets its share); atan2 & pow over grids
+ * and random arguments.
+ *
+ * Relative errors are only measured where the exact answer is a normal
+ * float; fastmath.h does not handle denormals.
+ *
+ * Exits with 1 if any error is over the bound in the header.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cfloat>
+#include <math.h>
+
+#include "../src/GML/fastmath.h"
+
+using gml::fast::_bits;
+using gml::fast::_float;
+
+static const int N_SAMPLES = 1 << 22; // Per sweep
+
+typedef struct
+{
+	const char *name;
+	const char *domain;
+	bool relative;
+	double bound;
+	double worst; // Largest error seen
+	float worstX, worstY; // ...and where
+	long samples;
+} Check;
+
+static void initCheck(Check &check, const char *name, const char *domain, const bool relative, const double bound)
+{
+	check.name = name;
+	check.domain = domain;
+	check.relative = relative;
+	check.bound = bound;
+	check.worst = 0.0;
+	check.worstX = check.worstY = 0.0f;
+	check.samples = 0;
+}
+
+static void record(Check &check, const double got, const double exact, const float x, const float y=0.0f)
+{
+	double err = fabs(got - exact);
+	if (check.relative)
+	{
+		if (fabs(exact) < FLT_MIN || fabs(exact) > FLT_MAX) return;
+		err /= fabs(exact);
+	}
+	check.samples += 1;
+	// Not a number is as bad as it gets
+	if ( !(err <= check.worst) )
+	{
+		check.worst = isnan(err) ? INFINITY : err;
+		check.worstX = x;
+		check.worstY = y;
+	}
+}
+
+// Print the result; returns true if within the bound
+static bool report(const Check &check)
+{
+	const bool ok = (check.worst <= check.bound);
+	printf("%-7s %-26s %9ld  %s %9.3g  bound %8.2g  at (%.9g, %.9g)  %s\n", check.name, check.domain,
+			check.samples, check.relative ? "rel" : "abs", check.worst, check.bound,
+			check.worstX, check.worstY, ok ? "ok" : "FAILED");
+	return ok;
+}
+
+// Every stride-th float in [lo, hi]; lo & hi >= 0
+typedef struct
+{
+	int32_t bits, end, stride;
+} Sweep;
+static Sweep sweep(const float lo, const float hi)
+{
+	Sweep s;
+	s.bits = _bits(lo);
+	s.end = _bits(hi);
+	s.stride = (s.end - s.bits) / N_SAMPLES;
+	if (s.stride < 1) s.stride = 1;
+	return s;
+}
+static bool next(Sweep &s, float &x)
+{
+	if (s.bits > s.end) return false;
+	x = _float(s.bits);
+	// Always end on hi itself
+	if (s.bits < s.end && s.end - s.bits < s.stride) s.bits = s.end;
+	else s.bits += s.stride;
+	return true;
+}
+
+static float uniform(const float lo, const float hi)
+{
+	return lo + (hi - lo)*((float)rand() / ((float)RAND_MAX + 1.0f));
+}
+
+static bool testAtan2()
+{
+	Check check;
+	initCheck(check, "atan2", "any finite y, x", false, 3e-7);
+	// Around the circle, at several radii
+	const int nAngles = 1 << 20;
+	const float radii[] = { 1e-30f, 1e-3f, 1.0f, 1e3f, 1e30f };
+	for (int r=0; r<5; r++)
+	{
+		for (int i=0; i<nAngles; i++)
+		{
+			const double a = 2*M_PI*i/nAngles - M_PI;
+			const float y = radii[r]*(float)sin(a), x = radii[r]*(float)cos(a);
+			record(check, gml::fast::atan2(y, x), atan2((double)y, (double)x), y, x);
+		}
+	}
+	// Magnitudes far apart, & the axes
+	for (int i=0; i<N_SAMPLES; i++)
+	{
+		const float y = ((rand() & 1) ? -1.0f : 1.0f) * ldexpf(uniform(1.0f, 2.0f), rand() % 250 - 125);
+		const float x = ((rand() & 1) ? -1.0f : 1.0f) * ldexpf(uniform(1.0f, 2.0f), rand() % 250 - 125);
+		record(check, gml::fast::atan2(y, x), atan2((double)y, (double)x), y, x);
+	}
+	const float axes[][2] = { {0,1}, {1,0}, {0,-1}, {-1,0}, {0,0}, {1,1}, {-1,-1} };
+	for (int i=0; i<7; i++)
+	{
+		record(check, gml::fast::atan2(axes[i][0], axes[i][1]), atan2((double)axes[i][0], (double)axes[i][1]),
+				axes[i][0], axes[i][1]);
+	}
+	return report(check);
+}
+
+static bool testAsin()
+{
+	Check check;
+	initCheck(check, "asin", "[-1, 1]", false, 3e-7);
+	Sweep s = sweep(0.0f, 1.0f);
+	float x;
+	while ( next(s, x) )
+	{
+		record(check, gml::fast::asin(x), asin((double)x), x);
+		record(check, gml::fast::asin(-x), asin(-(double)x), -x);
+	}
+	return report(check);
+}
+
+static bool testExp2()
+{
+	Check check;
+	initCheck(check, "exp2", "[-126, 127]", true, 3e-7);
+	Sweep s = sweep(0.0f, 127.0f);
+	float x;
+	while ( next(s, x) )
+	{
+		record(check, gml::fast::exp2(x), exp2((double)x), x);
+		if (x <= 126.0f) record(check, gml::fast::exp2(-x), exp2(-(double)x), -x);
+	}
+	return report(check);
+}
+
+static bool testLog2()
+{
+	Check inner, outer;
+	initCheck(inner, "log2", "[1/2, 2]", false, 1.5e-7);
+	initCheck(outer, "log2", "normal floats, x > 0", true, 1.2e-7);
+	Sweep s = sweep(FLT_MIN, FLT_MAX);
+	float x;
+	while ( next(s, x) )
+	{
+		record( (x >= 0.5f && x <= 2.0f) ? inner : outer, gml::fast::log2(x), log2((double)x), x );
+	}
+	// Densely where it is absolute
+	s = sweep(0.5f, 2.0f);
+	while ( next(s, x) )
+	{
+		record(inner, gml::fast::log2(x), log2((double)x), x);
+	}
+	const bool ok = report(inner);
+	return report(outer) && ok;
+}
+
+static bool testPow()
+{
+	Check check;
+	initCheck(check, "pow", "x in (0, 1], y in [0, 256]", true, 3e-5);
+	// Bit patterns of x, by y
+	const int nX = 1 << 11, nY = 1 << 11;
+	Sweep s = sweep(FLT_MIN, 1.0f);
+	s.stride = (s.end - s.bits) / nX;
+	float x;
+	while ( next(s, x) )
+	{
+		for (int j=0; j<=nY; j++)
+		{
+			const float y = 256.0f*j/nY;
+			record(check, gml::fast::pow(x, y), pow((double)x, (double)y), x, y);
+		}
+	}
+	// Near 1, where it is used for specular highlights
+	for (int i=0; i<N_SAMPLES; i++)
+	{
+		const float x = uniform(0.0f, 1.0f), y = uniform(0.0f, 256.0f);
+		if (x > 0.0f) record(check, gml::fast::pow(x, y), pow((double)x, (double)y), x, y);
+	}
+	return report(check);
+}
+
+static bool testSincos()
+{
+	Check check;
+	initCheck(check, "sincos", "|x| <= 8192", false, 9e-8);
+	Sweep s = sweep(0.0f, 8192.0f);
+	float x;
+	while ( next(s, x) )
+	{
+		for (int sign=0; sign<2; sign++)
+		{
+			const float xs = sign ? -x : x;
+			float sn, cs;
+			gml::fast::sincos(xs, sn, cs);
+			record(check, sn, sin((double)xs), xs);
+			record(check, cs, cos((double)xs), xs);
+		}
+	}
+	// Densely where it is used; angles of a turn or two
+	s = sweep(0.0f, 8.0f);
+	while ( next(s, x) )
+	{
+		float sn, cs;
+		gml::fast::sincos(x, sn, cs);
+		record(check, sn, sin((double)x), x);
+		record(check, cs, cos((double)x), x);
+	}
+	return report(check);
+}
+
+static bool testRsqrt()
+{
+	Check check;
+	initCheck(check, "rsqrt", "normal floats, x > 0", true, 5e-6);
+	Sweep s = sweep(FLT_MIN, FLT_MAX);
+	float x;
+	while ( next(s, x) )
+	{
+		record(check, gml::fast::rsqrt(x), 1.0/sqrt((double)x), x);
+	}
+	// Every float in [1, 4); the error repeats every 2 binades
+	s = sweep(1.0f, 4.0f);
+	s.stride = 1;
+	while ( next(s, x) )
+	{
+		record(check, gml::fast::rsqrt(x), 1.0/sqrt((double)x), x);
+	}
+	return report(check);
+}
+
+int main()
+{
+	srand(485);
+	printf("%-7s %-26s %9s  %13s  %14s\n", "", "domain", "samples", "max error", "");
+
+	bool ok = true;
+	ok = testAtan2() && ok;
+	ok = testAsin() && ok;
+	ok = testExp2() && ok;
+	ok = testLog2() && ok;
+	ok = testPow() && ok;
+	ok = testSincos() && ok;
+	ok = testRsqrt() && ok;
+
+	if ( !ok )
+	{
+		printf("FAILED: over the bounds in fastmath.h\n");
+		return 1;
+	}
+	printf("All within the bounds in fastmath.h\n");
+	return 0;
+}
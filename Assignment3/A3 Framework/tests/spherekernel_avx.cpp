@@ -0,0 +1,36 @@
+/*
+ * Copyright:
+ * Daniel D. Neilson (ddneilson@ieee.org)
+ * University of Saskatchewan
+ * All rights reserved
+ *
+ * Permission granted to use for use in assignments and
+ * projects for CMPT 485 & CMPT 829 at the University
+ * of Saskatchewan.
+ */
+
+// Built with -mavx, so that vec3x8_t is one AVX register per component
+
+#if !defined(__AVX__)
+#error "spherekernel_avx.cpp must be built with -mavx"
+#endif
+
+#include "spherekernel_batch.h"
+#include "../src/RayTracing/spherekernel.h"
+
+using namespace gml;
+
+void intersectAVX(const SphereBatch &batch)
+{
+	for (int i=0; i<batch.n; i+=8)
+	{
+		floatx8_t t;
+		const int hit = bits( RayTracing::intersectSphere(vec3x8_t(batch.f + i), vec3x8_t(batch.d + i),
+				floatx8_t(batch.r2 + i), floatx8_t(batch.t0 + i), floatx8_t(batch.t1 + i), t) );
+		store(batch.t + i, t);
+		for (int l=0; l<8; l++)
+		{
+			batch.hit[i+l] = (hit >> l) & 1;
+		}
+	}
+}
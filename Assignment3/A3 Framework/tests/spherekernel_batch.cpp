@@ -0,0 +1,44 @@
+/*
+ * Copyright:
+ * Daniel D. Neilson (ddneilson@ieee.org)
+ * University of Saskatchewan
+ * All rights reserved
+ *
+ * Permission granted to use for use in assignments and
+ * projects for CMPT 485 & CMPT 829 at the University
+ * of Saskatchewan.
+ */
+
+#include "spherekernel_batch.h"
+#include "../src/RayTracing/spherekernel.h"
+
+using namespace gml;
+
+void intersectScalar(const SphereBatch &batch)
+{
+	for (int i=0; i<batch.n; i++)
+	{
+		batch.hit[i] = RayTracing::intersectSphere(batch.f[i], batch.d[i], batch.r2[i],
+				batch.t0[i], batch.t1[i], batch.t[i]);
+	}
+}
+
+void intersectSSE(const SphereBatch &batch)
+{
+	for (int i=0; i<batch.n; i+=4)
+	{
+		floatx4_t t;
+		const int hit = bits( RayTracing::intersectSphere(vec3x4_t(batch.f + i), vec3x4_t(batch.d + i),
+				floatx4_t(batch.r2 + i), floatx4_t(batch.t0 + i), floatx4_t(batch.t1 + i), t) );
+		store(batch.t + i, t);
+		for (int l=0; l<4; l++)
+		{
+			batch.hit[i+l] = (hit >> l) & 1;
+		}
+	}
+}
+
+bool haveAVX()
+{
+	return __builtin_cpu_supports("avx");
+}
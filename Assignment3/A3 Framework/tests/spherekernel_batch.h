@@ -0,0 +1,45 @@
+/*
+ * Copyright:
+ * Daniel D. Neilson (ddneilson@ieee.org)
+ * University of Saskatchewan
+ * All rights reserved
+ *
+ * Permission granted to use for use in assignments and
+ * projects for CMPT 485 & CMPT 829 at the University
+ * of Saskatchewan.
+ */
+
+/*
+ * RayTracing::intersectSphere() over arrays of rays, in each of its
+ * forms; for the sphere kernel test & benchmark.
+ *
+ * Ray i is f[i] (origin - sphere center) & d[i], against a sphere of
+ * radius^2 r2[i], over [t0[i], t1[i]]. hit[i] is set iff it hits; t[i]
+ * is only meaningful if it does. n must be a multiple of 8.
+ *
+ * The AVX form is in its own file, built with -mavx; only call it if
+ * haveAVX().
+ */
+
+#pragma once
+#ifndef __INC_TESTS_SPHEREKERNEL_BATCH_H_
+#define __INC_TESTS_SPHEREKERNEL_BATCH_H_
+
+#include "../src/GML/gml.h"
+
+typedef struct
+{
+	int n;
+	const gml::vec3_t *f, *d;
+	const float *r2, *t0, *t1;
+	float *t;
+	bool *hit;
+} SphereBatch;
+
+void intersectScalar(const SphereBatch &batch);
+void intersectSSE(const SphereBatch &batch);
+void intersectAVX(const SphereBatch &batch);
+// True iff the CPU & OS can run intersectAVX()
+bool haveAVX();
+
+#endif
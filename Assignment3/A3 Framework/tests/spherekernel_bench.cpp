@@ -0,0 +1,113 @@
+/*
+ * Copyright:
+ * Daniel D. Neilson (ddneilson@ieee.org)
+ * University of Saskatchewan
+ * All rights reserved
+ *
+ * Permission granted to use for use in assignments and
+ * projects for CMPT 485 & CMPT 829 at the University
+ * of Saskatchewan.
+ */
+
+/*
+ * Microbenchmark for RayTracing::intersectSphere(): time per ray of the
+ * scalar, SSE & AVX forms, over a batch of rays that hit about half the
+ * time; so the scalar form's branches are unpredictable.
+ *
+ * Each form is run several times; the fastest run is reported.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <time.h>
+#include <math.h>
+
+#include "spherekernel_batch.h"
+
+using namespace gml;
+
+static const int N_RAYS = 4096; // Fits in L1/L2, so that the kernel is timed, not memory
+static const int N_PASSES = 2000; // Per run
+static const int N_RUNS = 5;
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+static float uniform(const float lo, const float hi)
+{
+	return lo + (hi - lo)*((float)rand() / ((float)RAND_MAX + 1.0f));
+}
+
+// Fastest ns per ray over N_RUNS runs
+static double timeForm(void (*form)(const SphereBatch&), const SphereBatch &batch)
+{
+	double best = INFINITY;
+	for (int run=0; run<N_RUNS; run++)
+	{
+		const double start = now();
+		for (int pass=0; pass<N_PASSES; pass++)
+		{
+			form(batch);
+		}
+		const double ns = 1e9*(now() - start) / ((double)N_PASSES*batch.n);
+		if (ns < best) best = ns;
+	}
+	return best;
+}
+
+int main()
+{
+	srand(485);
+
+	vec3_t *f = new vec3_t[N_RAYS];
+	vec3_t *d = new vec3_t[N_RAYS];
+	float *r2 = new float[N_RAYS];
+	float *t0 = new float[N_RAYS];
+	float *t1 = new float[N_RAYS];
+	float *t = new float[N_RAYS];
+	bool *hit = new bool[N_RAYS];
+	// Unit spheres, seen from 2-10 away; aimed within 1.4 of the center
+	for (int i=0; i<N_RAYS; i++)
+	{
+		const vec3_t o(uniform(-1,1), uniform(-1,1), -uniform(2.0f, 10.0f));
+		const vec3_t aim(uniform(-1,1), uniform(-1,1), 0.0f);
+		f[i] = o;
+		d[i] = normalize(sub(scale(1.4f, aim), o));
+		r2[i] = 1.0f;
+		t0[i] = 0.0f;
+		t1[i] = INFINITY;
+	}
+	const SphereBatch batch = { N_RAYS, f, d, r2, t0, t1, t, hit };
+
+	intersectScalar(batch);
+	int nHits = 0;
+	for (int i=0; i<N_RAYS; i++) nHits += hit[i];
+	printf("%d rays, %.0f%% hit\n", N_RAYS, 100.0*nHits/N_RAYS);
+
+	const double scalar = timeForm(intersectScalar, batch);
+	printf("scalar  %6.3f ns/ray\n", scalar);
+	const double sse = timeForm(intersectSSE, batch);
+	printf("sse     %6.3f ns/ray  (%.2fx)\n", sse, scalar/sse);
+	if ( haveAVX() )
+	{
+		const double avx = timeForm(intersectAVX, batch);
+		printf("avx     %6.3f ns/ray  (%.2fx)\n", avx, scalar/avx);
+	}
+	else
+	{
+		printf("avx     not supported by this CPU\n");
+	}
+
+	delete[] hit;
+	delete[] t;
+	delete[] t1;
+	delete[] t0;
+	delete[] r2;
+	delete[] d;
+	delete[] f;
+	return 0;
+}
@@ -0,0 +1,391 @@
+/*
+ * Copyright:
+ * Daniel D. Neilson (ddneilson@ieee.org)
+ * University of Saskatchewan
+ * All rights reserved
+ *
+ * Permission granted to use for use in assignments and
+ * projects for CMPT 485 & CMPT 829 at the University
+ * of Saskatchewan.
+ */
+
+/*
+ * Correctness test for RayTracing::intersectSphere().
+ *
+ * Each form (scalar, SSE & AVX) is checked against a double precision
+ * solver of the same quadratic. A ray must hit or miss as the reference
+ * does, and t must be within the error that float rounding of the inputs
+ * to the quadratic can cause. Where that error could change the answer
+ * (the ray is within rounding of tangent, or a root is within rounding
+ * of t0 or t1) either answer is accepted.
+ *
+ * The wide forms must also give exactly the scalar's answer.
+ *
+ * Exits with 1 if any check fails.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <math.h>
+
+#include "spherekernel_batch.h"
+#include "../src/RayTracing/spherekernel.h"
+
+using namespace gml;
+
+static const double EPS = 1.0/(1 << 24); // float rounding
+static const int N_RAYS = 1 << 16; // Per group
+
+// Uniform in [lo, hi)
+static float uniform(const float lo, const float hi)
+{
+	return lo + (hi - lo)*((float)rand() / ((float)RAND_MAX + 1.0f));
+}
+// Uniform in log scale
+static float logUniform(const float lo, const float hi)
+{
+	return expf( uniform(logf(lo), logf(hi)) );
+}
+static vec3_t randomDir()
+{
+	vec3_t v;
+	do
+	{
+		v = vec3_t(uniform(-1,1), uniform(-1,1), uniform(-1,1));
+	} while ( length2(v) < 1e-4f || length2(v) > 1.0f );
+	return normalize(v);
+}
+// A unit vector perpendicular to v
+static vec3_t perpendicular(const vec3_t v)
+{
+	const vec3_t axis = (fabsf(v.x) < 0.5f) ? vec3_t(1,0,0) : vec3_t(0,1,0);
+	return normalize(cross(v, axis));
+}
+
+typedef struct
+{
+	bool hit;
+	double t;
+	// Either answer is right
+	bool ambiguous;
+	// The error t may have; from float rounding of the inputs
+	double tol;
+	// The other root, and its error; where the choice is ambiguous
+	double tOther, tolOther;
+} Reference;
+
+static Reference solve(const vec3_t &f32, const vec3_t &d32, const float r2_32,
+		const float t0, const float t1)
+{
+	const double f[3] = { f32.x, f32.y, f32.z };
+	const double d[3] = { d32.x, d32.y, d32.z };
+	const double r2 = r2_32;
+	const double fxd[3] = { f[1]*d[2] - f[2]*d[1], f[2]*d[0] - f[0]*d[2], f[0]*d[1] - f[1]*d[0] };
+	const double a = d[0]*d[0] + d[1]*d[1] + d[2]*d[2];
+	const double b = f[0]*d[0] + f[1]*d[1] + f[2]*d[2];
+	const double ff = f[0]*f[0] + f[1]*f[1] + f[2]*f[2];
+	const double c = ff - r2;
+	const double cross2 = fxd[0]*fxd[0] + fxd[1]*fxd[1] + fxd[2]*fxd[2];
+	const double disc = a*r2 - cross2;
+
+	// Bounds on the float errors of the terms; with a safety factor
+	const double fLen = sqrt(ff), dLen = sqrt(a);
+	const double errDisc = 8*EPS*( a*r2 + cross2 + 2*sqrt(cross2)*fLen*dLen );
+	const double errB = 4*EPS*fLen*dLen;
+	const double errC = 4*EPS*(ff + r2);
+
+	Reference ref;
+	ref.ambiguous = (fabs(disc) <= errDisc);
+	ref.hit = false;
+	ref.t = ref.tOther = 0.0;
+	ref.tol = ref.tolOther = 0.0;
+	if (disc < 0.0 && !ref.ambiguous) return ref;
+
+	const double s = sqrt(fmax(disc, 0.0));
+	const double errS = (s > 0.0) ? fmin(errDisc/(2*s), sqrt(errDisc)) : sqrt(errDisc);
+	const double q = -(b + copysign(s, b));
+	const double aq = fabs(q);
+	double tNear = q/a, tFar = c/q;
+	double tolNear = 4*EPS*fabs(tNear) + (errB + errS)/a;
+	double tolFar = (aq > 0.0) ? 4*EPS*fabs(tFar) + errC/aq + fabs(tFar)*(errB + errS)/aq : INFINITY;
+	if (tNear > tFar)
+	{
+		double tt = tNear; tNear = tFar; tFar = tt;
+		tt = tolNear; tolNear = tolFar; tolFar = tt;
+	}
+	// Tangent; one root
+	if (disc <= 0.0)
+	{
+		tNear = tFar = -b/a;
+		tolNear = tolFar = 4*EPS*fabs(tNear) + (errB + errS)/a;
+	}
+
+	const bool nearIn = (tNear >= t0 && tNear <= t1);
+	const bool farIn = (tFar >= t0 && tFar <= t1);
+	if (nearIn)
+	{
+		ref.hit = true;
+		ref.t = tNear; ref.tol = tolNear;
+		ref.tOther = tFar; ref.tolOther = tolFar;
+	}
+	else if (farIn)
+	{
+		ref.hit = true;
+		ref.t = tFar; ref.tol = tolFar;
+		ref.tOther = tNear; ref.tolOther = tolNear;
+	}
+	else
+	{
+		ref.t = (fabs(tNear - t0) < fabs(tFar - t0)) ? tNear : tFar;
+		ref.tol = (ref.t == tNear) ? tolNear : tolFar;
+		ref.tOther = (ref.t == tNear) ? tFar : tNear;
+		ref.tolOther = (ref.t == tNear) ? tolFar : tolNear;
+	}
+	// Is either root within rounding of t0 or t1?
+	if ( fabs(tNear - t0) <= tolNear || fabs(tNear - t1) <= tolNear ||
+			fabs(tFar - t0) <= tolFar || fabs(tFar - t1) <= tolFar )
+	{
+		ref.ambiguous = true;
+	}
+	return ref;
+}
+
+typedef struct
+{
+	const char *name;
+	int fails;
+	int hits;
+	int ambiguous;
+	double worst; // Largest |t - reference| / tolerance
+} Result;
+
+// Check one form's answers against the reference
+static void check(Result &result, const SphereBatch &batch, const Reference *refs)
+{
+	result.fails = result.hits = result.ambiguous = 0;
+	result.worst = 0.0;
+	for (int i=0; i<batch.n; i++)
+	{
+		const Reference &ref = refs[i];
+		const bool hit = batch.hit[i];
+		if (hit) result.hits += 1;
+		if (ref.ambiguous) result.ambiguous += 1;
+
+		bool ok;
+		if ( !hit )
+		{
+			ok = !ref.hit || ref.ambiguous;
+		}
+		else if ( !ref.hit && !ref.ambiguous )
+		{
+			ok = false;
+		}
+		else
+		{
+			const double t = batch.t[i];
+			double err = fabs(t - ref.t) / ref.tol;
+			if (ref.ambiguous) err = fmin(err, fabs(t - ref.tOther) / ref.tolOther);
+			ok = (err <= 1.0) && (t >= batch.t0[i]) && (t <= batch.t1[i]);
+			if (err > result.worst) result.worst = err;
+		}
+		if ( !ok )
+		{
+			if (result.fails < 4)
+			{
+				fprintf(stderr, "  %s ray %d: f=(%g,%g,%g) d=(%g,%g,%g) r2=%g [%g,%g]: "
+						"got %s t=%.9g; expected %s t=%.9g (+-%g)%s\n", result.name, i,
+						batch.f[i].x, batch.f[i].y, batch.f[i].z, batch.d[i].x, batch.d[i].y, batch.d[i].z,
+						batch.r2[i], batch.t0[i], batch.t1[i], hit ? "hit" : "miss", hit ? batch.t[i] : 0.0f,
+						ref.hit ? "hit" : "miss", ref.t, ref.tol, ref.ambiguous ? " ambiguous" : "");
+			}
+			result.fails += 1;
+		}
+	}
+}
+
+// Count where the wide form differs from the scalar one at all
+static int countDifferent(const SphereBatch &scalar, const SphereBatch &wide)
+{
+	int different = 0;
+	for (int i=0; i<scalar.n; i++)
+	{
+		if ( scalar.hit[i] != wide.hit[i] || (scalar.hit[i] && scalar.t[i] != wide.t[i]) )
+		{
+			different += 1;
+		}
+	}
+	return different;
+}
+
+// The ray groups
+typedef enum
+{
+	RANDOM,     // Anywhere, aimed near the sphere
+	INSIDE,     // Starting inside the sphere
+	TANGENT,    // Grazing the sphere
+	GRAZING,    // Just inside & outside of tangent
+	SMALL_FAR,  // Tiny spheres, far away
+	CLIPPED,    // [t0,t1] ends near the roots
+	N_GROUPS
+} Group;
+static const char *groupNames[N_GROUPS] =
+{
+	"random", "inside-start", "tangent", "near-tangent", "small & far", "clipped"
+};
+
+static void makeRay(const Group group, vec3_t &f, vec3_t &d, float &r2, float &t0, float &t1)
+{
+	float r = logUniform(1e-2f, 1e2f);
+	const float dLen = logUniform(1e-2f, 1e2f);
+	t0 = 0.0f;
+	t1 = INFINITY;
+	switch (group)
+	{
+	case RANDOM:
+		{
+			f = scale(r*logUniform(1e-3f, 1e3f), randomDir());
+			// Toward the sphere, give or take
+			const vec3_t aim = sub( scale(r*uniform(0.0f, 2.0f), randomDir()), f );
+			d = scale(dLen, normalize(add(aim, scale(1e-3f*length(aim), randomDir()))));
+			if (rand() & 1) t0 = uniform(0.0f, 1.0f);
+		}
+		break;
+	case INSIDE:
+		f = scale(r*uniform(0.0f, 0.999f), randomDir());
+		d = scale(dLen, randomDir());
+		break;
+	case TANGENT:
+	case GRAZING:
+		{
+			// Passes r*offset from the center; offset = 1 is tangent
+			const vec3_t n = randomDir(), u = perpendicular(n);
+			float offset = 1.0f;
+			if (group == GRAZING) offset = (rand() & 1) ? 1.0f - 1e-3f : 1.0f + 1e-3f;
+			f = add( scale(r*offset, n), scale(-r*logUniform(1e-1f, 1e2f), u) );
+			d = scale(dLen, u);
+		}
+		break;
+	case SMALL_FAR:
+		{
+			r = logUniform(1e-4f, 1e-2f);
+			f = scale(logUniform(1e2f, 1e4f), randomDir());
+			const vec3_t aim = sub( scale(r*uniform(0.0f, 1.5f), randomDir()), f );
+			d = scale(dLen, normalize(aim));
+		}
+		break;
+	case CLIPPED:
+		{
+			f = scale(r*logUniform(1.5f, 10.0f), randomDir());
+			d = scale(dLen, normalize(sub( scale(0.5f*r, randomDir()), f )));
+			// Around where the ray reaches the sphere
+			const float tCenter = -dot(f, d) / dot(d, d);
+			const float tRadius = r / dLen;
+			t0 = tCenter - tRadius*uniform(0.5f, 1.5f);
+			t1 = tCenter + tRadius*uniform(0.5f, 1.5f);
+		}
+		break;
+	default:
+		break;
+	}
+	r2 = r*r;
+}
+
+int main()
+{
+	srand(485);
+
+	vec3_t *f = new vec3_t[N_RAYS];
+	vec3_t *d = new vec3_t[N_RAYS];
+	float *r2 = new float[N_RAYS];
+	float *t0 = new float[N_RAYS];
+	float *t1 = new float[N_RAYS];
+	Reference *refs = new Reference[N_RAYS];
+	float *t[3];
+	bool *hit[3];
+	for (int i=0; i<3; i++)
+	{
+		t[i] = new float[N_RAYS];
+		hit[i] = new bool[N_RAYS];
+	}
+	SphereBatch batches[3];
+	for (int i=0; i<3; i++)
+	{
+		SphereBatch b = { N_RAYS, f, d, r2, t0, t1, t[i], hit[i] };
+		batches[i] = b;
+	}
+
+	const bool avx = haveAVX();
+	if ( !avx ) printf("No AVX on this CPU; skipping the 8-wide form\n");
+	const char *formNames[3] = { "scalar", "sse", "avx" };
+	const int nForms = avx ? 3 : 2;
+
+	int failed = 0;
+	printf("%-14s %-7s %7s %7s %9s %10s\n", "group", "form", "hits", "ambig", "fails", "worst/tol");
+	for (int g=0; g<N_GROUPS; g++)
+	{
+		for (int i=0; i<N_RAYS; i++)
+		{
+			makeRay((Group)g, f[i], d[i], r2[i], t0[i], t1[i]);
+			refs[i] = solve(f[i], d[i], r2[i], t0[i], t1[i]);
+		}
+		intersectScalar(batches[0]);
+		intersectSSE(batches[1]);
+		if (avx) intersectAVX(batches[2]);
+
+		for (int form=0; form<nForms; form++)
+		{
+			Result result;
+			result.name = formNames[form];
+			check(result, batches[form], refs);
+			int different = 0;
+			if (form > 0)
+			{
+				different = countDifferent(batches[0], batches[form]);
+				if (different > 0)
+				{
+					fprintf(stderr, "  %s differs from scalar on %d rays\n", formNames[form], different);
+				}
+			}
+			printf("%-14s %-7s %7d %7d %9d %10.3f\n", groupNames[g], formNames[form],
+					result.hits, result.ambiguous, result.fails + different, result.worst);
+			failed += result.fails + different;
+		}
+	}
+
+	// Exact cases
+	{
+		float tt = -1.0f;
+		// Unit sphere, from (0,0,-3) along +z: enters at 2
+		const bool frontHit = RayTracing::intersectSphere(vec3_t(0,0,-3), vec3_t(0,0,1), 1.0f, 0.0f, INFINITY, tt);
+		if ( !frontHit || tt != 2.0f ) { fprintf(stderr, "  front hit: %d t=%g\n", frontHit, tt); failed++; }
+		// From the center: leaves at 1
+		const bool centerHit = RayTracing::intersectSphere(vec3_t(0,0,0), vec3_t(0,0,1), 1.0f, 0.0f, INFINITY, tt);
+		if ( !centerHit || tt != 1.0f ) { fprintf(stderr, "  center hit: %d t=%g\n", centerHit, tt); failed++; }
+		// Exactly tangent at (1,0,0)
+		const bool tangentHit = RayTracing::intersectSphere(vec3_t(1,0,-2), vec3_t(0,0,1), 1.0f, 0.0f, INFINITY, tt);
+		if ( !tangentHit || tt != 2.0f ) { fprintf(stderr, "  tangent hit: %d t=%g\n", tangentHit, tt); failed++; }
+		// Behind the ray
+		const bool behind = RayTracing::intersectSphere(vec3_t(0,0,3), vec3_t(0,0,1), 1.0f, 0.0f, INFINITY, tt);
+		if (behind) { fprintf(stderr, "  sphere behind the ray was hit\n"); failed++; }
+	}
+
+	for (int i=0; i<3; i++)
+	{
+		delete[] t[i];
+		delete[] hit[i];
+	}
+	delete[] refs;
+	delete[] t1;
+	delete[] t0;
+	delete[] r2;
+	delete[] d;
+	delete[] f;
+
+	if (failed)
+	{
+		printf("FAILED: %d checks\n", failed);
+		return 1;
+	}
+	printf("All passed\n");
+	return 0;
+}
@@ -0,0 +1,546 @@
+/*
+ * Copyright:
+ * Daniel D. Neilson (ddneilson@ieee.org)
+ * University of Saskatchewan
+ * All rights reserved
+ *
+ * Permission granted to use for use in assignments and
+ * projects for CMPT 485 & CMPT 829 at the University
+ * of Saskatchewan.
+ */
+
+/*
+ * Test of the watertight ray-triangle intersection,
+ * RayTracing::intersectTriangle(); Mesh's default triangle test.
+ *
+ * Leaks: rays from inside closed, convex meshes are aimed exactly at
+ * their edges and vertices. Every one must hit the mesh, where it
+ * leaves it; a ray that slips between the triangles sharing the edge
+ * or vertex is a leak.
+ *
+ * Accuracy: rays at single triangles are checked against a double
+ * precision Moller-Trumbore of the same inputs. A ray must hit or miss
+ * as the reference does, and t, u & v must be within the error that
+ * float rounding can cause. Where that error could change the answer
+ * (the ray is within rounding of an edge, or t of t0 or t1) either
+ * answer is accepted.
+ *
+ * Exits with 1 if any check fails.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <math.h>
+
+#include "../src/RayTracing/analytic.h"
+
+using namespace gml;
+using RayTracing::Triangle_t;
+
+static const double EPS = 1.0/(1 << 24); // float rounding
+static const int N_RAYS = 1 << 16; // Per group
+static const int N_MESH_RAYS = 1 << 14; // Per mesh & target
+
+// Uniform in [lo, hi)
+static float uniform(const float lo, const float hi)
+{
+	return lo + (hi - lo)*((float)rand() / ((float)RAND_MAX + 1.0f));
+}
+// Uniform in log scale
+static float logUniform(const float lo, const float hi)
+{
+	return expf( uniform(logf(lo), logf(hi)) );
+}
+static vec3_t randomDir()
+{
+	vec3_t v;
+	do
+	{
+		v = vec3_t(uniform(-1,1), uniform(-1,1), uniform(-1,1));
+	} while ( length2(v) < 1e-4f || length2(v) > 1.0f );
+	return normalize(v);
+}
+
+static float maxAbs(const vec3_t &v)
+{
+	return fmaxf( fabsf(v.x), fmaxf(fabsf(v.y), fabsf(v.z)) );
+}
+
+static RayTracing::Ray_t makeRay(const vec3_t &o, const vec3_t &d)
+{
+	RayTracing::Ray_t ray;
+	ray.o = o;
+	ray.d = d;
+	return ray;
+}
+
+// -----------------------------------------
+// Leaks
+// -----------------------------------------
+
+// A closed, convex triangle mesh; as Mesh lays it out for ray tracing
+typedef struct
+{
+	const char *name;
+	vec3_t center; // Inside
+	float inside; // Rays start within this of the center
+	int nVerts;
+	vec3_t *verts;
+	int nTris;
+	GLuint *indices; // 3 per triangle
+	Triangle_t *tris;
+} ClosedMesh;
+
+static void allocMesh(ClosedMesh &m, const char *name, const int nVerts, const int nTris)
+{
+	m.name = name;
+	m.nVerts = nVerts;
+	m.verts = new vec3_t[nVerts];
+	m.nTris = nTris;
+	m.indices = new GLuint[3*nTris];
+	m.tris = new Triangle_t[nTris];
+}
+
+static void freeMesh(ClosedMesh &m)
+{
+	delete[] m.verts;
+	delete[] m.indices;
+	delete[] m.tris;
+}
+
+static void setTriangles(ClosedMesh &m)
+{
+	for (int i=0; i<m.nTris; i++)
+	{
+		m.tris[i].v0 = m.verts[m.indices[3*i]];
+		m.tris[i].v1 = m.verts[m.indices[3*i+1]];
+		m.tris[i].v2 = m.verts[m.indices[3*i+2]];
+	}
+}
+
+// Latitude-longitude sphere; a vertex at each pole, where nLon triangles meet
+static void makeSphere(ClosedMesh &m, const int nLon, const int nLat, const vec3_t &center, const float radius)
+{
+	allocMesh(m, "sphere", 2 + nLon*(nLat-1), 2*nLon*(nLat-1));
+	m.center = center;
+	m.inside = 0.5f*radius;
+	m.verts[0] = add(center, vec3_t(0, radius, 0));
+	m.verts[1] = add(center, vec3_t(0, -radius, 0));
+	for (int j=1; j<nLat; j++)
+	{
+		for (int i=0; i<nLon; i++)
+		{
+			const float theta = (float)(M_PI*j/nLat), phi = (float)(2*M_PI*i/nLon);
+			m.verts[2 + (j-1)*nLon + i] = add(center,
+					scale(radius, vec3_t(sinf(theta)*cosf(phi), cosf(theta), sinf(theta)*sinf(phi))));
+		}
+	}
+	GLuint *idx = m.indices;
+	for (int i=0; i<nLon; i++)
+	{
+		const GLuint a = 2 + i, b = 2 + (i+1)%nLon;
+		*idx++ = 0; *idx++ = b; *idx++ = a;
+		const GLuint c = 2 + (nLat-2)*nLon + i, d = 2 + (nLat-2)*nLon + (i+1)%nLon;
+		*idx++ = 1; *idx++ = c; *idx++ = d;
+	}
+	for (int j=1; j<nLat-1; j++)
+	{
+		for (int i=0; i<nLon; i++)
+		{
+			const GLuint a = 2 + (j-1)*nLon + i, b = 2 + (j-1)*nLon + (i+1)%nLon;
+			const GLuint c = a + nLon, d = b + nLon;
+			*idx++ = a; *idx++ = b; *idx++ = c;
+			*idx++ = b; *idx++ = d; *idx++ = c;
+		}
+	}
+	setTriangles(m);
+}
+
+// Cube, far from the origin; its coordinates have few bits to spare
+static void makeFarCube(ClosedMesh &m, const vec3_t &center, const float halfSize)
+{
+	static const GLuint faces[12*3] =
+	{
+		0, 1, 3,  0, 3, 2, // -x
+		4, 6, 7,  4, 7, 5, // +x
+		0, 4, 5,  0, 5, 1, // -y
+		2, 3, 7,  2, 7, 6, // +y
+		0, 2, 6,  0, 6, 4, // -z
+		1, 5, 7,  1, 7, 3  // +z
+	};
+	allocMesh(m, "far cube", 8, 12);
+	m.center = center;
+	m.inside = 0.5f*halfSize;
+	for (int i=0; i<8; i++)
+	{
+		m.verts[i] = add(center, scale(halfSize, vec3_t((i & 4) ? 1 : -1, (i & 2) ? 1 : -1, (i & 1) ? 1 : -1)));
+	}
+	for (int i=0; i<12*3; i++) m.indices[i] = faces[i];
+	setTriangles(m);
+}
+
+// Two cones on an n-gon; n thin triangles meet at each apex
+static void makeBipyramid(ClosedMesh &m, const int n)
+{
+	allocMesh(m, "bipyramid", n + 2, 2*n);
+	m.center = vec3_t(0, 0, 0);
+	m.inside = 0.4f;
+	m.verts[0] = vec3_t(0, 2, 0);
+	m.verts[1] = vec3_t(0, -2, 0);
+	for (int i=0; i<n; i++)
+	{
+		const float phi = (float)(2*M_PI*i/n);
+		m.verts[2 + i] = vec3_t(cosf(phi), 0, sinf(phi));
+	}
+	for (int i=0; i<n; i++)
+	{
+		const GLuint a = 2 + i, b = 2 + (i+1)%n;
+		m.indices[6*i] = 0; m.indices[6*i+1] = b; m.indices[6*i+2] = a;
+		m.indices[6*i+3] = 1; m.indices[6*i+4] = a; m.indices[6*i+5] = b;
+	}
+	setTriangles(m);
+}
+
+// Nearest hit of the ray on the mesh; as Mesh::rayIntersects()
+static bool nearestHit(const ClosedMesh &m, const RayTracing::Ray_t &ray, float &tHit)
+{
+	const RayTracing::WatertightRay_t wray = RayTracing::makeWatertightRay(ray);
+	float tMax = INFINITY, t, u, v;
+	bool hit = false;
+	for (int i=0; i<m.nTris; i++)
+	{
+		if ( RayTracing::intersectTriangle(wray, m.tris[i], 0.0f, tMax, t, u, v) )
+		{
+			tMax = t;
+			hit = true;
+		}
+	}
+	tHit = tMax;
+	return hit;
+}
+
+typedef enum
+{
+	AT_EDGE,   // A point on an edge; half of them its midpoint
+	AT_VERTEX, // Exactly a vertex
+	N_TARGETS
+} Target;
+static const char *targetNames[N_TARGETS] = { "edges", "vertices" };
+
+static int checkLeaks(const ClosedMesh &m, const Target target)
+{
+	int leaks = 0, wrongT = 0;
+	double worst = 0.0;
+	for (int k=0; k<N_MESH_RAYS; k++)
+	{
+		const GLuint *tri = m.indices + 3*(rand() % m.nTris);
+		const int e = rand() % 3;
+		const vec3_t &a = m.verts[tri[e]], &b = m.verts[tri[(e+1)%3]];
+		vec3_t p = a;
+		if (target == AT_EDGE)
+		{
+			const float s = (rand() & 1) ? 0.5f : uniform(0.0f, 1.0f);
+			p = add( scale(1.0f - s, a), scale(s, b) );
+		}
+		const vec3_t o = add( m.center, scale(uniform(0.0f, m.inside), randomDir()) );
+		const vec3_t toP = sub(p, o);
+		const RayTracing::Ray_t ray = makeRay(o, normalize(toP));
+
+		float t;
+		if ( !nearestHit(m, ray, t) )
+		{
+			if (leaks < 4)
+			{
+				fprintf(stderr, "  %s %s: ray o=(%.9g,%.9g,%.9g) d=(%.9g,%.9g,%.9g) leaked\n", m.name,
+						targetNames[target], o.x, o.y, o.z, ray.d.x, ray.d.y, ray.d.z);
+			}
+			leaks += 1;
+			continue;
+		}
+		// The mesh is convex, and o inside, so the ray leaves where it was aimed
+		const double dist = length(toP);
+		const double tol = 1e-5*dist + 16*EPS*(maxAbs(o) + maxAbs(p));
+		const double err = fabs(t - dist) / tol;
+		if (err > worst) worst = err;
+		if (err > 1.0)
+		{
+			if (wrongT < 4)
+			{
+				fprintf(stderr, "  %s %s: t=%.9g; expected %.9g (+-%g)\n", m.name, targetNames[target], t, dist, tol);
+			}
+			wrongT += 1;
+		}
+	}
+	printf("%-10s %-9s %7d %7d %9d %10.3f\n", m.name, targetNames[target], m.nTris, leaks, wrongT, worst);
+	return leaks + wrongT;
+}
+
+// -----------------------------------------
+// Accuracy
+// -----------------------------------------
+
+typedef struct
+{
+	bool hit;
+	double t, u, v;
+	// Either answer is right
+	bool ambiguous;
+	// The errors t, and u & v, may have; from float rounding
+	double tolT, tolUV;
+} Reference;
+
+static Reference solve(const RayTracing::Ray_t &ray, const Triangle_t &tri, const float t0, const float t1)
+{
+	const double o[3] = { ray.o.x, ray.o.y, ray.o.z }, d[3] = { ray.d.x, ray.d.y, ray.d.z };
+	const double p0[3] = { tri.v0.x, tri.v0.y, tri.v0.z };
+	const double p1[3] = { tri.v1.x, tri.v1.y, tri.v1.z };
+	const double p2[3] = { tri.v2.x, tri.v2.y, tri.v2.z };
+	double e1[3], e2[3], T[3];
+	for (int k=0; k<3; k++)
+	{
+		e1[k] = p1[k] - p0[k];
+		e2[k] = p2[k] - p0[k];
+		T[k] = o[k] - p0[k];
+	}
+	const double P[3] = { d[1]*e2[2] - d[2]*e2[1], d[2]*e2[0] - d[0]*e2[2], d[0]*e2[1] - d[1]*e2[0] };
+	const double Q[3] = { T[1]*e1[2] - T[2]*e1[1], T[2]*e1[0] - T[0]*e1[2], T[0]*e1[1] - T[1]*e1[0] };
+	const double det = P[0]*e1[0] + P[1]*e1[1] + P[2]*e1[2];
+
+	Reference ref;
+	ref.hit = false;
+	ref.ambiguous = false;
+	ref.t = ref.u = ref.v = 0.0;
+	ref.tolT = ref.tolUV = 0.0;
+	if (det == 0.0)
+	{
+		ref.ambiguous = true;
+		return ref;
+	}
+	ref.u = (P[0]*T[0] + P[1]*T[1] + P[2]*T[2]) / det;
+	ref.v = (Q[0]*d[0] + Q[1]*d[1] + Q[2]*d[2]) / det;
+	ref.t = (Q[0]*e2[0] + Q[1]*e2[1] + Q[2]*e2[2]) / det;
+
+	// The kernel works relative to the ray's origin, along the ray; its
+	// inputs there are off by the rounding of the coordinates, and of t
+	// times the shear. Those move the triangle's edges by the error over
+	// the triangle's smallest altitude, as seen along the ray.
+	const double e1Len = sqrt(e1[0]*e1[0] + e1[1]*e1[1] + e1[2]*e1[2]);
+	const double e2Len = sqrt(e2[0]*e2[0] + e2[1]*e2[1] + e2[2]*e2[2]);
+	const double e3Len = sqrt( (e2[0]-e1[0])*(e2[0]-e1[0]) + (e2[1]-e1[1])*(e2[1]-e1[1]) + (e2[2]-e1[2])*(e2[2]-e1[2]) );
+	const double n[3] = { e1[1]*e2[2] - e1[2]*e2[1], e1[2]*e2[0] - e1[0]*e2[2], e1[0]*e2[1] - e1[1]*e2[0] };
+	const double area2 = sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+	const double cosine = fabs(det) / area2; // |d| is 1
+	const double altitude = area2 / fmax(e1Len, fmax(e2Len, e3Len)) * cosine;
+	const double errPos = 4*EPS*( maxAbs(ray.o) + maxAbs(tri.v0) + maxAbs(tri.v1) + maxAbs(tri.v2) + fabs(ref.t) );
+	ref.tolUV = errPos / altitude;
+	ref.tolT = 8*EPS*fabs(ref.t) + errPos / cosine;
+
+	const double w = 1.0 - ref.u - ref.v;
+	const bool inside = (ref.u >= 0.0 && ref.v >= 0.0 && w >= 0.0);
+	const bool inRange = (ref.t >= t0 && ref.t <= t1);
+	ref.hit = inside && inRange;
+	if ( fabs(ref.u) <= ref.tolUV || fabs(ref.v) <= ref.tolUV || fabs(w) <= ref.tolUV ||
+			fabs(ref.t - t0) <= ref.tolT || fabs(ref.t - t1) <= ref.tolT )
+	{
+		ref.ambiguous = true;
+	}
+	return ref;
+}
+
+typedef enum
+{
+	INSIDE,   // Aimed inside the triangle
+	OUTSIDE,  // Aimed just outside of it
+	CLIPPED,  // [t0,t1] ends near the hit
+	GRAZING,  // Nearly in the triangle's plane
+	N_GROUPS
+} Group;
+static const char *groupNames[N_GROUPS] = { "inside", "outside", "clipped", "grazing" };
+
+static void makeCase(const Group group, Triangle_t &tri, RayTracing::Ray_t &ray, float &t0, float &t1)
+{
+	// A triangle of any size & shape, anywhere
+	const float size = logUniform(1e-2f, 1e2f);
+	const vec3_t c = scale(logUniform(1e-3f, 1e3f), randomDir());
+	tri.v0 = add( c, scale(size, randomDir()) );
+	tri.v1 = add( c, scale(size, randomDir()) );
+	tri.v2 = add( c, scale(size, randomDir()) );
+
+	// The point aimed at, by barycentric coordinates
+	float u, v;
+	if (group == OUTSIDE)
+	{
+		// Past one edge, by a little or a lot
+		u = uniform(-0.2f, 1.2f);
+		v = -logUniform(1e-6f, 1e-1f);
+		if (rand() & 1) { const float s = u; u = v; v = s; }
+		if (rand() & 1) { const float w = 1.0f - u - v; u = w; }
+	}
+	else
+	{
+		do
+		{
+			u = uniform(0.0f, 1.0f);
+			v = uniform(0.0f, 1.0f);
+		} while (u + v > 1.0f);
+	}
+	const vec3_t p = add( tri.v0, add(scale(u, sub(tri.v1, tri.v0)), scale(v, sub(tri.v2, tri.v0))) );
+
+	const vec3_t n = normalize( cross(sub(tri.v1, tri.v0), sub(tri.v2, tri.v0)) );
+	vec3_t dir;
+	if (group == GRAZING)
+	{
+		// Within a small angle of the plane
+		dir = normalize( add(sub(randomDir(), scale(dot(randomDir(), n), n)), scale(uniform(-1e-3f, 1e-3f), n)) );
+	}
+	else
+	{
+		do
+		{
+			dir = randomDir();
+		} while ( fabsf(dot(dir, n)) < 0.05f );
+	}
+	const vec3_t o = sub( p, scale(size*logUniform(1e-1f, 1e2f), dir) );
+	ray = makeRay(o, normalize(sub(p, o)));
+
+	t0 = 0.0f;
+	t1 = INFINITY;
+	if (group == CLIPPED)
+	{
+		const float tHit = length(sub(p, o));
+		t0 = tHit*uniform(0.99f, 1.01f);
+		t1 = tHit*uniform(1.0f, 1.02f);
+		if (rand() & 1) { t1 = t0; t0 = tHit*uniform(0.98f, 1.0f); }
+	}
+}
+
+static int checkAccuracy(const Group group)
+{
+	int fails = 0, hits = 0, ambiguous = 0;
+	double worstT = 0.0, worstUV = 0.0;
+	for (int k=0; k<N_RAYS; k++)
+	{
+		Triangle_t tri;
+		RayTracing::Ray_t ray;
+		float t0, t1;
+		makeCase(group, tri, ray, t0, t1);
+		const Reference ref = solve(ray, tri, t0, t1);
+
+		float t = -1.0f, u = -1.0f, v = -1.0f;
+		const bool hit = RayTracing::intersectTriangle(RayTracing::makeWatertightRay(ray), tri, t0, t1, t, u, v);
+		if (hit) hits += 1;
+		if (ref.ambiguous) ambiguous += 1;
+
+		bool ok;
+		if ( !hit )
+		{
+			ok = !ref.hit || ref.ambiguous;
+		}
+		else if ( !ref.hit && !ref.ambiguous )
+		{
+			ok = false;
+		}
+		else
+		{
+			const double errT = fabs(t - ref.t) / ref.tolT;
+			const double errUV = fmax( fabs(u - ref.u), fabs(v - ref.v) ) / ref.tolUV;
+			if (errT > worstT) worstT = errT;
+			if (errUV > worstUV) worstUV = errUV;
+			ok = (errT <= 1.0) && (errUV <= 1.0) && (t >= t0) && (t <= t1);
+		}
+		if ( !ok )
+		{
+			if (fails < 4)
+			{
+				fprintf(stderr, "  %s ray %d: got %s t=%.9g u=%.9g v=%.9g; expected %s t=%.9g u=%.9g v=%.9g"
+						" (+-%g, +-%g)%s\n", groupNames[group], k, hit ? "hit" : "miss", t, u, v,
+						ref.hit ? "hit" : "miss", ref.t, ref.u, ref.v, ref.tolT, ref.tolUV,
+						ref.ambiguous ? " ambiguous" : "");
+			}
+			fails += 1;
+		}
+	}
+	printf("%-10s %7d %7d %9d %10.3f %10.3f\n", groupNames[group], hits, ambiguous, fails, worstT, worstUV);
+	return fails;
+}
+
+int main()
+{
+	srand(485);
+	int failed = 0;
+
+	ClosedMesh meshes[3];
+	makeSphere(meshes[0], 64, 32, vec3_t(0.3f, -0.2f, 0.1f), 3.7f);
+	makeFarCube(meshes[1], vec3_t(1000.0f, -2000.0f, 500.0f), 1.5f);
+	makeBipyramid(meshes[2], 64);
+
+	printf("%-10s %-9s %7s %7s %9s %10s\n", "mesh", "aimed at", "tris", "leaks", "wrong t", "worst/tol");
+	for (int i=0; i<3; i++)
+	{
+		for (int target=0; target<N_TARGETS; target++)
+		{
+			failed += checkLeaks(meshes[i], (Target)target);
+		}
+		freeMesh(meshes[i]);
+	}
+
+	printf("\n%-10s %7s %7s %9s %10s %10s\n", "group", "hits", "ambig", "fails", "t/tol", "uv/tol");
+	for (int g=0; g<N_GROUPS; g++)
+	{
+		failed += checkAccuracy((Group)g);
+	}
+
+	// Exact cases
+	{
+		Triangle_t tri;
+		tri.v0 = vec3_t(0,0,0);
+		tri.v1 = vec3_t(1,0,0);
+		tri.v2 = vec3_t(0,1,0);
+		float t = -1.0f, u = -1.0f, v = -1.0f;
+		// Straight down onto (0.25,0.25): t, u & v are exact
+		const bool centerHit = RayTracing::intersectTriangle(RayTracing::makeWatertightRay(makeRay(vec3_t(0.25f,0.25f,1), vec3_t(0,0,-1))),
+				tri, 0.0f, INFINITY, t, u, v);
+		if ( !centerHit || t != 1.0f || u != 0.25f || v != 0.25f )
+		{
+			fprintf(stderr, "  center hit: %d t=%g u=%g v=%g\n", centerHit, t, u, v); failed++;
+		}
+		// From below; triangles are two-sided
+		const bool backHit = RayTracing::intersectTriangle(RayTracing::makeWatertightRay(makeRay(vec3_t(0.25f,0.25f,-2), vec3_t(0,0,1))),
+				tri, 0.0f, INFINITY, t, u, v);
+		if ( !backHit || t != 2.0f ) { fprintf(stderr, "  back hit: %d t=%g\n", backHit, t); failed++; }
+		// Exactly on the corners & the long edge
+		const vec3_t onEdge[4] = { vec3_t(0,0,1), vec3_t(1,0,1), vec3_t(0,1,1), vec3_t(0.5f,0.5f,1) };
+		for (int i=0; i<4; i++)
+		{
+			if ( !RayTracing::intersectTriangle(RayTracing::makeWatertightRay(makeRay(onEdge[i], vec3_t(0,0,-1))),
+					tri, 0.0f, INFINITY, t, u, v) )
+			{
+				fprintf(stderr, "  missed the edge at (%g,%g)\n", onEdge[i].x, onEdge[i].y); failed++;
+			}
+		}
+		// Behind the ray
+		if ( RayTracing::intersectTriangle(RayTracing::makeWatertightRay(makeRay(vec3_t(0.25f,0.25f,-1), vec3_t(0,0,-1))),
+				tri, 0.0f, INFINITY, t, u, v) )
+		{
+			fprintf(stderr, "  triangle behind the ray was hit\n"); failed++;
+		}
+		// Degenerate; its vertices are on a line
+		Triangle_t line;
+		line.v0 = vec3_t(0,0,0);
+		line.v1 = vec3_t(1,1,0);
+		line.v2 = vec3_t(2,2,0);
+		if ( RayTracing::intersectTriangle(RayTracing::makeWatertightRay(makeRay(vec3_t(1,1,1), vec3_t(0,0,-1))),
+				line, 0.0f, INFINITY, t, u, v) )
+		{
+			fprintf(stderr, "  degenerate triangle was hit\n"); failed++;
+		}
+	}
+
+	if (failed)
+	{
+		printf("FAILED: %d checks\n", failed);
+		return 1;
+	}
+	printf("All passed\n");
+	return 0;
+}